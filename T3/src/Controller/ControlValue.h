@@ -0,0 +1,55 @@
+/**
+ * @file  ControlValue.h
+ * @brief 制御演算に使う数値型(浮動小数点/Q16.16固定小数点)の切り替え
+ *
+ * CONTROL_FIXED_POINTを1にすると,制御割り込みの演算を
+ * 32bit整数(下位16bitが小数部)で行う.
+ * 値の生成,演算はここのマクロを通して行い,型の違いを意識しない.
+ */
+
+#ifndef __CONTROLVALUE_H__
+#define __CONTROLVALUE_H__
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "../typedefine.h"
+
+/*----------------------------------------------------------------------
+	Macro Definitions
+ ----------------------------------------------------------------------*/
+// ホスト試験(test/ControlTest.c)では両方をビルドするため外から与える
+#ifndef CONTROL_FIXED_POINT
+#define CONTROL_FIXED_POINT	0	// 0:float, 1:Q16.16固定小数点
+#endif
+
+#if CONTROL_FIXED_POINT
+typedef _SDWORD CTRL_VAL;
+#define CTRL_Q					16
+#define CTRL_ONE				((CTRL_VAL)1 << CTRL_Q)
+#define CTRL_CONST(c)			((CTRL_VAL)((c) * 65536.0 + (((c) >= 0) ? 0.5 : -0.5)))	// 定数式(コンパイル時に計算)
+#define CTRL_FROM_FLOAT(f)		((CTRL_VAL)((f) * 65536.0f))
+#define CTRL_FROM_INT(i)		((CTRL_VAL)(i) << CTRL_Q)
+#define CTRL_TO_FLOAT(v)		((float)(v) * (1.0f / 65536.0f))
+#define CTRL_TO_INT(v)			((v) >> CTRL_Q)
+#define CTRL_MUL(a, b)			((CTRL_VAL)(((long long)(a) * (b) + (1 << (CTRL_Q - 1))) >> CTRL_Q))	// 四捨五入
+#define CTRL_MULI(a, i)			((a) * (i))			// 整数との積
+#define CTRL_DIVI(a, i)			((CTRL_VAL)(((a) + (((a) >= 0) ? (i) / 2 : -(i) / 2)) / (i)))	// 正の整数での商(四捨五入)
+// 正の整数での商を積算する(割り切れない分をremに持ち越し,毎周期の丸めを積もらせない)
+#define CTRL_INTEG(acc, a, i, rem)	do { CTRL_VAL n_ = (a) + (rem); (acc) += n_ / (i); (rem) = n_ % (i); } while(0)
+#else
+typedef float CTRL_VAL;
+#define CTRL_ONE				1.0f
+#define CTRL_CONST(c)			((CTRL_VAL)(c))
+#define CTRL_FROM_FLOAT(f)		((CTRL_VAL)(f))
+#define CTRL_FROM_INT(i)		((CTRL_VAL)(i))
+#define CTRL_TO_FLOAT(v)		((float)(v))
+#define CTRL_TO_INT(v)			((_SDWORD)(v))
+#define CTRL_MUL(a, b)			((a) * (b))
+#define CTRL_MULI(a, i)			((a) * (float)(i))
+#define CTRL_DIVI(a, i)			((a) * (1.0f / (i)))
+#define CTRL_INTEG(acc, a, i, rem)	do { (void)(rem); (acc) += CTRL_DIVI(a, i); } while(0)
+#endif
+
+#define CTRL_ABS(v)				(((v) > 0) ? (v) : -(v))
+
+#endif /* __CONTROLVALUE_H__ */
@@ -0,0 +1,48 @@
+/**
+ * @file  MazeDefine.h
+ * @brief 迷路の大きさと,それに応じたデータ型の定義
+ */
+
+#ifndef __MAZEDEFINE_H__
+#define __MAZEDEFINE_H__
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "../typedefine.h"
+
+/*----------------------------------------------------------------------
+	Macro Definitions
+ ----------------------------------------------------------------------*/
+// ==== 迷路の一辺の区画数(16:クラシック, 32:ハーフ) ====
+#ifndef MAZE_SIZE
+#define MAZE_SIZE		16
+#endif
+#define MAZE_CELL_NUM	(MAZE_SIZE * MAZE_SIZE)		// 全区画数
+
+#if MAZE_SIZE == 16
+#define MAZE_COORD_BITS	4		// 座標のビット数
+#define STEP_MAX		0xff	// 歩数の最大値(未到達)
+#elif MAZE_SIZE == 32
+#define MAZE_COORD_BITS	5
+#define STEP_MAX		0xffff
+#else
+#error "MAZE_SIZE must be 16 or 32"
+#endif
+
+/*----------------------------------------------------------------------
+	Typedef Definitions
+ ----------------------------------------------------------------------*/
+#if MAZE_SIZE == 16
+typedef _UBYTE MAZE_STEP;		// 歩数
+typedef _UBYTE MAZE_CELL;		// 区画番号(y * MAZE_SIZE + x)
+typedef _UWORD MAZE_ROW;		// 1行分の区画のビット列
+#else
+typedef _UWORD MAZE_STEP;
+typedef _UWORD MAZE_CELL;
+typedef _UDWORD MAZE_ROW;
+#endif
+
+// 1行分の全区画のビット(MAZE_ROWがMAZE_SIZEより広い処理系でも外へはみ出したビットを落とす)
+#define MAZE_ROW_ALL	((MAZE_ROW)((((MAZE_ROW)1 << (MAZE_SIZE - 1)) << 1) - 1))
+
+#endif /* __MAZEDEFINE_H__ */
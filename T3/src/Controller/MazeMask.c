@@ -0,0 +1,139 @@
+/**
+ * @file  MazeMask.c
+ * @brief 壁情報を行ごとのビット列で保持し,歩数マップを行単位で展開するクラス
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "MazeMask.h"
+
+/*----------------------------------------------------------------------
+	Public Method Definitions
+ ----------------------------------------------------------------------*/
+/**
+ * map形式の壁情報をビット列に変換する
+ * @param mask: 変換先のビット列
+ * @param map: 変換元のマップ
+ * @param shift: 変換する4bit(MAZE_MASK_SEARCH or MAZE_MASK_SECOND)
+ * @retval void
+ */
+void MazeMask_FromMap(MazeMask* mask, _UBYTE map[MAZE_SIZE][MAZE_SIZE], _UBYTE shift)
+{
+	_UBYTE x, y;
+
+	for(y = 0; y < MAZE_SIZE; y++)
+	{
+		mask->North[y] = mask->East[y] = mask->South[y] = mask->West[y] = 0;
+		for(x = 0; x < MAZE_SIZE; x++)
+		{
+			MazeMask_LoadCell(mask, map, shift, x, y);
+		}
+	}
+}
+
+/**
+ * ビット列の壁情報をmap形式に書き戻す
+ * @param mask: 変換元のビット列
+ * @param map: 変換先のマップ(shiftで指定しない側の4bitは保持する)
+ * @param shift: 書き込む4bit(MAZE_MASK_SEARCH or MAZE_MASK_SECOND)
+ * @retval void
+ */
+void MazeMask_ToMap(const MazeMask* mask, _UBYTE map[MAZE_SIZE][MAZE_SIZE], _UBYTE shift)
+{
+	_UBYTE x, y;
+	_UBYTE wall;
+
+	for(y = 0; y < MAZE_SIZE; y++)
+	{
+		for(x = 0; x < MAZE_SIZE; x++)
+		{
+			wall = 0x00;
+			if(mask->North[y] & ((MAZE_ROW)1 << x))	wall |= 0x08;
+			if(mask->East[y] & ((MAZE_ROW)1 << x))	wall |= 0x04;
+			if(mask->South[y] & ((MAZE_ROW)1 << x))	wall |= 0x02;
+			if(mask->West[y] & ((MAZE_ROW)1 << x))	wall |= 0x01;
+			map[y][x] = (map[y][x] & ~(0x0f << shift)) | (wall << shift);
+		}
+	}
+}
+
+/**
+ * map形式の1区画分の壁情報をビット列に反映する
+ * @param mask: 反映先のビット列
+ * @param map: 反映元のマップ
+ * @param shift: 反映する4bit(MAZE_MASK_SEARCH or MAZE_MASK_SECOND)
+ * @param x, y: 反映する区画の座標
+ * @retval void
+ */
+void MazeMask_LoadCell(MazeMask* mask, _UBYTE map[MAZE_SIZE][MAZE_SIZE], _UBYTE shift, _UBYTE x, _UBYTE y)
+{
+	_UBYTE wall = map[y][x] >> shift;
+	MAZE_ROW bit = (MAZE_ROW)1 << x;
+
+	mask->North[y] = (wall & 0x08)?	(mask->North[y] | bit) : (mask->North[y] & ~bit);
+	mask->East[y] = (wall & 0x04)?	(mask->East[y] | bit) : (mask->East[y] & ~bit);
+	mask->South[y] = (wall & 0x02)?	(mask->South[y] | bit) : (mask->South[y] & ~bit);
+	mask->West[y] = (wall & 0x01)?	(mask->West[y] | bit) : (mask->West[y] & ~bit);
+}
+
+/**
+ * 歩数マップを作成する
+ *   歩数kの区画の集合(波面)を行ごとのビット列で持ち,シフトとAND/ORで
+ *   1行分の区画をまとめて歩数k+1の区画へ展開する
+ *   16区画の迷路では波面が数区画しかない歩数が大半で,全行を毎歩数なめる分,
+ *   キューによる幅優先探索(Search_MakeStepMap)より遅い(test/MazeMaskTest.cで比べる).
+ *   このため探索の歩数マップには使っていない
+ * @param mask: 壁情報のビット列
+ * @param goal: ゴール区画のビット列(歩数0とする区画)
+ * @param smap: 作成する歩数マップ(到達できない区画はSTEP_MAX)
+ * @retval void
+ */
+void MazeMask_MakeStepMap(const MazeMask* mask, const MAZE_ROW goal[MAZE_SIZE], MAZE_STEP smap[MAZE_SIZE][MAZE_SIZE])
+{
+	MAZE_ROW front[MAZE_SIZE];		// 現在の波面
+	MAZE_ROW next[MAZE_SIZE];		// 次の波面
+	MAZE_ROW visited[MAZE_SIZE];	// 歩数が決まった区画
+	MAZE_ROW any;					// 次の波面が空でないか
+	MAZE_STEP step = 0;
+	_UBYTE x, y;
+
+	// ---- 歩数マップのクリアとゴールの設定 ----
+	for(y = 0; y < MAZE_SIZE; y++)
+	{
+		front[y] = visited[y] = goal[y];
+		for(x = 0; x < MAZE_SIZE; x++)
+		{
+			smap[y][x] = (goal[y] & ((MAZE_ROW)1 << x))?	0 : STEP_MAX;
+		}
+	}
+
+	// ---- 波面がなくなるまで展開 ----
+	do
+	{
+		step++;
+		any = 0;
+		for(y = 0; y < MAZE_SIZE; y++)
+		{
+			// 同じ行の東西,隣の行の南北へ壁のない区画だけを進める
+			next[y] = (MAZE_ROW)(((front[y] & ~mask->East[y]) << 1) & MAZE_ROW_ALL) | ((front[y] & ~mask->West[y]) >> 1);
+			if(y != 0)		next[y] |= front[y-1] & ~mask->North[y-1];
+			if(y != MAZE_SIZE - 1)	next[y] |= front[y+1] & ~mask->South[y+1];
+			next[y] &= ~visited[y];
+			any |= next[y];
+		}
+		for(y = 0; y < MAZE_SIZE; y++)
+		{
+			visited[y] |= next[y];
+			front[y] = next[y];
+			// 新しく到達した区画にだけ歩数を書き込む
+			for(x = 0; next[y] != 0; x++, next[y] >>= 1)
+			{
+				if(next[y] & 0x0001)
+				{
+					smap[y][x] = step;
+				}
+			}
+		}
+	}while(any != 0);
+}
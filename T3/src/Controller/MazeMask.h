@@ -0,0 +1,41 @@
+/**
+ * @file  MazeMask.h
+ * @brief 壁情報を行ごとのビット列で保持し,歩数マップを行単位で展開するクラス
+ */
+
+#ifndef __MAZEMASK_H__
+#define __MAZEMASK_H__
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "../typedefine.h"
+#include "MazeDefine.h"
+
+/*----------------------------------------------------------------------
+	Macro Definitions
+ ----------------------------------------------------------------------*/
+// ==== mapのどちらの4bitを変換するか ====
+#define MAZE_MASK_SEARCH	0	// 下位4bit(未探索の壁はなしとする:探索走行用)
+#define MAZE_MASK_SECOND	4	// 上位4bit(未探索の壁はありとする:二次走行用)
+
+/*----------------------------------------------------------------------
+	Struct Definitions
+ ----------------------------------------------------------------------*/
+// ==== 壁方向ごとの行ビット列(行yのbit xが区画(x, y)の壁) ====
+typedef struct stMazeMask
+{
+	MAZE_ROW North[MAZE_SIZE];		// 北壁
+	MAZE_ROW East[MAZE_SIZE];		// 東壁
+	MAZE_ROW South[MAZE_SIZE];		// 南壁
+	MAZE_ROW West[MAZE_SIZE];		// 西壁
+}MazeMask;
+
+/*----------------------------------------------------------------------
+	Public Method Declarations
+ ----------------------------------------------------------------------*/
+void MazeMask_FromMap(MazeMask* mask, _UBYTE map[MAZE_SIZE][MAZE_SIZE], _UBYTE shift);
+void MazeMask_ToMap(const MazeMask* mask, _UBYTE map[MAZE_SIZE][MAZE_SIZE], _UBYTE shift);
+void MazeMask_LoadCell(MazeMask* mask, _UBYTE map[MAZE_SIZE][MAZE_SIZE], _UBYTE shift, _UBYTE x, _UBYTE y);
+void MazeMask_MakeStepMap(const MazeMask* mask, const MAZE_ROW goal[MAZE_SIZE], MAZE_STEP smap[MAZE_SIZE][MAZE_SIZE]);
+
+#endif /* __MAZEMASK_H__ */
@@ -0,0 +1,202 @@
+/**
+ * @file  MotionPlan.c
+ * @brief 最短経路を動作単位の列に変換し,連続走行させるクラス
+ *
+ * 1区画1バイトの経路(0x88/0x44/0x22/0x11)を,「旋回してから半区画n個分の直進」と
+ * 「半区画n個分の直進」の列にまとめる.直進は区画ごとに止まらず
+ * 1回の加減速で走る.
+ * 1動作は1区画以上を受け持つので,動作列は経路より長くならない.
+ * 動作列は経路の格納先にそのまま上書きし,別の格納先を持たない.
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "MotionPlan.h"
+#include "MouseController.h"
+#include "../Global.h"
+
+/*----------------------------------------------------------------------
+	Macro Definitions
+ ----------------------------------------------------------------------*/
+#define MOTION_SEG_MAX		3		// 1つの旋回,直進が使う走行区間の最大数
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+static _UBYTE* _motion = 0;		// 動作列(経路の格納先を上書きしたもの.終端にMOTION_END)
+
+/*----------------------------------------------------------------------
+	Private Method Declarations
+ ----------------------------------------------------------------------*/
+static bool MotionPlan_Push(_UWORD* i, _UBYTE motion);
+static bool MotionPlan_WaitSpace(void);
+
+/*----------------------------------------------------------------------
+	Public Method Definitions
+ ----------------------------------------------------------------------*/
+/**
+ * 経路を動作列に変換する
+ *   動作列は経路に上書きする(読み終えた区画の位置にしか書かないので,未読の区画は壊さない)
+ * @param route: 経路(Search_MakeRouteと同じ形式, 0xffで終端, MAZE_CELL_NUM個)
+ * @retval bool: 変換できたらtrue (経路が終端していなければfalse)
+ */
+bool MotionPlan_Compile(_UBYTE* route)
+{
+	_UWORD i = 0;
+	_UWORD r;
+	_UBYTE motion = MOTION_END;	// まとめている動作(MOTION_ENDならなし)
+	_UBYTE halfNum = 0;			// まとめている直進の半区画数
+	_UBYTE turn;
+
+	_motion = route;
+	for(r = 0; (r < MAZE_CELL_NUM) && (route[r] != 0xff); r++)
+	{
+		// ---- 経路の各区画は「旋回してから1区画前進」 ----
+		switch(route[r])
+		{
+		case 0x44:	turn = MOTION_R90;		break;
+		case 0x11:	turn = MOTION_L90;		break;
+		case 0x22:	turn = MOTION_180;		break;
+		default:	turn = MOTION_STRAIGHT;	break;
+		}
+
+		// ---- 旋回する区画,または直進が上限に達したらまとめた動作を出力 ----
+		if((motion != MOTION_END) && ((turn != MOTION_STRAIGHT) || (halfNum + 2 > MOTION_NUM_MAX)))
+		{
+			if(!MotionPlan_Push(&i, motion | halfNum))
+			{
+				return false;
+			}
+			motion = MOTION_END;
+		}
+		if(motion == MOTION_END)
+		{
+			motion = turn;
+			halfNum = 0;
+		}
+		halfNum += 2;
+	}
+	if(r >= MAZE_CELL_NUM)
+	{
+		_motion[0] = MOTION_END;
+		return false;
+	}
+	if((motion != MOTION_END) && !MotionPlan_Push(&i, motion | halfNum))
+	{
+		return false;
+	}
+	_motion[i] = MOTION_END;
+
+	return true;
+}
+
+/**
+ * 動作列の取得
+ * @param void
+ * @retval const _UBYTE*: 動作列(MOTION_ENDで終端.変換前は0)
+ */
+const _UBYTE* MotionPlan_Get(void)
+{
+	return _motion;
+}
+
+/**
+ * 動作列に従って走行する
+ *   各動作を走行区間キューに先行して格納し,動作の間で止まらずに走る
+ *   スイッチが押されたらキューを破棄して停止する
+ * @param void
+ * @retval void
+ */
+void MotionPlan_Run(void)
+{
+	_UWORD i;
+	_UWORD seq = 0;
+
+	if(_motion == 0)
+	{
+		return;
+	}
+	for(i = 0; _motion[i] != MOTION_END; i++)
+	{
+		// ---- 1動作分の空きができるまで待つ(その間も前の動作は走行中) ----
+		if(!MotionPlan_WaitSpace())
+		{
+			return;
+		}
+
+		// ---- 旋回してから直進する ----
+		if((_motion[i] & MOTION_TYPE_MASK) != MOTION_STRAIGHT)
+		{
+			switch(_motion[i] & MOTION_TYPE_MASK)
+			{
+			case MOTION_R90:
+				TurnR90ADQueue();
+				break;
+			case MOTION_L90:
+				TurnL90ADQueue();
+				break;
+			default:
+				TurnR180ADQueue();
+				break;
+			}
+			if(!MotionPlan_WaitSpace())
+			{
+				return;
+			}
+		}
+		seq = SectionADQueue(_motion[i] & MOTION_NUM_MASK);
+	}
+
+	// ---- 全ての動作が終わるまで待つ ----
+	while(MouseController_GetQueueSpace() < SEG_QUEUE_SIZE - 1)
+	{
+		if(GetSwitchState())
+		{
+			MouseController_CancelSegment();
+			return;
+		}
+		Yield();
+	}
+	MouseController_WaitSegment(seq);
+}
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+/**
+ * 動作列の末尾に追加する
+ * @param i: 追加位置(追加後に1進める)
+ * @param motion: 動作
+ * @retval bool: 終端を書く場所がなくなったらfalse
+ */
+static bool MotionPlan_Push(_UWORD* i, _UBYTE motion)
+{
+	if(*i >= MAZE_CELL_NUM - 1)
+	{
+		_motion[0] = MOTION_END;
+		return false;
+	}
+	_motion[(*i)++] = motion;
+	return true;
+}
+
+/**
+ * 走行区間キューに1つの旋回,直進分の空きができるまで待つ
+ *   スイッチが押されたらキューを破棄して停止する
+ * @param void
+ * @retval bool: 空きができたらtrue (停止したらfalse)
+ */
+static bool MotionPlan_WaitSpace(void)
+{
+	while(MouseController_GetQueueSpace() < MOTION_SEG_MAX)
+	{
+		if(GetSwitchState())
+		{
+			MouseController_CancelSegment();
+			return false;
+		}
+		Yield();
+	}
+	return true;
+}
@@ -0,0 +1,37 @@
+/**
+ * @file  MotionPlan.h
+ * @brief 最短経路を動作単位の列に変換し,連続走行させるクラス
+ */
+
+#ifndef __MOTIONPLAN_H__
+#define __MOTIONPLAN_H__
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "../typedefine.h"
+#include "MazeDefine.h"
+#include <stdbool.h>
+
+/*----------------------------------------------------------------------
+	Macro Definitions
+ ----------------------------------------------------------------------*/
+// ==== 動作単位(上位2bit:種類, 下位6bit:直進の半区画数) ====
+//   旋回は,その後の直進(半区画数)と合わせて1動作とする
+#define MOTION_TYPE_MASK	0xc0
+#define MOTION_NUM_MASK		0x3f
+#define MOTION_STRAIGHT		0x00	// 直進(半区画数分を1回の加減速で走る)
+#define MOTION_R90			0x40	// 右90度旋回してから直進
+#define MOTION_L90			0x80	// 左90度旋回してから直進
+#define MOTION_180			0xc0	// 180度旋回してから直進
+#define MOTION_END			0xff	// 終端
+
+#define MOTION_NUM_MAX		(MOTION_NUM_MASK - 1)	// 1動作で走れる半区画数の最大値(偶数.MOTION_ENDと重ならない)
+
+/*----------------------------------------------------------------------
+	Public Method Declarations
+ ----------------------------------------------------------------------*/
+bool MotionPlan_Compile(_UBYTE* route);
+const _UBYTE* MotionPlan_Get(void);
+void MotionPlan_Run(void);
+
+#endif /* __MOTIONPLAN_H__ */
@@ -14,23 +14,53 @@
 #include "../Devices/AS5055.h"
 #include "../Devices/DRV8836.h"
 #include "../Devices/LightSensor.h"
+#include "../Devices/MPU6500.h"
+#include "../Peripherals/Timer.h"
+#include "../Utils/ParamStore.h"
+#include "../Peripherals/RSPI.h"
+#include "WheelEstimator.h"
+
+#if WHEEL_EST_RESOLUTION != ENCODER_RESOLUTION
+#error "WHEEL_EST_RESOLUTION must match ENCODER_RESOLUTION"
+#endif
+#if LS_DIST_POINTS * 2 > PARAM_VALUE_MAX
+#error "LS_DIST_POINTS does not fit in PARAM_VALUE_MAX"
+#endif
 
 /*----------------------------------------------------------------------
 	Private Global Variables
  ----------------------------------------------------------------------*/
-static FloatTimeSeriesVal _vel;			// 機体速度 [m/s]
-static FloatTimeSeriesVal _angvel;		// 機体角速度 [rad/s]
+static CtrlTimeSeriesVal _vel;			// 機体速度 [m/s]
+static CtrlTimeSeriesVal _angvel;		// 機体角速度 [rad/s]
 
 static BinaryTimeSeriesVal _wheelLAng;	// 左車輪回転角度
 static BinaryTimeSeriesVal _wheelRAng;	// 右車輪回転角度
-static FloatTimeSeriesVal _wheelLDist;	// 左車輪回転量
-static FloatTimeSeriesVal _wheelRDist;	// 右車輪回転量
-static FloatTimeSeriesVal _wheelLVel;	// 左車輪回転速度
-static FloatTimeSeriesVal _wheelRVel;	// 右車輪回転速度
-
-static float _x = 0;
-static _UWORD _t = 0;
+static CtrlTimeSeriesVal _wheelLDist;	// 左車輪回転量
+static CtrlTimeSeriesVal _wheelRDist;	// 右車輪回転量
+static CtrlTimeSeriesVal _wheelLVel;	// 左車輪回転速度
+static CtrlTimeSeriesVal _wheelRVel;	// 右車輪回転速度
+#if WHEEL_ESTIMATOR
+static WheelEstimator _estL;			// 左車輪の角度,角速度推定
+static WheelEstimator _estR;			// 右車輪の角度,角速度推定
+#endif
+
+static CTRL_VAL _x = 0;
+static CTRL_VAL _ang = 0;				// 旋回角度(右回りが正) [rad]
+static _UDWORD _t = 0;
+#if GYRO_FUSION
+static CTRL_VAL _angEnc = 0;			// 左右車輪の回転量の差から求めた旋回角度 [rad]
+static CTRL_VAL _angRem = 0;			// ジャイロの角速度の積算で持ち越す端数
+static CTRL_VAL _yawRate = 0;			// ジャイロの角速度(右回りが正) [rad/s]
+static CTRL_VAL _yawInteg = 0;			// 角速度偏差の積分 [rad]
+static CTRL_VAL _yawCorr = 0;			// 角速度ループの出力(目標角速度への加算分)
+#endif
 static bool _driving = false;;
+// センサ値の発行(書き込み中は奇数.読み出し側は前後で値が変わっていれば読み直す)
+static volatile _UDWORD _frameSeq = 0;
+static volatile SensorFrame _frame;
+#if SENSOR_PHASE_LOCK
+static _UBYTE _lsDivCnt = 0;			// 光センサ起動の間引きカウンタ
+#endif
 
 #define LOG_SIZE	500
 static	volatile _UWORD wordlogL[LOG_SIZE] = {0};
@@ -38,14 +68,31 @@ static	volatile _UWORD wordlogR[LOG_SIZE] = {0};
 static	volatile float floatlogL[LOG_SIZE] = {0};
 static	volatile float floatlogR[LOG_SIZE] = {0};
 
-static float kp = -0.01, kd = 0.0;						// 比例,微分制御係数格納変数
-static float _dl, _dr;
-static float _dutyL, _dutyR;
-static float _tarv, _taracc, _tarvmax;
-static float _tarvmin = DEF_VMIN;
-static float _tarangv, _tarangacc, _tarangvmax;
-static float _tarangvmin = DEF_VMIN;
-static float _kVtoDuty = 0.5;
+static CTRL_VAL kp = CTRL_CONST(-0.01), kd = CTRL_CONST(0.0);	// 比例,微分制御係数格納変数
+static CTRL_VAL kpDist = CTRL_CONST(SIDE_KP_MM / LS_DIST_SCALE);	// LS_DISTANCEのときの比例制御係数
+static CTRL_VAL _dl, _dr;
+static CTRL_VAL _dutyL, _dutyR;
+static CTRL_VAL _tarv, _taracc, _tarvmax;
+static CTRL_VAL _tarvmin = CTRL_CONST(DEF_VMIN);
+static CTRL_VAL _tarangv, _tarangacc, _tarangvmax;
+static CTRL_VAL _tarvRem, _tarangvRem;	// 目標速度,目標角速度の積算で持ち越す端数
+static CTRL_VAL _tarangvmin = CTRL_CONST(DEF_VMIN);
+static CTRL_VAL _kVtoDuty = CTRL_CONST(0.5);
+#if VELOCITY_FEEDBACK
+static WheelVelCtrl _velCtrlL, _velCtrlR;	// 左右車輪の速度制御器
+static volatile CTRL_VAL _battGain = CTRL_ONE;	// 電池電圧の補正係数(基準値/実測値)
+#endif
+
+static volatile MotionSegment _segQueue[SEG_QUEUE_SIZE];	// 走行区間キュー
+static volatile _UBYTE _segHead = 0;	// 取り出し位置(制御割り込みだけが書き換える)
+static volatile _UBYTE _segTail = 0;	// 格納位置(メインループだけが書き換える)
+static volatile _UWORD _segDone = 0;	// 終了した区間の数
+static _UWORD _segIssued = 0;			// 格納した区間の数
+static volatile bool _segCancel = false;	// キュー破棄要求
+static bool _segActive = false;			// 区間を実行中
+static MotionSegment _seg;				// 実行中の区間
+static CTRL_VAL _segEnd;				// 実行中の区間の終了条件(距離,角度)
+static _UDWORD _segEndTick;				// 実行中の区間の終了条件(時間)
 
 /*----------------------------------------------------------------------
 	Private Method Declarations
@@ -53,11 +100,33 @@ static float _kVtoDuty = 0.5;
 static void MouseController_InitializeMTU2(void);
 static void MouseController_UpdateParameter(void);
 static void MouseController_SideWallControl(void);
+static void MouseController_PublishFrame(void);
+static void MouseController_StartSegment(void);
+static bool MouseController_IsSegmentEnd(void);
+static void MouseController_EndSegment(void);
+static void MouseController_ClearTarget(void);
+#if VELOCITY_FEEDBACK
+static CTRL_VAL MouseController_WheelDuty(WheelVelCtrl* ctrl, CTRL_VAL tarv, CTRL_VAL vel);
+static void MouseController_ResetWheelCtrl(void);
+static void MouseController_UpdateBattery(void);
+#endif
+static _UWORD DriveAQueue(float v0, float vmax, float acc, float dist);
+static _UWORD DriveDQueue(float vmin, float acc, float dist, bool rs);
+static _UWORD DriveTimeQueue(float v0, float ms);
+static _UWORD TurnAQueue(float angv0, float angvmax, float angacc, float dist);
+static _UWORD TurnDQueue(float angvmin, float angacc, float dist, bool rs);
+static _UWORD StopQueue(float ms);
+static _UWORD SlalomQueue(float v, float angvmax, float angvmin, float angacc, float ang, float distPre, float distPost);
+#if GYRO_FUSION
+static _UWORD TurnAngQueue(float angv0, float angvmax, float angvmin, float angacc, float ang);
+static void MouseController_YawControl(void);
+#endif
 static void DriveA(float v0, float vmax, float acc, float dist);
 static void DriveD(float vmin, float acc, float dist, bool rs);
 static void DriveTime(float v0, float ms);
 static void TurnA(float angv0, float angvmax, float angacc, float dist);
 static void TurnD(float angvmin, float angacc, float dist, bool rs);
+static void Slalom(float v, float angvmax, float angvmin, float angacc, float ang, float distPre, float distPost);
 
 
 /*----------------------------------------------------------------------
@@ -70,7 +139,15 @@ static void TurnD(float angvmin, float angacc, float dist, bool rs);
  */
 void MouseController_Initialize(void)
 {
+#if WHEEL_ESTIMATOR
+	WheelEstimator_Reset(&_estL);
+	WheelEstimator_Reset(&_estR);
+#endif
 	MouseController_InitializeMTU2();
+#if VELOCITY_FEEDBACK
+	MouseController_UpdateBattery();
+	Timer_AddTask(MouseController_UpdateBattery, BATTERY_UPDATE_MS);
+#endif
 }
 
 /**
@@ -78,14 +155,61 @@ void MouseController_Initialize(void)
  */
 void MouseController_IntMTU2TGIA(void)
 {
+#if SENSOR_PHASE_LOCK
+	// 光センサの取得は制御周期の先頭にそろえる
+	if(++_lsDivCnt >= SENSOR_LS_DIV)
+	{
+		_lsDivCnt = 0;
+		LightSensor_TriggerScan();
+	}
+#endif
+
 	MouseController_UpdateParameter();
+	MouseController_PublishFrame();
+
+	// キュー破棄要求があれば実行中の区間ごと破棄する
+	if(_segCancel)
+	{
+		_segHead = _segTail;
+		_segActive = false;
+		_driving = false;
+		MouseController_ClearTarget();
+		_segCancel = false;
+	}
+
+#if VELOCITY_FEEDBACK
+	// 停止中は積分値を持ち越さない
+	if(!_driving)
+	{
+		MouseController_ResetWheelCtrl();
+	}
+#endif
+#if GYRO_FUSION
+	if(!_driving)
+	{
+		_yawInteg = 0;
+		_yawCorr = 0;
+
+		// 車輪が止まっている間はジャイロのバイアスを追従させる
+		if((_wheelLDist.Now == 0) && (_wheelRDist.Now == 0))
+		{
+			MPU6500_TrackBias();
+		}
+	}
+#endif
+
+	// 区間を実行していなければキューから取り出す
+	if(!_segActive)
+	{
+		MouseController_StartSegment();
+	}
 
 	if(_driving)
 	{
-		float xL, xR;
+		CTRL_VAL xL, xR, angv;
 
 		// 目標速度の算出
-		_tarv += _taracc * CONTROL_INTERVAL_SEC;
+		CTRL_INTEG(_tarv, _taracc, CONTROL_FREQ, _tarvRem);
 		if(_tarv > 0)
 		{
 			_tarv = (_tarv > _tarvmax) ? _tarvmax : _tarv;
@@ -98,7 +222,7 @@ void MouseController_IntMTU2TGIA(void)
 		}
 
 		// 目標角速度の算出
-		_tarangv += _tarangacc * CONTROL_INTERVAL_SEC;
+		CTRL_INTEG(_tarangv, _tarangacc, CONTROL_FREQ, _tarangvRem);
 		if(_tarangv > 0)
 		{
 			_tarangv = (_tarangv > _tarangvmax) ? _tarangvmax : _tarangv;
@@ -112,32 +236,63 @@ void MouseController_IntMTU2TGIA(void)
 
 		// 横壁制御成分の計算
 		MouseController_SideWallControl();
+#if GYRO_FUSION
+		// 角速度ループ
+		MouseController_YawControl();
+#endif
 
 		// 各車輪回転速度を算出し,回転させる
-		_dutyL = _kVtoDuty * (_tarv + _dl + HW_TREAD_WIDTH * _tarangv);
-		_dutyR = _kVtoDuty * (_tarv + _dr - HW_TREAD_WIDTH * _tarangv);
-		if(_dutyL > 0.0)
+#if GYRO_FUSION
+		angv = _tarangv + _yawCorr;
+#else
+		angv = _tarangv;
+#endif
+#if VELOCITY_FEEDBACK
+		_dutyL = MouseController_WheelDuty(&_velCtrlL,
+					CTRL_MUL(CTRL_CONST(VEL_UNIT_MMPS), _tarv + _dl + CTRL_MUL(CTRL_CONST(HW_TREAD_WIDTH), angv)),
+					_wheelLVel.Now);
+		_dutyR = MouseController_WheelDuty(&_velCtrlR,
+					CTRL_MUL(CTRL_CONST(VEL_UNIT_MMPS), _tarv + _dr - CTRL_MUL(CTRL_CONST(HW_TREAD_WIDTH), angv)),
+					_wheelRVel.Now);
+#else
+		_dutyL = CTRL_MUL(_kVtoDuty, _tarv + _dl + CTRL_MUL(CTRL_CONST(HW_TREAD_WIDTH), angv));
+		_dutyR = CTRL_MUL(_kVtoDuty, _tarv + _dr - CTRL_MUL(CTRL_CONST(HW_TREAD_WIDTH), angv));
+#endif
+		if(_dutyL > 0)
 		{
-			DRV8836_DriveMotor(MOTOR_TYPE_LEFT, MOTOR_DIR_CCW, _dutyL);
+			DRV8836_DriveMotor(MOTOR_TYPE_LEFT, MOTOR_DIR_CCW, CTRL_TO_FLOAT(_dutyL));
 			xL = _wheelLDist.Now;
 		}
 		else
 		{
-			DRV8836_DriveMotor(MOTOR_TYPE_LEFT, MOTOR_DIR_CW, -_dutyL);
+			DRV8836_DriveMotor(MOTOR_TYPE_LEFT, MOTOR_DIR_CW, CTRL_TO_FLOAT(-_dutyL));
 			xL = -_wheelLDist.Now;
 		}
-		if(_dutyR > 0.0)
+		if(_dutyR > 0)
 		{
-			DRV8836_DriveMotor(MOTOR_TYPE_RIGHT, MOTOR_DIR_CW, _dutyR);
+			DRV8836_DriveMotor(MOTOR_TYPE_RIGHT, MOTOR_DIR_CW, CTRL_TO_FLOAT(_dutyR));
 			xR = _wheelRDist.Now;
 		}
 		else
 		{
-			DRV8836_DriveMotor(MOTOR_TYPE_RIGHT, MOTOR_DIR_CCW, -_dutyR);
+			DRV8836_DriveMotor(MOTOR_TYPE_RIGHT, MOTOR_DIR_CCW, CTRL_TO_FLOAT(-_dutyR));
 			xR = -_wheelRDist.Now;
 		}
 		_t++;
-		_x += (xL + xR) / 2.0;
+		_x += CTRL_MUL(xL + xR, CTRL_CONST(0.5));
+#if GYRO_FUSION
+		_angEnc += CTRL_MUL(_wheelLDist.Now - _wheelRDist.Now, CTRL_CONST(1.0 / HW_TREAD_WIDTH));
+		CTRL_INTEG(_ang, _yawRate, CONTROL_FREQ, _angRem);
+		_ang += CTRL_MUL(CTRL_CONST(GYRO_FUSION_K), _angEnc - _ang);
+#else
+		_ang += CTRL_MUL(_wheelLDist.Now - _wheelRDist.Now, CTRL_CONST(1.0 / HW_TREAD_WIDTH));
+#endif
+
+		// 終了条件を満たせば次の周期から次の区間を実行する
+		if(_segActive && MouseController_IsSegmentEnd())
+		{
+			MouseController_EndSegment();
+		}
 	}
 //	else
 //	{
@@ -146,6 +301,17 @@ void MouseController_IntMTU2TGIA(void)
 //	}
 }
 
+/**
+ * センサ取得起動用MTU2TGIB割り込み関数
+ *   制御割り込みのSENSOR_LEAD_US前に入る
+ */
+void MouseController_IntMTU2TGIB(void)
+{
+#if SENSOR_PHASE_LOCK
+	RSPI0_TriggerCycleOperation();
+#endif
+}
+
 /**
  * 機体速度の取得
  * @param void
@@ -153,7 +319,7 @@ void MouseController_IntMTU2TGIA(void)
  */
 float MouseController_GetVel(void)
 {
-	return _vel.Now;
+	return CTRL_TO_FLOAT(_vel.Now);
 }
 
 /**
@@ -163,7 +329,24 @@ float MouseController_GetVel(void)
  */
 float MouseController_GetAngvel(void)
 {
-	return _angvel.Now;
+	return CTRL_TO_FLOAT(_angvel.Now);
+}
+
+/**
+ * 最新の制御周期で発行したセンサ値をまとめて取得する
+ *   割り込みを禁止せずに,同じ制御周期の値の組を得る
+ * @param frame: 格納先
+ * @retval void
+ */
+void MouseController_GetSensorFrame(SensorFrame* frame)
+{
+	_UDWORD seq;
+
+	do
+	{
+		seq = _frameSeq;
+		*frame = _frame;
+	}while((seq & 1) || (seq != _frameSeq));
 }
 
 /**
@@ -173,7 +356,7 @@ float MouseController_GetAngvel(void)
  */
 void MouseController_CheckValue(void)
 {
-	Printf("L:%4.2f, R: %4.2f\n", _wheelLDist.Now, _wheelRDist.Now);
+	Printf("L:%4.2f, R: %4.2f\n", CTRL_TO_FLOAT(_wheelLDist.Now), CTRL_TO_FLOAT(_wheelRDist.Now));
 //	Printf("L:%d, %f, R:%d, %f\n", _wheelLAng.Now, _wheelLVel.Now, _wheelRAng.Now, _wheelRVel.Now);
 //	Printf("vel:%f, angvel:%f\n", _vel.Now, _angvel.Now);
 }
@@ -224,8 +407,8 @@ void MouseControlle_MotorTest(void)
 			{
 				wordlogL[i] = _wheelLAng.Now;
 				wordlogR[i] = _wheelRAng.Now;
-				floatlogL[i] = _wheelLDist.Now;
-				floatlogR[i] = _wheelRDist.Now;
+				floatlogL[i] = CTRL_TO_FLOAT(_wheelLDist.Now);
+				floatlogR[i] = CTRL_TO_FLOAT(_wheelRDist.Now);
 				WaitMS(1);
 			}
 			DRV8836_DriveMotor(MOTOR_TYPE_LEFT, MOTOR_DIR_CCW, 0.0);
@@ -268,6 +451,242 @@ void MouseControlle_MotorTest(void)
 	}
 }
 
+/**
+ * 光センサの距離変換表の較正
+ *   区画の左右に壁がある所で,横方向は中央に合わせ,機体前端を前壁につけてから始める
+ *   前センサ: LS_CAL_Vで後退しながら,距離の表の点を通るごとにA/D値を記録する
+ *   横センサ: 同じ側の前センサの表を,区画中央(LS_DIST_SIDE_CENTER)での値が
+ *             開始時の横センサの値になるように縮尺する(センサ,LEDの特性は同じとみなす)
+ *   開始位置は区画中央なので,左右センサ基準値もここで取り直して保存する
+ * @param void
+ * @retval void
+ */
+void MouseController_CalibrateSensor(void)
+{
+	static _SWORD fwdL[LS_DIST_POINTS], fwdR[LS_DIST_POINTS], side[LS_DIST_POINTS];
+	const _UBYTE center = (LS_DIST_SIDE_CENTER - LS_DIST_MIN_MM) / LS_DIST_STEP_MM;
+	SensorFrame frame;
+	_UWORD encL, encR, seq;
+	_SDWORD baseL = 0, baseR = 0;
+	_SWORD lsBase[2];
+	_SDWORD cnt = 0;		// 後退した量(左右の回転量の和) [count]
+	float dist;				// 前センサから前壁までの距離 [mm]
+	_UBYTE i, n = 0;
+
+	// 左右センサ基準値(次の起動でも使うよう保存する)
+	LightSensor_GetBaseLR();
+	lsBase[0] = LightSensor_GetValue()->Base.Left;
+	lsBase[1] = LightSensor_GetValue()->Base.Right;
+	if(!ParamStore_Set(PARAM_KEY_LS_BASE, lsBase, sizeof(lsBase)))
+	{
+		Printf("Save failed\n");
+	}
+
+	// 開始位置での横センサの値
+	for(i = 0; i < LS_CAL_BASE_NUM; i++)
+	{
+		MouseController_GetSensorFrame(&frame);
+		baseL += frame.LsNow.Left;
+		baseR += frame.LsNow.Right;
+		WaitMS(2);
+	}
+	baseL /= LS_CAL_BASE_NUM;
+	baseR /= LS_CAL_BASE_NUM;
+
+	// 後退しながら前センサの値を記録する
+	encL = frame.EncL;
+	encR = frame.EncR;
+	seq = DriveTimeQueue(-LS_CAL_V, LS_CAL_TIME_MS);
+	while((n < LS_DIST_POINTS) && ((_SWORD)(_UWORD)(_segDone - seq) < 0))
+	{
+		WaitMS(1);
+		MouseController_GetSensorFrame(&frame);
+		cnt += WheelEstimator_WrapDiff(frame.EncR, encR) - WheelEstimator_WrapDiff(frame.EncL, encL);	// 右は逆回転が前進
+		encL = frame.EncL;
+		encR = frame.EncR;
+
+		dist = LS_DIST_FWD_CONTACT + cnt * (float)(PI * HW_WHEEL_DIAM / (1 << ENCODER_RESOLUTION) / 2.0);
+		while((n < LS_DIST_POINTS) && (dist >= LS_DIST_MIN_MM + n * LS_DIST_STEP_MM))
+		{
+			fwdL[n] = frame.LsNow.FwdL;
+			fwdR[n] = frame.LsNow.FwdR;
+			n++;
+		}
+	}
+	MouseController_CancelSegment();
+
+	if(n <= center)
+	{
+		// 区画中央の距離まで下がれなかった
+		PlaySound(100);
+		PlaySound(100);
+		Printf("calibration failed (%d points)\n", n);
+		return;
+	}
+	// 下がりきれなかった分は最後の値で埋める
+	for(i = n; i < LS_DIST_POINTS; i++)
+	{
+		fwdL[i] = fwdL[n - 1];
+		fwdR[i] = fwdR[n - 1];
+	}
+	LightSensor_SetDistTable(LS_FWD_L, fwdL);
+	LightSensor_SetDistTable(LS_FWD_R, fwdR);
+
+	for(i = 0; i < LS_DIST_POINTS; i++)
+	{
+		side[i] = (fwdL[center] > 0) ? (_SWORD)(fwdL[i] * baseL / fwdL[center]) : 0;
+	}
+	LightSensor_SetDistTable(LS_LEFT, side);
+	for(i = 0; i < LS_DIST_POINTS; i++)
+	{
+		side[i] = (fwdR[center] > 0) ? (_SWORD)(fwdR[i] * baseR / fwdR[center]) : 0;
+	}
+	LightSensor_SetDistTable(LS_RIGHT, side);
+
+	// 次の起動でも使うよう保存する
+	for(i = 0; i < PARAM_KEY_LS_DIST_END - PARAM_KEY_LS_DIST; i++)
+	{
+		if(!ParamStore_Set((PARAM_KEY)(PARAM_KEY_LS_DIST + i), LightSensor_GetDistTable((E_LS_CHANNEL)i), LS_DIST_POINTS * sizeof(_SWORD)))
+		{
+			Printf("Save failed\n");
+		}
+	}
+
+	PlaySound(500);
+	LightSensor_PrintDistTable();
+}
+
+/**
+ * 横壁制御のゲインを設定する
+ * @param gain: 横壁制御のゲイン
+ * @retval void
+ */
+void MouseController_SetSideGain(const SideGain* gain)
+{
+	kp = CTRL_FROM_FLOAT(gain->Kp);
+	kd = CTRL_FROM_FLOAT(gain->Kd);
+	kpDist = CTRL_FROM_FLOAT(gain->KpMM / LS_DIST_SCALE);
+}
+
+/**
+ * 横壁制御のゲインを取得する
+ * @param gain: 横壁制御のゲインの格納先
+ * @retval void
+ */
+void MouseController_GetSideGain(SideGain* gain)
+{
+	gain->Kp = CTRL_TO_FLOAT(kp);
+	gain->Kd = CTRL_TO_FLOAT(kd);
+	gain->KpMM = CTRL_TO_FLOAT(kpDist) * LS_DIST_SCALE;
+}
+
+/**
+ * 壁判断基準値,横壁制御のゲインをシリアルから入力する
+ *   負の基準値を入力したら何も変えずに終わる.入力した値は次の起動でも使うよう保存する
+ * @param void
+ * @retval void
+ */
+void MouseController_InputParam(void)
+{
+	static const char* name[4] = {"FwdL", "Left", "Right", "FwdR"};	// E_LS_CHANNEL順
+	_SWORD wall[4];
+	SideGain gain;
+	int ad;
+	_UBYTE ch;
+
+	for(ch = 0; ch < 4; ch++)
+	{
+		Printf("Wall %s (%d):", name[ch], LightSensor_GetWallBase()[ch]);
+		Scanf("%d", &ad);
+		if((ad < 0) || (ad > 4095))
+		{
+			Printf("Invalid wall base\n");
+			return;
+		}
+		wall[ch] = (_SWORD)ad;
+	}
+	MouseController_GetSideGain(&gain);
+	Printf("Side Kp (%f):", gain.Kp);
+	Scanf("%f", &gain.Kp);
+	Printf("Side Kd (%f):", gain.Kd);
+	Scanf("%f", &gain.Kd);
+	Printf("Side Kp/mm (%f):", gain.KpMM);
+	Scanf("%f", &gain.KpMM);
+
+	LightSensor_SetWallBase(wall);
+	MouseController_SetSideGain(&gain);
+	Printf("Wall:%d, %d, %d, %d Kp:%f Kd:%f Kp/mm:%f\n", wall[0], wall[1], wall[2], wall[3], gain.Kp, gain.Kd, gain.KpMM);
+
+	//====次の起動でも使うよう保存====
+	if( !ParamStore_Set(PARAM_KEY_WALL_BASE, wall, sizeof(wall))
+			|| !ParamStore_Set(PARAM_KEY_SIDE_GAIN, &gain, sizeof(gain)) ){
+		Printf("Save failed\n");
+	}
+}
+
+/**
+ * 走行区間をキューに格納する
+ *   キューが一杯なら空くまで待つ.格納した区間は制御割り込みが順に実行する
+ * @param seg: 走行区間
+ * @retval _UWORD: 区間番号(MouseController_WaitSegmentに渡す)
+ */
+_UWORD MouseController_PushSegment(const MotionSegment* seg)
+{
+	_UBYTE tail = _segTail;
+	_UBYTE next = (tail + 1) & SEG_QUEUE_MASK;
+
+	while(next == _segHead)
+	{
+		Yield();
+	}
+	_segQueue[tail] = *seg;
+
+	// 区間を書き終えてから格納位置を進める
+	_segTail = next;
+	return ++_segIssued;
+}
+
+/**
+ * キューの空き数の取得
+ * @param void
+ * @retval _UBYTE: 格納できる区間の数
+ */
+_UBYTE MouseController_GetQueueSpace(void)
+{
+	return (_segHead - _segTail - 1) & SEG_QUEUE_MASK;
+}
+
+/**
+ * 区間が終了するまで待つ
+ * @param seq: MouseController_PushSegmentが返した区間番号
+ * @retval void
+ */
+void MouseController_WaitSegment(_UWORD seq)
+{
+	while((_SWORD)(_UWORD)(_segDone - seq) < 0)
+	{
+		Yield();
+	}
+}
+
+/**
+ * キューの区間を全て破棄して停止する
+ * @param void
+ * @retval void
+ */
+void MouseController_CancelSegment(void)
+{
+	_segCancel = true;
+	while(_segCancel)
+	{
+		Yield();
+	}
+	// 割り込みは区間を実行していないので,ここで終了数を揃えてよい
+	_segDone = _segIssued;
+
+	MouseController_WaitSegment(StopQueue(WAIT_STOP_MS));
+}
+
 void HalfSectionA(void)
 {
 	_MF.CTRL.BIT.SIDE = 1;
@@ -279,34 +698,162 @@ void HalfSectionD(void)
 	_MF.CTRL.BIT.SIDE = 1;
 	DriveD(DEF_VMIN, -DEF_ACC, DR_SEC_HALF, true);
 	_MF.CTRL.BIT.SIDE = 0;
-	WaitMS(400);
+	WaitMS(WAIT_STOP_MS);
+}
+
+/**
+ * 半区画n個分を1回の加減速で直進して停止する
+ *   最後の半区画で減速するのはHalfSectionA,HalfSectionDと同じ
+ * @param halfNum: 半区画の数
+ * @retval void
+ */
+void SectionAD(_UBYTE halfNum)
+{
+	MouseController_WaitSegment(SectionADQueue(halfNum));
 }
 
 void TurnL90AD(void)
 {
+#if GYRO_FUSION
+	MouseController_WaitSegment(TurnAngQueue(-DEF_ANGV0, -DEF_ANGVMAX, -DEF_ANGVMIN, -DEF_ANGACC, ROT_ANG_90));
+#else
 	TurnA(-DEF_ANGV0, -DEF_ANGVMAX, -DEF_ANGACC, DR_ROT_L90/2);
 	TurnD(-DEF_ANGVMIN, DEF_ANGACC, DR_ROT_L90/2, true);
-	WaitMS(400);
+#endif
+	WaitMS(WAIT_STOP_MS);
 }
 
 void TurnR90AD(void)
 {
+#if GYRO_FUSION
+	MouseController_WaitSegment(TurnAngQueue(DEF_ANGV0, DEF_ANGVMAX, DEF_ANGVMIN, DEF_ANGACC, ROT_ANG_90));
+#else
 	TurnA(DEF_ANGV0, DEF_ANGVMAX, DEF_ANGACC, DR_ROT_R90/2);
 	TurnD(DEF_ANGVMIN, -DEF_ANGACC, DR_ROT_R90/2, true);
-	WaitMS(400);
+#endif
+	WaitMS(WAIT_STOP_MS);
 }
 
 void TurnL180AD(void)
 {
+#if GYRO_FUSION
+	MouseController_WaitSegment(TurnAngQueue(-DEF_ANGV0, -DEF_ANGVMAX, -DEF_ANGVMIN, -DEF_ANGACC, ROT_ANG_180));
+#else
 	TurnA(-DEF_ANGV0, -DEF_ANGVMAX, -DEF_ANGACC, DR_ROT_L180/2);
 	TurnD(-DEF_ANGVMIN, DEF_ANGACC, DR_ROT_L180/2, true);
-	WaitMS(400);
+#endif
+	WaitMS(WAIT_STOP_MS);
 }
 void TurnR180AD(void)
 {
+#if GYRO_FUSION
+	MouseController_WaitSegment(TurnAngQueue(DEF_ANGV0, DEF_ANGVMAX, DEF_ANGVMIN, DEF_ANGACC, ROT_ANG_180));
+#else
 	TurnA(DEF_ANGV0, DEF_ANGVMAX, DEF_ANGACC, DR_ROT_R180/2);
 	TurnD(DEF_ANGVMIN, -DEF_ANGACC, DR_ROT_R180/2, true);
-	WaitMS(400);
+#endif
+	WaitMS(WAIT_STOP_MS);
+}
+
+/**
+ * 右90度スラローム
+ *   区画の入口から速度を保ったまま旋回し,右の区画との境界まで走る
+ * @param void
+ * @retval void
+ */
+void SlalomR90(void)
+{
+	_MF.MOTOR.BIT.SLAL_R = 1;
+	Slalom(SLA_V, SLA_ANGVMAX, SLA_ANGVMIN, SLA_ANGACC, SLA_ANG_90, SLA_PRE_R90, SLA_POST_R90);
+	_MF.MOTOR.BIT.SLAL_R = 0;
+}
+
+/**
+ * 左90度スラローム
+ *   区画の入口から速度を保ったまま旋回し,左の区画との境界まで走る
+ * @param void
+ * @retval void
+ */
+void SlalomL90(void)
+{
+	_MF.MOTOR.BIT.SLAL_L = 1;
+	Slalom(SLA_V, -SLA_ANGVMAX, -SLA_ANGVMIN, -SLA_ANGACC, -SLA_ANG_90, SLA_PRE_L90, SLA_POST_L90);
+	_MF.MOTOR.BIT.SLAL_L = 0;
+}
+
+/**
+ * 半区画n個分の直進をキューに格納する(SectionADの非ブロッキング版)
+ * @param halfNum: 半区画の数
+ * @retval _UWORD: 最後の区間の区間番号
+ */
+_UWORD SectionADQueue(_UBYTE halfNum)
+{
+	if(halfNum == 0)
+	{
+		return _segIssued;
+	}
+	_MF.CTRL.BIT.SIDE = 1;
+	if(halfNum > 1)
+	{
+		DriveAQueue(DEF_V0, DEF_VMAX, DEF_ACC, DR_SEC_HALF * (halfNum - 1));
+		DriveDQueue(DEF_VMIN, -DEF_ACC, DR_SEC_HALF, true);
+	}
+	else
+	{
+		// 半区画だけなら前半で加速,後半で減速
+		DriveAQueue(DEF_V0, DEF_VMAX, DEF_ACC, DR_SEC_HALF/2);
+		DriveDQueue(DEF_VMIN, -DEF_ACC, DR_SEC_HALF/2, true);
+	}
+	_MF.CTRL.BIT.SIDE = 0;
+	return StopQueue(WAIT_STOP_MS);
+}
+
+/**
+ * 右90度超信地旋回をキューに格納する(TurnR90ADの非ブロッキング版)
+ * @param void
+ * @retval _UWORD: 最後の区間の区間番号
+ */
+_UWORD TurnR90ADQueue(void)
+{
+#if GYRO_FUSION
+	TurnAngQueue(DEF_ANGV0, DEF_ANGVMAX, DEF_ANGVMIN, DEF_ANGACC, ROT_ANG_90);
+#else
+	TurnAQueue(DEF_ANGV0, DEF_ANGVMAX, DEF_ANGACC, DR_ROT_R90/2);
+	TurnDQueue(DEF_ANGVMIN, -DEF_ANGACC, DR_ROT_R90/2, true);
+#endif
+	return StopQueue(WAIT_STOP_MS);
+}
+
+/**
+ * 左90度超信地旋回をキューに格納する(TurnL90ADの非ブロッキング版)
+ * @param void
+ * @retval _UWORD: 最後の区間の区間番号
+ */
+_UWORD TurnL90ADQueue(void)
+{
+#if GYRO_FUSION
+	TurnAngQueue(-DEF_ANGV0, -DEF_ANGVMAX, -DEF_ANGVMIN, -DEF_ANGACC, ROT_ANG_90);
+#else
+	TurnAQueue(-DEF_ANGV0, -DEF_ANGVMAX, -DEF_ANGACC, DR_ROT_L90/2);
+	TurnDQueue(-DEF_ANGVMIN, DEF_ANGACC, DR_ROT_L90/2, true);
+#endif
+	return StopQueue(WAIT_STOP_MS);
+}
+
+/**
+ * 右180度超信地旋回をキューに格納する(TurnR180ADの非ブロッキング版)
+ * @param void
+ * @retval _UWORD: 最後の区間の区間番号
+ */
+_UWORD TurnR180ADQueue(void)
+{
+#if GYRO_FUSION
+	TurnAngQueue(DEF_ANGV0, DEF_ANGVMAX, DEF_ANGVMIN, DEF_ANGACC, ROT_ANG_180);
+#else
+	TurnAQueue(DEF_ANGV0, DEF_ANGVMAX, DEF_ANGACC, DR_ROT_R180/2);
+	TurnDQueue(DEF_ANGVMIN, -DEF_ANGACC, DR_ROT_R180/2, true);
+#endif
+	return StopQueue(WAIT_STOP_MS);
 }
 
 void SetPosition(void)
@@ -346,20 +893,57 @@ static void MouseController_InitializeMTU2(void)
 
 	// TGRyの設定
 	MTU2.TGRA = CONTROL_INTERVAL;
+#if SENSOR_PHASE_LOCK
+	MTU2.TGRB = CONTROL_INTERVAL - SENSOR_LEAD_COUNT;	// センサ取得の起動タイミング
+#endif
 
 	// 割り込み許可設定
 	MTU2.TIER.BIT.TGIEA = 1;	// TGIA割り込み要求を許可
+#if SENSOR_PHASE_LOCK
+	MTU2.TIER.BIT.TGIEB = 1;	// TGIB割り込み要求を許可
+#endif
 
 	// 割り込みレベル設定
-	IPR(MTU2, TGIA2)= 10;
+	IPR(MTU2, TGIA2)= 10;		// TGIB2と共通
 
 	// 割り込み要求を許可
 	IEN(MTU2, TGIA2) = 1;
+#if SENSOR_PHASE_LOCK
+	IEN(MTU2, TGIB2) = 1;
+#endif
 
 	// カウント動作開始
 	MTU.TSTR.BIT.CST2 = 1;		// MTU2カウント動作開始
 }
 
+/**
+ * 今回の制御周期のセンサ値を発行する
+ *   書き込みはこの制御割り込みだけが行う
+ * @param void
+ * @retval void
+ */
+static void MouseController_PublishFrame(void)
+{
+	LSVal *lsv;
+
+	LightSensor_Update();
+	lsv = LightSensor_GetValue();
+
+	_frameSeq++;
+	_frame.Tick++;
+	_frame.Stamp = Timer_GetTimeUS();
+	_frame.LsNow = lsv->Now;
+	_frame.LsDif = lsv->Dif;
+	_frame.LsDist = lsv->Dist;
+	_frame.LsStamp = LightSensor_GetStamp();
+	_frame.EncL = _wheelLAng.Now;
+	_frame.EncR = _wheelRAng.Now;
+	_frame.EncLStamp = AS5055_GetStamp(ENC_L);
+	_frame.EncRStamp = AS5055_GetStamp(ENC_R);
+	MPU6500_GetSample((ImuSample*)&_frame.Imu);
+	_frameSeq++;
+}
+
 /**
  * 機体パラメータの更新
  * @param void
@@ -367,9 +951,7 @@ static void MouseController_InitializeMTU2(void)
  */
 static void MouseController_UpdateParameter(void)
 {
-	_SWORD a,b,c;
-	_UWORD absa,absb,absc;
-	_SWORD wheelVel;
+	_SWORD diffL, diffR;
 
 	// 1時刻前状態の保存
 	_wheelLAng.Old = _wheelLAng.Now;
@@ -379,67 +961,55 @@ static void MouseController_UpdateParameter(void)
 	_wheelLVel.Old = _wheelLVel.Now;
 	_wheelRVel.Old = _wheelRVel.Now;
 
-	// 左右輪について計算
-	for(int i = 0; i < 2; i++)
-	{
-		// 一時刻前との差分
-		if(i == 0)
-		{
-			_wheelLAng.Now = AS5055_GetAngle(ENC_L);
-			a = (_SWORD)_wheelLAng.Now - (_SWORD)_wheelLAng.Old;
-		}
-		else
-		{
-			_wheelRAng.Now = AS5055_GetAngle(ENC_R);
-			a = (_SWORD)_wheelRAng.Now - (_SWORD)_wheelRAng.Old;
-		}
-		b = a + (_SWORD)(1 << ENCODER_RESOLUTION);
-		c = a - (_SWORD)(1 << ENCODER_RESOLUTION);
-
-		// 絶対値をとる
-		absa = ((a >= 0)?  a : -a);
-		absb = ((b >= 0)?  b : -b);
-		absc = ((c >= 0)?  c : -c);
-
-		// 最小値が正しい変化値となる
-//		if(absa <= absb)
-//		{
-//			if(absa <= absc)	wheelVel = a;
-//			else				wheelVel = c;
-//		}
-//		else if(absb <= absc)	wheelVel = b;
-//		else					wheelVel = c;
-		wheelVel = ((absa >= absb)?  ((absb >= absc)?	c : b)  : (absa >= absc)?  c : a);
-
-		if(i == 0)
-		{
-			_wheelLDist.Now = (float)wheelVel / (float)(1 << ENCODER_RESOLUTION) * PI * HW_WHEEL_DIAM;
-			_wheelLVel.Now = _wheelLDist.Now * (float)CONTROL_INTERVEL_INVSEC;
-		}
-		else
-		{
-			_wheelRDist.Now = -(float)wheelVel / (float)(1 << ENCODER_RESOLUTION) * PI * HW_WHEEL_DIAM;
-			_wheelRVel.Now = _wheelRDist.Now * (float)CONTROL_INTERVEL_INVSEC;
-		}
-	}
+	_wheelLAng.Now = AS5055_GetAngle(ENC_L);
+	_wheelRAng.Now = AS5055_GetAngle(ENC_R);
+
+#if WHEEL_ESTIMATOR
+	// 回転量は採用したサンプルの差分,速度は推定器から
+	diffL = WheelEstimator_Update(&_estL, _wheelLAng.Now, AS5055_GetStamp(ENC_L));
+	diffR = WheelEstimator_Update(&_estR, _wheelRAng.Now, AS5055_GetStamp(ENC_R));
+	_wheelLDist.Now = CTRL_MULI(CTRL_CONST(PI * HW_WHEEL_DIAM / (1 << ENCODER_RESOLUTION)), diffL);
+	_wheelRDist.Now = CTRL_MULI(CTRL_CONST(PI * HW_WHEEL_DIAM / (1 << ENCODER_RESOLUTION)), -diffR);
+	_wheelLVel.Now = CTRL_MUL(CTRL_CONST(PI * HW_WHEEL_DIAM / (1 << ENCODER_RESOLUTION) * 1000000.0 / WHEEL_EST_DT_US), _estL.Vel);
+	_wheelRVel.Now = CTRL_MUL(CTRL_CONST(PI * HW_WHEEL_DIAM / (1 << ENCODER_RESOLUTION) * 1000000.0 / WHEEL_EST_DT_US), -_estR.Vel);
+#else
+	// 一時刻前との差分(1回転で折り返すので絶対値が最小となる方を正しい変化値とする)
+	diffL = WheelEstimator_WrapDiff(_wheelLAng.Now, _wheelLAng.Old);
+	diffR = WheelEstimator_WrapDiff(_wheelRAng.Now, _wheelRAng.Old);
+	_wheelLDist.Now = CTRL_MULI(CTRL_CONST(PI * HW_WHEEL_DIAM / (1 << ENCODER_RESOLUTION)), diffL);
+	_wheelRDist.Now = CTRL_MULI(CTRL_CONST(PI * HW_WHEEL_DIAM / (1 << ENCODER_RESOLUTION)), -diffR);
+	_wheelLVel.Now = CTRL_MULI(_wheelLDist.Now, CONTROL_INTERVEL_INVSEC);
+	_wheelRVel.Now = CTRL_MULI(_wheelRDist.Now, CONTROL_INTERVEL_INVSEC);
+#endif
 
 	// 機体速度(物理量)の計算
 	_vel.Old = _vel.Now;
 	_angvel.Old = _angvel.Now;
-	_vel.Now = (_wheelLVel.Now + _wheelRVel.Now) / 2;
-	_angvel.Now = (_wheelLVel.Now - _wheelRVel.Now) / (2 * HW_TREAD_WIDTH);
+	_vel.Now = CTRL_MUL(_wheelLVel.Now + _wheelRVel.Now, CTRL_CONST(0.5));
+	_angvel.Now = CTRL_MUL(_wheelLVel.Now - _wheelRVel.Now, CTRL_CONST(0.5 / HW_TREAD_WIDTH));
+
+#if GYRO_FUSION
+	// ジャイロ角速度 [rad/s] (固定小数点でも係数の桁を落とさないよう256倍して掛ける)
+	_yawRate = CTRL_DIVI(CTRL_MULI(CTRL_CONST(HW_GYRO_SIGN * PI / 180.0 / GYRO_LSB_PER_DPS * 256), MPU6500_GetAngVel()), 256);
+#endif
 }
 
 static void MouseController_SideWallControl()
 {
-	float dl, dr;
+	CTRL_VAL dl, dr;
 //	float kp = 0.01, kd = 0.0;						// 比例,微分制御係数格納変数
 	//float v;
+#if !LS_DISTANCE
 	_SWORD ctrlRefMinL, ctrlRefMinR;				// 制御基準値格納変数
+#endif
+	_SWORD difL, difR, deltaL, deltaR;				// 制御に使う偏差,その変化
+	bool inL, inR;									// 制御基準範囲に収まっている
+	CTRL_VAL p, d;									// 比例,微分制御係数
 
 	// ==== 横壁制御フラグがあれば制御 ====
-	if( _MF.CTRL.BIT.SIDE ){
+	if( _seg.Flag & SEG_SIDE ){
 
+#if !LS_DISTANCE
 		// 制御基準下限値代入
 		ctrlRefMinL = CTRL_REF_MIN_L;
 		ctrlRefMinR = CTRL_REF_MIN_R;
@@ -458,6 +1028,7 @@ static void MouseController_SideWallControl()
 			ctrlRefMinR = AD.Base.Right + 50;
 		}
 */
+#endif
 		// 壁切れ検知(壁有り->壁なしのとき検知)
 //		if( MF.CTRL.BIT.EDGT ){
 //			if( -AD.Delta.Left > EDGE_REF_DELTA_L){
@@ -474,26 +1045,45 @@ static void MouseController_SideWallControl()
 //		}
 
 		// ---- 制御値の決定 ----
-		LSVal *lsv = LightSensor_GetValue();
+		LSVal *lsv = LightSensor_GetValue();	// この周期にMouseController_PublishFrame()で更新済み
+#if LS_DISTANCE
+		// 区画中央からのずれ(横壁に近いほど正)
+		difL = LS_MM(LS_DIST_SIDE_CENTER) - lsv->Dist.Left;
+		difR = LS_MM(LS_DIST_SIDE_CENTER) - lsv->Dist.Right;
+		deltaL = deltaR = 0;
+		inL = (lsv->Dist.Left <= LS_MM(CTRL_DIST_MAX_SIDE));
+		inR = (lsv->Dist.Right <= LS_MM(CTRL_DIST_MAX_SIDE));
+		p = kpDist;
+		d = 0;
+#else
+		difL = lsv->Dif.Left;
+		difR = lsv->Dif.Right;
+		deltaL = lsv->Delta.Left;
+		deltaR = lsv->Delta.Right;
+		inL = (ctrlRefMinL <= difL) && (difL <= CTRL_REF_MAX_L);
+		inR = (ctrlRefMinR <= difR) && (difR <= CTRL_REF_MAX_R);
+		p = kp;
+		d = kd;
+#endif
 
 		// 左右センサ(基準からの)差分値が共に制御基準範囲に収まっている時
-		if( ( (ctrlRefMinL <= lsv->Dif.Left) && (lsv->Dif.Left <= CTRL_REF_MAX_L) ) && ( (ctrlRefMinR <= lsv->Dif.Right) && (lsv->Dif.Right <= CTRL_REF_MAX_R ) ) ){
-			dl = kp * (lsv->Dif.Left - lsv->Dif.Right) + kd * lsv->Delta.Left;
-			dr = kp * (lsv->Dif.Right - lsv->Dif.Left) + kd * lsv->Delta.Right;
+		if( inL && inR ){
+			dl = CTRL_MULI(p, difL - difR) + CTRL_MULI(d, deltaL);
+			dr = CTRL_MULI(p, difR - difL) + CTRL_MULI(d, deltaR);
 		}
 		// 左右センサ差分値が共に制御基準範囲に収まっていない時
-		else if(((ctrlRefMinL > lsv->Dif.Left) || (lsv->Dif.Left > CTRL_REF_MAX_L)) && ((ctrlRefMinR > lsv->Dif.Right) || (lsv->Dif.Right > CTRL_REF_MAX_R))){
+		else if( !inL && !inR ){
 			dl = dr = 0;					//制御をかけない
 		}
 		// 左センサ差分値だけ制御基準範囲に収まっている時
-		else if((ctrlRefMinL <= lsv->Dif.Left) && (lsv->Dif.Left <= CTRL_REF_MAX_L)){
-			dl =  kp * (1 * lsv->Dif.Left) + kd * lsv->Delta.Left;
-			dr = -kp * (1 * lsv->Dif.Left) - kd * lsv->Delta.Left;
+		else if( inL ){
+			dl =  CTRL_MULI(p, difL) + CTRL_MULI(d, deltaL);
+			dr = -CTRL_MULI(p, difL) - CTRL_MULI(d, deltaL);
 		}
 		// 右センサ差分値だけ制御基準範囲に収まっている時
 		else{
-			dl = -kp * (1 * lsv->Dif.Right) - kd * lsv->Delta.Right;
-			dr =  kp * (1 * lsv->Dif.Right) + kd * lsv->Delta.Right;
+			dl = -CTRL_MULI(p, difR) - CTRL_MULI(d, deltaR);
+			dr =  CTRL_MULI(p, difR) + CTRL_MULI(d, deltaR);
 		}
 	}
 
@@ -506,165 +1096,438 @@ static void MouseController_SideWallControl()
 	_dr = dr;
 }
 
-static void DriveA(float v0, float vmax, float acc, float dist)
+#if GYRO_FUSION
+/**
+ * 角速度ループ
+ *   目標角速度とジャイロ角速度の偏差にPIをかけ,目標角速度への加算分を求める
+ *   車輪の滑りで生じた旋回の遅れ,行き過ぎをその場で打ち消す
+ * @param void
+ * @retval void
+ */
+static void MouseController_YawControl(void)
 {
-	_t = 0;
-	_x = 0;
-	_tarv = v0;
-	_tarvmax = vmax;
-	_taracc = acc;
-	_tarangv = 0;
-	_tarangvmin = 0;
-	_tarangvmax = 0;
-	_tarangacc = 0;
+	CTRL_VAL err = CTRL_MUL(CTRL_CONST(ANGV_UNIT_RADPS), _tarangv) - _yawRate;
 
-	_driving = true;
-
-	while(_x < dist)
+	_yawInteg += CTRL_DIVI(err, CONTROL_FREQ);
+	if(_yawInteg > CTRL_CONST(YAW_INTEG_MAX))
 	{
-		// 何かしら処理がないと無限ループに陥るのでウェイトを入れている
-		WaitUS(1);
+		_yawInteg = CTRL_CONST(YAW_INTEG_MAX);
+	}
+	else if(_yawInteg < CTRL_CONST(-YAW_INTEG_MAX))
+	{
+		_yawInteg = CTRL_CONST(-YAW_INTEG_MAX);
 	}
 
-	_driving = false;
+	_yawCorr = CTRL_MUL(CTRL_CONST(YAW_KP / ANGV_UNIT_RADPS), err)
+			 + CTRL_MUL(CTRL_CONST(YAW_KI / ANGV_UNIT_RADPS), _yawInteg);
 }
+#endif
 
-static void DriveD(float vmin, float acc, float dist, bool rs)
+/**
+ * キューから次の区間を取り出し,目標値を設定する
+ * @param void
+ * @retval void
+ */
+static void MouseController_StartSegment(void)
 {
+	if(_segHead == _segTail)
+	{
+		return;
+	}
+	_seg = _segQueue[_segHead];
+
+	// 区間を読み終えてから取り出し位置を進める
+	_segHead = (_segHead + 1) & SEG_QUEUE_MASK;
+
 	_t = 0;
 	_x = 0;
-	_tarvmin = vmin;
-	_taracc = acc;
-	_tarangv = 0;
-	_tarangvmin = 0;
-	_tarangvmax = 0;
-	_tarangacc = 0;
+	if(!(_seg.Flag & SEG_KEEP_ANG))
+	{
+		_ang = 0;
+#if GYRO_FUSION
+		_angEnc = 0;
+		_angRem = 0;
+#endif
+	}
+	if(_seg.Flag & SEG_SET_V)
+	{
+		_tarv = _seg.V;
+		_tarvRem = 0;
+	}
+	_tarvmax = (_seg.Flag & SEG_VMAX_NOW) ? _tarv : _seg.VMax;
+	_tarvmin = _seg.VMin;
+	_taracc = _seg.Acc;
+	if(_seg.Flag & SEG_SET_ANGV)
+	{
+		_tarangv = _seg.AngV;
+		_tarangvRem = 0;
+	}
+	_tarangvmax = (_seg.Flag & SEG_ANGVMAX_NOW) ? _tarangv : _seg.AngVMax;
+	_tarangvmin = _seg.AngVMin;
+	_tarangacc = _seg.AngAcc;
+
+	_segEnd = _seg.End;
+	_segEndTick = (_UDWORD)_seg.End;
+	if(_seg.Flag & SEG_ANG_MIRROR)
+	{
+		_segEnd -= CTRL_ABS(_ang);
+	}
 
+	_segActive = true;
 	_driving = true;
+}
 
-	while(_x < dist)
+/**
+ * 実行中の区間の終了判定
+ * @param void
+ * @retval bool: 終了条件を満たしたらtrue
+ */
+static bool MouseController_IsSegmentEnd(void)
+{
+	switch(_seg.Flag & SEG_END_MASK)
 	{
-		// 何かしら処理がないと無限ループに陥るのでウェイトを入れている
-		WaitUS(1);
+	case SEG_END_ANG:
+		if((_seg.Flag & SEG_END_ANGVMAX) && (_tarangv == _tarangvmax))
+		{
+			return true;
+		}
+		return (CTRL_ABS(_ang) >= _segEnd);
+	case SEG_END_TIME:
+		return (_t >= _segEndTick);
+	default:
+		return (_x >= _segEnd);
 	}
+}
 
-	if(rs)
+/**
+ * 実行中の区間を終了する
+ *   次の区間がなければ制御を止める(モータは直前の出力のまま)
+ * @param void
+ * @retval void
+ */
+static void MouseController_EndSegment(void)
+{
+	if(_seg.Flag & SEG_STOP)
 	{
-		_tarv = 0;
-		_tarvmin = 0;
-		_tarvmax = 0;
-		_taracc = 0;
+		MouseController_ClearTarget();
 	}
+	_segActive = false;
+	_segDone++;
 
-	_driving = false;
+	if(_segHead == _segTail)
+	{
+		_driving = false;
+	}
 }
 
-static void DriveTime(float v0, float ms)
+/**
+ * 目標速度,角速度を全て0にする
+ * @param void
+ * @retval void
+ */
+static void MouseController_ClearTarget(void)
 {
-	_t = 0;
-	_x = 0;
-	_tarv = v0;
-	_tarvmax = v0;
+	_tarv = 0;
+	_tarvRem = 0;
+	_tarvmin = 0;
+	_tarvmax = 0;
 	_taracc = 0;
 	_tarangv = 0;
+	_tarangvRem = 0;
 	_tarangvmin = 0;
 	_tarangvmax = 0;
 	_tarangacc = 0;
+}
 
-	_driving = true;
+#if VELOCITY_FEEDBACK
+/**
+ * 車輪1輪分の速度制御
+ *   duty = 電池電圧補正 x (逆起電力 + 加速分 + 摩擦) + PI
+ *   出力が上限に張り付いている間は,さらに張り付く向きの積分を止める
+ * @param ctrl: 制御器の状態
+ * @param tarv: 目標車輪速度 [mm/s]
+ * @param vel: エンコーダから求めた車輪速度 [mm/s]
+ * @retval CTRL_VAL: duty [%](正で前進)
+ */
+static CTRL_VAL MouseController_WheelDuty(WheelVelCtrl* ctrl, CTRL_VAL tarv, CTRL_VAL vel)
+{
+	CTRL_VAL ff, err, integ, duty;
 
-	while(_t * CONTROL_INTERVAL_MSEC < ms)
+	// フィードフォワード
+	ff = CTRL_MUL(CTRL_CONST(VEL_FF_V), tarv) + CTRL_MUL(CTRL_CONST(VEL_FF_A), tarv - ctrl->TarOld);
+	if(tarv > 0)
 	{
-		// 何かしら処理がないと無限ループに陥るのでウェイトを入れている
-		WaitUS(1);
+		ff += CTRL_CONST(VEL_FF_F);
 	}
+	else if(tarv < 0)
+	{
+		ff -= CTRL_CONST(VEL_FF_F);
+	}
+	ff = CTRL_MUL(_battGain, ff);
+	ctrl->TarOld = tarv;
 
-	_tarv = 0;
-	_tarvmax = 0;
+	// フィードバック
+	err = tarv - vel;
+	integ = ctrl->Integ + CTRL_DIVI(err, CONTROL_FREQ);
+	duty = ff + CTRL_MUL(CTRL_CONST(VEL_KP), err) + CTRL_MUL(CTRL_CONST(VEL_KI), integ);
+
+	// 飽和とアンチワインドアップ
+	if(duty > CTRL_CONST(DRV8836_DUTY_MAX))
+	{
+		duty = CTRL_CONST(DRV8836_DUTY_MAX);
+		if(err < 0)	ctrl->Integ = integ;
+	}
+	else if(duty < CTRL_CONST(-DRV8836_DUTY_MAX))
+	{
+		duty = CTRL_CONST(-DRV8836_DUTY_MAX);
+		if(err > 0)	ctrl->Integ = integ;
+	}
+	else
+	{
+		ctrl->Integ = integ;
+	}
 
-	_driving = false;
+	return duty;
 }
 
-static void TurnA(float angv0, float angvmax, float angacc, float dist)
+/**
+ * 速度制御器の状態を初期化する
+ * @param void
+ * @retval void
+ */
+static void MouseController_ResetWheelCtrl(void)
 {
-	_t = 0;
-	_x = 0;
-	_tarv = 0;
-	_tarvmin = 0;
-	_tarvmax = 0;
-	_taracc = 0;
-	_tarangv = angv0;
-	_tarangvmin = angv0;
-	_tarangvmax = angvmax;
-	_tarangacc = angacc;
+	_velCtrlL.TarOld = 0;
+	_velCtrlL.Integ = 0;
+	_velCtrlR.TarOld = 0;
+	_velCtrlR.Integ = 0;
+}
 
-	_driving = true;
+/**
+ * 電池電圧を読み,フィードフォワードの補正係数を更新する(Timerのタスク)
+ * @param void
+ * @retval void
+ */
+static void MouseController_UpdateBattery(void)
+{
+	float bat = Battery_GetValue();
 
-	while(_x < dist)
+	// A/D変換前など明らかにおかしい値は使わない
+	if(bat < HW_BATTERY_NOMINAL * 0.5)
 	{
-		// 何かしら処理がないと無限ループに陥るのでウェイトを入れている
-		WaitUS(1);
+		return;
 	}
-//	Printf("_x:%f\n", _x);
+	_battGain = CTRL_FROM_FLOAT(HW_BATTERY_NOMINAL / bat);
+}
+#endif
 
-	_driving = false;
+/**
+ * 加速直進区間の格納
+ *   格納時の横壁制御フラグを区間に引き継ぐ
+ */
+static _UWORD DriveAQueue(float v0, float vmax, float acc, float dist)
+{
+	MotionSegment seg = {0};
+
+	seg.Flag = SEG_END_DIST | SEG_SET_V | SEG_SET_ANGV;
+	seg.Flag |= _MF.CTRL.BIT.SIDE ? SEG_SIDE : 0;
+	seg.V = CTRL_FROM_FLOAT(v0);
+	seg.VMax = CTRL_FROM_FLOAT(vmax);
+	seg.Acc = CTRL_FROM_FLOAT(acc);
+	seg.End = CTRL_FROM_FLOAT(dist);
+	return MouseController_PushSegment(&seg);
 }
 
-static void TurnD(float angvmin, float angacc, float dist, bool rs)
+/**
+ * 減速直進区間の格納
+ *   速度は前の区間から引き継ぐ
+ */
+static _UWORD DriveDQueue(float vmin, float acc, float dist, bool rs)
 {
-	_t = 0;
-	_x = 0;
-	_tarv = 0;
-	_tarvmin = 0;
-	_tarvmax = 0;
-	_taracc = 0;
-	_tarangvmin = angvmin;
-	_tarangvmax = _tarangv;
-	_tarangacc = angacc;
+	MotionSegment seg = {0};
+
+	seg.Flag = SEG_END_DIST | SEG_VMAX_NOW | SEG_SET_ANGV;
+	seg.Flag |= _MF.CTRL.BIT.SIDE ? SEG_SIDE : 0;
+	seg.Flag |= rs ? SEG_STOP : 0;
+	seg.VMin = CTRL_FROM_FLOAT(vmin);
+	seg.Acc = CTRL_FROM_FLOAT(acc);
+	seg.End = CTRL_FROM_FLOAT(dist);
+	return MouseController_PushSegment(&seg);
+}
 
-	_driving = true;
+/**
+ * 定速直進区間(時間指定)の格納
+ */
+static _UWORD DriveTimeQueue(float v0, float ms)
+{
+	MotionSegment seg = {0};
+
+	seg.Flag = SEG_END_TIME | SEG_SET_V | SEG_SET_ANGV | SEG_STOP;
+	seg.Flag |= _MF.CTRL.BIT.SIDE ? SEG_SIDE : 0;
+	seg.V = CTRL_FROM_FLOAT(v0);
+	seg.VMax = CTRL_FROM_FLOAT(v0);
+	seg.End = (CTRL_VAL)(_UDWORD)(ms * CONTROL_FREQ / 1000);
+	return MouseController_PushSegment(&seg);
+}
 
-	while(_x < dist)
-	{
-		// 何かしら処理がないと無限ループに陥るのでウェイトを入れている
-		WaitUS(1);
-	}
+/**
+ * 加速旋回区間の格納
+ */
+static _UWORD TurnAQueue(float angv0, float angvmax, float angacc, float dist)
+{
+	MotionSegment seg = {0};
+
+	seg.Flag = SEG_END_DIST | SEG_SET_V | SEG_SET_ANGV;
+	seg.AngV = CTRL_FROM_FLOAT(angv0);
+	seg.AngVMin = CTRL_FROM_FLOAT(angv0);
+	seg.AngVMax = CTRL_FROM_FLOAT(angvmax);
+	seg.AngAcc = CTRL_FROM_FLOAT(angacc);
+	seg.End = CTRL_FROM_FLOAT(dist);
+	return MouseController_PushSegment(&seg);
+}
 
-	if(rs)
-	{
-		_tarangv = 0;
-		_tarangvmin = 0;
-		_tarangvmax = 0;
-		_tarangacc = 0;
-	}
-//	Printf("_x:%f\n", _x);
+/**
+ * 減速旋回区間の格納
+ *   角速度は前の区間から引き継ぐ
+ */
+static _UWORD TurnDQueue(float angvmin, float angacc, float dist, bool rs)
+{
+	MotionSegment seg = {0};
+
+	seg.Flag = SEG_END_DIST | SEG_SET_V | SEG_ANGVMAX_NOW;
+	seg.Flag |= rs ? SEG_STOP : 0;
+	seg.AngVMin = CTRL_FROM_FLOAT(angvmin);
+	seg.AngAcc = CTRL_FROM_FLOAT(angacc);
+	seg.End = CTRL_FROM_FLOAT(dist);
+	return MouseController_PushSegment(&seg);
+}
+
+/**
+ * 停止区間(目標値0で時間待ち)の格納
+ */
+static _UWORD StopQueue(float ms)
+{
+	MotionSegment seg = {0};
 
-	_driving = false;
+	seg.Flag = SEG_END_TIME | SEG_SET_V | SEG_SET_ANGV | SEG_STOP;
+	seg.End = (CTRL_VAL)(_UDWORD)(ms * CONTROL_FREQ / 1000);
+	return MouseController_PushSegment(&seg);
 }
 
-//static void Slalom(float v0, float angv0, float angvmax, float angacc, float distB, float )
-//{
-//	_t = 0;
-//	_x = 0;
-//	_tarv = v0;
-//	_tarvmin = v0;
-//	_tarvmax = DEF_ANGVMAX;
-//	_taracc = 0;
-//	_tarangv = 0;
-//	_tarangvmax = 0;
-//	_tarangacc = 0;
-//
-//	_driving = true;
-//
-//	while(_x < dist)
-//	{
-//		// 何かしら処理がないと無限ループに陥るのでウェイトを入れている
-//		WaitUS(1);
-//	}
-//	_tarangv = angv0;
-//	_tarangvmax = angvmax;
-//	_tarangacc = angacc;
-//
-//
-//	_driving = false;
-//}
+/**
+ * スラローム区間の格納
+ *   並進速度vを保ったまま,角加速->定角速度->角減速で角度angだけ旋回する
+ *   角度,角速度,角加速度は右回りが正.左旋回では全て負を与える
+ * @param v: 並進速度
+ * @param angvmax: 最大角速度
+ * @param angvmin: 角減速時の下限角速度
+ * @param angacc: 角加速度
+ * @param ang: 旋回角度 [rad]
+ * @param distPre: 旋回前の直進距離
+ * @param distPost: 旋回後の直進距離
+ * @retval _UWORD: 最後の区間の区間番号
+ */
+static _UWORD SlalomQueue(float v, float angvmax, float angvmin, float angacc, float ang, float distPre, float distPost)
+{
+	MotionSegment seg = {0};
+	float absAng = (ang > 0) ? ang : -ang;
+
+	// ---- 旋回前の直進 ----
+	seg.Flag = SEG_END_DIST | SEG_SET_V | SEG_SET_ANGV;
+	seg.V = CTRL_FROM_FLOAT(v);
+	seg.VMin = CTRL_FROM_FLOAT(v);
+	seg.VMax = CTRL_FROM_FLOAT(v);
+	seg.End = CTRL_FROM_FLOAT(distPre);
+	MouseController_PushSegment(&seg);
+
+	// ---- 角加速(最大角速度に達するか,旋回角度の半分まで) ----
+	seg.Flag = SEG_END_ANG | SEG_END_ANGVMAX;
+	seg.AngVMax = CTRL_FROM_FLOAT(angvmax);
+	seg.AngAcc = CTRL_FROM_FLOAT(angacc);
+	seg.End = CTRL_FROM_FLOAT(absAng / 2);
+	MouseController_PushSegment(&seg);
+
+	// ---- 定角速度(減速に角加速と同じ角度を残す) ----
+	seg.Flag = SEG_END_ANG | SEG_KEEP_ANG | SEG_ANG_MIRROR;
+	seg.AngAcc = 0;
+	seg.End = CTRL_FROM_FLOAT(absAng);
+	MouseController_PushSegment(&seg);
+
+	// ---- 角減速 ----
+	seg.Flag = SEG_END_ANG | SEG_KEEP_ANG | SEG_ANGVMAX_NOW;
+	seg.AngVMin = CTRL_FROM_FLOAT(angvmin);
+	seg.AngAcc = CTRL_FROM_FLOAT(-angacc);
+	seg.End = CTRL_FROM_FLOAT(absAng);
+	MouseController_PushSegment(&seg);
+
+	// ---- 旋回後の直進 ----
+	seg.Flag = SEG_END_DIST | SEG_SET_ANGV;
+	seg.AngVMin = 0;
+	seg.AngVMax = 0;
+	seg.AngAcc = 0;
+	seg.End = CTRL_FROM_FLOAT(distPost);
+	return MouseController_PushSegment(&seg);
+}
+
+#if GYRO_FUSION
+/**
+ * 旋回角度で終了する超信地旋回の格納
+ *   角加速で半分,角減速で残り半分を旋回して止まる
+ * @param angv0: 初期角速度(左旋回は負)
+ * @param angvmax: 最大角速度
+ * @param angvmin: 角減速時の下限角速度
+ * @param angacc: 角加速度
+ * @param ang: 旋回角度 [rad]
+ * @retval _UWORD: 最後の区間の通し番号
+ */
+static _UWORD TurnAngQueue(float angv0, float angvmax, float angvmin, float angacc, float ang)
+{
+	MotionSegment seg = {0};
+
+	// ---- 角加速 ----
+	seg.Flag = SEG_END_ANG | SEG_SET_V | SEG_SET_ANGV;
+	seg.AngV = CTRL_FROM_FLOAT(angv0);
+	seg.AngVMin = CTRL_FROM_FLOAT(angv0);
+	seg.AngVMax = CTRL_FROM_FLOAT(angvmax);
+	seg.AngAcc = CTRL_FROM_FLOAT(angacc);
+	seg.End = CTRL_FROM_FLOAT(ang / 2);
+	MouseController_PushSegment(&seg);
+
+	// ---- 角減速 ----
+	seg.Flag = SEG_END_ANG | SEG_SET_V | SEG_KEEP_ANG | SEG_ANGVMAX_NOW | SEG_STOP;
+	seg.AngVMin = CTRL_FROM_FLOAT(angvmin);
+	seg.AngAcc = CTRL_FROM_FLOAT(-angacc);
+	seg.End = CTRL_FROM_FLOAT(ang);
+	return MouseController_PushSegment(&seg);
+}
+#endif
+
+static void DriveA(float v0, float vmax, float acc, float dist)
+{
+	MouseController_WaitSegment(DriveAQueue(v0, vmax, acc, dist));
+}
+
+static void DriveD(float vmin, float acc, float dist, bool rs)
+{
+	MouseController_WaitSegment(DriveDQueue(vmin, acc, dist, rs));
+}
+
+static void DriveTime(float v0, float ms)
+{
+	MouseController_WaitSegment(DriveTimeQueue(v0, ms));
+}
+
+static void TurnA(float angv0, float angvmax, float angacc, float dist)
+{
+	MouseController_WaitSegment(TurnAQueue(angv0, angvmax, angacc, dist));
+}
+
+static void TurnD(float angvmin, float angacc, float dist, bool rs)
+{
+	MouseController_WaitSegment(TurnDQueue(angvmin, angacc, dist, rs));
+}
+
+static void Slalom(float v, float angvmax, float angvmin, float angacc, float ang, float distPre, float distPost)
+{
+	MouseController_WaitSegment(SlalomQueue(v, angvmax, angvmin, angacc, ang, distPre, distPost));
+}
@@ -9,20 +9,97 @@
 	Includes
  ----------------------------------------------------------------------*/
 #include "../typedefine.h"
+#include "ControlValue.h"
+#include "../Devices/LightSensor.h"
+#include "../Devices/MPU6500.h"
 
 /*----------------------------------------------------------------------
 	Macro Definitions
  ----------------------------------------------------------------------*/
-#define CONTROL_INTERVAL		12000	// 制御周期 12000: 1[mSec]
-#define CONTROL_INTERVAL_MSEC	1		// [msec]単位制御周期
-#define CONTROL_INTERVAL_SEC	0.001	// [sec]単位制御周期
-#define CONTROL_INTERVEL_INVSEC	1000	// [sec]単位制御周期の逆数[1/sec]
+#define CONTROL_FREQ			1000	// 制御周波数 [Hz] (1000〜10000)
+#define CONTROL_INTERVAL		(12000000 / CONTROL_FREQ)	// 制御周期 12000: 1[mSec] (PCLK/4)
+#define CONTROL_INTERVAL_SEC	(1.0 / CONTROL_FREQ)		// [sec]単位制御周期
+#define CONTROL_INTERVEL_INVSEC	CONTROL_FREQ				// [sec]単位制御周期の逆数[1/sec]
+
+// ==== 車輪速度制御 ====
+// 0: 目標速度に_kVtoDutyを掛けたdutyをそのまま出力する(開ループ)
+// 1: モータモデルによるフィードフォワード + エンコーダ速度のPIフィードバック
+#ifndef VELOCITY_FEEDBACK
+#define VELOCITY_FEEDBACK	0
+#endif
+#define VEL_UNIT_MMPS		10.0	// 目標速度1あたりの車輪速度 [mm/s]
+#define VEL_KP				0.02	// 比例ゲイン [%/(mm/s)]
+#define VEL_KI				0.5		// 積分ゲイン [%/mm]
+#define BATTERY_UPDATE_MS	100		// 電池電圧を読み直す周期 [msec]
+
+// ==== 車輪速度の推定 ====
+// 0: 1制御周期の角度差から求める
+// 1: 取得時刻付きのα-βフィルタ(WheelEstimator)で求め,外れ値を棄却する
+#ifndef WHEEL_ESTIMATOR
+#define WHEEL_ESTIMATOR		0
+#endif
+
+// ---- フィードフォワード係数(電池電圧が基準値のときのduty[%]) ----
+// 車輪速度 -> 逆起電力
+#define VEL_FF_V	(100.0 / HW_BATTERY_NOMINAL * HW_MOTOR_KE * HW_GEAR_RATIO / (HW_WHEEL_DIAM / 2.0))
+// 車輪1輪が受け持つ加速 -> 巻線電流による電圧降下(1制御周期あたりの速度変化に掛ける)
+#define VEL_FF_A	(100.0 / HW_BATTERY_NOMINAL * HW_MOTOR_R / HW_MOTOR_KT * (HW_MASS / 2.0) * (HW_WHEEL_DIAM / 2.0) / HW_GEAR_RATIO / 1000000.0 * CONTROL_FREQ)
+// 摩擦トルク
+#define VEL_FF_F	(100.0 / HW_BATTERY_NOMINAL * HW_MOTOR_R * HW_MOTOR_TF / HW_MOTOR_KT)
+
+// ==== ジャイロ融合 ====
+// 0: 旋回角度を左右車輪の回転量の差だけから求める
+// 1: ジャイロの角速度を積分し,エンコーダの角度で緩やかに補正する(相補フィルタ)
+//    併せて角速度のPIループをかけ,超信地旋回も旋回角度で終了する
+#ifndef GYRO_FUSION
+#define GYRO_FUSION			0
+#endif
+#define GYRO_LSB_PER_DPS	16.4	// ジャイロ感度(±2000dps) [LSB/(deg/s)]
+#define GYRO_FUSION_K		0.0005	// 1制御周期あたりのエンコーダ角度への補正率(時定数2[sec])
+#define ANGV_UNIT_RADPS		(2.0 * VEL_UNIT_MMPS)	// 目標角速度1あたりの旋回角速度 [rad/s]
+#define YAW_KP				0.5		// 角速度比例ゲイン
+#define YAW_KI				5.0		// 角速度積分ゲイン [1/sec]
+#define YAW_INTEG_MAX		0.2		// 角速度偏差の積分の上限 [rad]
+
+// ==== センサ取得の位相同期 ====
+// 0: RSPIのCycleOperation(CMT1)と光センサ(MTU3)はそれぞれのタイマで自走する
+// 1: 制御周期(MTU2)を基準に,制御割り込みから一定の位相でセンサ取得を1巡ずつ起動する
+//    RSPI: 制御割り込みのSENSOR_LEAD_US前にMTU2のTGRBコンペアマッチで起動
+//          (エンコーダ2個+MPU6500の1巡は1Mbpsでおよそ560[usec])
+//    光センサ: SENSOR_LS_DIV制御周期に1回,制御割り込みの先頭で起動
+//          (1巡LS_SCAN_COUNTが制御周期より長いと毎周期は回せない.LS_GROUP_SCANなら1でよい)
+#ifndef SENSOR_PHASE_LOCK
+#define SENSOR_PHASE_LOCK	0
+#endif
+#define SENSOR_LEAD_US		700		// RSPIを起動してから制御割り込みまでの時間 [usec]
+#define SENSOR_LEAD_COUNT	(SENSOR_LEAD_US * 12)	// MTU2のカウント数(PCLK/4)
+#if LS_GROUP_SCAN
+#define SENSOR_LS_DIV		1		// 光センサを起動する制御周期の間隔
+#else
+#define SENSOR_LS_DIV		2		// 光センサを起動する制御周期の間隔
+#endif
+
+#if SENSOR_PHASE_LOCK && (SENSOR_LEAD_COUNT >= CONTROL_INTERVAL)
+#error "SENSOR_LEAD_US must be shorter than the control interval"
+#endif
+#if SENSOR_PHASE_LOCK && (LS_SCAN_COUNT >= SENSOR_LS_DIV * CONTROL_INTERVAL)
+#error "SENSOR_LS_DIV is too small for one light sensor scan"
+#endif
 
 // ==== 制御基準値 ====
 #define CTRL_REF_MIN_L	-300			// 左制御基準下限
 #define CTRL_REF_MAX_L	500				// 左制御基準上限
 #define CTRL_REF_MIN_R	-300			// 右制御基準下限
 #define CTRL_REF_MAX_R	500				// 右制御基準上限
+// ---- LS_DISTANCEのとき(LS_DIST_SIDE_CENTERからのずれで制御) ----
+#define CTRL_DIST_MAX_SIDE	WALL_DIST_SIDE	// 横壁制御に使う横壁までの距離の上限 [mm]
+#define SIDE_KP_MM			-0.4			// 比例ゲイン(中央からのずれ1[mm]あたり)の初期値
+
+// ==== 光センサの距離較正 ====
+// 機体前端を前壁につけた位置からLS_CAL_Vで後退し,前センサのA/D値を距離ごとに記録する
+#define LS_CAL_V			2.0				// 後退速度(20[mm/s])
+#define LS_CAL_TIME_MS		((LS_DIST_MAX_MM - LS_DIST_FWD_CONTACT + 20) * 1000.0 / (LS_CAL_V * VEL_UNIT_MMPS))
+#define LS_CAL_BASE_NUM		16				// 横センサの区画中央での値を平均する回数
 
 // ==== 走行距離 ====
 #define DR_SEC_HALF			24.0	// 半区画走行
@@ -32,6 +109,10 @@
 #define DR_ROT_L180			50.0	// 左180度回転
 #define DR_CENT_SET			8.0		// 後ろ壁から中央までの距離
 
+// ==== 旋回角度(GYRO_FUSION時の超信地旋回) ====
+#define ROT_ANG_90			(PI / 2)
+#define ROT_ANG_180			PI
+
 #define DEF_V0		8
 #define DEF_V_CONST	30
 #define DEF_VMIN	8
@@ -42,9 +123,88 @@
 #define DEF_ANGVMAX	0.3
 #define DEF_ANGACC	0
 
+// ==== 探索用スラローム(区画の入口から出口までで90度旋回) ====
+#define SLA_V			DEF_VMAX	// 並進速度
+#define SLA_ANGVMAX		0.3			// 最大角速度
+#define SLA_ANGVMIN		0.05		// 角減速時の下限角速度
+#define SLA_ANGACC		3.0			// 角加速度
+#define SLA_ANG_90		(PI / 2)	// 旋回角度 [rad]
+#define SLA_PRE_R90		4.0			// 右旋回前の直進距離
+#define SLA_POST_R90	4.0			// 右旋回後の直進距離
+#define SLA_PRE_L90		4.0			// 左旋回前の直進距離
+#define SLA_POST_L90	4.0			// 左旋回後の直進距離
+
+// ==== 停止後の待ち時間 ====
+#define WAIT_STOP_MS		400		// 減速停止,超信地旋回の後 [msec]
+
+// ==== 走行区間キュー ====
+#define SEG_QUEUE_SIZE		16		// 格納数(2のべき乗)
+#define SEG_QUEUE_MASK		(SEG_QUEUE_SIZE - 1)
+
+// ---- 走行区間フラグ ----
+#define SEG_END_DIST		0x0000	// 走行距離で終了
+#define SEG_END_ANG			0x0001	// 旋回角度で終了
+#define SEG_END_TIME		0x0002	// 経過時間で終了
+#define SEG_END_MASK		0x0003
+#define SEG_SET_V			0x0004	// 開始時に目標速度をVにする(なければ前の区間から継続)
+#define SEG_SET_ANGV		0x0008	// 開始時に目標角速度をAngVにする(なければ前の区間から継続)
+#define SEG_VMAX_NOW		0x0010	// 開始時の目標速度を速度上限にする
+#define SEG_ANGVMAX_NOW		0x0020	// 開始時の目標角速度を角速度上限にする
+#define SEG_STOP			0x0040	// 終了時に目標値を全て0にする
+#define SEG_KEEP_ANG		0x0080	// 開始時に旋回角度を0に戻さない
+#define SEG_ANG_MIRROR		0x0100	// 終了角度から開始時の旋回角度を引く
+#define SEG_END_ANGVMAX		0x0200	// 目標角速度が上限に達しても終了
+#define SEG_SIDE			0x0400	// 横壁制御を行う
+
 /*----------------------------------------------------------------------
 	Struct Definitions
  ----------------------------------------------------------------------*/
+// ==== 走行区間(制御割り込みが1つずつ取り出して実行する) ====
+typedef struct stMotionSegment
+{
+	_UWORD Flag;		// SEG_*
+	CTRL_VAL V;			// 開始時の目標速度
+	CTRL_VAL VMax;		// 速度上限
+	CTRL_VAL VMin;		// 速度下限
+	CTRL_VAL Acc;		// 加速度
+	CTRL_VAL AngV;		// 開始時の目標角速度
+	CTRL_VAL AngVMax;	// 角速度上限
+	CTRL_VAL AngVMin;	// 角速度下限
+	CTRL_VAL AngAcc;	// 角加速度
+	CTRL_VAL End;		// 終了条件(距離, 角度の絶対値[rad], 時間[制御周期数]は整数のまま)
+}MotionSegment;
+
+// ==== 車輪1輪分の速度制御器の状態 ====
+typedef struct stWheelVelCtrl
+{
+	CTRL_VAL TarOld;	// 1制御周期前の目標車輪速度 [mm/s]
+	CTRL_VAL Integ;		// 速度偏差の積分 [mm]
+}WheelVelCtrl;
+
+// ==== 横壁制御のゲイン(不揮発パラメータに保存する形) ====
+typedef struct stSideGain
+{
+	float Kp;			// 比例ゲイン(基準値との差1あたり)
+	float Kd;			// 微分ゲイン(差の変化1あたり)
+	float KpMM;			// LS_DISTANCEのときの比例ゲイン(中央からのずれ1[mm]あたり)
+}SideGain;
+
+// ==== 1制御周期分のセンサ値(制御割り込みが毎周期まとめて発行する) ====
+typedef struct stSensorFrame
+{
+	_UDWORD Tick;		// 発行した制御周期の番号
+	_UDWORD Stamp;		// 発行した時刻 [usec] (Timer_GetTimeUS)
+	LSChannel LsNow;	// 光センサ現在値
+	LSChannel LsDif;	// 光センサ現在値と基準値の差
+	LSChannel LsDist;	// 光センサから壁までの距離(LS_DISTANCEのとき) [1/LS_DIST_SCALE mm]
+	_UDWORD LsStamp;	// 光センサ値が揃った時刻 [usec]
+	_UWORD EncL;		// 左エンコーダ角度
+	_UWORD EncR;		// 右エンコーダ角度
+	_UDWORD EncLStamp;	// 左エンコーダ角度を取得した時刻 [usec]
+	_UDWORD EncRStamp;	// 右エンコーダ角度を取得した時刻 [usec]
+	ImuSample Imu;		// 6軸+温度
+}SensorFrame;
+
 typedef struct stBinaryTimeSeriesVal
 {
 	_UWORD Now;
@@ -57,23 +217,48 @@ typedef struct sFloatTimeSeriesVal
 	float Old;
 }FloatTimeSeriesVal;
 
+typedef struct sCtrlTimeSeriesVal
+{
+	CTRL_VAL Now;
+	CTRL_VAL Old;
+}CtrlTimeSeriesVal;
+
 /*----------------------------------------------------------------------
 	Public Method Declarations
  ----------------------------------------------------------------------*/
 void MouseController_Initialize(void);
 #pragma inline(MouseController_IntMTU2TGIA)
 void MouseController_IntMTU2TGIA(void);
+#pragma inline(MouseController_IntMTU2TGIB)
+void MouseController_IntMTU2TGIB(void);
 float MouseController_GetVel(void);
 float MouseController_GetAngvel(void);
+void MouseController_GetSensorFrame(SensorFrame* frame);
 void MouseController_CheckValue(void);
 void MouseControlle_MotorTest(void);
+void MouseController_CalibrateSensor(void);
+void MouseController_SetSideGain(const SideGain* gain);
+void MouseController_GetSideGain(SideGain* gain);
+void MouseController_InputParam(void);
+_UWORD MouseController_PushSegment(const MotionSegment* seg);
+_UBYTE MouseController_GetQueueSpace(void);
+void MouseController_WaitSegment(_UWORD seq);
+void MouseController_CancelSegment(void);
 
 void HalfSectionA(void);
 void HalfSectionD(void);
+void SectionAD(_UBYTE halfNum);
 void TurnL90AD(void);
 void TurnR90AD(void);
 void TurnR180AD(void);
 void TurnL180AD(void);
+void SlalomR90(void);
+void SlalomL90(void);
 void SetPosition(void);
 
+_UWORD SectionADQueue(_UBYTE halfNum);
+_UWORD TurnR90ADQueue(void);
+_UWORD TurnL90ADQueue(void);
+_UWORD TurnR180ADQueue(void);
+
 #endif /* __MOUSECONTROLLER_H__ */
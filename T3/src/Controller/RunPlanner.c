@@ -0,0 +1,392 @@
+/**
+ * @file  RunPlanner.c
+ * @brief 走行時間を評価値とする最短走行経路の計画を行うクラス
+ *
+ * (区画, 向き)を状態とし,MouseControllerの走行プロファイルから求めた
+ * 直進,旋回の所要時間を辺の重みとしてダイクストラ法で経路を求める.
+ * 歩数が同じでも曲がる回数の少ない経路が選ばれる.
+ * 所要時間はCOST_UNIT単位の16bitで持ち,作業領域は状態あたり6バイト
+ * (16x16で6K[byte], 32x32で24K[byte])とする.
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "RunPlanner.h"
+#include <math.h>
+#include "MouseController.h"
+#include "Search.h"
+#include "../Hardware/HardwareParameter.h"
+
+/*----------------------------------------------------------------------
+	Macro Definitions
+ ----------------------------------------------------------------------*/
+#define STATE_NUM			(MAZE_CELL_NUM * 4)		// 状態数(区画 x 向き)
+#define STATE(x, y, dir)	((_UWORD)((((y) * MAZE_SIZE + (x)) << 2) | (dir)))
+#define STATE_X(s)			(((s) >> 2) % MAZE_SIZE)
+#define STATE_Y(s)			(((s) >> 2) / MAZE_SIZE)
+#define STATE_DIR(s)		((s) & 0x03)
+#define HEAP_NONE			0xffff		// ヒープに積まれていない
+#define HEAP_DONE			0xfffe		// 所要時間が確定した
+#if MAZE_SIZE == 16
+#define COST_UNIT			0.02f		// 所要時間の単位 [sec] (最大1310[sec]: 全区画で旋回する経路も収まる)
+#else
+#define COST_UNIT			0.04f		// 所要時間の単位 [sec] (最大2621[sec])
+#endif
+#define COST_INF			0xffff		// 到達できない(これ以上の所要時間は扱わない)
+#define TO_COST(sec)		((_UWORD)((sec) / COST_UNIT + 0.5f))
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+static _UWORD _cost[STATE_NUM];			// 各状態からゴールまでの所要時間 [COST_UNIT]
+static _UWORD _heap[STATE_NUM];			// 所要時間の小さい順に状態を取り出す二分ヒープ
+static _UWORD _heapPos[STATE_NUM];		// 各状態のヒープ内の位置
+static _UWORD _heapNum;					// ヒープ内の状態数
+static _UWORD _straightTime[MAZE_SIZE];	// n区画直進の所要時間 [COST_UNIT]
+static _UWORD _turnTime[4];				// 右回りの旋回量(0〜3)ごとの旋回の所要時間 [COST_UNIT]
+
+static const _SBYTE _dx[4] = {0, 1, 0, -1};	// 北,東,南,西へ進んだときのx変化
+static const _SBYTE _dy[4] = {1, 0, -1, 0};	// 北,東,南,西へ進んだときのy変化
+
+/*----------------------------------------------------------------------
+	Private Method Declarations
+ ----------------------------------------------------------------------*/
+static bool RunPlanner_IsOpen(_UBYTE map[MAZE_SIZE][MAZE_SIZE], _UBYTE x, _UBYTE y, _UBYTE dir);
+static void RunPlanner_Relax(_UWORD state, _UDWORD cost);
+static _UWORD RunPlanner_HeapPop(void);
+static void RunPlanner_HeapUp(_UWORD i);
+static void RunPlanner_HeapDown(_UWORD i);
+static void RunPlanner_HeapSet(_UWORD i, _UWORD state);
+
+/*----------------------------------------------------------------------
+	Public Method Definitions
+ ----------------------------------------------------------------------*/
+/**
+ * 走行時間最小の経路を求める
+ *   二次走行用(未探索の壁はありとする)の上位4bitの壁情報を用いる
+ * @param map: マップ
+ * @param x, y: 出発区画
+ * @param dir: 出発時のマウスの方向
+ * @param route: 経路の格納先(Search_MakeRouteと同じ形式, MAZE_CELL_NUM個)
+ * @retval float: 予測走行時間 [sec] (経路がなければRUN_PLANNER_NO_ROUTE)
+ */
+float RunPlanner_MakeRoute(_UBYTE map[MAZE_SIZE][MAZE_SIZE], _UBYTE x, _UBYTE y, _UBYTE dir, _UBYTE* route)
+{
+	_UWORD s, p;
+	_UWORD i;
+	_UBYTE cx, cy, d, k, t, td;
+	_SBYTE px, py;
+	_UDWORD best, c;
+	_UBYTE bestTurn, bestNum;
+
+	// ==== 直進,旋回時間表の作成と初期化 ====
+	for(k = 1; k < MAZE_SIZE; k++)
+	{
+		_straightTime[k] = TO_COST(RunPlanner_StraightTime(2 * k));
+	}
+	_turnTime[0] = 0;
+	_turnTime[1] = TO_COST(RunPlanner_TurnTime(DIR_TURN_R90));
+	_turnTime[2] = TO_COST(RunPlanner_TurnTime(DIR_TURN_180));
+	_turnTime[3] = TO_COST(RunPlanner_TurnTime(DIR_TURN_L90));
+	_heapNum = 0;
+	for(s = 0; s < STATE_NUM; s++)
+	{
+		_cost[s] = COST_INF;
+		_heapPos[s] = HEAP_NONE;
+	}
+	for(i = 0; i < MAZE_CELL_NUM; i++)
+	{
+		route[i] = 0xff;
+	}
+
+	// ==== ゴール区画の全状態を0として,ゴール側から所要時間を求める ====
+	for(cy = 0; cy < MAZE_SIZE; cy++)
+	{
+		for(cx = 0; cx < MAZE_SIZE; cx++)
+		{
+			if(Search_IsGoal(cx, cy))
+			{
+				for(d = 0; d < 4; d++)
+				{
+					RunPlanner_Relax(STATE(cx, cy, d), 0);
+				}
+			}
+		}
+	}
+	while(_heapNum > 0)
+	{
+		s = RunPlanner_HeapPop();
+		cx = STATE_X(s);
+		cy = STATE_Y(s);
+		d = STATE_DIR(s);
+
+		// ---- 旋回してからk区画直進してこの状態になる状態 ----
+		//   旋回は直進の前に1回だけとする(旋回を続けると,経路に書けない旋回の組になるため)
+		px = cx;
+		py = cy;
+		for(k = 1; k < MAZE_SIZE; k++)
+		{
+			px -= _dx[d];
+			py -= _dy[d];
+			if((px < 0) || (px >= MAZE_SIZE) || (py < 0) || (py >= MAZE_SIZE) || !RunPlanner_IsOpen(map, px, py, d))
+			{
+				break;
+			}
+			c = (_UDWORD)_cost[s] + _straightTime[k];
+			RunPlanner_Relax(STATE(px, py, d), c);
+			RunPlanner_Relax(STATE(px, py, (d + 3) & 0x03), c + _turnTime[1]);
+			RunPlanner_Relax(STATE(px, py, (d + 1) & 0x03), c + _turnTime[3]);
+			RunPlanner_Relax(STATE(px, py, (d + 2) & 0x03), c + _turnTime[2]);
+		}
+	}
+
+	s = STATE(x, y, dir & 0x03);
+	if(_cost[s] >= COST_INF)
+	{
+		return RUN_PLANNER_NO_ROUTE;
+	}
+
+	// ==== 出発状態から,所要時間が最小となる辺をたどって経路を作成 ====
+	i = 0;
+	while(_cost[s] > 0)
+	{
+		cx = STATE_X(s);
+		cy = STATE_Y(s);
+		d = STATE_DIR(s);
+
+		// ---- 旋回してk区画直進 ----
+		best = COST_INF;
+		bestTurn = 0;
+		bestNum = 0;
+		for(t = 0; t < 4; t++)
+		{
+			td = (d + t) & 0x03;
+			px = cx;
+			py = cy;
+			for(k = 1; k < MAZE_SIZE; k++)
+			{
+				if(!RunPlanner_IsOpen(map, px, py, td))
+				{
+					break;
+				}
+				px += _dx[td];
+				py += _dy[td];
+				if((px < 0) || (px >= MAZE_SIZE) || (py < 0) || (py >= MAZE_SIZE))
+				{
+					break;
+				}
+				c = (_UDWORD)_turnTime[t] + _straightTime[k] + _cost[STATE(px, py, td)];
+				if(c < best)
+				{
+					best = c;
+					bestTurn = t;
+					bestNum = k;
+				}
+			}
+		}
+
+		td = (d + bestTurn) & 0x03;
+		switch(bestTurn)
+		{
+		case 0x01:	route[i++] = 0x44;	break;
+		case 0x02:	route[i++] = 0x22;	break;
+		case 0x03:	route[i++] = 0x11;	break;
+		default:	route[i++] = 0x88;	break;
+		}
+		for(k = 1; k < bestNum; k++)
+		{
+			route[i++] = 0x88;
+		}
+		p = STATE(cx + _dx[td] * bestNum, cy + _dy[td] * bestNum, td);
+		s = p;
+	}
+
+	return (float)_cost[STATE(x, y, dir & 0x03)] * COST_UNIT;
+}
+
+/**
+ * 経路の予測走行時間を求める
+ *   直進は旋回から次の旋回までを1回の加減速として評価する
+ * @param route: 経路(Search_MakeRouteと同じ形式)
+ * @retval float: 予測走行時間 [sec]
+ */
+float RunPlanner_EstimateTime(const _UBYTE* route)
+{
+	float t = 0;
+	_UWORD i;
+	_UWORD num = 0;		// 連続する直進区画数
+
+	for(i = 0; i < MAZE_CELL_NUM; i++)
+	{
+		if((route[i] != 0x88) && (num > 0))
+		{
+			t += RunPlanner_StraightTime(2 * num);
+			num = 0;
+		}
+		switch(route[i])
+		{
+		case 0x88:
+			break;
+		case 0x44:
+			t += RunPlanner_TurnTime(DIR_TURN_R90);
+			break;
+		case 0x22:
+			t += RunPlanner_TurnTime(DIR_TURN_180);
+			break;
+		case 0x11:
+			t += RunPlanner_TurnTime(DIR_TURN_L90);
+			break;
+		default:
+			return t;
+		}
+		num++;
+	}
+	if(num > 0)
+	{
+		t += RunPlanner_StraightTime(2 * num);
+	}
+	return t;
+}
+
+/**
+ * 停止状態から半区画n個分を直進して停止するまでの所要時間
+ *   DEF_V0から加速度DEF_ACCでDEF_VMAXまで加速し,DEF_VMINまで減速する台形プロファイル
+ * @param halfNum: 半区画の数
+ * @retval float: 所要時間 [sec]
+ */
+float RunPlanner_StraightTime(_UWORD halfNum)
+{
+	float dist = (float)halfNum * DR_SEC_HALF;
+	float distAcc = ((float)DEF_VMAX * DEF_VMAX - (float)DEF_V0 * DEF_V0) / (2.0f * DEF_ACC);		// 加速距離
+	float distDec = ((float)DEF_VMAX * DEF_VMAX - (float)DEF_VMIN * DEF_VMIN) / (2.0f * DEF_ACC);	// 減速距離
+	float vpeak;
+
+	// 最高速度に達する場合
+	if(distAcc + distDec <= dist)
+	{
+		return ((float)DEF_VMAX - DEF_V0) / DEF_ACC + ((float)DEF_VMAX - DEF_VMIN) / DEF_ACC
+				+ (dist - distAcc - distDec) / DEF_VMAX + WAIT_STOP_MS / 1000.0f;
+	}
+	// 最高速度に達する前に減速する場合
+	vpeak = sqrtf((2.0f * DEF_ACC * dist + (float)DEF_V0 * DEF_V0 + (float)DEF_VMIN * DEF_VMIN) / 2.0f);
+	return (vpeak - DEF_V0) / DEF_ACC + (vpeak - DEF_VMIN) / DEF_ACC + WAIT_STOP_MS / 1000.0f;
+}
+
+/**
+ * 超信地旋回の所要時間
+ *   車輪速度HW_TREAD_WIDTH * DEF_ANGVMAXで旋回距離を走る
+ * @param turn: DIR_TURN_R90, DIR_TURN_L90, DIR_TURN_180
+ * @retval float: 所要時間 [sec]
+ */
+float RunPlanner_TurnTime(_UBYTE turn)
+{
+	float dist;
+
+	switch(turn)
+	{
+	case DIR_TURN_R90:	dist = DR_ROT_R90;	break;
+	case DIR_TURN_L90:	dist = DR_ROT_L90;	break;
+	default:			dist = DR_ROT_R180;	break;
+	}
+	return dist / (float)(HW_TREAD_WIDTH * DEF_ANGVMAX) + WAIT_STOP_MS / 1000.0f;
+}
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+/**
+ * 区画(x, y)からdir方向へ進めるか(二次走行用の壁情報で判定)
+ */
+static bool RunPlanner_IsOpen(_UBYTE map[MAZE_SIZE][MAZE_SIZE], _UBYTE x, _UBYTE y, _UBYTE dir)
+{
+	return !(map[y][x] & (0x80 >> dir));
+}
+
+/**
+ * 状態の所要時間が短くなるなら更新してヒープに積む
+ */
+static void RunPlanner_Relax(_UWORD state, _UDWORD cost)
+{
+	if((_heapPos[state] == HEAP_DONE) || (cost >= _cost[state]))
+	{
+		return;
+	}
+	_cost[state] = (_UWORD)cost;
+	if(_heapPos[state] == HEAP_NONE)
+	{
+		RunPlanner_HeapSet(_heapNum++, state);
+	}
+	RunPlanner_HeapUp(_heapPos[state]);
+}
+
+/**
+ * 所要時間が最小の状態をヒープから取り出す
+ */
+static _UWORD RunPlanner_HeapPop(void)
+{
+	_UWORD top = _heap[0];
+
+	_heapNum--;
+	if(_heapNum > 0)
+	{
+		RunPlanner_HeapSet(0, _heap[_heapNum]);
+		RunPlanner_HeapDown(0);
+	}
+	_heapPos[top] = HEAP_DONE;
+	return top;
+}
+
+/**
+ * ヒープの要素を親の方向へ移動させる
+ */
+static void RunPlanner_HeapUp(_UWORD i)
+{
+	_UWORD state = _heap[i];
+	_UWORD parent;
+
+	while(i > 0)
+	{
+		parent = (i - 1) / 2;
+		if(_cost[_heap[parent]] <= _cost[state])
+		{
+			break;
+		}
+		RunPlanner_HeapSet(i, _heap[parent]);
+		i = parent;
+	}
+	RunPlanner_HeapSet(i, state);
+}
+
+/**
+ * ヒープの要素を子の方向へ移動させる
+ */
+static void RunPlanner_HeapDown(_UWORD i)
+{
+	_UWORD state = _heap[i];
+	_UWORD child;
+
+	while((child = 2 * i + 1) < _heapNum)
+	{
+		if((child + 1 < _heapNum) && (_cost[_heap[child + 1]] < _cost[_heap[child]]))
+		{
+			child++;
+		}
+		if(_cost[state] <= _cost[_heap[child]])
+		{
+			break;
+		}
+		RunPlanner_HeapSet(i, _heap[child]);
+		i = child;
+	}
+	RunPlanner_HeapSet(i, state);
+}
+
+/**
+ * ヒープのi番目に状態を置く
+ */
+static void RunPlanner_HeapSet(_UWORD i, _UWORD state)
+{
+	_heap[i] = state;
+	_heapPos[state] = i;
+}
@@ -0,0 +1,27 @@
+/**
+ * @file  RunPlanner.h
+ * @brief 走行時間を評価値とする最短走行経路の計画を行うクラス
+ */
+
+#ifndef __RUNPLANNER_H__
+#define __RUNPLANNER_H__
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "../typedefine.h"
+#include "MazeDefine.h"
+
+/*----------------------------------------------------------------------
+	Macro Definitions
+ ----------------------------------------------------------------------*/
+#define RUN_PLANNER_NO_ROUTE	(-1.0f)		// ゴールに至る経路がない
+
+/*----------------------------------------------------------------------
+	Public Method Declarations
+ ----------------------------------------------------------------------*/
+float RunPlanner_MakeRoute(_UBYTE map[MAZE_SIZE][MAZE_SIZE], _UBYTE x, _UBYTE y, _UBYTE dir, _UBYTE* route);
+float RunPlanner_EstimateTime(const _UBYTE* route);
+float RunPlanner_StraightTime(_UWORD halfNum);
+float RunPlanner_TurnTime(_UBYTE turn);
+
+#endif /* __RUNPLANNER_H__ */
@@ -7,35 +7,101 @@
 	Includes
  ----------------------------------------------------------------------*/
 #include "Search.h"
+#include <stdbool.h>
 #include "../iodefine.h"
 #include "../Global.h"
 #include "MouseController.h"
+#include "MazeMask.h"
+#include "RunPlanner.h"
+#include "MotionPlan.h"
 #include "../Devices/LightSensor.h"
+#include "../Utils/ParamStore.h"
 
 
+/*----------------------------------------------------------------------
+	Macro Definitions
+ ----------------------------------------------------------------------*/
+// ==== 歩数マップ展開用キューの区画番号 ====
+#define STEP_QUEUE_CELL(x, y)	((MAZE_CELL)(((y) << MAZE_COORD_BITS) | (x)))	// 座標から区画番号
+#define STEP_QUEUE_X(cell)		((cell) & (MAZE_SIZE - 1))						// 区画番号からX座標
+#define STEP_QUEUE_Y(cell)		((cell) >> MAZE_COORD_BITS)						// 区画番号からY座標
+#define STEP_QUEUE_MASK			(MAZE_CELL_NUM - 1)								// キュー位置の折り返し用
+
+// ==== 探索の途中保存(ParamStoreのキーへの割り当て) ====
+#define CHECKPOINT_MAP_ROWS			(PARAM_VALUE_MAX / MAZE_SIZE)			// マップの1キー分の行数
+#define CHECKPOINT_MAP_NUM			(MAZE_SIZE / CHECKPOINT_MAP_ROWS)		// マップのキー数
+#define CHECKPOINT_MAP_BIT(y)		((_UWORD)1 << ((y) / CHECKPOINT_MAP_ROWS))	// 行を含むキーのビット
+#define CHECKPOINT_ROW_BYTES		((MAZE_SIZE == 16) ? 2 : 4)				// MAZE_ROWのバイト数(#ifで使うのでsizeofにしない)
+#define CHECKPOINT_SEARCHED_ROWS	(PARAM_VALUE_MAX / CHECKPOINT_ROW_BYTES)	// 探索済み区画の1キー分の行数
+#define CHECKPOINT_SEARCHED_NUM		((MAZE_SIZE + CHECKPOINT_SEARCHED_ROWS - 1) / CHECKPOINT_SEARCHED_ROWS)	// 探索済み区画のキー数
+#define CHECKPOINT_SEARCHED_BIT(y)	((_UBYTE)1 << ((y) / CHECKPOINT_SEARCHED_ROWS))	// 行を含むキーのビット
+
+#if CHECKPOINT_MAP_NUM > PARAM_MAP_KEY_NUM
+#error "PARAM_MAP_KEY_NUM is too small for MAZE_SIZE"
+#endif
+#if CHECKPOINT_SEARCHED_NUM > PARAM_SEARCHED_KEY_NUM
+#error "PARAM_SEARCHED_KEY_NUM is too small for MAZE_SIZE"
+#endif
+
+// ==== 壁の有無の判断(センサフレームから) ====
+#if LS_DISTANCE
+#define WALL_FWD(f)		((f).LsDist.FwdL < LS_MM(WALL_DIST_FWD))
+#define WALL_RIGHT(f)	((f).LsDist.Right < LS_MM(WALL_DIST_SIDE))
+#define WALL_LEFT(f)	((f).LsDist.Left < LS_MM(WALL_DIST_SIDE))
+#else
+#define WALL_FWD(f)		((f).LsNow.FwdL > LightSensor_GetWallBase()[LS_FWD_L])
+#define WALL_RIGHT(f)	((f).LsNow.Right > LightSensor_GetWallBase()[LS_RIGHT])
+#define WALL_LEFT(f)	((f).LsNow.Left > LightSensor_GetWallBase()[LS_LEFT])
+#endif
+
+//----探索の再開位置(保存用)----
+typedef struct stSearchCheckpoint
+{
+	_UBYTE X;			// X座標
+	_UBYTE Y;			// Y座標
+	_UBYTE Dir;			// マウスの方向
+	_UBYTE Reserved;
+	_SWORD BaseLeft;	// 横センサの基準値(再開する区画に左右の壁があるとは限らないため)
+	_SWORD BaseRight;
+}SearchCheckpoint;
+
 //----現在地格納共用・構造体----
 volatile union map_coor{
-	_UBYTE PLANE;		//YX座標
+	_UWORD PLANE;		//YX座標
 	struct coor_axis{
-		_UBYTE Y:4;		//Y座標
-		_UBYTE X:4;		//X座標
+		_UWORD Y:MAZE_COORD_BITS;		//Y座標
+		_UWORD X:MAZE_COORD_BITS;		//X座標
 	}AXIS;
 }PRELOC;
 
-_UBYTE map[16][16];		// マップ格納配列
-_UBYTE smap[16][16];		// 歩数マップ格納配列
+_UBYTE map[MAZE_SIZE][MAZE_SIZE];		// マップ格納配列
+MAZE_STEP smap[MAZE_SIZE][MAZE_SIZE];	// 歩数マップ格納配列
 _UBYTE wallInfo;			// 壁情報格納変数
 _UBYTE mDir;				// マウスの方向
-_UBYTE mStep;			// 歩数格納
-_UBYTE route[256];		// 最短経路格納
-_UBYTE routeCnt;			// 経路カウンタ
+MAZE_STEP mStep;		// 歩数格納
+_UBYTE route[MAZE_CELL_NUM];	// 最短経路格納
+_UWORD routeCnt;			// 経路カウンタ
+
+MAZE_ROW goalMask[MAZE_SIZE];	// ゴール区画(行ごとのビット)
+MAZE_CELL stepQueue[MAZE_CELL_NUM];	// 歩数マップ展開用キュー(区画番号を格納)
+MAZE_ROW stepQueued[MAZE_SIZE];		// 差分更新用キューに積まれている区画(行ごとのビット)
+
+MAZE_ROW searchedMask[MAZE_SIZE];	// 探索済み(壁を読んだ)区画(行ごとのビット)
+_UWORD mapDirty;			// 保存していないマップのキー(ビット)
+_UBYTE searchedDirty;		// 保存していない探索済み区画のキー(ビット)
 
 _UBYTE stopFlag;			// 走行中断用フラグ
+bool centerStop;			// 区画中央で停止している(スラロームか超信地旋回かの判断用)
 int count;				// 何回曲がったかをカウント
 
 /*----------------------------------------------------------------------
 	Private Method Declarations
  ----------------------------------------------------------------------*/
+static bool Search_GetNeighbor(_UBYTE x, _UBYTE y, _UBYTE dir, _UBYTE *nx, _UBYTE *ny);
+static bool Search_HasParent(_UBYTE x, _UBYTE y);
+static void Search_PushStepQueue(_UBYTE x, _UBYTE y, _UWORD *tail);
+static void Search_FloodStepMap(_UBYTE shift);
+static void Search_WalkRoute(_UBYTE shift);
 
 
 /*----------------------------------------------------------------------
@@ -49,8 +115,15 @@ int count;				// 何回曲がったかをカウント
 -----------------------------------------------------------*/
 void Search_Init()
 {
+	_UBYTE goal[4];
+
 	// ---- 探索系 ----
 	Search_MapInit();				//マップの初期化
+	//====ゴール領域の初期化(保存してあればそれを使う)====
+	if( !ParamStore_Get(PARAM_KEY_GOAL, goal, sizeof(goal))
+			|| !Search_SetGoalRegion(goal[0], goal[1], goal[2], goal[3]) ){
+		Search_SetGoalRegion(GOAL_X, GOAL_Y, GOAL_W, GOAL_H);
+	}
 	PRELOC.PLANE = 0x00;	//現在地の初期化
 	Search_SetDir(DIR_TURN_0);		//マウス方向の初期化
 	stopFlag = 0;			//走行中断用フラグの初期化
@@ -64,10 +137,12 @@ void Search_Adachi()
 	// ==== 歩数等初期化 ====
 	count = 0;				// 曲がりカウンタの初期化
 	mStep = routeCnt = 0;	// 歩数の初期化
+	centerStop = true;		// 区画中央で停止した状態から始める
 	Search_GetWallInfo();			// 壁情報の初期化
 	Search_WriteMap();				// 地図の初期化
 	Search_MakeStepMap();			// 歩数図の初期化
 	Search_MakeRoute();			// 最短経路探索
+	Search_SaveCheckpoint();		// 探索の途中保存
 
 	// ==== 探索走行 ====
 	do{
@@ -75,6 +150,7 @@ void Search_Adachi()
 		if( GetSwitchState() ){
 			stopFlag = 1;
 			HalfSectionD();
+			centerStop = true;
 			break;
 		}
 
@@ -83,10 +159,17 @@ void Search_Adachi()
 			// ---- 前進 ----
 			case 0x88:
 				HalfSectionA();		//半区画加速前進
+				centerStop = false;
 				break;
 
 			// ---- 右折 ----
 			case 0x44:
+				// スラローム探索で走行中なら区画の入口から止まらずに旋回
+				if( _MF.STATE.BIT.SLAL && !centerStop ){
+					SlalomR90();
+					Search_TurnDir(DIR_TURN_R90);
+					break;
+				}
 				TurnR90AD();
 				// 規定数回以上曲がっていて かつ 曲がった後に後ろ壁がある時
 				if((count >= ADJUST_NUM) && (wallInfo & 0x11)){
@@ -98,6 +181,7 @@ void Search_Adachi()
 				// 位置補正しない時
 				else count++;						// 曲がりカウンタのインクリメント
 				HalfSectionA();					// 半区画加速前進
+				centerStop = false;
 
 				Search_TurnDir(DIR_TURN_R90);
 				break;
@@ -110,11 +194,18 @@ void Search_Adachi()
 					count = 0;					// 曲がりカウンタのリセット
 				}
 				HalfSectionA();
+				centerStop = false;
 				Search_TurnDir(DIR_TURN_180);
 				break;
 
 			// ---- 左折 ----
 			case 0x11:
+				// スラローム探索で走行中なら区画の入口から止まらずに旋回
+				if( _MF.STATE.BIT.SLAL && !centerStop ){
+					SlalomL90();
+					Search_TurnDir(DIR_TURN_L90);
+					break;
+				}
 				TurnL90AD();
 				// 規定数回以上曲がっていて かつ 曲がった後に後ろ壁がある時
 				if( (count >= ADJUST_NUM) && (wallInfo & 0x44)){
@@ -127,6 +218,7 @@ void Search_Adachi()
 				else count++;							// 曲がりカウンタのインクリメント
 
 				HalfSectionA();					// 半区画前進
+				centerStop = false;
 
 				Search_TurnDir(DIR_TURN_L90);
 				break;
@@ -150,17 +242,26 @@ void Search_Adachi()
 		// 進行ルートが前なら加速し走行続行
 		if( route[routeCnt] & 0x88 ){
 			HalfSectionA();
+			centerStop = false;
 		}
 		// 進行ルートが右or左のとき
 		else if( (route[routeCnt] & 0x44) || (route[routeCnt] & 0x11) ){
-			HalfSectionD();			//減速し停止
+			// スラローム探索なら区画の入口のまま次の旋回へ
+			if( !_MF.STATE.BIT.SLAL ){
+				HalfSectionD();			//減速し停止
+				centerStop = true;
+			}
 		}
     	// 進行ルートが後ろなら減速し停止
 		else{
 			HalfSectionD();
+			centerStop = true;
 		}
 
-	}while( (PRELOC.AXIS.X != GOAL_X) || (PRELOC.AXIS.Y != GOAL_Y) );
+		// ---- 次の動作を出してから途中保存(書き込みは周期タスクが進める) ----
+		Search_SaveCheckpoint();
+
+	}while( !Search_IsGoal(PRELOC.AXIS.X, PRELOC.AXIS.Y) );
 
 	// ==== ゴール後の処理 ====
   	if(stopFlag != 1) {
@@ -197,28 +298,29 @@ void Search_AdvancePosition()
 void Search_GetWallInfo()
 {
 	_UBYTE ledPattern;
+	SensorFrame frame;
 
 	// ---- 壁情報の初期化 ----
 	wallInfo = 0x00;
 	ledPattern = 0x00;
 
-	LSVal *lsv = LightSensor_GetValue();
+	MouseController_GetSensorFrame(&frame);
 
 
 	// ---- 前壁を見る ----
-	if( lsv->Now.FwdL > WALL_BASE_FWD_L ){
+	if( WALL_FWD(frame) ){
 		wallInfo |= 0x88;
 		ledPattern |= 0x06;
 	}
 
 	// ---- 右壁を見る ----
-	if( lsv->Now.Right > WALL_BASE_RIGHT ){
+	if( WALL_RIGHT(frame) ){
 		wallInfo |= 0x44;
 		ledPattern |= 0x01;
 	}
 
 	// ---- 左壁を見る ----
-	if( lsv->Now.Left > WALL_BASE_LEFT ){
+	if( WALL_LEFT(frame) ){
 		wallInfo |= 0x11;
 		ledPattern |= 0x08;
 	}
@@ -230,12 +332,16 @@ void Search_GetWallInfo()
 -----------------------------------------------------------*/
 void Search_ConfirmRoute()
 {
+	_UBYTE wallOld = map[PRELOC.AXIS.Y][PRELOC.AXIS.X] & 0x0f;	// 書き込み前の壁情報
+
 	// ---- 壁情報書き込み ----
 	Search_WriteMap();
 
+	// ---- 変化した壁の影響を受ける区画だけ歩数を更新 ----
+	Search_UpdateStepMap(wallOld ^ (map[PRELOC.AXIS.Y][PRELOC.AXIS.X] & 0x0f));
+
 	// ---- 最短経路上に壁があれば進路変更 ----
 	if(wallInfo & route[routeCnt]){
-		Search_MakeStepMap();			// 歩数マップ作成
 		Search_MakeRoute();			// 最短経路作成
 		routeCnt = 0;
 	}
@@ -249,19 +355,27 @@ void Search_MapInit()
 	_UBYTE x, y;
 
 	// ==== 初期化開始 ====
-	for( y = 0; y <= 0x0f; y++ ){
-		for(x = 0; x <= 0x0f; x++){
+	for( y = 0; y < MAZE_SIZE; y++ ){
+		for(x = 0; x < MAZE_SIZE; x++){
 			map[y][x] = 0xf0;		// 上位を壁、下位を壁なしとする。
 		}
 	}
-	for( y = 0; y <= 0x0f; y++ ){
+	for( y = 0; y < MAZE_SIZE; y++ ){
 		map[y][0] |= 0xf1;
-		map[y][15] |= 0xf4;
+		map[y][MAZE_SIZE - 1] |= 0xf4;
 	}
-	for( x = 0; x <= 0x0f; x++ ){
+	for( x = 0; x < MAZE_SIZE; x++ ){
 		map[0][x] |= 0xf2;
-		map[15][x] |= 0xf8;
+		map[MAZE_SIZE - 1][x] |= 0xf8;
+	}
+	//====探索済み区画の初期化====
+	for( y = 0; y < MAZE_SIZE; y++ ){
+		searchedMask[y] = 0;
 	}
+
+	//====次の途中保存で全て書き直す====
+	mapDirty = (_UWORD)((1UL << CHECKPOINT_MAP_NUM) - 1);
+	searchedDirty = (_UBYTE)((1U << CHECKPOINT_SEARCHED_NUM) - 1);
 }
 /*-----------------------------------------------------------
 		マップデータ書き込み
@@ -278,7 +392,7 @@ void Search_WriteMap()
 	// ==== データの書き込み ====
 	map[PRELOC.AXIS.Y][PRELOC.AXIS.X] = mTemp; // 現在地に書き込み
 	// ---- 周辺に書き込む ----
-	if(PRELOC.AXIS.Y != 15){				// 北側について(現在最北端でないとき)
+	if(PRELOC.AXIS.Y != MAZE_SIZE - 1){				// 北側について(現在最北端でないとき)
 		if(mTemp & 0x88){		//北壁がある場合
 			//北側の区画から見て南壁書き込み
 			map[PRELOC.AXIS.Y + 1][PRELOC.AXIS.X] |= 0x22;
@@ -287,7 +401,7 @@ void Search_WriteMap()
 			map[PRELOC.AXIS.Y + 1][PRELOC.AXIS.X] &= 0xDD;
 		}
 	}
-	if(PRELOC.AXIS.X != 15){	//東側について(現在最東端でないとき)
+	if(PRELOC.AXIS.X != MAZE_SIZE - 1){	//東側について(現在最東端でないとき)
 		if(mTemp & 0x44){		//東壁があるとき
 			//東側の区画から見て西壁存在を書き込む
 			map[PRELOC.AXIS.Y][PRELOC.AXIS.X + 1] |= 0x11;
@@ -314,6 +428,218 @@ void Search_WriteMap()
 			map[PRELOC.AXIS.Y][PRELOC.AXIS.X - 1] &= 0xBB;
 		}
 	}
+
+	// ==== 探索済みとし,書き換えた行を途中保存の対象にする ====
+	if( !(searchedMask[PRELOC.AXIS.Y] & ((MAZE_ROW)1 << PRELOC.AXIS.X)) ){
+		searchedMask[PRELOC.AXIS.Y] |= (MAZE_ROW)1 << PRELOC.AXIS.X;
+		searchedDirty |= CHECKPOINT_SEARCHED_BIT(PRELOC.AXIS.Y);
+	}
+	mapDirty |= CHECKPOINT_MAP_BIT(PRELOC.AXIS.Y);
+	if(PRELOC.AXIS.Y != MAZE_SIZE - 1)	mapDirty |= CHECKPOINT_MAP_BIT(PRELOC.AXIS.Y + 1);
+	if(PRELOC.AXIS.Y != 0)	mapDirty |= CHECKPOINT_MAP_BIT(PRELOC.AXIS.Y - 1);
+}
+
+/*-----------------------------------------------------------
+		探索の途中保存
+		前回から書き換えたマップ,探索済み区画と現在地を書き込み待ちに積む
+		(積めなかった分は次の呼び出しで積み直す)
+-----------------------------------------------------------*/
+void Search_SaveCheckpoint()
+{
+	_UBYTE i, rows;
+	SearchCheckpoint cp;
+
+	//====マップ====
+	for( i = 0; i < CHECKPOINT_MAP_NUM; i++ ){
+		if( (mapDirty & ((_UWORD)1 << i))
+				&& ParamStore_Set((PARAM_KEY)(PARAM_KEY_MAP + i), map[i * CHECKPOINT_MAP_ROWS], CHECKPOINT_MAP_ROWS * MAZE_SIZE) ){
+			mapDirty &= ~((_UWORD)1 << i);
+		}
+	}
+
+	//====探索済み区画(MAZE_SIZE×MAZE_SIZEビット)====
+	for( i = 0; i < CHECKPOINT_SEARCHED_NUM; i++ ){
+		rows = MAZE_SIZE - i * CHECKPOINT_SEARCHED_ROWS;
+		if( rows > CHECKPOINT_SEARCHED_ROWS ){
+			rows = CHECKPOINT_SEARCHED_ROWS;
+		}
+		if( (searchedDirty & ((_UBYTE)1 << i))
+				&& ParamStore_Set((PARAM_KEY)(PARAM_KEY_SEARCHED + i), &searchedMask[i * CHECKPOINT_SEARCHED_ROWS], rows * sizeof(MAZE_ROW)) ){
+			searchedDirty &= ~((_UBYTE)1 << i);
+		}
+	}
+
+	//====再開位置====
+	// マップ,探索済み区画を全て積めたときだけ,その後ろに積む(書き込みは積んだ順なので,
+	// 再開位置がそれより古いマップと組になることはない.積めなければ次の呼び出しで書く)
+	if( (mapDirty != 0) || (searchedDirty != 0) ){
+		return;
+	}
+
+	cp.X = (_UBYTE)PRELOC.AXIS.X;
+	cp.Y = (_UBYTE)PRELOC.AXIS.Y;
+	cp.Dir = mDir;
+	cp.Reserved = 0;
+	cp.BaseLeft = LightSensor_GetValue()->Base.Left;
+	cp.BaseRight = LightSensor_GetValue()->Base.Right;
+	ParamStore_Set(PARAM_KEY_SEARCH_STATE, &cp, sizeof(cp));
+}
+
+/*-----------------------------------------------------------
+		途中保存した探索の読み込み
+		マップ,探索済み区画,現在地,方向,横センサの基準値を戻す(全て揃わなければfalse)
+-----------------------------------------------------------*/
+bool Search_LoadCheckpoint()
+{
+	_UBYTE i, rows;
+	SearchCheckpoint cp;
+
+	if( !ParamStore_Get(PARAM_KEY_SEARCH_STATE, &cp, sizeof(cp))
+			|| (cp.X >= MAZE_SIZE) || (cp.Y >= MAZE_SIZE) ){
+		return false;
+	}
+	for( i = 0; i < CHECKPOINT_MAP_NUM; i++ ){
+		if( !ParamStore_Get((PARAM_KEY)(PARAM_KEY_MAP + i), map[i * CHECKPOINT_MAP_ROWS], CHECKPOINT_MAP_ROWS * MAZE_SIZE) ){
+			Search_MapInit();		// 読みかけのマップは使わない
+			return false;
+		}
+	}
+	for( i = 0; i < CHECKPOINT_SEARCHED_NUM; i++ ){
+		rows = MAZE_SIZE - i * CHECKPOINT_SEARCHED_ROWS;
+		if( rows > CHECKPOINT_SEARCHED_ROWS ){
+			rows = CHECKPOINT_SEARCHED_ROWS;
+		}
+		if( !ParamStore_Get((PARAM_KEY)(PARAM_KEY_SEARCHED + i), &searchedMask[i * CHECKPOINT_SEARCHED_ROWS], rows * sizeof(MAZE_ROW)) ){
+			Search_MapInit();
+			return false;
+		}
+	}
+	mapDirty = 0;
+	searchedDirty = 0;
+
+	PRELOC.AXIS.X = cp.X;
+	PRELOC.AXIS.Y = cp.Y;
+	Search_SetDir(cp.Dir);
+	LightSensor_GetValue()->Base.Left = cp.BaseLeft;
+	LightSensor_GetValue()->Base.Right = cp.BaseRight;
+	return true;
+}
+
+/*-----------------------------------------------------------
+		途中保存した所から探索を再開
+		保存した区画の中央に,保存した方向へ向けて置いてから始める
+-----------------------------------------------------------*/
+void Search_Resume()
+{
+	_UBYTE x, y;
+	_UWORD num = 0;
+
+	if( !Search_LoadCheckpoint() ){
+		Printf("No checkpoint\n");
+		return;
+	}
+	for( y = 0; y < MAZE_SIZE; y++ ){
+		for( x = 0; x < MAZE_SIZE; x++ ){
+			if( searchedMask[y] & ((MAZE_ROW)1 << x) ) num++;
+		}
+	}
+	Printf("Resume:(%d, %d) Dir:%d Searched:%d\n", PRELOC.AXIS.X, PRELOC.AXIS.Y, mDir, num);
+	if( Search_IsGoal(PRELOC.AXIS.X, PRELOC.AXIS.Y) ){
+		Printf("Already at goal\n");
+		return;
+	}
+
+	PlaySound(500);
+	PlaySound(500);
+	PlaySound(500);
+	WaitMS(1000);
+	Search_Adachi();
+}
+
+/*-----------------------------------------------------------
+		ゴール区画を全て消去
+-----------------------------------------------------------*/
+void Search_ClearGoal()
+{
+	_UBYTE y;
+
+	for( y = 0; y < MAZE_SIZE; y++ ){
+		goalMask[y] = 0;
+	}
+}
+
+/*-----------------------------------------------------------
+		ゴール区画を追加(迷路外ならfalse)
+-----------------------------------------------------------*/
+bool Search_AddGoal(_UBYTE x, _UBYTE y)
+{
+	if( (x >= MAZE_SIZE) || (y >= MAZE_SIZE) ){
+		return false;
+	}
+	goalMask[y] |= (MAZE_ROW)1 << x;
+	return true;
+}
+
+/*-----------------------------------------------------------
+		ゴール領域を設定
+		(x, y)を南西端とするw x hの区画をゴールとする(迷路外にはみ出すならfalse)
+-----------------------------------------------------------*/
+bool Search_SetGoalRegion(_UBYTE x, _UBYTE y, _UBYTE w, _UBYTE h)
+{
+	_UBYTE i, j;
+
+	if( (w == 0) || (h == 0) || (x + w > MAZE_SIZE) || (y + h > MAZE_SIZE) ){
+		return false;
+	}
+	Search_ClearGoal();
+	for( j = y; j < y + h; j++ ){
+		for( i = x; i < x + w; i++ ){
+			Search_AddGoal(i, j);
+		}
+	}
+	return true;
+}
+
+/*-----------------------------------------------------------
+		ゴール区画か判定
+-----------------------------------------------------------*/
+bool Search_IsGoal(_UBYTE x, _UBYTE y)
+{
+	return (goalMask[y] & ((MAZE_ROW)1 << x)) != 0;
+}
+
+/*-----------------------------------------------------------
+		ゴール領域をシリアルから入力
+-----------------------------------------------------------*/
+void Search_InputGoal()
+{
+	int x, y, w, h;
+	_UBYTE goal[4];
+
+	Printf("Goal X:");
+	Scanf("%d", &x);
+	Printf("Goal Y:");
+	Scanf("%d", &y);
+	Printf("Goal W:");
+	Scanf("%d", &w);
+	Printf("Goal H:");
+	Scanf("%d", &h);
+
+	if( (x < 0) || (y < 0) || (w < 0) || (h < 0)
+			|| !Search_SetGoalRegion((_UBYTE)x, (_UBYTE)y, (_UBYTE)w, (_UBYTE)h) ){
+		Printf("Invalid goal\n");
+		return;
+	}
+	Printf("Goal:(%d, %d) %dx%d\n", x, y, w, h);
+
+	//====次の起動でも使うよう保存====
+	goal[0] = (_UBYTE)x;
+	goal[1] = (_UBYTE)y;
+	goal[2] = (_UBYTE)w;
+	goal[3] = (_UBYTE)h;
+	if( !ParamStore_Set(PARAM_KEY_GOAL, goal, sizeof(goal)) ){
+		Printf("Save failed\n");
+	}
 }
 
 /*-----------------------------------------------------------
@@ -338,85 +664,270 @@ void Search_SetDir(_UBYTE t_pat)
 		歩数マップ作成
 -----------------------------------------------------------*/
 void Search_MakeStepMap()
+{
+	Search_FloodStepMap(MAZE_MASK_SEARCH);
+}
+
+/*-----------------------------------------------------------
+		歩数マップ差分更新
+		changed: 現在地で変化した壁(下位4bit,NESW順)
+-----------------------------------------------------------*/
+void Search_UpdateStepMap(_UBYTE changed)
 {
 	//====変数宣言====
 	_UBYTE x, y;		//マップ用カウンタ
-	_UBYTE mTemp;	//マップデータ一時保持
+	_UBYTE nx, ny;		//隣接区画の座標
+	_UBYTE cx, cy;		//無効化を調べる区画の座標
+	_UBYTE ax, ay;		//無効化を調べる区画の隣接区画の座標
+	_UBYTE d, cd;		//方向
+	_UBYTE side;		//壁のどちら側の区画を調べるか
+	_UWORD head, tail;	//キューの読み出し,書き込み位置(STEP_QUEUE_MASKで折り返す)
+	_UWORD levelEnd;	//現在処理している歩数の区画の終端
+	MAZE_STEP level;	//現在処理している区画の更新前の歩数
+	_UWORD start;		//無効化した区画の先頭
 
-	//====歩数マップのクリア====
-	for(y = 0; y <= 0x0f; y++){
-		for( x = 0; x <= 0x0f; x++){
-			smap[y][x] = 0xff;		//歩数最大とする
+	x = (_UBYTE)PRELOC.AXIS.X;
+	y = (_UBYTE)PRELOC.AXIS.Y;
+	head = tail = 0;
+
+	for( d = 0; d < 4; d++ ){
+		//----変化のない方向,外周の方向,壁がなくなった方向は飛ばす----
+		if( !(changed & (0x08 >> d)) || !(map[y][x] & (0x08 >> d)) || !Search_GetNeighbor(x, y, d, &nx, &ny) ){
+			continue;
 		}
-	}
 
-	//====ゴール座標を0にする====
-	smap[GOAL_Y][GOAL_X] = 0;
+		//----壁が増えたとき:壁の両側の区画について,歩数の1小さい隣接区画(親)を失っていれば影響を受ける----
+		//  同じ区画に複数の壁が増えた場合も扱えるよう,歩数の大小によらず両側を調べる
+		for( side = 0; side < 2; side++ ){
+			cx = (side == 0)? x : nx;
+			cy = (side == 0)? y : ny;
+			if( (smap[cy][cx] == STEP_MAX) || Search_HasParent(cx, cy) ){
+				continue;
+			}
 
-	//====歩数カウンタを0にする====
-	mStep = 0;
+			//----影響を受ける区画を,更新前の歩数の小さい順にたどって無効化する----
+			//  無効化はキューに積む時点で行うので,同じ歩数の区画は子を調べる前にすべて無効化されている
+			start = head = tail;
+			level = smap[cy][cx];
+			smap[cy][cx] = STEP_MAX;
+			stepQueue[tail++ & STEP_QUEUE_MASK] = STEP_QUEUE_CELL(cx, cy);
+			levelEnd = tail;
+			while( head != tail ){
+				if( head == levelEnd ){
+					level++;
+					levelEnd = tail;
+				}
+				cx = STEP_QUEUE_X(stepQueue[head & STEP_QUEUE_MASK]);
+				cy = STEP_QUEUE_Y(stepQueue[head & STEP_QUEUE_MASK]);
+				head++;
 
-	//====自分の座標にたどり着くまでループ====
-	do{
-		//----マップ全域を捜索----
-		for( y = 0; y <= 0x0f; y++){
-			for( x = 0; x <= 0x0f; x++){
-				//----現在最大の歩数を発見したとき----
-				if( smap[y][x] == mStep){
-					mTemp = map[y][x];
-//					if( _MF.STATE.BIT.SCND ){	//二次走行用マップを作るときは1にする
-//						mTemp >>= 4;			//4bitシフトさせる
-//					}
-					//----北壁がなく現在最北端でないとき----
-					if(!(mTemp & 0x08) && y != 0x0f){
-						if(smap[y+1][x] == 0xff){		//北側がクリア状態なら
-							smap[y+1][x] = mStep + 1;	//次の歩数を書き込む
-						}
+				for( cd = 0; cd < 4; cd++ ){
+					if( (map[cy][cx] & (0x08 >> cd)) || !Search_GetNeighbor(cx, cy, cd, &ax, &ay) ){
+						continue;
 					}
-					//----東壁についての処理----
-					if(!(mTemp & 0x04) && x != 0x0f){
-						if(smap[y][x+1] == 0xff){
-							smap[y][x+1] = mStep + 1;
-						}
-					}
-					//----南壁についての処理----
-					if(!(mTemp & 0x02) && y != 0){
-						if(smap[y-1][x] == 0xff){
-							smap[y-1][x] = mStep + 1;
-						}
-					}
-					//----西壁についての処理----
-					if(!(mTemp & 0x01) && x != 0){
-						if(smap[y][x-1] == 0xff){
-							smap[y][x-1] = mStep + 1;
-						}
+					// 無効化した区画の子で,ほかに親を持たない区画を無効化
+					if( (smap[ay][ax] == level + 1) && !Search_HasParent(ax, ay) ){
+						smap[ay][ax] = STEP_MAX;
+						stepQueue[tail++ & STEP_QUEUE_MASK] = STEP_QUEUE_CELL(ax, ay);
 					}
 				}
 			}
+			// 無効化した区画は次の伝播で周囲から歩数を求め直す
+			for( ; start != tail; start++ ){
+				stepQueued[STEP_QUEUE_Y(stepQueue[start & STEP_QUEUE_MASK])] |= (MAZE_ROW)1 << STEP_QUEUE_X(stepQueue[start & STEP_QUEUE_MASK]);
+			}
+		}
+	}
+
+	//====壁がなくなったとき:歩数が減る区画を後で伝播させる====
+	//  無効化の後に積むので,無効化した区画と重ならずキューに同じ区画が2度入らない
+	for( d = 0; d < 4; d++ ){
+		if( !(changed & (0x08 >> d)) || (map[y][x] & (0x08 >> d)) || !Search_GetNeighbor(x, y, d, &nx, &ny) ){
+			continue;
+		}
+		Search_PushStepQueue(x, y, &tail);
+		Search_PushStepQueue(nx, ny, &tail);
+	}
+
+	//====キューが空になるまで,隣接区画から歩数を求め直して伝播させる====
+	head = 0;
+	while( head != tail ){
+		x = STEP_QUEUE_X(stepQueue[head & STEP_QUEUE_MASK]);
+		y = STEP_QUEUE_Y(stepQueue[head & STEP_QUEUE_MASK]);
+		head++;
+		stepQueued[y] &= ~((MAZE_ROW)1 << x);
+
+		for( d = 0; d < 4; d++ ){
+			if( (map[y][x] & (0x08 >> d)) || !Search_GetNeighbor(x, y, d, &nx, &ny) ){
+				continue;
+			}
+			//----隣接区画から自分の歩数を求め直す----
+			if( (smap[ny][nx] != STEP_MAX) && (smap[ny][nx] + 1 < smap[y][x]) ){
+				smap[y][x] = smap[ny][nx] + 1;
+			}
+		}
+		if( smap[y][x] == STEP_MAX ){
+			continue;		// まだ歩数の決まっていない区画
 		}
-		//====歩数カウンタのインクリメント====
-		mStep++;
-	}while(smap[PRELOC.AXIS.Y][PRELOC.AXIS.X] == 0xff);
+		for( d = 0; d < 4; d++ ){
+			if( (map[y][x] & (0x08 >> d)) || !Search_GetNeighbor(x, y, d, &nx, &ny) ){
+				continue;
+			}
+			//----隣接区画の歩数が減るなら書き換えて積む----
+			if( smap[y][x] + 1 < smap[ny][nx] ){
+				smap[ny][nx] = smap[y][x] + 1;
+				Search_PushStepQueue(nx, ny, &tail);
+			}
+		}
+	}
 }
 
 /*-----------------------------------------------------------
 		最短経路導出
 -----------------------------------------------------------*/
 void Search_MakeRoute()
+{
+	Search_WalkRoute(MAZE_MASK_SEARCH);
+}
+
+/*-----------------------------------------------------------
+		走行時間最小の経路導出(二次走行用)
+-----------------------------------------------------------*/
+void Search_MakeTimeRoute()
+{
+	float stepTime, runTime;
+
+	// ==== 歩数最小の経路の予測時間 ====
+	//  走行時間最小の経路と比べられるよう,同じ二次走行用の壁情報(未探索の壁はあり)で求める
+	Search_FloodStepMap(MAZE_MASK_SECOND);
+	Search_WalkRoute(MAZE_MASK_SECOND);
+	stepTime = (route[0] == 0x00) ? RUN_PLANNER_NO_ROUTE : RunPlanner_EstimateTime(route);
+
+	//====探索用の歩数マップに戻す====
+	Search_MakeStepMap();
+
+	// ==== 走行時間最小の経路で置き換え ====
+	runTime = RunPlanner_MakeRoute(map, (_UBYTE)PRELOC.AXIS.X, (_UBYTE)PRELOC.AXIS.Y, mDir, route);
+	if(runTime < 0){
+		Printf("No route\n");
+		return;
+	}
+	Printf("Step route:%f[s], Time route:%f[s]\n", stepTime, runTime);
+}
+
+/*-----------------------------------------------------------
+		最短走行(スタート区画から)
+-----------------------------------------------------------*/
+void Search_FastRun()
+{
+	// ==== スタート区画から経路を作成し,動作列に変換(動作列はrouteに上書きする) ====
+	PRELOC.AXIS.X = START_X;
+	PRELOC.AXIS.Y = START_Y;
+	Search_SetDir(DIR_TURN_0);
+	if(RunPlanner_MakeRoute(map, START_X, START_Y, mDir, route) < 0){
+		Printf("No route\n");
+		return;
+	}
+	if(!MotionPlan_Compile(route)){
+		Printf("Bad route\n");
+		return;
+	}
+
+	// ==== 走行 ====
+	PlaySound(500);
+	PlaySound(500);
+	PlaySound(500);
+	WaitMS(1000);
+	LightSensor_GetBaseLR();
+	MotionPlan_Run();
+	WaitMS(1500);
+}
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+/*-----------------------------------------------------------
+		歩数マップ作成(キューによる幅優先探索)
+		shift: 使う壁情報(MAZE_MASK_SEARCH, MAZE_MASK_SECOND)
+-----------------------------------------------------------*/
+static void Search_FloodStepMap(_UBYTE shift)
+{
+	//====変数宣言====
+	_UBYTE x, y;		//マップ用カウンタ
+	_UWORD head, tail;	//キューの読み出し,書き込み位置
+	_UBYTE mTemp;		//比較用マップ情報
+	MAZE_STEP next;		//隣接区画に書き込む歩数
+
+	//====全ゴール区画を0にしてキューに積み,それ以外をクリア====
+	head = tail = 0;
+	for( y = 0; y < MAZE_SIZE; y++ ){
+		for( x = 0; x < MAZE_SIZE; x++ ){
+			if( goalMask[y] & ((MAZE_ROW)1 << x) ){
+				smap[y][x] = 0;
+				stepQueue[tail++] = STEP_QUEUE_CELL(x, y);
+			}else{
+				smap[y][x] = STEP_MAX;
+			}
+		}
+	}
+
+	//====キューが空になるまで,歩数の小さい区画から順に展開====
+	//  壁発見時の差分更新(Search_UpdateStepMap)のため,到達できる全区画の歩数を求める
+	//  各区画はキューに1度しか積まれないので,全区画分のキューで足りる
+	while( head != tail ){
+		x = STEP_QUEUE_X(stepQueue[head]);
+		y = STEP_QUEUE_Y(stepQueue[head]);
+		head++;
+
+		next = smap[y][x] + 1;
+		mTemp = map[y][x] >> shift;	//下位4bitに揃える
+		//----北壁がなく現在最北端でないとき----
+		if(!(mTemp & 0x08) && (y != MAZE_SIZE - 1) && (smap[y+1][x] == STEP_MAX)){
+			smap[y+1][x] = next;	//次の歩数を書き込む
+			stepQueue[tail++] = STEP_QUEUE_CELL(x, y+1);
+		}
+		//----東壁についての処理----
+		if(!(mTemp & 0x04) && (x != MAZE_SIZE - 1) && (smap[y][x+1] == STEP_MAX)){
+			smap[y][x+1] = next;
+			stepQueue[tail++] = STEP_QUEUE_CELL(x+1, y);
+		}
+		//----南壁についての処理----
+		if(!(mTemp & 0x02) && (y != 0) && (smap[y-1][x] == STEP_MAX)){
+			smap[y-1][x] = next;
+			stepQueue[tail++] = STEP_QUEUE_CELL(x, y-1);
+		}
+		//----西壁についての処理----
+		if(!(mTemp & 0x01) && (x != 0) && (smap[y][x-1] == STEP_MAX)){
+			smap[y][x-1] = next;
+			stepQueue[tail++] = STEP_QUEUE_CELL(x-1, y);
+		}
+	}
+}
+
+/*-----------------------------------------------------------
+		歩数マップを下りて現在地から経路を導出
+		shift: 使う壁情報(MAZE_MASK_SEARCH, MAZE_MASK_SECOND. 歩数マップも同じ壁情報で作ること)
+-----------------------------------------------------------*/
+static void Search_WalkRoute(_UBYTE shift)
 {
 	// ==== 変数宣言 ====
-	_UBYTE i = 0;				// カウンタ
+	_UWORD i;					// カウンタ
 	_UBYTE x, y;
 	_UBYTE dirTemp =  mDir;		// 方向変数
 	_UBYTE mTemp;
 
 	// ==== 最短経路を初期化 ====
-	do{
-		route[i++] = 0xff;
-	}while(i != 0);
+	for( i = 0; i < MAZE_CELL_NUM; i++ ){
+		route[i] = 0xff;
+	}
+	i = 0;
 
 	// ==== 歩数カウンタをセット ====
 	mStep = smap[PRELOC.AXIS.Y][PRELOC.AXIS.X];
+	if( mStep == STEP_MAX ){		// 現在地からゴールに至れない
+		route[0] = 0x00;			// 進行方向なし(探索走行側で停止)
+		return;
+	}
 
 	// ==== x, yに現在座標を書き込み ====
 	x = (_UBYTE)PRELOC.AXIS.X;
@@ -424,10 +935,7 @@ void Search_MakeRoute()
 
 	// ==== 最短経路を導出 ====
 	do{
-		mTemp = map[y][x];			//比較用マップ情報の格納
-//		if( MF.STATE.BIT.SCND ){	//二次走行時はここをTrueにする
-//			mTemp >>= 4;
-//		}
+		mTemp = map[y][x] >> shift;	//比較用マップ情報の格納(下位4bitに揃える)
 		// ---- 北を見る ----
 		if(!(mTemp & 0x08) && (smap[y+1][x] < mStep)){
 			route[i] = (0x00 - mDir) & 0x03;
@@ -474,13 +982,77 @@ void Search_MakeRoute()
 				route[i] = 0x00;
 				break;
 		}
-		i++;
-	}while( smap[y][x] != 0);
+		// 歩数の下る隣接区画がなければ経路はここで終わり
+		if( route[i++] == 0x00 ){
+			break;
+		}
+	}while( (smap[y][x] != 0) && (i < MAZE_CELL_NUM) );
 
+	// ==== ゴールに届かなければ経路なしとする ====
+	if( smap[y][x] != 0 ){
+		route[0] = 0x00;
+	}
 	mDir = dirTemp;
 }
 
-/*----------------------------------------------------------------------
-	Private Method Definitions
- ----------------------------------------------------------------------*/
+/*-----------------------------------------------------------
+		隣接区画の座標取得(外周の外側ならfalse)
+-----------------------------------------------------------*/
+static bool Search_GetNeighbor(_UBYTE x, _UBYTE y, _UBYTE dir, _UBYTE *nx, _UBYTE *ny)
+{
+	*nx = x;
+	*ny = y;
+	switch(dir){
+		case 0x00:
+			if(y == MAZE_SIZE - 1) return false;
+			(*ny)++;
+			break;
+		case 0x01:
+			if(x == MAZE_SIZE - 1) return false;
+			(*nx)++;
+			break;
+		case 0x02:
+			if(y == 0) return false;
+			(*ny)--;
+			break;
+		default:
+			if(x == 0) return false;
+			(*nx)--;
+			break;
+	}
+	return true;
+}
 
+/*-----------------------------------------------------------
+		歩数が1小さい隣接区画(親)があるか判定
+-----------------------------------------------------------*/
+static bool Search_HasParent(_UBYTE x, _UBYTE y)
+{
+	_UBYTE nx, ny;
+	_UBYTE d;
+
+	//----ゴールは親を持たない----
+	if( smap[y][x] == 0 ){
+		return true;
+	}
+	for( d = 0; d < 4; d++ ){
+		if( (map[y][x] & (0x08 >> d)) || !Search_GetNeighbor(x, y, d, &nx, &ny) ){
+			continue;
+		}
+		if( smap[ny][nx] + 1 == smap[y][x] ){
+			return true;
+		}
+	}
+	return false;
+}
+
+/*-----------------------------------------------------------
+		差分更新用キューに区画を積む(積まれていれば何もしない)
+-----------------------------------------------------------*/
+static void Search_PushStepQueue(_UBYTE x, _UBYTE y, _UWORD *tail)
+{
+	if( !(stepQueued[y] & ((MAZE_ROW)1 << x)) ){
+		stepQueued[y] |= (MAZE_ROW)1 << x;
+		stepQueue[(*tail)++ & STEP_QUEUE_MASK] = STEP_QUEUE_CELL(x, y);
+	}
+}
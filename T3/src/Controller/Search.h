@@ -9,6 +9,8 @@
 	Includes
  ----------------------------------------------------------------------*/
 #include "../typedefine.h"
+#include "MazeDefine.h"
+#include <stdbool.h>
 
 /*----------------------------------------------------------------------
 	Macro Definitions
@@ -22,8 +24,11 @@
 // ==== スタート座標 ====
 #define START_X	0
 #define START_Y	0
+// ==== ゴール区画(GOAL_X, GOAL_Yを南西端とするGOAL_W x GOAL_Hの領域) ====
 #define GOAL_X	11
 #define GOAL_Y 	3
+#define GOAL_W	1
+#define GOAL_H	1
 
 #define ADJUST_NUM 0
 
@@ -52,6 +57,15 @@ void Search_MapInit();
 // ==== マップデータ書き込み ====
 void Search_WriteMap();
 
+// ==== 探索の途中保存 ====
+void Search_SaveCheckpoint();
+
+// ==== 途中保存した探索の読み込み ====
+bool Search_LoadCheckpoint();
+
+// ==== 途中保存した所から探索を再開 ====
+void Search_Resume();
+
 // ==== マウスの方向を変更 ====
 void Search_TurnDir(_UBYTE);
 
@@ -61,14 +75,35 @@ void Search_SetDir(_UBYTE);
 // ==== 歩数マップ作成 ====
 void Search_MakeStepMap();
 
+// ==== 歩数マップ差分更新 ====
+void Search_UpdateStepMap(_UBYTE changed);
+
 // ==== 最短経路導出 ====
 void Search_MakeRoute();
 
+// ==== 走行時間最小の経路導出 ====
+void Search_MakeTimeRoute();
+
+// ==== 最短走行 ====
+void Search_FastRun();
+
+// ==== ゴール区画を全て消去 ====
+void Search_ClearGoal();
+
+// ==== ゴール区画を追加 ====
+bool Search_AddGoal(_UBYTE x, _UBYTE y);
+
+// ==== ゴール領域を設定 ====
+bool Search_SetGoalRegion(_UBYTE x, _UBYTE y, _UBYTE w, _UBYTE h);
+
+// ==== ゴール区画か判定 ====
+bool Search_IsGoal(_UBYTE x, _UBYTE y);
+
+// ==== ゴール領域をシリアルから入力 ====
+void Search_InputGoal();
+
 //// ==== 最短経路を表示 ====
 //void Search_PrintRoute();
-//
-//// ==== ゴール座標をセット ====
-//void Search_SetGoal(SCHAR x, SCHAR y);
 
 
 #endif /* __SEARCH_H__ */
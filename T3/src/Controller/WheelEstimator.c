@@ -0,0 +1,173 @@
+/**
+ * @file  WheelEstimator.c
+ * @brief 磁気エンコーダの角度から車輪の角度,角速度を推定するクラス
+ *
+ * 1制御周期ごとの角度差をそのまま速度にすると,低速では1カウント刻みに
+ * 量子化され,SPIの取得周期と制御周期がずれると0と2倍を行き来する.
+ * ここではサンプルの取得時刻を使ったα-βフィルタで角度と角速度を追従させ,
+ * 予測から大きく外れたサンプルは棄却する.
+ * 固定小数点では毎周期の64bitの割り算を避け,間隔がWHEEL_EST_DT_USちょうどのサンプルは
+ * 割り算なしで,ずれたサンプルだけ32bitの整数で割って補正する.
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "WheelEstimator.h"
+
+/*----------------------------------------------------------------------
+	Private Method Declarations
+ ----------------------------------------------------------------------*/
+static CTRL_VAL WheelEstimator_WrapPos(CTRL_VAL v);
+static CTRL_VAL WheelEstimator_WrapRes(CTRL_VAL v);
+static void WheelEstimator_Start(WheelEstimator* est, _UWORD angle, _UDWORD stamp, CTRL_VAL vel);
+
+/*----------------------------------------------------------------------
+	Public Method Definitions
+ ----------------------------------------------------------------------*/
+/** 推定をやり直す(次のサンプルを初期値とする)
+ * @param est: 推定器
+ * @retval void
+ */
+void WheelEstimator_Reset(WheelEstimator* est)
+{
+	est->Pos = 0;
+	est->Vel = 0;
+	est->Raw = 0;
+	est->Stamp = 0;
+	est->SeenStamp = 0;
+	est->RejectRun = 0;
+	est->RejectNum = 0;
+	est->Valid = false;
+}
+
+/** サンプルを1つ取り込む
+ *   同じ時刻のサンプルを続けて渡した場合は何もしない
+ * @param est: 推定器
+ * @param angle: エンコーダ角度 [count]
+ * @param stamp: angleを取得した時刻 [usec]
+ * @retval _SWORD: 前に採用したサンプルからの角度変化 [count] (棄却したときは0)
+ */
+_SWORD WheelEstimator_Update(WheelEstimator* est, _UWORD angle, _UDWORD stamp)
+{
+	_UDWORD dtUs = stamp - est->Stamp;
+	_SDWORD dtS;
+	_SWORD diff;
+	CTRL_VAL pred, res, gain;
+
+	if(!est->Valid)
+	{
+		WheelEstimator_Start(est, angle, stamp, 0);
+		return 0;
+	}
+	if((stamp == est->SeenStamp) || (dtUs < WHEEL_EST_DT_MIN_US))
+	{
+		return 0;
+	}
+	est->SeenStamp = stamp;
+
+	diff = WheelEstimator_WrapDiff(angle, est->Raw);
+
+	// 間隔が空きすぎたら予測が当てにならないので,差分からやり直す
+	if(dtUs > WHEEL_EST_DT_MAX_US)
+	{
+		WheelEstimator_Start(est, angle, stamp, 0);
+		return diff;
+	}
+
+	// 取得時刻まで等速で予測し,予測との差で補正する
+	//   (間隔がWHEEL_EST_DT_USならVelがそのまま1間隔分の角度変化)
+	dtS = (_SDWORD)dtUs;
+	if(dtS == WHEEL_EST_DT_US)
+	{
+		pred = est->Pos + est->Vel;
+	}
+	else
+	{
+		pred = est->Pos + CTRL_MUL(est->Vel, CTRL_DIVI(CTRL_FROM_INT(dtS), WHEEL_EST_DT_US));
+	}
+	res = WheelEstimator_WrapRes(CTRL_FROM_INT(angle) - pred);
+
+	if(CTRL_ABS(res) > CTRL_FROM_INT(WHEEL_EST_GATE))
+	{
+		est->RejectNum++;
+		if(++est->RejectRun < WHEEL_EST_REJECT_MAX)
+		{
+			return 0;
+		}
+		// 外れ値が続くなら実際に動いたとみなす
+		WheelEstimator_Start(est, angle, stamp, CTRL_MULI(CTRL_DIVI(CTRL_FROM_INT(diff), dtS), WHEEL_EST_DT_US));
+		return diff;
+	}
+
+	est->Pos = WheelEstimator_WrapPos(pred + CTRL_MUL(CTRL_CONST(WHEEL_EST_ALPHA), res));
+	gain = CTRL_MUL(CTRL_CONST(WHEEL_EST_BETA), res);
+	if(dtS == WHEEL_EST_DT_US)
+	{
+		est->Vel += gain;
+	}
+	else
+	{
+		est->Vel += CTRL_DIVI(CTRL_MULI(gain, WHEEL_EST_DT_US), dtS);
+	}
+	est->Raw = angle;
+	est->Stamp = stamp;
+	est->RejectRun = 0;
+
+	return diff;
+}
+
+/** 1回転で折り返す角度の差を求める
+ * @param a: 角度 [count]
+ * @param b: 角度 [count]
+ * @retval _SWORD: a - b [count] (-WHEEL_EST_COUNT/2〜WHEEL_EST_COUNT/2-1)
+ */
+_SWORD WheelEstimator_WrapDiff(_UWORD a, _UWORD b)
+{
+	_SWORD d = (_SWORD)((a - b) & (WHEEL_EST_COUNT - 1));
+
+	return (d >= WHEEL_EST_COUNT / 2) ? (d - WHEEL_EST_COUNT) : d;
+}
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+/** 角度を0〜WHEEL_EST_COUNTに収める
+ * @param v: 角度 [count]
+ * @retval CTRL_VAL: 角度 [count]
+ */
+static CTRL_VAL WheelEstimator_WrapPos(CTRL_VAL v)
+{
+	while(v >= CTRL_FROM_INT(WHEEL_EST_COUNT))	v -= CTRL_FROM_INT(WHEEL_EST_COUNT);
+	while(v < 0)								v += CTRL_FROM_INT(WHEEL_EST_COUNT);
+	return v;
+}
+
+/** 角度の差を±WHEEL_EST_COUNT/2に収める
+ * @param v: 角度の差 [count]
+ * @retval CTRL_VAL: 角度の差 [count]
+ */
+static CTRL_VAL WheelEstimator_WrapRes(CTRL_VAL v)
+{
+	while(v >= CTRL_FROM_INT(WHEEL_EST_COUNT / 2))	v -= CTRL_FROM_INT(WHEEL_EST_COUNT);
+	while(v < -CTRL_FROM_INT(WHEEL_EST_COUNT / 2))	v += CTRL_FROM_INT(WHEEL_EST_COUNT);
+	return v;
+}
+
+/** サンプルを初期値として推定を始める
+ * @param est: 推定器
+ * @param angle: エンコーダ角度 [count]
+ * @param stamp: angleを取得した時刻 [usec]
+ * @param vel: 角速度の初期値 [count/WHEEL_EST_DT_US]
+ * @retval void
+ */
+static void WheelEstimator_Start(WheelEstimator* est, _UWORD angle, _UDWORD stamp, CTRL_VAL vel)
+{
+	est->Pos = CTRL_FROM_INT(angle);
+	est->Vel = vel;
+	est->Raw = angle;
+	est->Stamp = stamp;
+	est->SeenStamp = stamp;
+	est->RejectRun = 0;
+	est->Valid = true;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file  WheelEstimator.h
+ * @brief 磁気エンコーダの角度から車輪の角度,角速度を推定するクラス
+ */
+
+#ifndef __WHEELESTIMATOR_H__
+#define __WHEELESTIMATOR_H__
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "../typedefine.h"
+#include "ControlValue.h"
+#include <stdbool.h>
+
+/*----------------------------------------------------------------------
+	Macro Definitions
+ ----------------------------------------------------------------------*/
+#define WHEEL_EST_RESOLUTION	12		// エンコーダ分解能 [bit] (AS5055のENCODER_RESOLUTIONに合わせる)
+#define WHEEL_EST_COUNT			(1 << WHEEL_EST_RESOLUTION)	// 1回転のカウント数
+
+// ==== α-βフィルタ(β = α^2 / (2 - α)で臨界減衰) ====
+#define WHEEL_EST_ALPHA			0.5		// 角度の補正率
+#define WHEEL_EST_BETA			0.167	// 角速度の補正率
+#define WHEEL_EST_DT_US			1000	// 角速度の時間単位 [usec] (Velは[count/WHEEL_EST_DT_US])
+#define WHEEL_EST_DT_MIN_US		100		// これより短い間隔のサンプルは使わない [usec]
+#define WHEEL_EST_DT_MAX_US		8000	// これより間隔が空いたら推定をやり直す [usec]
+
+// ==== 外れ値の棄却 ====
+#define WHEEL_EST_GATE			32		// 予測との差がこれを超えたサンプルは棄却する [count]
+#define WHEEL_EST_REJECT_MAX	3		// 続けて棄却したらサンプルを信じて推定をやり直す回数
+
+/*----------------------------------------------------------------------
+	Struct Definitions
+ ----------------------------------------------------------------------*/
+// ==== 車輪1輪分の推定器の状態 ====
+typedef struct stWheelEstimator
+{
+	CTRL_VAL Pos;		// 推定角度 [count] (0〜WHEEL_EST_COUNT)
+	CTRL_VAL Vel;		// 推定角速度 [count/WHEEL_EST_DT_US]
+	_UWORD Raw;			// 最後に採用した角度 [count]
+	_UDWORD Stamp;		// 最後に採用したサンプルの時刻 [usec]
+	_UDWORD SeenStamp;	// 最後に受け取ったサンプルの時刻 [usec]
+	_UBYTE RejectRun;	// 続けて棄却した回数
+	_UDWORD RejectNum;	// 棄却した回数の累計
+	bool Valid;			// 推定値が有効
+}WheelEstimator;
+
+/*----------------------------------------------------------------------
+	Public Method Declarations
+ ----------------------------------------------------------------------*/
+void WheelEstimator_Reset(WheelEstimator* est);
+_SWORD WheelEstimator_Update(WheelEstimator* est, _UWORD angle, _UDWORD stamp);
+_SWORD WheelEstimator_WrapDiff(_UWORD a, _UWORD b);
+
+#endif /* __WHEELESTIMATOR_H__ */
@@ -22,8 +22,16 @@ static _UWORD EncR_send[2] = {0};	// SPI送信データ格納用
 //static _UWORD recv[2] = {0};		// SPI送信データ格納用
 static _UWORD EncL_angle[ENCODER_SAMPLING_NUM] = {0};		// 磁気エンコーダ角度情報格納用
 static _UWORD EncR_angle[ENCODER_SAMPLING_NUM] = {0};		// 磁気エンコーダ角度情報格納用
+static _UWORD EncL_recv = 0;		// SPI受信データ(検査してからEncL_angleに入れる)
+static _UWORD EncR_recv = 0;		// SPI受信データ(検査してからEncR_angleに入れる)
+static volatile _UDWORD _errL = 0;	// 左エンコーダの受信データを捨てた回数
+static volatile _UDWORD _errR = 0;	// 右エンコーダの受信データを捨てた回数
 static volatile _UBYTE _tpL = 0;
 static volatile _UBYTE _tpR = 0;
+static volatile _UDWORD _stampL = 0;	// 左エンコーダの角度を取得した時刻 [usec]
+static volatile _UDWORD _stampR = 0;	// 右エンコーダの角度を取得した時刻 [usec]
+static RSPI_CYCLE_DESC EncL_cycle;	// CycleOperationでの転送
+static RSPI_CYCLE_DESC EncR_cycle;	// CycleOperationでの転送
 
 /*----------------------------------------------------------------------
 	Private Method Declarations
@@ -35,10 +43,11 @@ static void AS5055_LeftEnc_Deselect(void);
 static void AS5055_RightEnc_Select(void);
 static void AS5055_RightEnc_Deselect(void);
 static _UWORD AppendEvenParity(_UWORD command);
+static bool AS5055_IsValidFrame(_UWORD frame);
 //static void AS5055_RSPI_Write(_UWORD registerAddress, _UWORD data);
 //static _UWORD AS5055_RSPI_Read(_UWORD registerAddress);
-static void AS5055_LeftEnc_CycleSendCommand(void);
-static void AS5055_RightEnc_CycleSendCommand(void);
+static void AS5055_LeftEnc_CycleTransferEnd(void);
+static void AS5055_RightEnc_CycleTransferEnd(void);
 
 /*----------------------------------------------------------------------
 	Public Method Definitions
@@ -61,27 +70,36 @@ void AS5055_Initialize(void)
  */
 _UWORD AS5055_GetAngle(E_AS5055_LR encLR)
 {
-	_UWORD ang = 0;
+	_UWORD *angle = (encLR == ENC_L) ? EncL_angle : EncR_angle;
+	_UWORD ref = (angle[0] >> 2) & 0x0FFF;
+	_SDWORD sum = 0;
 
-	switch(encLR)
+	// 0と4095の境目をまたいでも平均が崩れないよう,1つ目との差で平均する
+	for(int i = 0; i < ENCODER_SAMPLING_NUM; i++)
 	{
-	case ENC_L:
-		for(int i = 0; i < ENCODER_SAMPLING_NUM; i++)
-		{
-			ang += (_UWORD)((EncL_angle[i] >> 2) & 0x0FFF);
-		}
-		break;
-	case ENC_R:
-		for(int i = 0; i < ENCODER_SAMPLING_NUM; i++)
-		{
-			ang += (_UWORD)((EncR_angle[i] >> 2) & 0x0FFF);
-		}
-		break;
+		_SWORD d = (_SWORD)((((angle[i] >> 2) & 0x0FFF) - ref) & 0x0FFF);
+		sum += (d >= (1 << (ENCODER_RESOLUTION - 1))) ? (d - (1 << ENCODER_RESOLUTION)) : d;
 	}
 
-	ang /= ENCODER_SAMPLING_NUM;
+	return (_UWORD)((ref + sum / ENCODER_SAMPLING_NUM) & 0x0FFF);
+}
+
+/** 磁気エンコーダの角度情報を取得した時刻を取得する
+ * @param encLR: 左右エンコーダの選択
+ * @retval _UDWORD: Timer_GetTimeUS()で測った時刻 [usec]
+ */
+_UDWORD AS5055_GetStamp(E_AS5055_LR encLR)
+{
+	return (encLR == ENC_L) ? _stampL : _stampR;
+}
 
-	return ang;
+/** パリティ異常,エラーフラグで捨てた受信データの数を取得する
+ * @param encLR: 左右エンコーダの選択
+ * @retval _UDWORD: 捨てた回数
+ */
+_UDWORD AS5055_GetErrorCount(E_AS5055_LR encLR)
+{
+	return (encLR == ENC_L) ? _errL : _errR;
 }
 
 /*----------------------------------------------------------------------
@@ -113,8 +131,16 @@ static void AS5055_InitializeRSPI0(void)
 	EncL_dep.format = RSPI_WORD_DATA;
 	EncL_dep.ChipSelectFunc = AS5055_LeftEnc_Select;
 	EncL_dep.ChipDeselectFunc = AS5055_LeftEnc_Deselect;
+	EncL_dep.TransferEndFunc = AS5055_LeftEnc_CycleTransferEnd;
 
-	RSPI0_RegisterDeviceForCycleOperation(AS5055_LeftEnc_CycleSendCommand);
+	// コマンドは決まっているので,処理量削減のために予めコマンドを与える
+	// (角度情報のReadコマンドに偶数パリティを付加したもの)
+	EncL_send[0] = 0xFFFF;
+	EncL_cycle.dep = &EncL_dep;
+	EncL_cycle.psrc = EncL_send;
+	EncL_cycle.pdest = &EncL_recv;
+	EncL_cycle.length = 1;
+	RSPI0_RegisterDeviceForCycleOperation(&EncL_cycle);
 
 	// 右エンコーダ用
 	EncR_dep.brdv_val = 3;		// ベースのビットレートの8分周:1Mbps(=T:10nS)
@@ -129,8 +155,14 @@ static void AS5055_InitializeRSPI0(void)
 	EncR_dep.format = RSPI_WORD_DATA;
 	EncR_dep.ChipSelectFunc = AS5055_RightEnc_Select;
 	EncR_dep.ChipDeselectFunc = AS5055_RightEnc_Deselect;
+	EncR_dep.TransferEndFunc = AS5055_RightEnc_CycleTransferEnd;
 
-	RSPI0_RegisterDeviceForCycleOperation(AS5055_RightEnc_CycleSendCommand);
+	EncR_send[0] = 0xFFFF;
+	EncR_cycle.dep = &EncR_dep;
+	EncR_cycle.psrc = EncR_send;
+	EncR_cycle.pdest = &EncR_recv;
+	EncR_cycle.length = 1;
+	RSPI0_RegisterDeviceForCycleOperation(&EncR_cycle);
 }
 
 /** AS5055で使うポートの初期化
@@ -234,47 +266,52 @@ static _UWORD AppendEvenParity(_UWORD command)
 //	return recv[1];
 //}
 
-/** RSPI0 Cycle Operation で送信するコマンド(左エンコーダ角度情報取得)
+/** AS5055(左)のCycleOperation転送完了(RSPI0のDMA転送終了割り込みから呼ばれる)
+ *   受信データが正しければ格納して次の格納先に切り替える
  * @param void
  * @retval void
  */
-static void AS5055_LeftEnc_CycleSendCommand(void)
+static void AS5055_LeftEnc_CycleTransferEnd(void)
 {
-//	_UWORD command;
-//
-//	// 角度情報を取得
-//	// 送信用に1ビット左にシフトし，先頭にReadコマンドを付加
-//	command = (ASREG_ANGULAR_DATA << 1) | AS_READ_FLAG;
-//
-//	// 末尾に偶数パリティを付加
-//	EncL_send[0] = AppendEvenParity(command);
-
-	// コマンドは決まっているので,処理量削減のために予めコマンドを与える
-	EncL_send[0] = 0xFFFF;
-
-	RSPI0_WriteRead(EncL_send, &EncL_angle[_tpL], 1, EncL_dep);
+	if(!AS5055_IsValidFrame(EncL_recv))
+	{
+		_errL++;
+		return;
+	}
+	EncL_angle[_tpL] = EncL_recv;
+	_stampL = Timer_GetTimeUS();
 	_tpL++;
 	if(_tpL >= ENCODER_SAMPLING_NUM) _tpL = 0;
 }
 
-/** RSPI0 Cycle Operation で送信するコマンド(右エンコーダ角度情報取得)
+/** AS5055(右)のCycleOperation転送完了(RSPI0のDMA転送終了割り込みから呼ばれる)
+ *   受信データが正しければ格納して次の格納先に切り替える
  * @param void
  * @retval void
  */
-static void AS5055_RightEnc_CycleSendCommand(void)
+static void AS5055_RightEnc_CycleTransferEnd(void)
 {
-//	_UWORD command;
-//
-//	// 角度情報を取得
-//	// 送信用に1ビット左にシフトし，先頭にReadコマンドを付加
-//	command = (ASREG_ANGULAR_DATA << 1) | AS_READ_FLAG;
-//
-//	// 末尾に偶数パリティを付加
-//	EncR_send[0] = AppendEvenParity(command);
-	// コマンドは決まっているので,処理量削減のために予めコマンドを与える
-	EncR_send[0] = 0xFFFF;
-
-	RSPI0_WriteRead(EncR_send, &EncR_angle[_tpR], 1, EncR_dep);
+	if(!AS5055_IsValidFrame(EncR_recv))
+	{
+		_errR++;
+		return;
+	}
+	EncR_angle[_tpR] = EncR_recv;
+	_stampR = Timer_GetTimeUS();
 	_tpR++;
 	if(_tpR >= ENCODER_SAMPLING_NUM) _tpR = 0;
 }
+
+/** 受信データの検査
+ *   bit0:偶数パリティ, bit1:エラーフラグ(前のコマンドの異常)
+ * @param frame: 受信データ
+ * @retval bool: true:正常, false:異常
+ */
+static bool AS5055_IsValidFrame(_UWORD frame)
+{
+	if(frame & AS_ERROR_FLAG)
+	{
+		return false;
+	}
+	return (AppendEvenParity(frame & ~AS_PARITY_BIT) == frame);
+}
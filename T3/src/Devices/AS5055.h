@@ -26,12 +26,18 @@
 
 // SPI読み出しフラグ
 #define AS_READ_FLAG	0x8000
+// 受信データのフラグ
+#define AS_ERROR_FLAG	0x0002	// エラーフラグ
+#define AS_PARITY_BIT	0x0001	// 偶数パリティ
 
 // エンコーダ分解能
 #define ENCODER_RESOLUTION	12		// 12bit
 
 // 一つのエンコーダに対し指定した回数分値取得を行い,その平均値をエンコーダ値とする
+// (ホスト試験(test/WheelEstimatorTest.c)では平均を確かめるため外から与える)
+#ifndef ENCODER_SAMPLING_NUM
 #define ENCODER_SAMPLING_NUM	1
+#endif
 
 /*----------------------------------------------------------------------
 	Enum definitions
@@ -47,5 +53,7 @@ typedef enum eAS5055_LR
  ----------------------------------------------------------------------*/
 void AS5055_Initialize(void);
 _UWORD AS5055_GetAngle(E_AS5055_LR encLR);
+_UDWORD AS5055_GetStamp(E_AS5055_LR encLR);
+_UDWORD AS5055_GetErrorCount(E_AS5055_LR encLR);
 
 #endif
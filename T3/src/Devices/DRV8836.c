@@ -14,7 +14,7 @@
 	Private global variables
  ----------------------------------------------------------------------*/
 static const _UINT PWM_FREQ = 256;		// PWMの周期(256:187.5kHz)
-static const float DUTY_MAX	= 25.0;		// dutyの最大値[%]
+static const float DUTY_MAX	= DRV8836_DUTY_MAX;	// dutyの最大値[%]
 static _UINT _motorA_duty = 0;			// モータAのDuty
 static _UINT _motorB_duty = 0;			// モータBのDuty
 static E_MOTOR_DIR _motorA_dir = MOTOR_DIR_CW;			// モータAの回転方向
@@ -20,6 +20,8 @@
 #define MDR_AENBL_TGR		MTU0.TGRC
 #define MDR_BENBL_TGR		MTU0.TGRD
 
+#define DRV8836_DUTY_MAX	25.0	// dutyの最大値[%]
+
 /*----------------------------------------------------------------------
 	Enum Definitions
  ----------------------------------------------------------------------*/
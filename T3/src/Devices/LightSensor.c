@@ -9,15 +9,59 @@
 #include "../iodefine.h"
 #include "../Global.h"
 
+#if !LS_GROUP_SCAN
+/*----------------------------------------------------------------------
+	Private Macro Definitions
+ ----------------------------------------------------------------------*/
+#define LS_SLOT_BATTERY		4		// スケジュール表で電池電圧を表すチャンネル
+
+/*----------------------------------------------------------------------
+	Private Struct Definitions
+ ----------------------------------------------------------------------*/
+// ==== チャンネルごとの取得設定 ====
+typedef struct stLightSensorChannelConfig
+{
+	_UBYTE AdCh;		// A/Dチャンネル(ANxxx)
+	_UWORD Settle;		// LEDを点灯させてから点灯時A/D変換を開始するまでの待ち [MTU3カウント]
+}LSChannelConfig;
+#endif
+
 /*----------------------------------------------------------------------
 	Private global variables
  ----------------------------------------------------------------------*/
-static _UBYTE _tp = 0;	// タスクポインタ
-static _UBYTE _sensorCh = 0;	// 処理対象センサチャンネル
+static _UBYTE _tp = 0;	// タスクポインタ(LS_GROUP_SCANでなければスケジュール表の位置)
+#if LS_GROUP_SCAN
+static _UWORD _scanOff[LS_SCAN_WORDS];	// LEDオフ時のスキャン結果(ADDR0〜ADDR12)
+static _UWORD _scanOn[LS_SCAN_WORDS];	// LEDオン時のスキャン結果(ADDR0〜ADDR12)
+static const _UBYTE _adIndex[4] = {0, 1, 2, 6};	// 各センサチャンネルのA/Dチャンネル
+#else
+// E_LS_CHANNEL順(+電池).前方センサは遠くの壁を見るので,必要ならここで待ちを延ばす
+static const LSChannelConfig _chConfig[5] = {
+	{ 0, PT_DELAY},		// LS_FWD_L: AN000
+	{ 1, PT_DELAY},		// LS_LEFT: AN001
+	{ 2, PT_DELAY},		// LS_RIGHT: AN002
+	{ 6, PT_DELAY},		// LS_FWD_R: AN006
+	{12, 0},			// LS_SLOT_BATTERY: AN012 (LEDなし)
+};
+// 取得順.壁制御に使う左右センサを前方センサの倍の頻度で取る
+//   同じチャンネルが続くとLEDの残光が残るので離して並べる
+static const _UBYTE _schedule[] = {
+	LS_LEFT, LS_RIGHT, LS_FWD_L,
+	LS_LEFT, LS_RIGHT, LS_FWD_R,
+	LS_SLOT_BATTERY,
+};
+#define LS_SCHEDULE_NUM	(sizeof(_schedule) / sizeof(_schedule[0]))
+static bool _ledOn = false;		// 現在のスロットでLEDを点灯させている(点灯時A/D変換の待ち)
 static _UWORD _ledOffAdVal[4];	// フィルタ用LEDオフ時A/D値格納
 static _UWORD _ledOnAdVal[4];	// フィルタ用LEDオン時A/D値格納
 static _UWORD _batteryAdVal;	// バッテリー電圧A/D値格納
+#endif
 static volatile LSVal _LS;		// A/D値格納構造体
+static bool _extTrigger = false;	// 1巡ごとに外部から起動する(MTU3で自走しない)
+static volatile _UDWORD _stamp = 0;	// 全センサのA/D値が揃った時刻 [usec]
+static _UWORD _offSettle = LS_OFF_SETTLE_MIN;	// 消灯時A/D変換前の待ち(目標周期から求める) [MTU3カウント]
+static _SWORD _distTable[4][LS_DIST_POINTS];	// 距離変換表(E_LS_CHANNEL順,遠いほど小さいA/D値)
+static _SWORD _wallBase[4] = {WALL_BASE_FWD_L, WALL_BASE_LEFT, WALL_BASE_RIGHT, WALL_BASE_FWD_R};	// 壁判断基準値(E_LS_CHANNEL順)
 
 /*----------------------------------------------------------------------
 	Private Method Declarations
@@ -27,7 +71,15 @@ static void LightSensor_InitializeADC(void);
 static void LightSensor_InitializeDMAC(void);
 static void LightSensor_InitializeMTU3(void);
 static void LightSensor_SetLedState(_UBYTE ch, E_IR_LED_STATE state);
+#if LS_GROUP_SCAN
+static void LightSensor_SetAllLedState(E_IR_LED_STATE state);
+#else
+static bool LightSensor_NextStep(void);
+static void LightSensor_SelectSlot(_UBYTE slot);
+#endif
 static _SWORD LightSensor_GetADValueSingle(E_LS_CHANNEL ch);
+static void LightSensor_CalcNow(LSChannel* now);
+static void LightSensor_InitDistTable(void);
 
 /*----------------------------------------------------------------------
 	Public Method Definitions
@@ -38,15 +90,22 @@ static _SWORD LightSensor_GetADValueSingle(E_LS_CHANNEL ch);
  */
 void LightSensor_Initialize(void)
 {
+	LightSensor_SetFrameRate(LS_FRAME_RATE);	// 消灯時A/D変換前の待ちを決める
 	LightSensor_InitializePort();		// ポートの初期化
 	LightSensor_InitializeDMAC();		// DMACの初期化
 	LightSensor_InitializeADC();		// 12ビットA/Dコンバータの初期化
+#if !LS_GROUP_SCAN
+	LightSensor_SelectSlot(0);			// スケジュール表の先頭から始める
+#endif
 	LightSensor_InitializeMTU3();		// MTU3の初期化
 
 	_LS.Now.FwdL = 0, _LS.Now.FwdR = 0, _LS.Now.Left = 0, _LS.Now.Right = 0;
 	_LS.Old.FwdL = 0, _LS.Old.FwdR = 0, _LS.Old.Left = 0, _LS.Old.Right = 0;
 	_LS.Delta.FwdL = 0, _LS.Delta.FwdR = 0, _LS.Delta.Left = 0, _LS.Delta.Right = 0;
 	_LS.Dif.FwdL = 0, _LS.Dif.FwdR = 0, _LS.Dif.Left = 0, _LS.Dif.Right = 0;
+	_LS.Dist.FwdL = 0, _LS.Dist.FwdR = 0, _LS.Dist.Left = 0, _LS.Dist.Right = 0;
+
+	LightSensor_InitDistTable();		// 較正するまでの仮の距離変換表
 }
 
 /** DMA転送終了割り込み
@@ -55,74 +114,29 @@ void LightSensor_Initialize(void)
  */
 void LightSensor_IntDMAC0(void)
 {
+	bool frameEnd;		// 1巡し終わった
+
 	MTU.TSTR.BIT.CST3 = 0;		// MTU3カウント動作停止
 	MTU3.TCNT = 0;				// タイマカウンタの初期化
 
-//	LED発光からフォトトラ反応が安定するまで約50～60us
-//	かかるので、case:偶数 ではその待ちを設定。
+#if LS_GROUP_SCAN
+	// 消灯スキャン,点灯スキャンの2回で4センサ分(+電池)がそろう
 	switch(_tp)
 	{
 	case 0:
-	case 2:
-	case 4:
-	case 6:
-		LightSensor_SetLedState(_sensorCh, IR_LED_ON);	// IRLED点灯
-		DMAC0.DMDAR = (void*)&(_ledOnAdVal[_sensorCh]);	// DMAC転送先アドレス設定
-		MTU3.TGRA = PT_DELAY;							// LEDを発光させて少ししてからA/D変換を開始させる
+		// 消灯スキャン終了: 全LEDを点灯させ,少ししてから点灯スキャン
+		LightSensor_SetAllLedState(IR_LED_ON);
+		S12AD.ADANS0.WORD = LS_ADANS_ON;
+		DMAC0.DMDAR = (void*)_scanOn;
+		MTU3.TGRA = PT_DELAY;
 		break;
 	case 1:
-		LightSensor_SetLedState(_sensorCh, IR_LED_OFF);	// IRLED消灯
-		S12AD.ADANS0.WORD = 0x0002;						// AN001を変換対象とする
-		S12AD.ADADS0.BIT.ADS0 = 0x0002;					// AN001をA/D変換値加算に設定
-		DMAC0.DMSAR = (void*)&S12AD.ADDR1;				// DMAC転送元アドレス設定:AN001
-		_sensorCh = 1;
-		DMAC0.DMDAR = (void*)&(_ledOffAdVal[_sensorCh]);// DMAC転送先アドレス設定
-		MTU3.TGRA = GET_INTERVAL;
-		break;
-	case 3:
-		LightSensor_SetLedState(_sensorCh, IR_LED_OFF);	// IRLED消灯
-		S12AD.ADANS0.WORD = 0x0004;						// AN002を変換対象とする
-		S12AD.ADADS0.BIT.ADS0 = 0x0004;					// AN002をA/D変換値加算に設定
-		DMAC0.DMSAR = (void*)&S12AD.ADDR2;				// DMAC転送元アドレス設定:AN002
-		_sensorCh = 2;
-		DMAC0.DMDAR = (void*)&(_ledOffAdVal[_sensorCh]);// DMAC転送先アドレス設定
-		MTU3.TGRA = GET_INTERVAL;
-		break;
-	case 5:
-		LightSensor_SetLedState(_sensorCh, IR_LED_OFF);	// IRLED消灯
-		S12AD.ADANS0.WORD = 0x0040;						// AN006を変換対象とする
-		S12AD.ADADS0.BIT.ADS0 = 0x0040;					// AN006をA/D変換値加算に設定
-		DMAC0.DMSAR = (void*)&S12AD.ADDR6;				// DMAC転送元アドレス設定:AN006
-		_sensorCh = 3;
-		DMAC0.DMDAR = (void*)&(_ledOffAdVal[_sensorCh]);// DMAC転送先アドレス設定
-		MTU3.TGRA = GET_INTERVAL;
-		break;
-//	case 7:
-//		LightSensor_SetLedState(_sensorCh, IR_LED_OFF);	// IRLED消灯
-//		S12AD.ADANS0.WORD = 0x0001;						// AN000を変換対象とする
-//		S12AD.ADADS0.BIT.ADS0 = 0x0001;					// AN000をA/D変換値加算に設定
-//		DMAC0.DMSAR = (void*)&S12AD.ADDR0;				// DMAC転送元アドレス設定:AN000
-//		_sensorCh = 0;
-//		DMAC0.DMDAR = (void*)&(_ledOffAdVal[_sensorCh]);// DMAC転送先アドレス設定
-//		MTU3.TGRA = GET_INTERVAL;
-//		break;
-	case 7:
-		// for LiPO battery
-		LightSensor_SetLedState(_sensorCh, IR_LED_OFF);	// IRLED消灯
-		S12AD.ADANS0.WORD = 0x1000;						// AN012を変換対象とする
-		S12AD.ADADS0.BIT.ADS0 = 0x1000;					// AN012をA/D変換値加算に設定
-		DMAC0.DMSAR = (void*)&S12AD.ADDR12;				// DMAC転送元アドレス設定:AN012
-		DMAC0.DMDAR = (void*)&_batteryAdVal;			// DMAC転送先アドレス設定
-		MTU3.TGRA = GET_INTERVAL;
-		break;
-	case 8:
-//		LightSensor_SetLedState(_sensorCh, IR_LED_OFF);	// IRLED消灯
-		S12AD.ADANS0.WORD = 0x0001;						// AN000を変換対象とする
-		S12AD.ADADS0.BIT.ADS0 = 0x0001;					// AN000をA/D変換値加算に設定
-		DMAC0.DMSAR = (void*)&S12AD.ADDR0;				// DMAC転送元アドレス設定:AN000
-		_sensorCh = 0;
-		DMAC0.DMDAR = (void*)&(_ledOffAdVal[_sensorCh]);// DMAC転送先アドレス設定
-		MTU3.TGRA = GET_INTERVAL;
+		// 点灯スキャン終了: 全LEDを消灯させ,残光が消えてから消灯スキャン
+		_stamp = Timer_GetTimeUS();
+		LightSensor_SetAllLedState(IR_LED_OFF);
+		S12AD.ADANS0.WORD = LS_ADANS_OFF;
+		DMAC0.DMDAR = (void*)_scanOff;
+		MTU3.TGRA = _offSettle;
 		break;
 	default:
 		break;
@@ -130,37 +144,155 @@ void LightSensor_IntDMAC0(void)
 
 	// タスクポインタを進める
 	_tp++;
-	if (_tp >= 9)
+	if (_tp >= 2)
 	{
 		_tp = 0;
 	}
 
+	// 次のスキャン結果転送のためのDMAC設定
+	DMAC0.DMSTS.BIT.DTIF = 0;			// DMAC0転送終了割り込みフラグをクリア
+	DMAC0.DMSAR = (void*)&S12AD.ADDR0;	// 転送元アドレス設定
+	DMAC0.DMCRA = LS_DMA_BLOCK;			// ブロックサイズ
+	DMAC0.DMCRB = 1;					// ブロック転送回数:1
+	DMAC0.DMCNT.BIT.DTE = 1;			// DMA転送を許可
+	frameEnd = (_tp == 0);
+#else
+	// スケジュール表に従って1ステップ進める
+	frameEnd = LightSensor_NextStep();
+
 	// 次のA/D値転送のためのDMAC設定
 	DMAC0.DMSTS.BIT.DTIF = 0;	// DMAC0転送終了割り込みフラグをクリア
 	DMAC0.DMCRA = 1;			// 転送回数:1
 	DMAC0.DMCNT.BIT.DTE = 1;	// DMA転送を許可
+#endif
 
+	// 外部起動時は1巡したら次のLightSensor_TriggerScan()まで止めておく
+	if (_extTrigger && frameEnd)
+	{
+		return;
+	}
 	MTU.TSTR.BIT.CST3 = 1;		// MTU3カウント動作開始
 }
 
 /**
- * 光センサの各値を取得する
+ * 光センサの取得を1巡だけ起動する
+ *   一度呼ぶとMTU3による自走をやめ,以降は呼ばれるたびに1巡する
+ *   前の巡回がまだ終わっていなければ何もしない
  * @param void
- * @retval LSVal*: 光センサ値格納構造体へのポインタ
+ * @retval void
  */
-LSVal* LightSensor_GetValue(void)
+void LightSensor_TriggerScan(void)
+{
+	if (!_extTrigger)
+	{
+		_extTrigger = true;		// 自走中の巡回は最後まで回してから止まる
+		return;
+	}
+	if ((_tp == 0) && (MTU.TSTR.BIT.CST3 == 0))
+	{
+		MTU3.TCNT = 0;
+		MTU3.TGRA = PT_DELAY;	// 消灯は前の巡回から続いているので待ちは短くてよい
+		MTU.TSTR.BIT.CST3 = 1;	// MTU3カウント動作開始
+	}
+}
+
+/**
+ * 光センサ1巡の目標周期を設定する
+ *   1巡がこの周期になるように消灯時A/D変換前の待ちを決め直す
+ * @param hz: 1巡の目標周波数 [Hz]
+ * @retval bool: true: 目標周期で回せる, false: 回せない(待ちを範囲内に丸めた)
+ */
+bool LightSensor_SetFrameRate(_UWORD hz)
+{
+	_UDWORD frame, busy, wait;
+	_UBYTE slots;
+#if !LS_GROUP_SCAN
+	_UBYTE i;
+#endif
+
+	if(hz == 0)
+	{
+		return false;
+	}
+	frame = LS_FRAME_COUNT(hz);
+
+	// 1巡のうち消灯時の待ち以外にかかる時間(LED点灯の待ち+A/D変換)
+#if LS_GROUP_SCAN
+	busy = PT_DELAY + 2 * LS_CONV_COUNT;
+	slots = 1;
+#else
+	busy = 0;
+	for(i = 0; i < LS_SCHEDULE_NUM; i++)
+	{
+		_UBYTE ch = _schedule[i];
+
+		busy += _chConfig[ch].Settle + LS_CONV_COUNT_CH;
+		if(ch != LS_SLOT_BATTERY)
+		{
+			busy += LS_CONV_COUNT_CH;	// 消灯時,点灯時の2回
+		}
+	}
+	slots = LS_SCHEDULE_NUM;
+#endif
+
+	if(frame < busy + (_UDWORD)slots * LS_OFF_SETTLE_MIN)
+	{
+		_offSettle = LS_OFF_SETTLE_MIN;
+		return false;
+	}
+	wait = (frame - busy) / slots;
+	if(wait > 0xFFFF)
+	{
+		_offSettle = 0xFFFF;
+		return false;
+	}
+	_offSettle = (_UWORD)wait;
+	return true;
+}
+
+/**
+ * 光センサ値が揃った時刻を取得する
+ * @param void
+ * @retval _UDWORD: Timer_GetTimeUS()で測った時刻 [usec]
+ */
+_UDWORD LightSensor_GetStamp(void)
 {
-	_LS.Now.FwdL = LightSensor_GetADValueSingle(LS_FWD_L);
-	_LS.Now.Left = LightSensor_GetADValueSingle(LS_LEFT);
-	_LS.Now.Right = LightSensor_GetADValueSingle(LS_RIGHT);
-	_LS.Now.FwdR = LightSensor_GetADValueSingle(LS_FWD_R);
+	return _stamp;
+}
+
+/**
+ * 光センサの各値を更新する
+ *   制御割り込みから1制御周期に1回だけ呼ぶ
+ * @param void
+ * @retval void
+ */
+void LightSensor_Update(void)
+{
+	LightSensor_CalcNow((LSChannel*)&_LS.Now);
 
 	_LS.Dif.FwdL = _LS.Now.FwdL - _LS.Base.FwdL;
 	_LS.Dif.Left = _LS.Now.Left - _LS.Base.Left;
 	_LS.Dif.Right = _LS.Now.Right - _LS.Base.Right;
 	_LS.Dif.FwdR = _LS.Now.FwdR - _LS.Base.FwdR;
 
-	return &_LS;
+#if LS_DISTANCE
+	_LS.Dist.FwdL = LightSensor_ToDist(LS_FWD_L, _LS.Now.FwdL);
+	_LS.Dist.Left = LightSensor_ToDist(LS_LEFT, _LS.Now.Left);
+	_LS.Dist.Right = LightSensor_ToDist(LS_RIGHT, _LS.Now.Right);
+	_LS.Dist.FwdR = LightSensor_ToDist(LS_FWD_R, _LS.Now.FwdR);
+#endif
+}
+
+/**
+ * 光センサの各値を取得する
+ *   値はLightSensor_Update()で更新されるので,制御割り込みの中でだけ使うこと
+ *   (メインからはMouseController_GetSensorFrame()を使う)
+ * @param void
+ * @retval LSVal*: 光センサ値格納構造体へのポインタ
+ */
+LSVal* LightSensor_GetValue(void)
+{
+	return (LSVal*)&_LS;
 }
 
 /**
@@ -193,32 +325,144 @@ void LightSensor_ValueCheckMode(bool scion)
 	}
 	while(!GetSwitchState())
 	{
+		LSChannel now;		// _LSは制御割り込みが書き換えるので手元で求める
+
 		ledPatter = 0;
-		LightSensor_GetValue();
+		LightSensor_CalcNow(&now);
 
 		if(scion)
 		{
 			//AD128160_Locate(3, 0);
-			Printf("%5d, ", _LS.Now.FwdL);
-			Printf("%5d, ", _LS.Now.Left);
-			Printf("%5d, ", _LS.Now.Right);
-			Printf("%5d, ", _LS.Now.FwdR);
-			Printf("%5d, ", _LS.Dif.FwdL);
-			Printf("%5d, ", _LS.Dif.Left);
-			Printf("%5d, ", _LS.Dif.Right);
-			Printf("%5d\n", _LS.Dif.FwdR);
+			Printf("%5d, ", now.FwdL);
+			Printf("%5d, ", now.Left);
+			Printf("%5d, ", now.Right);
+			Printf("%5d, ", now.FwdR);
+			Printf("%5d, ", now.FwdL - _LS.Base.FwdL);
+			Printf("%5d, ", now.Left - _LS.Base.Left);
+			Printf("%5d, ", now.Right - _LS.Base.Right);
+			Printf("%5d\n", now.FwdR - _LS.Base.FwdR);
 		}
 
-		if(_LS.Now.FwdL >= WALL_BASE_FWD_L)		ledPatter |= 0x08;
-		if(_LS.Now.Left >= WALL_BASE_LEFT)		ledPatter |= 0x04;
-		if(_LS.Now.Right >= WALL_BASE_RIGHT)	ledPatter |= 0x02;
-		if(_LS.Now.FwdR >= WALL_BASE_FWD_R)		ledPatter |= 0x01;
+		if(now.FwdL >= _wallBase[LS_FWD_L])		ledPatter |= 0x08;
+		if(now.Left >= _wallBase[LS_LEFT])		ledPatter |= 0x04;
+		if(now.Right >= _wallBase[LS_RIGHT])	ledPatter |= 0x02;
+		if(now.FwdR >= _wallBase[LS_FWD_R])		ledPatter |= 0x01;
 
 		DispLED(ledPatter);
 		WaitMS(50);
 	}
 }
 
+/**
+ * A/D値を壁までの距離に直す
+ *   変換表を二分探索して隣り合う2点の間を線形補間する(制御割り込みから呼んでよい)
+ * @param ch: センサチャンネル
+ * @param ad: A/D値(現在値Now)
+ * @retval _SWORD: 壁までの距離 [1/LS_DIST_SCALE mm] (表の範囲外は表の端の距離)
+ */
+_SWORD LightSensor_ToDist(E_LS_CHANNEL ch, _SWORD ad)
+{
+	const _SWORD* t = _distTable[ch];
+	_UBYTE lo = 0, hi = LS_DIST_POINTS - 1, mid;
+
+	if(ad >= t[lo])
+	{
+		return LS_MM(LS_DIST_MIN_MM);
+	}
+	if(ad <= t[hi])
+	{
+		return LS_MM(LS_DIST_MAX_MM);
+	}
+
+	// t[lo] > ad >= t[hi] となる隣り合う2点を探す
+	while((hi - lo) > 1)
+	{
+		mid = (lo + hi) >> 1;
+		if(t[mid] > ad)
+		{
+			lo = mid;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return LS_MM(LS_DIST_MIN_MM) + lo * LS_MM(LS_DIST_STEP_MM)
+		+ (_SWORD)((_SDWORD)LS_MM(LS_DIST_STEP_MM) * (t[lo] - ad) / (t[lo] - t[hi]));
+}
+
+/**
+ * 距離変換表を設定する
+ *   制御割り込みが表を読んでいるので,走行中には呼ばないこと
+ * @param ch: センサチャンネル
+ * @param ad: 距離LS_DIST_MIN_MMからLS_DIST_STEP_MMごとのA/D値(LS_DIST_POINTS個)
+ * @retval void
+ */
+void LightSensor_SetDistTable(E_LS_CHANNEL ch, const _SWORD* ad)
+{
+	_UBYTE i;
+
+	for(i = 0; i < LS_DIST_POINTS; i++)
+	{
+		_distTable[ch][i] = ad[i];
+	}
+}
+
+/**
+ * 距離変換表を取得する
+ * @param ch: センサチャンネル
+ * @retval const _SWORD*: 距離LS_DIST_MIN_MMからLS_DIST_STEP_MMごとのA/D値(LS_DIST_POINTS個)
+ */
+const _SWORD* LightSensor_GetDistTable(E_LS_CHANNEL ch)
+{
+	return _distTable[ch];
+}
+
+/**
+ * 壁判断基準値を設定する
+ *   較正前の仮の距離変換表も作り直すので,保存した距離変換表を読み込む前に呼ぶこと
+ * @param base: 壁判断基準値(E_LS_CHANNEL順に4つ)
+ * @retval void
+ */
+void LightSensor_SetWallBase(const _SWORD* base)
+{
+	_UBYTE ch;
+
+	for(ch = 0; ch < 4; ch++)
+	{
+		_wallBase[ch] = base[ch];
+	}
+	LightSensor_InitDistTable();
+}
+
+/**
+ * 壁判断基準値を取得する
+ * @param void
+ * @retval const _SWORD*: 壁判断基準値(E_LS_CHANNEL順に4つ)
+ */
+const _SWORD* LightSensor_GetWallBase(void)
+{
+	return _wallBase;
+}
+
+/**
+ * 距離変換表を出力する(CSV)
+ * @param void
+ * @retval void
+ */
+void LightSensor_PrintDistTable(void)
+{
+	_UBYTE i;
+
+	Printf("mm,FwdL,Left,Right,FwdR\n");
+	for(i = 0; i < LS_DIST_POINTS; i++)
+	{
+		Printf("%d,%d,%d,%d,%d\n", LS_DIST_MIN_MM + i * LS_DIST_STEP_MM,
+				_distTable[LS_FWD_L][i], _distTable[LS_LEFT][i], _distTable[LS_RIGHT][i], _distTable[LS_FWD_R][i]);
+		WaitMS(10);
+	}
+}
+
 /**
  * LiPOバッテリーAD値取得
  * @param void
@@ -226,8 +470,12 @@ void LightSensor_ValueCheckMode(bool scion)
  */
 float Battery_GetValue(void)
 {
+#if LS_GROUP_SCAN
+	_UWORD ad = (_scanOff[LS_BATTERY_AD_CH] >> 2) / ADC_SAMPLING_NUM;
+#else
 	_UWORD ad = (_batteryAdVal >> 2) / ADC_SAMPLING_NUM;
-	Printf("ad:%d\n", ad);
+#endif
+//	Printf("ad:%d\n", ad);
 	return (float)ad * 2.0 * 3.0 / 4096;
 }
 
@@ -294,7 +542,9 @@ static void LightSensor_InitializeADC(void)
 	S12AD.ADCSR.BIT.ADIE = 1;	// スキャン終了後の割り込み許可
 	S12AD.ADCSR.BIT.ADCS = 0;	// モード選択(0:シングル，1:連続)
 	S12AD.ADADC.BIT.ADC = ADC_SAMPLING_NUM-1;	// A/D変換値加算回数
-	S12AD.ADADS0.BIT.ADS0 = 0x0001;	// AN000をA/D変換値加算に設定
+#if LS_GROUP_SCAN
+	S12AD.ADADS0.BIT.ADS0 = LS_ADANS_OFF;	// スキャンする全チャンネルをA/D変換値加算に設定
+#endif
 //	S12AD.ADCER.BIT.ADRFMT = 0;	// ADDRレジスタのフォーマット:右づめ(変換値加算の場合左詰め)
 
 	// A/D変換開始トリガの選択
@@ -306,8 +556,10 @@ static void LightSensor_InitializeADC(void)
 	// 割り込み要求を許可
 	IEN(S12AD, S12ADI0) = 1;
 
-	// A/Dチャネル設定
-	S12AD.ADANS0.WORD = 0x0001;	// AN000を変換対象とする
+	// A/Dチャネル設定(LS_GROUP_SCANでなければLightSensor_SelectSlot()で設定する)
+#if LS_GROUP_SCAN
+	S12AD.ADANS0.WORD = LS_ADANS_OFF;	// 最初は消灯スキャン
+#endif
 }
 
 /* DMACの初期化
@@ -323,12 +575,21 @@ static void LightSensor_InitializeDMAC(void)
 
 	DTC.DTCCR.BIT.RRS = 0;				// 転送情報リードスキップに対するフラグをリセット
 	ICU.DMRSR0 = VECT_S12AD_S12ADI0;	// DMA起動要因:S12AD0 ADI0
+#if LS_GROUP_SCAN
+	DMAC0.DMAMD.WORD = 0x8080;			// 転送先・転送元アドレスインクリメント
+	DMAC0.DMTMD.WORD = 0x9101;			// ブロック転送(転送元がブロック領域),16ビット転送,周辺モジュール割り込みトリガ
+	DMAC0.DMSAR = (void*)&S12AD.ADDR0;	// 転送元アドレス設定
+	DMAC0.DMDAR = (void*)_scanOff;		// 転送先アドレス設定
+	DMAC0.DMCSL.BIT.DISEL = 0;			// 転送開始時に起動要因の割り込みフラグをクリア
+	DMAC0.DMCRA = LS_DMA_BLOCK;			// ブロックサイズ
+	DMAC0.DMCRB = 1;					// ブロック転送回数:1
+#else
 	DMAC0.DMAMD.WORD = 0x0000;			// 転送先・転送元アドレス固定
 	DMAC0.DMTMD.WORD = 0x2101;			// ノーマル転送,16ビット転送,周辺モジュール割り込みトリガ
-	DMAC0.DMSAR = (void*)&S12AD.ADDR0;	// 転送元アドレス設定
-	DMAC0.DMDAR = (void*)&(_ledOffAdVal)[0];	// 転送先アドレス設定
+	// 転送元,転送先アドレスはLightSensor_SelectSlot()で設定
 	DMAC0.DMCSL.BIT.DISEL = 0;			// 転送開始時に起動要因の割り込みフラグをクリア
 	DMAC0.DMCRA = 1;					// 転送回数:1
+#endif
 
 	// 割り込み設定
 	DMAC0.DMINT.BIT.DTIE = 1;			// 転送終了割り込みを許可
@@ -365,7 +626,7 @@ static void LightSensor_InitializeMTU3(void)
 	MTU3.TMDR.BIT.MD = 0;		// ノーマルモード
 
 	// TGRyの設定
-	MTU3.TGRA = GET_INTERVAL;
+	MTU3.TGRA = _offSettle;
 
 	// 割り込み許可設定
 	MTU3.TIER.BIT.TTGE = 1;		// A/D変換開始要求の発生を許可
@@ -400,12 +661,122 @@ static void LightSensor_SetLedState(_UBYTE ch, E_IR_LED_STATE state)
 	}
 }
 
+#if LS_GROUP_SCAN
+/** 全赤外LEDの発光状態の設定
+ * @param state: 設定する状態
+ * @retval void
+ */
+static void LightSensor_SetAllLedState(E_IR_LED_STATE state)
+{
+	for(_UBYTE ch = 0; ch < 4; ch++)
+	{
+		LightSensor_SetLedState(ch, state);
+	}
+}
+#else
+/** スケジュール表に従ってA/D変換を1ステップ進める
+ *   消灯時A/D変換が終わったらLEDを点灯させて点灯時A/D変換を待ち,
+ *   点灯時A/D変換が終わったらLEDを消灯させて次のスロットの消灯時A/D変換を待つ
+ * @param void
+ * @retval bool: true: スケジュール表を1巡し終わった
+ */
+static bool LightSensor_NextStep(void)
+{
+	_UBYTE ch = _schedule[_tp];
+
+	if(!_ledOn && (ch != LS_SLOT_BATTERY))
+	{
+		LightSensor_SetLedState(ch, IR_LED_ON);			// IRLED点灯
+		DMAC0.DMDAR = (void*)&(_ledOnAdVal[ch]);		// DMAC転送先アドレス設定
+		MTU3.TGRA = _chConfig[ch].Settle;				// LEDを発光させて少ししてからA/D変換を開始させる
+		_ledOn = true;
+		return false;
+	}
+
+	LightSensor_SetLedState(ch, IR_LED_OFF);			// IRLED消灯(電池なら何もしない)
+	_ledOn = false;
+
+	// タスクポインタを進める
+	_tp++;
+	if(_tp >= LS_SCHEDULE_NUM)
+	{
+		_tp = 0;
+		_stamp = Timer_GetTimeUS();						// ここで全センサのA/D値が揃う
+	}
+	LightSensor_SelectSlot(_tp);
+	MTU3.TGRA = _offSettle;								// 残光が消えてから消灯時A/D変換を開始させる
+
+	return (_tp == 0);
+}
+
+/** スケジュール表のスロットの消灯時A/D変換を準備する
+ * @param slot: スケジュール表の位置
+ * @retval void
+ */
+static void LightSensor_SelectSlot(_UBYTE slot)
+{
+	_UBYTE ch = _schedule[slot];
+	_UWORD ans = (_UWORD)1 << _chConfig[ch].AdCh;
+
+	S12AD.ADANS0.WORD = ans;							// 変換対象のチャンネル
+	S12AD.ADADS0.BIT.ADS0 = ans;						// A/D変換値加算に設定
+	DMAC0.DMSAR = (void*)(&S12AD.ADDR0 + _chConfig[ch].AdCh);	// DMAC転送元アドレス設定(ADDRnは連続している)
+	if(ch == LS_SLOT_BATTERY)
+	{
+		DMAC0.DMDAR = (void*)&_batteryAdVal;			// DMAC転送先アドレス設定
+	}
+	else
+	{
+		DMAC0.DMDAR = (void*)&(_ledOffAdVal[ch]);		// DMAC転送先アドレス設定
+	}
+}
+#endif
+
 /** 単チャンネルAD値取得
  * @param ch: 取得するチャンネル
  * @retval _SWORD: AD値
  */
 static _SWORD LightSensor_GetADValueSingle(E_LS_CHANNEL ch)
 {
+#if LS_GROUP_SCAN
+	return ((_SWORD)(_scanOn[_adIndex[ch]] >> 2) - (_scanOff[_adIndex[ch]] >> 2)) / ADC_SAMPLING_NUM;
+#else
 //	return (_SWORD)(_ledOnAdVal[ch]) - _ledOffAdVal[ch];
 	return ((_SWORD)(_ledOnAdVal[ch] >> 2) - (_ledOffAdVal[ch] >> 2)) / ADC_SAMPLING_NUM;
+#endif
+}
+
+/** 較正するまでの仮の距離変換表を作る
+ *   反射光は距離の2乗に反比例するとして,壁判断距離で壁判断基準値になるようにする
+ *   (LS_DISTANCEにしても較正前は今までと同じところで壁を判断する)
+ * @param void
+ * @retval void
+ */
+static void LightSensor_InitDistTable(void)
+{
+	static const _SWORD wallDist[4] = {WALL_DIST_FWD, WALL_DIST_SIDE, WALL_DIST_SIDE, WALL_DIST_FWD};
+	_UBYTE ch, i;
+
+	for(ch = 0; ch < 4; ch++)
+	{
+		for(i = 0; i < LS_DIST_POINTS; i++)
+		{
+			float r = (float)wallDist[ch] / (LS_DIST_MIN_MM + i * LS_DIST_STEP_MM);
+			float ad = _wallBase[ch] * r * r;
+
+			_distTable[ch][i] = (ad > 4095) ? 4095 : (_SWORD)ad;
+		}
+	}
+}
+
+/** 4センサ分の現在値を求める
+ * @param now: 現在値の格納先
+ * @retval void
+ */
+static void LightSensor_CalcNow(LSChannel* now)
+{
+	now->FwdL = LightSensor_GetADValueSingle(LS_FWD_L);
+	now->Left = LightSensor_GetADValueSingle(LS_LEFT);
+	now->Right = LightSensor_GetADValueSingle(LS_RIGHT);
+	now->FwdR = LightSensor_GetADValueSingle(LS_FWD_R);
 }
@@ -22,19 +22,86 @@
 // 赤外LEDを発光させてからフォトトランジスタ電圧のA/D変換を開始するまでの遅れ時間
 //   600: 50[usec]
 #define PT_DELAY		600
-// 一つのセンサに対するA/D値を取得してから次のA/D値を取得するまでの間隔
-//   2400: 200[usec]
-#define GET_INTERVAL	2400
+// LEDを消灯してから次の消灯時A/D変換を開始するまでの最短の待ち(フォトトラの残光が消えるまで)
+//   1200: 100[usec]
+#define LS_OFF_SETTLE_MIN	1200
 
 // 一つのA/Dチャンネルに対し指定した回数分A/D変換を行い,その加算値をA/D値として得る(1~4で指定)
 #define ADC_SAMPLING_NUM	4
 
-// 壁判断基準値
+// ==== A/D変換の方式 ====
+// 0: 1チャンネルずつLEDを点灯させて変換する(LightSensor.cのスケジュール表の順に巡回する)
+// 1: 全LED消灯で4センサ+電池を,全LED点灯で4センサを1回ずつスキャンし,
+//    スキャン結果(ADDR0〜ADDR12)をDMAのブロック転送で取り込む(1巡でDMAC0割り込み2回)
+//    全LEDを同時に点灯するので他のLEDの反射光も受ける.壁判断基準値は取り直すこと
+#ifndef LS_GROUP_SCAN
+#define LS_GROUP_SCAN		0
+#endif
+#define LS_SCAN_WORDS		13			// ブロック転送するA/Dデータレジスタの数(ADDR0〜ADDR12)
+#define LS_DMA_BLOCK		(((_UDWORD)LS_SCAN_WORDS << 16) | LS_SCAN_WORDS)	// DMCRA(リロード値,ブロックサイズ)
+#define LS_ADANS_ON			0x0047		// 点灯スキャン: AN000,AN001,AN002,AN006
+#define LS_ADANS_OFF		0x1047		// 消灯スキャン: 上記+AN012(電池)
+#define LS_BATTERY_AD_CH	12
+// 1回のスキャンにかかる時間(加算4回*5チャンネル,約21[usec])
+//   300: 25[usec]
+#define LS_CONV_COUNT		300
+// 1チャンネル分のA/D変換にかかる時間
+//   60: 5[usec]
+#define LS_CONV_COUNT_CH	(LS_CONV_COUNT / 5)
+
+// ==== 1巡(4センサ+電池)の目標周期 ====
+// 消灯時A/D変換前の待ちをこの周期に収まるように決める(LightSensor_SetFrameRate()で変更可)
+// LED点灯の待ちとA/D変換だけで周期を超える場合は待ちをLS_OFF_SETTLE_MINにし,周期は目標より延びる
+#if LS_GROUP_SCAN
+#define LS_FRAME_RATE		3000		// [Hz]
+#else
+#define LS_FRAME_RATE		900			// [Hz] (左右センサは2回ずつ取るので1800[Hz])
+#endif
+#define LS_FRAME_COUNT(hz)	(12000000UL / (hz))	// 周期のMTU3(PCLK/4)カウント数
+
+// 外部起動したときに1巡(4センサ+電池)にかかる時間
+#if LS_GROUP_SCAN
+//   起動からPT_DELAY後に消灯スキャン,PT_DELAY後に点灯スキャン
+//   1800: 150[usec]
+#define LS_SCAN_COUNT	(2 * (PT_DELAY + LS_CONV_COUNT))
+#else
+//   スケジュール表を1巡する時間.目標周期に収まっていればそれ以下になる
+#define LS_SCAN_COUNT	LS_FRAME_COUNT(LS_FRAME_RATE)
+#endif
+
+// 壁判断基準値(初期値.実行中の値はLightSensor_GetWallBase()で,不揮発パラメータから変えられる)
 #define WALL_BASE_FWD_L		2200
 #define WALL_BASE_LEFT		2800
 #define WALL_BASE_RIGHT		2800
 #define WALL_BASE_FWD_R		2200
 
+// ==== 距離への変換 ====
+// 0: 壁の判断,横壁制御をA/D値(現在値と基準値の差)で行う
+// 1: センサごとの変換表でA/D値を壁までの距離に直し,距離で行う
+//    変換表は較正モード(MouseController_CalibrateSensor)で作る.較正前は壁判断基準値から作った仮の表
+#ifndef LS_DISTANCE
+#define LS_DISTANCE			0
+#endif
+// 変換表: 壁までの距離を一定間隔に区切った点ごとのA/D値(現在値Now).間は線形補間する
+#define LS_DIST_POINTS		32		// 表の点数
+#define LS_DIST_MIN_MM		10		// 表の先頭の距離 [mm]
+#define LS_DIST_STEP_MM		5		// 表の点の間隔 [mm]
+#define LS_DIST_MAX_MM		(LS_DIST_MIN_MM + LS_DIST_STEP_MM * (LS_DIST_POINTS - 1))	// 表の末尾の距離 [mm]
+#define LS_DIST_SCALE		10		// 距離の値1あたりの長さ 1/LS_DIST_SCALE[mm]
+#define LS_MM(mm)			((_SWORD)((mm) * LS_DIST_SCALE))	// [mm]から距離の値へ
+
+// ---- 機体の寸法(機体に合わせて測ること) ----
+#define LS_DIST_FWD_CONTACT	12		// 機体前端を前壁につけたときの前センサから前壁までの距離 [mm]
+#define LS_DIST_SIDE_CENTER	45		// 区画の中央にいるときの横センサから横壁までの距離 [mm]
+
+// 壁判断距離(これより近ければ壁あり) [mm]
+#define WALL_DIST_FWD		110
+#define WALL_DIST_SIDE		70
+
+#if (LS_DIST_SIDE_CENTER - LS_DIST_MIN_MM) % LS_DIST_STEP_MM
+#error "LS_DIST_SIDE_CENTER must be on the distance table grid"
+#endif
+
 /*----------------------------------------------------------------------
 	Enum Definitions
  ----------------------------------------------------------------------*/
@@ -64,6 +131,7 @@ typedef struct stLightSensorVal{
 	LSChannel Old;				// 過去値
 	LSChannel Dif;				// 現在値と基準値の差
 	LSChannel Delta;			// 現在値と過去値の差
+	LSChannel Dist;				// 壁までの距離(LS_DISTANCEのとき) [1/LS_DIST_SCALE mm]
 }LSVal;
 
 /*----------------------------------------------------------------------
@@ -82,9 +150,19 @@ typedef enum eIrLedState
 void LightSensor_Initialize(void);
 #pragma inline(LightSensor_IntDMAC0)
 void LightSensor_IntDMAC0(void);
+void LightSensor_TriggerScan(void);
+bool LightSensor_SetFrameRate(_UWORD hz);
+_UDWORD LightSensor_GetStamp(void);
+void LightSensor_Update(void);
 LSVal* LightSensor_GetValue(void);
 void LightSensor_GetBaseLR(void);
 void LightSensor_ValueCheckMode(bool scion);
+_SWORD LightSensor_ToDist(E_LS_CHANNEL ch, _SWORD ad);
+void LightSensor_SetDistTable(E_LS_CHANNEL ch, const _SWORD* ad);
+const _SWORD* LightSensor_GetDistTable(E_LS_CHANNEL ch);
+void LightSensor_SetWallBase(const _SWORD* base);
+const _SWORD* LightSensor_GetWallBase(void);
+void LightSensor_PrintDistTable(void);
 float Battery_GetValue(void);
 
 #endif
@@ -7,18 +7,35 @@
 	Includes
  ----------------------------------------------------------------------*/
 #include "MPU6500.h"
+#include <stdbool.h>
+#include <stddef.h>
 #include "../iodefine.h"
 #include "../Global.h"
 #include "../Peripherals/RSPI.h"
+#include "../Peripherals/Timer.h"
 
 /*----------------------------------------------------------------------
 	Private global variables
  ----------------------------------------------------------------------*/
 static RSPI_DEPENDENCE dep;		// RSPIペリフェラル依存パラメータ
+static RSPI_DEPENDENCE cycledep;	// RSPIペリフェラル依存パラメータ(CycleOperation専用)
 static _UBYTE recv[4] = {0};	// SPI送信データ格納用
 static _UBYTE send[4] = {0};	// SPI送信データ格納用
-static _UBYTE cyclesend[4] = {0};	// SPI送信データ格納用(CycleOperation専用)
-static _UBYTE angvel[3] = {0};	// 角速度情報格納用
+static _UBYTE cyclesend[MPU_BURST_LEN + 1] = {0};	// SPI送信データ格納用(CycleOperation専用)
+static _UBYTE cyclerecv[MPU_BURST_LEN + 1] = {0};	// 6軸,温度情報格納用(先頭はダミー)
+static RSPI_CYCLE_DESC cycle;		// CycleOperationでの転送
+
+// 読み出した値の二重バッファ(書き込み中でない方を読む)
+static ImuSample _sample[2];
+static volatile _UBYTE _sampleFront = 0;	// 読み出し側が使うバッファ
+
+// ジャイロZ軸のバイアス(温度tempRefのときbiasRef, 温度係数slope)
+static float _biasRef = 0;			// [LSB]
+static float _tempRef = 0;			// [℃]
+static float _slope = 0;			// [LSB/℃]
+static float _slopeBias = 0;		// 温度係数を求めた時点のバイアス [LSB]
+static float _slopeTemp = 0;		// 温度係数を求めた時点の温度 [℃]
+static volatile bool _calibrated = false;
 
 /*----------------------------------------------------------------------
 	Private Method Declarations
@@ -30,7 +47,10 @@ static void MPU6500_Select(void);
 static void MPU6500_Deselect(void);
 static void MPU6500_RSPI_Write(_UBYTE registerAddress, _UBYTE data);
 static _UBYTE MPU6500_RSPI_Read(_UBYTE registerAddress);
-static void MPU6500_CycleSendCommand(void);
+static void MPU6500_CycleTransferEnd(void);
+static _SWORD MPU6500_GetRawAngVel(void);
+static _SWORD MPU6500_ToWord(_UBYTE high, _UBYTE low);
+static float MPU6500_GetBias(float temp);
 
 /*----------------------------------------------------------------------
 	Public Method Definitions
@@ -48,13 +68,112 @@ void MPU6500_Initialize(void)
 }
 
 /** ジャイロの角速度情報(ヨージャイロ)を取得する
+ *   温度に合わせたバイアスを差し引いた値を返す
  * @param void
  * @retval _SWORD: ヨージャイロ
  */
 _SWORD MPU6500_GetAngVel(void)
 {
-	_UWORD angv = (((_UWORD)angvel[1] << 8) & 0xFF00) | ((_UWORD)angvel[2] & 0x00FF);
-	return (_SWORD)angv;
+	float angv = (float)MPU6500_GetRawAngVel() - MPU6500_GetBias(MPU6500_GetTemp());
+
+	return (_SWORD)((angv >= 0) ? angv + 0.5f : angv - 0.5f);
+}
+
+/** 温度を取得する
+ * @param void
+ * @retval float: 温度 [℃]
+ */
+float MPU6500_GetTemp(void)
+{
+	return (float)_sample[_sampleFront].Temp * (1.0f / MPU_TEMP_LSB_PER_DEG) + MPU_TEMP_OFFSET;
+}
+
+/** 最新の6軸,温度をまとめて取得する
+ *   同じ読み出しで得た値の組が返る
+ * @param sample: 格納先
+ * @retval void
+ */
+void MPU6500_GetSample(ImuSample* sample)
+{
+	*sample = _sample[_sampleFront];
+}
+
+/** 静止状態でジャイロのバイアスを求める
+ *   CycleOperationでの読み出しが動いている状態で呼ぶこと
+ *   新しいサンプルが届かなければ較正せずに戻る(バイアスの追従もしない)
+ * @param void
+ * @retval bool: true: 較正できた, false: サンプルが届かなかった
+ */
+bool MPU6500_Calibrate(void)
+{
+	float sumAngv = 0, sumTemp = 0;
+	ImuSample s;
+	_UDWORD stamp, start;
+	_UWORD i;
+
+	_calibrated = false;
+	MPU6500_GetSample(&s);
+	for(i = 0; i < GYRO_CALIB_NUM; i++)
+	{
+		// 前と違う読み出しの値を使う
+		stamp = s.Stamp;
+		start = Timer_GetTimeUS();
+		do
+		{
+			if(Timer_GetTimeUS() - start > GYRO_CALIB_TIMEOUT_US)
+			{
+				return false;
+			}
+			Yield();
+			MPU6500_GetSample(&s);
+		}while(s.Stamp == stamp);
+
+		sumAngv += (float)s.GyroZ;
+		sumTemp += (float)s.Temp * (1.0f / MPU_TEMP_LSB_PER_DEG) + MPU_TEMP_OFFSET;
+	}
+
+	_biasRef = sumAngv / GYRO_CALIB_NUM;
+	_tempRef = sumTemp / GYRO_CALIB_NUM;
+	_slopeBias = _biasRef;
+	_slopeTemp = _tempRef;
+	_calibrated = true;
+	return true;
+}
+
+/** 停止中のバイアス追従(停止中の制御割り込みから呼ぶ)
+ *   今の温度でのバイアスに少しずつ寄せ,温度が十分変わったら温度係数も求め直す
+ * @param void
+ * @retval void
+ */
+void MPU6500_TrackBias(void)
+{
+	float temp, bias, raw;
+
+	if(!_calibrated)
+	{
+		return;
+	}
+
+	temp = MPU6500_GetTemp();
+	bias = MPU6500_GetBias(temp);
+	raw = (float)MPU6500_GetRawAngVel();
+
+	// 手で持ち上げたなど,回っていそうなときは追従しない
+	if((raw - bias > GYRO_BIAS_TRACK_LIMIT) || (raw - bias < -GYRO_BIAS_TRACK_LIMIT))
+	{
+		return;
+	}
+
+	bias += (raw - bias) * GYRO_BIAS_TRACK_K;
+	_biasRef = bias;
+	_tempRef = temp;
+
+	if((temp - _slopeTemp >= GYRO_SLOPE_MIN_DT) || (temp - _slopeTemp <= -GYRO_SLOPE_MIN_DT))
+	{
+		_slope += ((bias - _slopeBias) / (temp - _slopeTemp) - _slope) * GYRO_SLOPE_K;
+		_slopeBias = bias;
+		_slopeTemp = temp;
+	}
 }
 
 void MPU6500_LogMode(void)
@@ -63,7 +182,7 @@ void MPU6500_LogMode(void)
 	//AD128160_Locate(4, 0);
 	while(!GetSwitchState())
 	{
-		Printf("AngVel:%6d\n", MPU6500_GetAngVel());
+		Printf("AngVel:%6d, Temp:%f, Bias:%f\n", MPU6500_GetAngVel(), MPU6500_GetTemp(), MPU6500_GetBias(MPU6500_GetTemp()));
 		DispLED((_UBYTE)(MPU6500_GetAngVel()/256));
 		WaitMS(100);
 	}
@@ -90,23 +209,26 @@ static void InitializeGyro(void)
 	// センサリセット
 	MPU6500_RSPI_Write(MPUREG_SIGNAL_PATH_REST, BIT_GYRO_RST | BIT_ACCEL_RST | BIT_TEMP_RST);
 	WaitMS(100);
-	// Sample rate divider
-	MPU6500_RSPI_Write(MPUREG_SMPLRT_DIV, 0x01);
+	// Sample rate divider(1kHz)
+	MPU6500_RSPI_Write(MPUREG_SMPLRT_DIV, 0x00);
 	WaitMS(10);
 	// Low pass filter settings
-	MPU6500_RSPI_Write(MPUREG_CONFIG, BITS_DLPF_CFG_5HZ);
+	// (バイアスはソフトウェアで差し引くので,位相遅れの小さい帯域にする)
+	MPU6500_RSPI_Write(MPUREG_CONFIG, BITS_DLPF_CFG_98HZ);
 	WaitMS(10);
 	// Set full scale range for Gyros
 	MPU6500_RSPI_Write(MPUREG_GYRO_CONFIG, BITS_FS_2000DPS);
 	WaitMS(10);
+	// Set full scale range for Accels(壁への衝突を検出できる幅)
+	MPU6500_RSPI_Write(MPUREG_ACCEL_CONFIG, BITS_FS_8G);
+	WaitMS(10);
 	// 割り込み無効
 	MPU6500_RSPI_Write(MPUREG_INT_ENABLE, 0x00);
 	WaitMS(10);
 
 	// CycleOperation用コマンドの設定
-	cyclesend[0] = MPUREG_GYRO_ZOUT_H | MPU_READ_FLAG;
-	cyclesend[1] = 0x00;
-	cyclesend[2] = 0x00;
+	// (ACCEL_XOUT_HからGYRO_ZOUT_Lまでの14バイトを1回のチップセレクトで読む)
+	cyclesend[0] = MPUREG_ACCEL_XOUT_H | MPU_READ_FLAG;
 }
 
 /** RSPI0の初期化
@@ -138,8 +260,16 @@ static void MPU6500_InitializeRSPI0(void)
 	dep.format = RSPI_BYTE_DATA;
 	dep.ChipSelectFunc = MPU6500_Select;
 	dep.ChipDeselectFunc = MPU6500_Deselect;
+	dep.TransferEndFunc = NULL;
+
+	cycledep = dep;
+	cycledep.TransferEndFunc = MPU6500_CycleTransferEnd;
 
-	RSPI0_RegisterDeviceForCycleOperation(MPU6500_CycleSendCommand);
+	cycle.dep = &cycledep;
+	cycle.psrc = cyclesend;
+	cycle.pdest = cyclerecv;
+	cycle.length = MPU_BURST_LEN + 1;
+	RSPI0_RegisterDeviceForCycleOperation(&cycle);
 }
 
 /** MPU6500で使うポートの初期化
@@ -196,15 +326,52 @@ static _UBYTE MPU6500_RSPI_Read(_UBYTE registerAddress)
 	return recv[1];
 }
 
-/** RSPI0 Cycle Operation で送信するコマンド(角速度情報取得)
+/** CycleOperationの読み出し完了(RSPI0のDMA転送終了割り込みから呼ばれる)
+ *   読み出し側が使っていない方のバッファに書き,書き終えてから入れ替える
  * @param void
  * @retval void
  */
-static void MPU6500_CycleSendCommand(void)
+static void MPU6500_CycleTransferEnd(void)
+{
+	_UBYTE back = _sampleFront ^ 1;
+	ImuSample* s = &_sample[back];
+
+	s->AccX = MPU6500_ToWord(cyclerecv[1], cyclerecv[2]);
+	s->AccY = MPU6500_ToWord(cyclerecv[3], cyclerecv[4]);
+	s->AccZ = MPU6500_ToWord(cyclerecv[5], cyclerecv[6]);
+	s->Temp = MPU6500_ToWord(cyclerecv[7], cyclerecv[8]);
+	s->GyroX = MPU6500_ToWord(cyclerecv[9], cyclerecv[10]);
+	s->GyroY = MPU6500_ToWord(cyclerecv[11], cyclerecv[12]);
+	s->GyroZ = MPU6500_ToWord(cyclerecv[13], cyclerecv[14]);
+	s->Stamp = Timer_GetTimeUS();
+
+	_sampleFront = back;
+}
+
+/** 上位,下位バイトから符号付き16bit値を作る
+ * @param high: 上位バイト
+ * @param low: 下位バイト
+ * @retval _SWORD: 値
+ */
+static _SWORD MPU6500_ToWord(_UBYTE high, _UBYTE low)
+{
+	return (_SWORD)((((_UWORD)high << 8) & 0xFF00) | ((_UWORD)low & 0x00FF));
+}
+
+/** バイアスを差し引く前のヨージャイロを取得する
+ * @param void
+ * @retval _SWORD: ヨージャイロ
+ */
+static _SWORD MPU6500_GetRawAngVel(void)
 {
-//	send[0] = MPUREG_GYRO_ZOUT_H | MPU_READ_FLAG;
-//	send[1] = 0x00;
-//	send[2] = 0x00;
+	return _sample[_sampleFront].GyroZ;
+}
 
-	RSPI0_WriteRead(cyclesend, angvel, 3, dep);
+/** 指定した温度でのバイアスを求める
+ * @param temp: 温度 [℃]
+ * @retval float: バイアス [LSB]
+ */
+static float MPU6500_GetBias(float temp)
+{
+	return _biasRef + _slope * (temp - _tempRef);
 }
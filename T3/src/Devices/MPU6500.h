@@ -9,6 +9,7 @@
 	Includes
  ----------------------------------------------------------------------*/
 #include "../typedefine.h"
+#include <stdbool.h>
 
 /*----------------------------------------------------------------------
 	Macro Definitions
@@ -106,11 +107,49 @@
 // SPI読み出しフラグ
 #define MPU_READ_FLAG 0x80
 
+// 加速度センサ
+#define MPU_ACCEL_LSB_PER_G		4096.0	// 感度(±8g) [LSB/g]
+
+// CycleOperationで連続して読むレジスタ(ACCEL_XOUT_HからGYRO_ZOUT_Lまで)
+#define MPU_BURST_LEN			(MPUREG_GYRO_ZOUT_L - MPUREG_ACCEL_XOUT_H + 1)
+
+// 温度センサ
+#define MPU_TEMP_LSB_PER_DEG	333.87	// 感度 [LSB/℃]
+#define MPU_TEMP_OFFSET			21.0	// 出力0のときの温度 [℃]
+
+// ==== ジャイロのバイアス推定 ====
+#define GYRO_CALIB_NUM			1000	// 起動時の平均に使うサンプル数(1[mSec]毎)
+#define GYRO_CALIB_TIMEOUT_US	10000	// 次のサンプルをこれ以上待ったら較正をあきらめる [usec]
+#define GYRO_BIAS_TRACK_K		0.001	// 停止中の1サンプルあたりのバイアス追従率
+#define GYRO_BIAS_TRACK_LIMIT	50.0	// 停止中とみなす残差の上限 [LSB] (約3[deg/s])
+#define GYRO_SLOPE_MIN_DT		1.0		// 温度係数を求め直す温度変化 [℃]
+#define GYRO_SLOPE_K			0.2		// 温度係数の更新率
+
+/*----------------------------------------------------------------------
+	Struct Definitions
+ ----------------------------------------------------------------------*/
+// ==== 1回の読み出しで得た6軸+温度 ====
+typedef struct stImuSample
+{
+	_SWORD AccX;		// 加速度 [LSB]
+	_SWORD AccY;
+	_SWORD AccZ;
+	_SWORD Temp;		// 温度 [LSB]
+	_SWORD GyroX;		// 角速度 [LSB] (バイアスは差し引いていない)
+	_SWORD GyroY;
+	_SWORD GyroZ;
+	_UDWORD Stamp;		// 読み出しを終えた時刻 [usec] (Timer_GetTimeUS)
+}ImuSample;
+
 /*----------------------------------------------------------------------
 	Public Method Declarations
  ----------------------------------------------------------------------*/
 void MPU6500_Initialize(void);
 _SWORD MPU6500_GetAngVel(void);
+void MPU6500_GetSample(ImuSample* sample);
+float MPU6500_GetTemp(void);
+bool MPU6500_Calibrate(void);
+void MPU6500_TrackBias(void);
 void MPU6500_LogMode(void);
 
 #endif
@@ -31,6 +31,7 @@ volatile struct stMouseFlags _MF;
 
 void (*WaitMS)(_UINT msec) = Timer_WaitMS;
 void (*WaitUS)(_UINT usec) = Timer_WaitUS;
+void (*Yield)(void) = Timer_Yield;
 void (*DispLED)(_UBYTE lightPattern) = LED_Disp;
 void (*PlaySound)(_UINT freq) = Speaker_PlaySound;
 bool (*GetSwitchState)(void) = Switch_GetState;
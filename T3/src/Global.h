@@ -77,6 +77,7 @@ extern void (*Printf)(_UBYTE* str, ...);
 extern void (*Scanf)(_UBYTE* str, ...);
 extern void (*WaitMS)(_UINT msec);
 extern void (*WaitUS)(_UINT usec);
+extern void (*Yield)(void);
 extern void (*DispLED)(_UBYTE lightPattern);
 extern void (*PlaySound)(_UINT freq);
 extern bool (*GetSwitchState)(void);
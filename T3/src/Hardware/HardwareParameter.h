@@ -15,6 +15,17 @@
  ----------------------------------------------------------------------*/
 #define HW_WHEEL_DIAM	17		// 車輪径 [mm]
 #define HW_TREAD_WIDTH	38.5	// トレッド幅 [mm]
+#define HW_GEAR_RATIO	4.0		// 減速比(モータ回転数/車輪回転数)
+#define HW_MASS			0.015	// 機体質量 [kg]
+#define HW_GYRO_SIGN	-1.0	// ジャイロZ軸出力を右回り正に直す符号(基板を上向きに実装)
+
+// ==== モータ(暫定値,実測して合わせること) ====
+#define HW_MOTOR_R		3.4		// 巻線抵抗 [ohm]
+#define HW_MOTOR_KT		0.00059	// トルク定数 [Nm/A]
+#define HW_MOTOR_KE		0.00059	// 逆起電力定数 [V/(rad/s)]
+#define HW_MOTOR_TF		0.00002	// 摩擦トルク [Nm]
+
+#define HW_BATTERY_NOMINAL	4.0	// 電池電圧の基準値 [V]
 
 /*----------------------------------------------------------------------
 	Public Method Declarations
@@ -0,0 +1,238 @@
+/**
+ * @file  DataFlash.c
+ * @brief E2データフラッシュ(FCUによる書き込み,消去)
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "DataFlash.h"
+#include <string.h>
+#include "../iodefine.h"
+
+/*----------------------------------------------------------------------
+	Private Macro Definitions
+ ----------------------------------------------------------------------*/
+// ==== FCUコマンド(P/Eモードで対象アドレスに書き込む) ====
+#define FCU_CMD_PROGRAM		0xE8	// プログラム
+#define FCU_CMD_ERASE		0x20	// ブロックイレーズ
+#define FCU_CMD_BLANK		0x71	// ブランクチェック
+#define FCU_CMD_CLEAR		0x50	// ステータスレジスタクリア
+#define FCU_CMD_PCKA		0xE9	// 周辺クロック通知
+#define FCU_CMD_FINAL		0xD0	// 最終コマンド
+
+#define FENTRYR_READ		0xAA00	// リードモード
+#define FENTRYR_PE			0xAA80	// データフラッシュP/Eモード
+
+#define DF_CMD_B(offset)	(*(volatile _UBYTE __evenaccess *)(DF_ADDR + (offset)))
+#define DF_CMD_W(offset)	(*(volatile _UWORD __evenaccess *)(DF_ADDR + (offset)))
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+static bool _busy = false;		// 書き込み,消去を開始して終了を確認していない
+static E_DF_STATUS _result = DF_READY;	// 最後に終了した書き込み,消去の結果
+
+/*----------------------------------------------------------------------
+	Private Method Declarations
+ ----------------------------------------------------------------------*/
+static void DataFlash_EnterPE(void);
+static void DataFlash_ExitPE(void);
+static bool DataFlash_WaitReady(void);
+
+/*----------------------------------------------------------------------
+	Public Method Definitions
+ ----------------------------------------------------------------------*/
+/** データフラッシュの初期化
+ *   FCUファームウェアの転送,全ブロックの読み出し,書き込み許可,周辺クロックの通知を行う
+ * @param void
+ * @retval bool: true: 初期化できた, false: 周辺クロック通知でエラー
+ */
+bool DataFlash_Initialize(void)
+{
+	volatile _UDWORD* src = (volatile _UDWORD*)DF_FCU_FIRM_ADDR;
+	volatile _UDWORD* dst = (volatile _UDWORD*)DF_FCU_RAM_ADDR;
+	_UWORD i;
+	bool ok;
+
+	// FCUファームウェアをFCU RAMへ転送する(リードモードで行う)
+	FLASH.FENTRYR.WORD = FENTRYR_READ;
+	while(FLASH.FENTRYR.WORD != 0x0000)
+	{
+	}
+	FLASH.FCURAME.WORD = 0xC401;		// FCU RAMへの書き込みを許可
+	for(i = 0; i < DF_FCU_FIRM_SIZE / 4; i++)
+	{
+		dst[i] = src[i];
+	}
+
+	// 全ブロック(DB00〜DB15)の読み出し,書き込み/消去を許可
+	FLASH.DFLRE0.WORD = 0x2DFF;
+	FLASH.DFLRE1.WORD = 0x2DFF;
+	FLASH.DFLWE0.WORD = 0x1EFF;
+	FLASH.DFLWE1.WORD = 0x1EFF;
+
+	// 周辺クロック(FCLK)を通知する
+	DataFlash_EnterPE();
+	FLASH.PCKAR.WORD = DF_FCLK_MHZ;
+	DF_CMD_B(0) = FCU_CMD_PCKA;
+	DF_CMD_B(0) = 0x03;
+	DF_CMD_W(0) = 0x0F0F;
+	DF_CMD_W(0) = 0x0F0F;
+	DF_CMD_W(0) = 0x0F0F;
+	DF_CMD_B(0) = FCU_CMD_FINAL;
+	ok = DataFlash_WaitReady();
+	DataFlash_ExitPE();
+
+	_busy = false;
+	_result = DF_READY;
+	return ok;
+}
+
+/** データフラッシュの読み出し
+ *   書き込み,消去中なら終わるまで待つ.消去したままの領域の値は不定
+ * @param offset: 読み出す位置(データフラッシュ先頭から)
+ * @param buf: 格納先
+ * @param len: 読み出すバイト数
+ * @retval void
+ */
+void DataFlash_Read(_UDWORD offset, void* buf, _UWORD len)
+{
+	while(DataFlash_GetStatus() == DF_BUSY)
+	{
+	}
+	memcpy(buf, (const void*)(DF_ADDR + offset), len);
+}
+
+/** 2バイトのブランクチェック(消去したままか)
+ *   終わるまで待つので起動時などに使う
+ * @param offset: 調べる位置(データフラッシュ先頭から,偶数)
+ * @retval bool: true: 消去したまま
+ */
+bool DataFlash_IsBlank(_UDWORD offset)
+{
+	bool blank;
+
+	while(DataFlash_GetStatus() == DF_BUSY)
+	{
+	}
+
+	DataFlash_EnterPE();
+	FLASH.FMODR.BIT.FRDMD = 1;			// ブランクチェックはレジスタリード方式で行う
+	FLASH.DFLBCCNT.BIT.BCSIZE = 0;		// 2バイト
+	FLASH.DFLBCCNT.BIT.BCADR = offset & (DF_BLOCK_SIZE - 1);
+	DF_CMD_B(offset & ~(DF_BLOCK_SIZE - 1)) = FCU_CMD_BLANK;
+	DF_CMD_B(offset & ~(DF_BLOCK_SIZE - 1)) = FCU_CMD_FINAL;
+	blank = DataFlash_WaitReady() && (FLASH.DFLBCSTAT.BIT.BCST == 0);
+	FLASH.FMODR.BIT.FRDMD = 0;
+	DataFlash_ExitPE();
+
+	return blank;
+}
+
+/** 消去の開始(DF_ERASE_SIZEバイト)
+ *   終了はDataFlash_GetStatus()で調べる
+ * @param offset: 消去する位置(データフラッシュ先頭から,DF_ERASE_SIZEの倍数)
+ * @retval void
+ */
+void DataFlash_StartErase(_UDWORD offset)
+{
+	DataFlash_EnterPE();
+	DF_CMD_B(offset) = FCU_CMD_ERASE;
+	DF_CMD_B(offset) = FCU_CMD_FINAL;
+	_result = DF_READY;
+	_busy = true;
+}
+
+/** 書き込みの開始(DF_WRITE_SIZEバイト)
+ *   終了はDataFlash_GetStatus()で調べる
+ * @param offset: 書き込む位置(データフラッシュ先頭から,DF_WRITE_SIZEの倍数,消去したままであること)
+ * @param data: 書き込むデータ(DF_WRITE_SIZEバイト)
+ * @retval void
+ */
+void DataFlash_StartWrite(_UDWORD offset, const _UBYTE* data)
+{
+	_UBYTE i;
+
+	DataFlash_EnterPE();
+	DF_CMD_B(offset) = FCU_CMD_PROGRAM;
+	DF_CMD_B(offset) = DF_WRITE_SIZE / 2;	// ワード数
+	for(i = 0; i < DF_WRITE_SIZE; i += 2)
+	{
+		DF_CMD_W(offset + i) = (_UWORD)(data[i] | (data[i + 1] << 8));	// リトルエンディアン
+	}
+	DF_CMD_B(offset) = FCU_CMD_FINAL;
+	_result = DF_READY;
+	_busy = true;
+}
+
+/** 書き込み,消去の状態を調べる
+ *   終了していればリードモードに戻す.結果は次の開始まで返し続ける
+ * @param void
+ * @retval E_DF_STATUS: 状態
+ */
+E_DF_STATUS DataFlash_GetStatus(void)
+{
+	bool ok;
+
+	if(!_busy)
+	{
+		return _result;
+	}
+	if(FLASH.FSTATR0.BIT.FRDY == 0)
+	{
+		return DF_BUSY;
+	}
+
+	_busy = false;
+	ok = DataFlash_WaitReady();
+	DataFlash_ExitPE();
+	_result = ok ? DF_READY : DF_ERROR;
+	return _result;
+}
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+/** データフラッシュP/Eモードに入る
+ * @param void
+ * @retval void
+ */
+static void DataFlash_EnterPE(void)
+{
+	FLASH.FENTRYR.WORD = FENTRYR_PE;
+	FLASH.FWEPROR.BYTE = 0x01;			// 書き込み/消去を許可
+}
+
+/** リードモードに戻る
+ * @param void
+ * @retval void
+ */
+static void DataFlash_ExitPE(void)
+{
+	FLASH.FENTRYR.WORD = FENTRYR_READ;
+	while(FLASH.FENTRYR.WORD != 0x0000)
+	{
+	}
+}
+
+/** コマンドの終了を待ち,エラーならステータスをクリアする
+ * @param void
+ * @retval bool: true: エラーなし
+ */
+static bool DataFlash_WaitReady(void)
+{
+	while(FLASH.FSTATR0.BIT.FRDY == 0)
+	{
+	}
+	if(FLASH.FSTATR0.BIT.ILGLERR || FLASH.FSTATR0.BIT.ERSERR || FLASH.FSTATR0.BIT.PRGERR)
+	{
+		if(FLASH.FSTATR0.BIT.ILGLERR && (FLASH.FASTAT.BYTE != 0x10))
+		{
+			FLASH.FASTAT.BYTE = 0x10;		// アクセス違反を解除
+		}
+		DF_CMD_B(0) = FCU_CMD_CLEAR;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file  DataFlash.h
+ * @brief E2データフラッシュ(FCUによる書き込み,消去)
+ *
+ * 書き込み,消去は開始するだけで戻り,DataFlash_GetStatus()で終了を調べる.
+ * 書き込み,消去中はデータフラッシュを読めないが,ROMの命令フェッチや割り込みは止まらない.
+ * アドレスはデータフラッシュ先頭からのオフセットで指定する.
+ */
+
+#ifndef __DATAFLASH_H__
+#define __DATAFLASH_H__
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "../typedefine.h"
+#include <stdbool.h>
+
+/*----------------------------------------------------------------------
+	Macro Definitions
+ ----------------------------------------------------------------------*/
+#define DF_ADDR				0x00100000	// データフラッシュの先頭アドレス(読み出し,P/Eとも)
+#define DF_SIZE				0x8000		// 容量(32K[byte])
+#define DF_BLOCK_SIZE		2048		// 読み出し,書き込み許可の単位(DB00〜DB15)
+#define DF_ERASE_SIZE		32			// 消去の単位 [byte]
+#define DF_WRITE_SIZE		8			// 書き込みの単位 [byte]
+#define DF_FCLK_MHZ			48			// FCLK(周辺クロック通知コマンドで通知する) [MHz]
+
+#define DF_FCU_FIRM_ADDR	0xFEFFE000	// FCUファームウェアの格納先(ROM)
+#define DF_FCU_RAM_ADDR		0x007F8000	// FCU RAM
+#define DF_FCU_FIRM_SIZE	0x2000		// FCUファームウェアの大きさ
+
+/*----------------------------------------------------------------------
+	Enum Definitions
+ ----------------------------------------------------------------------*/
+// 書き込み,消去の状態
+typedef enum eDataFlashStatus
+{
+	DF_READY = 0,		// 終了した(または何もしていない)
+	DF_BUSY,			// 実行中
+	DF_ERROR			// 失敗した(エラーはステータスクリアで解除済み)
+}E_DF_STATUS;
+
+/*----------------------------------------------------------------------
+	Public Method Declarations
+ ----------------------------------------------------------------------*/
+bool DataFlash_Initialize(void);
+void DataFlash_Read(_UDWORD offset, void* buf, _UWORD len);
+bool DataFlash_IsBlank(_UDWORD offset);
+void DataFlash_StartErase(_UDWORD offset);
+void DataFlash_StartWrite(_UDWORD offset, const _UBYTE* data);
+E_DF_STATUS DataFlash_GetStatus(void);
+
+#endif /* __DATAFLASH_H__ */
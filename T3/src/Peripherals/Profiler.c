@@ -0,0 +1,162 @@
+/**
+ * @file  Profiler.c
+ * @brief 割り込み処理時間の計測
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "Profiler.h"
+#include <machine.h>
+#include "../Global.h"
+
+/*----------------------------------------------------------------------
+	Struct Definitions
+ ----------------------------------------------------------------------*/
+typedef struct stProfileStat
+{
+	_UDWORD Count;		// 回数
+	_UDWORD Sum;		// 処理時間の合計
+	_UWORD Min;			// 処理時間の最小
+	_UWORD Max;			// 処理時間の最大
+	_UWORD LatencyMax;	// 要求から入口までの遅れの最大
+}ProfileStat;
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+static ProfileStat _stat[PROFILE_NUM];
+
+static const char* const _name[PROFILE_NUM] =
+{
+	"MTU2_TGIA",
+	"MTU2_TGIB",
+	"DMAC0",
+	"DMAC2",
+	"RSPI0_SPRI0",
+	"RSPI0_SPTI0",
+	"SCI1_TXI1",
+	"CMT1",
+	"CMT2",
+};
+
+/*----------------------------------------------------------------------
+	Public Method Definitions
+ ----------------------------------------------------------------------*/
+/**
+ * プロファイラの初期化(CMT3をフリーランで動かす)
+ * @param void
+ * @retval void
+ */
+void Profiler_Initialize(void)
+{
+#if PROFILER_ENABLE
+	MSTP(CMT3) = 0;						// CMTユニット1(CMT3)モジュールストップ状態の解除
+
+	CMT.CMSTR1.BIT.STR3 = 0;			// CMT3.CMCNTカウンタのカウント動作停止
+	// カウントクロック
+	// (0:8分周, 1:32分周, 2:128分周, 3:512分周)
+	CMT3.CMCR.BIT.CKS = 0;				// カウントクロック
+	CMT3.CMCR.BIT.CMIE = 0;				// 割り込みは使わない
+	CMT3.CMCOR = 0xffff;				// 16bit全体で回す
+	CMT3.CMCNT = 0;						// タイマカウンタの初期化
+
+	CMT.CMSTR1.BIT.STR3 = 1;			// CMT3.CMCNTカウンタのカウント動作開始
+#endif
+	Profiler_Reset();
+}
+
+/**
+ * 処理時間の記録(PROFILE_EXITから呼ばれる)
+ * @param id: 割り込み
+ * @param count: 入口から出口までのカウント数
+ * @retval void
+ */
+void Profiler_Record(E_PROFILE_ID id, _UWORD count)
+{
+	ProfileStat* s = &_stat[id];
+
+	s->Count++;
+	s->Sum += count;
+	if(count < s->Min)
+	{
+		s->Min = count;
+	}
+	if(count > s->Max)
+	{
+		s->Max = count;
+	}
+}
+
+/**
+ * 遅れの記録(PROFILE_ENTER_LATENCYから呼ばれる)
+ * @param id: 割り込み
+ * @param count: 要求から入口までのカウント数
+ * @retval void
+ */
+void Profiler_Latency(E_PROFILE_ID id, _UWORD count)
+{
+	if(count > _stat[id].LatencyMax)
+	{
+		_stat[id].LatencyMax = count;
+	}
+}
+
+/**
+ * 集計のリセット
+ * @param void
+ * @retval void
+ */
+void Profiler_Reset(void)
+{
+	_UBYTE i;
+
+	clrpsw_i();
+	for(i = 0; i < PROFILE_NUM; i++)
+	{
+		_stat[i].Count = 0;
+		_stat[i].Sum = 0;
+		_stat[i].Min = 0xffff;
+		_stat[i].Max = 0;
+		_stat[i].LatencyMax = 0;
+	}
+	setpsw_i();
+}
+
+/**
+ * 集計結果をシリアルに出力する [usec]
+ * @param void
+ * @retval void
+ */
+void Profiler_Dump(void)
+{
+	ProfileStat s;
+	_UBYTE i;
+
+	if(!PROFILER_ENABLE)
+	{
+		Printf("Profiler disabled\n");
+		return;
+	}
+
+	Printf("name,count,min,mean,max,latency\n");
+	for(i = 0; i < PROFILE_NUM; i++)
+	{
+		// 割り込みと競合しないよう,禁止してから複写する
+		clrpsw_i();
+		s = _stat[i];
+		setpsw_i();
+
+		if(s.Count == 0)
+		{
+			Printf("%s,0,-,-,-,-\n", _name[i]);
+			continue;
+		}
+		Printf("%s,%l,%f,%f,%f,%f\n", _name[i], s.Count,
+				(float)s.Min / PROFILER_COUNT_PER_US,
+				(float)s.Sum / s.Count / PROFILER_COUNT_PER_US,
+				(float)s.Max / PROFILER_COUNT_PER_US,
+				(float)s.LatencyMax / PROFILER_COUNT_PER_US);
+		WaitMS(10);
+	}
+}
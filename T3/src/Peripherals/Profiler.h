@@ -0,0 +1,63 @@
+/**
+ * @file  Profiler.h
+ * @brief 割り込み処理時間の計測
+ *
+ * CMT3をフリーランカウンタ(PCLK/8, 1カウント1/6[usec])として使い,
+ * 割り込みごとに入口から出口までの時間と,要求から入口までの遅れを集計する.
+ * PROFILER_ENABLEが0なら計測用マクロは何も生成しない.
+ */
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "../typedefine.h"
+#include "../iodefine.h"
+
+/*----------------------------------------------------------------------
+	Macro definitions
+ ----------------------------------------------------------------------*/
+#ifndef PROFILER_ENABLE
+#define PROFILER_ENABLE			0		// 0:計測しない, 1:計測する
+#endif
+#define PROFILER_COUNT_PER_US	6		// 1[usec]あたりのカウント数
+
+// ==== 計測対象の割り込み ====
+typedef enum
+{
+	PROFILE_MTU2_TGIA = 0,	// 制御
+	PROFILE_MTU2_TGIB,		// センサ取得起動
+	PROFILE_DMAC0,			// 光センサ
+	PROFILE_DMAC2,			// RSPI0 CycleOperation(1デバイス分の転送終了)
+	PROFILE_RSPI0_SPRI0,	// RSPI受信
+	PROFILE_RSPI0_SPTI0,	// RSPI送信
+	PROFILE_SCI1_TXI1,		// シリアル送信
+	PROFILE_CMT1,			// RSPIサイクル
+	PROFILE_CMT2,			// 時刻カウンタ
+	PROFILE_NUM
+}E_PROFILE_ID;
+
+#if PROFILER_ENABLE
+// 割り込みの入口で呼ぶ
+#define PROFILE_ENTER(id)				_UWORD _profileStart = CMT3.CMCNT
+// 割り込みの入口で呼ぶ(要求からの遅れが分かる場合, latencyはプロファイラのカウント数)
+#define PROFILE_ENTER_LATENCY(id, latency)	_UWORD _profileStart = CMT3.CMCNT; Profiler_Latency((id), (latency))
+// 割り込みの出口で呼ぶ
+#define PROFILE_EXIT(id)				Profiler_Record((id), (_UWORD)(CMT3.CMCNT - _profileStart))
+#else
+#define PROFILE_ENTER(id)
+#define PROFILE_ENTER_LATENCY(id, latency)
+#define PROFILE_EXIT(id)
+#endif
+
+/*----------------------------------------------------------------------
+	Public Method Declarations
+ ----------------------------------------------------------------------*/
+void Profiler_Initialize(void);
+void Profiler_Record(E_PROFILE_ID id, _UWORD count);
+void Profiler_Latency(E_PROFILE_ID id, _UWORD count);
+void Profiler_Reset(void);
+void Profiler_Dump(void);
+
+#endif
@@ -36,6 +36,7 @@ typedef struct rspi_tcb_s
 
    void	(*ChipSelectFunc)(void);
    void	(*ChipDeselectFunc)(void);
+   void	(*TransferEndFunc)(void);
 } rspi_tcb_t;
 
 /*----------------------------------------------------------------------
@@ -47,10 +48,16 @@ static volatile _UINT g_rxdata; /* Space for fast read of RSPI RX data register.
 static rspi_tcb_t g_rspi_tcb = {0};
 
 // Cycle Operation 関連
+// (DMAC1が送信,DMAC2が受信を受け持ち,1デバイスの転送が終わるごとにDMAC2の転送終了割り込みが1回入る)
 static bool spiCycleoperationFlag = false;		// Cycle Operation実行フラグ
+static bool g_cycleExtTrigger = false;			// 1巡ごとに外部から起動する(CMT1で自走しない)
+static volatile bool g_cycleDmaBusy = false;	// DMAによる転送中
 static _UBYTE g_registerdCycleDeviceNum = 0;	// Cycle Operationで処理するデバイスの数
 static _SBYTE g_cycleTargetPtr = 0;				// Cycle Operationで現在処理するデバイスのナンバー
-static void (*g_cycleSendFunc[])(void);			// Cycle Operationでデバイスにコマンドを送る関数
+static RSPI_CYCLE_DESC *g_cycleDesc[RSPI_CYCLE_DEVICE_MAX];	// Cycle Operationで処理するデバイスの転送
+static _UBYTE g_cycleOffset[RSPI_CYCLE_DEVICE_MAX];			// 各デバイスの転送データの位置
+static _UINT g_cycleTx[RSPI_CYCLE_BUF_SIZE];	// DMA送信データ(SPDRへのLONGアクセスに合わせる)
+static _UINT g_cycleRx[RSPI_CYCLE_BUF_SIZE];	// DMA受信データ
 
 
 /*----------------------------------------------------------------------
@@ -74,7 +81,9 @@ static void RSPI0_InterruptsEnable(bool enabled);
 static void RSPI0_TxRxCommon(void);
 // Cycle Operation 実行関数
 static void RSPI0_CycleOperation(void);
+static void RSPI0_CycleStartDevice(_UBYTE num);
 static void RSPI0_InitializeCMT1(void);
+static void RSPI0_InitializeDMAC(void);
 
 /*----------------------------------------------------------------------
 	Public Method Definitions
@@ -87,6 +96,7 @@ void InitializeRSPI0(void)
 {
 	RSPI0_Open();
 	RSPI0_InitializeCMT1();
+	RSPI0_InitializeDMAC();
 }
 
 /** RSPI0受信データフル割り込み
@@ -95,6 +105,12 @@ void InitializeRSPI0(void)
  */
 void Int_SPRI0(void)
 {
+	// Cycle Operation中はDMAが受信する
+	if (g_cycleDmaBusy)
+	{
+		return;
+	}
+
 	g_rxdata = RSPI0.SPDR.LONG; // Need to read RX data reg ASAP.
 	g_rspi_tcb.rx_count++;
 	RSPI0_TxRxCommon();
@@ -106,6 +122,13 @@ void Int_SPRI0(void)
  */
 void Int_SPTI0(void)
 {
+	// Cycle Operation中,送信DMAが終わった後の送信要求はここに来るので止めるだけ
+	if (g_cycleDmaBusy)
+	{
+		RSPI0.SPCR.BIT.SPTIE = 0;
+		return;
+	}
+
 	g_rxdata = RSPI0.SPDR.LONG; // Read rx-data register into temp buffer.
 
 	/* If master mode then disable further spti interrupts on first transmit.
@@ -178,6 +201,55 @@ void RSPI0_IntCMT1(void)
 	RSPI0_CycleOperation();		// CycleOperation再開
 }
 
+/**
+ * Cycle Operationの受信DMA(DMAC2)転送終了割り込み
+ *   1デバイス分の転送が終わったので,受信データを格納して次のデバイスに移る
+ * @param void
+ * @retval void
+ */
+void RSPI0_IntDMAC2(void)
+{
+	RSPI_CYCLE_DESC *desc = g_cycleDesc[g_cycleTargetPtr];
+	_UINT *rx = &g_cycleRx[g_cycleOffset[g_cycleTargetPtr]];
+
+	RSPI0.SPCR.BIT.SPTIE = 0;
+	RSPI0.SPCR.BIT.SPRIE = 0;
+	RSPI0.SPCR.BIT.SPE   = 0;
+	g_cycleDmaBusy = false;
+
+	desc->dep->ChipDeselectFunc();
+
+	// 受信データをデバイスの形式で格納する
+	if (desc->pdest != NULL)
+	{
+		for (_UWORD i = 0; i < desc->length; i++)
+		{
+			if (RSPI_BYTE_DATA == desc->dep->format)
+			{
+				((_UBYTE *)desc->pdest)[i] = (_UBYTE)rx[i];
+			}
+			else if (RSPI_WORD_DATA == desc->dep->format)
+			{
+				((_UWORD *)desc->pdest)[i] = (_UWORD)rx[i];
+			}
+			else
+			{
+				((_UINT *)desc->pdest)[i] = rx[i];
+			}
+		}
+	}
+
+	if (desc->dep->TransferEndFunc != NULL)
+	{
+		desc->dep->TransferEndFunc();
+	}
+
+	if (spiCycleoperationFlag == true)
+	{
+		RSPI0_CycleOperation();
+	}
+}
+
 /** RSPI0で読み込みを行う
  * @param *pdest: 読み込みデータ列を格納する配列へのポインタ
  * @param length: 読み込みデータ列の配列の大きさ
@@ -216,26 +288,89 @@ void RSPI0_WriteRead(void *psrc,
 	RSPI0_WriteReadCommon(psrc, pdest, length, dep, RSPI_DO_TX_RX);
 }
 
-/** Cycle Operation用のコマンドを登録する
- * @param *cyleSendFunc: コマンドを送信する関数へのポインタ(必ずRSPI0_Read,Write,WriteReadを含むこと!)
- * @retval void
+/** Cycle Operationで行う転送を登録する
+ * @param *desc: 転送(CycleOperation中は書き換えないこと.pdestのみTransferEndFuncの中で差し替えてよい)
+ * @retval bool: 登録できたらtrue
  */
-void RSPI0_RegisterDeviceForCycleOperation(void (*cycleSendFunc)(void))
+bool RSPI0_RegisterDeviceForCycleOperation(RSPI_CYCLE_DESC *desc)
 {
-	g_cycleSendFunc[g_registerdCycleDeviceNum++] = cycleSendFunc;
+	_UBYTE offset = 0;
+
+	if (g_registerdCycleDeviceNum > 0)
+	{
+		_UBYTE last = g_registerdCycleDeviceNum - 1;
+		offset = g_cycleOffset[last] + g_cycleDesc[last]->length;
+	}
+	if ((g_registerdCycleDeviceNum >= RSPI_CYCLE_DEVICE_MAX) || (offset + desc->length > RSPI_CYCLE_BUF_SIZE))
+	{
+		return false;
+	}
+
+	g_cycleDesc[g_registerdCycleDeviceNum] = desc;
+	g_cycleOffset[g_registerdCycleDeviceNum] = offset;
+	g_registerdCycleDeviceNum++;
+	return true;
 }
 
 /** CycleOperationを開始する
+ *   各デバイスの送信データはここで一度だけ取り込む
  * @param void
  * @retval void
  */
 void RSPI0_StartCycleOperation(void)
 {
-	if(spiCycleoperationFlag == false)
+	if(spiCycleoperationFlag == false && g_registerdCycleDeviceNum > 0)
 	{
+		for (_UBYTE n = 0; n < g_registerdCycleDeviceNum; n++)
+		{
+			RSPI_CYCLE_DESC *desc = g_cycleDesc[n];
+			_UINT *tx = &g_cycleTx[g_cycleOffset[n]];
+
+			for (_UWORD i = 0; i < desc->length; i++)
+			{
+				if (desc->psrc == NULL)
+				{
+					tx[i] = RSPI_DUMMY_TXDATA;
+				}
+				else if (RSPI_BYTE_DATA == desc->dep->format)
+				{
+					tx[i] = ((_UBYTE *)desc->psrc)[i];
+				}
+				else if (RSPI_WORD_DATA == desc->dep->format)
+				{
+					tx[i] = ((_UWORD *)desc->psrc)[i];
+				}
+				else
+				{
+					tx[i] = ((_UINT *)desc->psrc)[i];
+				}
+			}
+		}
+
 		spiCycleoperationFlag = true;
 		g_cycleTargetPtr = 0;
-		g_cycleSendFunc[0]();
+		RSPI0_CycleStartDevice(0);
+	}
+}
+
+/** CycleOperationを1巡だけ起動する
+ *   一度呼ぶとCMT1による自走をやめ,以降は呼ばれるたびに1巡する
+ *   前の巡回がまだ終わっていなければ何もしない
+ *   割り込みは多重に受け付けない(割り込み関数はenable指定なし)ので,CMT1割り込みの途中に呼ばれることはない
+ *   自走をやめるときは,保留中のCMT1割り込みを取り消す
+ * @param void
+ * @retval void
+ */
+void RSPI0_TriggerCycleOperation(void)
+{
+	if (spiCycleoperationFlag == true && g_cycleTargetPtr < 0)
+	{
+		g_cycleExtTrigger = true;
+		CMT.CMSTR0.BIT.STR1 = 0;	// 自走中のウェイトを止める
+		IR(CMT1, CMI1) = 0;
+
+		g_cycleTargetPtr = 0;
+		RSPI0_CycleStartDevice(0);
 	}
 }
 
@@ -332,6 +467,7 @@ static void RSPI0_WriteReadCommon(void *psrc,
     g_rspi_tcb.transfer_mode = tx_rx_mode;
     g_rspi_tcb.ChipSelectFunc = dep.ChipSelectFunc;
     g_rspi_tcb.ChipDeselectFunc = dep.ChipDeselectFunc;
+    g_rspi_tcb.TransferEndFunc = dep.TransferEndFunc;
 //    g_rspi_tcb.CycleSendCommand = dep.CycleSendCommand;
 
     if (tx_rx_mode & RSPI_DO_TX)
@@ -480,10 +616,9 @@ static void RSPI0_TxRxCommon(void)
 
 	     g_rspi_tcb.ChipDeselectFunc();
 
-	     // Cycle Operation フラグがtrueなら，SPI動作を再開し次のデバイスにサイクル処理用コマンドを送信
-	     if (spiCycleoperationFlag == true)
+	     if (g_rspi_tcb.TransferEndFunc != NULL)
 	     {
-	    	 RSPI0_CycleOperation();
+	    	 g_rspi_tcb.TransferEndFunc();
 	     }
 	 }
 }
@@ -498,19 +633,75 @@ static void RSPI0_CycleOperation(void)
 	g_cycleTargetPtr++;
 
 	// 1周したら割り込み処理で指定時間ウェイトした後に始めのデバイスから再開
+	// (外部起動時は次のRSPI0_TriggerCycleOperation()まで待つ)
 	if (g_cycleTargetPtr >= g_registerdCycleDeviceNum)
 	{
 		g_cycleTargetPtr = -1;		// 次のCycleでインクリメントしたときに0になるようにするため-1
-		CMT1.CMCNT = 0;				// カウンタの初期化
-		CMT.CMSTR0.BIT.STR1 = 1;	// CMT1.CMCNTカウンタのカウント動作開始
+		if (g_cycleExtTrigger == false)
+		{
+			CMT1.CMCNT = 0;				// カウンタの初期化
+			CMT.CMSTR0.BIT.STR1 = 1;	// CMT1.CMCNTカウンタのカウント動作開始
+		}
 	}
 	else
 	{
 		// デバイスにコマンドを送る
-		g_cycleSendFunc[g_cycleTargetPtr]();
+		RSPI0_CycleStartDevice(g_cycleTargetPtr);
 	}
 }
 
+/** Cycle Operationで1デバイス分のDMA転送を開始する
+ * @param num: デバイスのナンバー
+ * @retval void
+ */
+static void RSPI0_CycleStartDevice(_UBYTE num)
+{
+	RSPI_CYCLE_DESC *desc = g_cycleDesc[num];
+	RSPI_DEPENDENCE *dep = desc->dep;
+	_UBYTE offset = g_cycleOffset[num];
+
+	/* Wait for channel to be idle before making changes to registers. */
+	while (RSPI0.SPSR.BIT.IDLNF)
+	{
+	}
+
+	RSPI0.SPCMD0.BIT.CPHA = 	dep->cpha_val;
+	RSPI0.SPCMD0.BIT.CPOL = 	dep->cpol_val;
+	RSPI0.SPCMD0.BIT.SSLKP = 	dep->sslkp_val;
+	RSPI0.SPCMD0.BIT.SPB = 	    dep->spb_val;
+	RSPI0.SPCMD0.BIT.LSBF =		dep->lsbf_val;
+	RSPI0.SPCMD0.BIT.SPNDEN =	dep->spnden_val;
+	RSPI0.SPCMD0.BIT.SLNDEN = 	dep->slnden_val;
+	RSPI0.SPCMD0.BIT.SCKDEN = 	dep->sckden_val;
+
+	// 送信: g_cycleTx -> SPDR
+	DMAC1.DMCNT.BIT.DTE = 0;
+	DMAC1.DMSAR = (void*)&g_cycleTx[offset];
+	DMAC1.DMCRA = desc->length;
+	// 受信: SPDR -> g_cycleRx
+	DMAC2.DMCNT.BIT.DTE = 0;
+	DMAC2.DMDAR = (void*)&g_cycleRx[offset];
+	DMAC2.DMCRA = desc->length;
+	DMAC2.DMSTS.BIT.DTIF = 0;
+	DMAC1.DMCNT.BIT.DTE = 1;
+	DMAC2.DMCNT.BIT.DTE = 1;
+
+	// フラグクリア
+	RSPI0.SPSR.BYTE &= 0xFD;
+	RSPI0_InterruptsClear();
+	RSPI0_InterruptsEnable(true);
+	g_cycleDmaBusy = true;
+
+	dep->ChipSelectFunc();
+
+	RSPI0.SPCR2.BIT.SPIIE = 0; 		// RSPI0アイドル割り込み
+	RSPI0.SPCR.BIT.SPEIE = 1;		// RSPI0エラー割り込み
+	RSPI0.SPCR.BIT.SPRIE = 1;		// RSPI0受信割り込み(DMAC2起動)
+	RSPI0.SPCR.BIT.SPTIE = 1;		// RSPI0送信割り込み(DMAC1起動)
+
+	RSPI0.SPCR.BIT.SPE = 1;		// RSPI0の機能を有効化
+}
+
 /** コンペアマッチタイマ1(CMT1)の初期化
  * @param void
  * @retval void
@@ -535,3 +726,39 @@ static void RSPI0_InitializeCMT1(void)
 
 //	CMT.CMSTR0.BIT.STR1 = 1;			// CMT1.CMCNTカウンタのカウント動作開始
 }
+
+/** Cycle Operation用DMAC(DMAC1:送信, DMAC2:受信)の初期化
+ * @param void
+ * @retval void
+ */
+static void RSPI0_InitializeDMAC(void)
+{
+	MSTP(DMAC) = 0;						// DAMコントローラのモジュールストップ状態の解除
+
+	DMAC1.DMCNT.BIT.DTE = 0;			// DMA転送を禁止
+	DMAC2.DMCNT.BIT.DTE = 0;			// DMA転送を禁止
+
+	// 送信
+	ICU.DMRSR1 = VECT_RSPI0_SPTI0;		// DMA起動要因:RSPI0 SPTI0
+	DMAC1.DMAMD.WORD = 0x8000;			// 転送元アドレスインクリメント,転送先アドレス固定
+	DMAC1.DMTMD.WORD = 0x2201;			// ノーマル転送,32ビット転送,周辺モジュール割り込みトリガ
+	DMAC1.DMDAR = (void*)&RSPI0.SPDR.LONG;	// 転送先アドレス設定
+	DMAC1.DMCSL.BIT.DISEL = 0;			// 転送開始時に起動要因の割り込みフラグをクリア
+	DMAC1.DMINT.BYTE = 0;				// 割り込みなし
+
+	// 受信
+	ICU.DMRSR2 = VECT_RSPI0_SPRI0;		// DMA起動要因:RSPI0 SPRI0
+	DMAC2.DMAMD.WORD = 0x0080;			// 転送元アドレス固定,転送先アドレスインクリメント
+	DMAC2.DMTMD.WORD = 0x2201;			// ノーマル転送,32ビット転送,周辺モジュール割り込みトリガ
+	DMAC2.DMSAR = (void*)&RSPI0.SPDR.LONG;	// 転送元アドレス設定
+	DMAC2.DMCSL.BIT.DISEL = 0;			// 転送開始時に起動要因の割り込みフラグをクリア
+	DMAC2.DMINT.BIT.DTIE = 1;			// 転送終了割り込みを許可
+
+	// 割り込みレベル設定
+	IPR(DMAC, DMAC2I)= 10;
+
+	// 割り込み要求を許可
+	IEN(DMAC, DMAC2I) = 1;
+
+	DMAC.DMAST.BIT.DMST = 1;			// DMAC起動を許可
+}
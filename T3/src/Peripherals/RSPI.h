@@ -9,6 +9,7 @@
 	Includes
  ----------------------------------------------------------------------*/
 #include "../typedefine.h"
+#include <stdbool.h>
 
 /*----------------------------------------------------------------------
 	Macro definitions
@@ -17,6 +18,8 @@
 
 //#define RSPI_CYCLE_INTERVAL		375	// Cycleモードの周期 375: 250[uSec]
 #define RSPI_CYCLE_INTERVAL		1500	// Cycleモードの周期 1500: 1[mSec]
+#define RSPI_CYCLE_DEVICE_MAX	4		// Cycleモードに登録できるデバイスの数
+#define RSPI_CYCLE_BUF_SIZE		32		// Cycleモードの全デバイス分の転送データ数
 
 /*----------------------------------------------------------------------
 	Typedef definitions
@@ -43,8 +46,18 @@ typedef struct rspi_denpendence
 	RSPI_DATA_FORMAT format;
 	void	(*ChipSelectFunc)(void);
 	void	(*ChipDeselectFunc)(void);
+	void	(*TransferEndFunc)(void);	// 転送完了時に割り込み処理から呼ぶ関数(不要ならNULL)
 }RSPI_DEPENDENCE;
 
+// Cycle Operationで1デバイスに対して行う転送
+typedef struct rspi_cycle_desc
+{
+	RSPI_DEPENDENCE	*dep;		// 転送設定(TransferEndFuncは転送完了ごとに呼ばれる)
+	void	*psrc;				// 送信データ(CycleOperation開始時に取り込む)
+	void	*pdest;				// 受信データ格納先(TransferEndFuncの中で差し替えてよい)
+	_UWORD	length;				// 転送データ数
+}RSPI_CYCLE_DESC;
+
 
 /*----------------------------------------------------------------------
 	Public Methods Declarations
@@ -59,11 +72,14 @@ void Int_SPII0(void);
 void Int_SPEI0(void);
 #pragma inline(RSPI0_IntCMT1)
 void RSPI0_IntCMT1(void);
+#pragma inline(RSPI0_IntDMAC2)
+void RSPI0_IntDMAC2(void);
 void RSPI0_Read(void *pdest, _UWORD length, RSPI_DEPENDENCE dep);
 void RSPI0_Write(void *psrc, _UWORD length, RSPI_DEPENDENCE dep);
 void RSPI0_WriteRead(void *psrc, void *pdest, _UWORD length, RSPI_DEPENDENCE dep);
-void RSPI0_RegisterDeviceForCycleOperation(void (*cycleSendFunc)(void));
+bool RSPI0_RegisterDeviceForCycleOperation(RSPI_CYCLE_DESC *desc);
 void RSPI0_StartCycleOperation(void);
+void RSPI0_TriggerCycleOperation(void);
 void RSPI0_StopCycleOperation(void);
 
 #endif
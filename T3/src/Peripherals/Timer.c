@@ -6,43 +6,217 @@
 	インクルード
  ----------------------------------------------------------------------*/
 #include "Timer.h"
+#include <stddef.h>
 #include "../BoardDefine.h"
 
 /*----------------------------------------------------------------------
 	定数定義
  ----------------------------------------------------------------------*/
 
+/*----------------------------------------------------------------------
+	構造体定義
+ ----------------------------------------------------------------------*/
+typedef struct stTimerTask
+{
+	void (*Func)(void);		// タスク関数(NULLなら空き)
+	_UWORD Period;			// 実行周期 [msec]
+	_UDWORD Next;			// 次に実行する時刻 [msec]
+}TimerTask;
+
+/*----------------------------------------------------------------------
+	変数定義
+ ----------------------------------------------------------------------*/
+static volatile _UDWORD _tick = 0;			// 経過時間 [msec]
+static TimerTask _task[TIMER_TASK_MAX];		// 周期タスク
+static _UBYTE _taskTurn = 0;				// 次に優先して調べるタスク
+static bool _taskRunning = false;			// タスク実行中(タスク内の待ちでは実行しない)
+
 /*----------------------------------------------------------------------
 	ソースコード
  ----------------------------------------------------------------------*/
+/** タイマー(CMT2による1[msec]周期の時刻カウンタ)の初期化
+ * @param void
+ * @retval void
+ */
+void Timer_Initialize(void)
+{
+	MSTP(CMT2) = 0;						// CMTユニット1(CMT2)モジュールストップ状態の解除
+
+	CMT.CMSTR1.BIT.STR2 = 0;			// CMT2.CMCNTカウンタのカウント動作停止
+	// カウントクロック
+	// (0:8分周, 1:32分周, 2:128分周, 3:512分周)
+	CMT2.CMCR.BIT.CKS = 0;				// カウントクロック
+	CMT2.CMCR.BIT.CMIE = 1;				// コンペアマッチ割り込みの許可
+	CMT2.CMCOR = TIMER_TICK_INTERVAL - 1;	// コンペアマッチ周期
+	CMT2.CMCNT = 0;						// タイマカウンタの初期化
+
+	// 割り込みレベル設定
+	IPR(CMT2, CMI2)= 12;
+
+	// 割り込み要求を許可
+	IEN(CMT2, CMI2) = 1;
+
+	CMT.CMSTR1.BIT.STR2 = 1;			// CMT2.CMCNTカウンタのカウント動作開始
+}
+
+/** 時刻カウンタ更新用CMT2割り込み
+ * @param void
+ * @retval void
+ */
+void Timer_IntCMT2(void)
+{
+	_tick++;
+}
+
+/** 現在時刻の取得
+ * @param void
+ * @retval _UDWORD: 初期化からの経過時間 [msec]
+ */
+_UDWORD Timer_GetTick(void)
+{
+	return _tick;
+}
+
+/** 現在時刻の取得(マイクロ秒単位)
+ * @param void
+ * @retval _UDWORD: 初期化からの経過時間 [usec]
+ */
+_UDWORD Timer_GetTimeUS(void)
+{
+	_UDWORD tick;
+	_UWORD cnt;
+
+	do
+	{
+		tick = _tick;
+		cnt = CMT2.CMCNT;
+	}while(tick != _tick);
+
+	// 割り込み処理中などでコンペアマッチがまだ_tickに反映されていない
+	if(IR(CMT2, CMI2) && (cnt < TIMER_TICK_INTERVAL / 2))
+	{
+		tick++;
+	}
+
+	return tick * 1000 + cnt / TIMER_COUNT_PER_US;
+}
+
+/** 指定時刻まで待つ
+ * @param deadline : 待ち終える時刻 [msec]
+ * @retval void
+ */
+void Timer_SleepUntil(_UDWORD deadline)
+{
+	// 時刻カウンタの桁あふれをまたいでも正しく比較できるよう差で判定
+	while((_SDWORD)(deadline - _tick) > 0)
+	{
+		Timer_Yield();
+	}
+}
+
 /** 指定ミリ秒待つ
  * @param msec : 待つミリ秒
  * @retval void
  */
 void Timer_WaitMS(_UINT msec)
 {
-	volatile unsigned long i, j;
+	// 現在の1[msec]の残りで待ちが短くならないよう,次の時刻から数える
+	Timer_SleepUntil(_tick + msec + 1);
+}
 
-	for (i = 0; i < msec; i++)
+/** 指定マイクロ秒待つ
+ * @param usec : 待つマイクロ秒
+ * @retval void
+ */
+void Timer_WaitUS(_UINT usec)
+{
+	_UDWORD total = (_UDWORD)usec * TIMER_COUNT_PER_US;
+	_UDWORD elapsed = 0;
+	_UWORD prev = CMT2.CMCNT;
+	_UWORD now;
+
+	while(elapsed < total)
 	{
-		for (j = 0; j < MILLI_SEC; j++)
+		now = CMT2.CMCNT;
+		// コンペアマッチでのクリアをまたいだ分を補正
+		elapsed += (now >= prev) ? (now - prev) : (now + TIMER_TICK_INTERVAL - prev);
+		prev = now;
+	}
+}
+
+/** 周期タスクの登録
+ * @param task : タスク関数
+ * @param periodMS : 実行周期 [msec]
+ * @retval bool: 登録できたらtrue
+ */
+bool Timer_AddTask(void (*task)(void), _UWORD periodMS)
+{
+	_UBYTE i;
+
+	for(i = 0; i < TIMER_TASK_MAX; i++)
+	{
+		if(_task[i].Func == NULL)
 		{
+			_task[i].Period = periodMS;
+			_task[i].Next = _tick + periodMS;
+			_task[i].Func = task;
+			return true;
 		}
 	}
+	return false;
 }
 
-/** 指定マイクロ秒待つ
- * @param usec : 待つマイクロ秒
+/** 周期タスクの登録解除
+ * @param task : タスク関数
  * @retval void
  */
-void Timer_WaitUS(_UINT usec)
+void Timer_RemoveTask(void (*task)(void))
 {
-	volatile unsigned long i, j;
+	_UBYTE i;
 
-	for (i = 0; i < usec; i++)
+	for(i = 0; i < TIMER_TASK_MAX; i++)
 	{
-		for (j = 0; j < MICRO_SEC; j++)
+		if(_task[i].Func == task)
 		{
+			_task[i].Func = NULL;
 		}
 	}
 }
+
+/** 実行時刻になったタスクを1つ実行する
+ *   前回実行したタスクの次から調べ,同じタスクばかりが実行されないようにする
+ * @param void
+ * @retval void
+ */
+void Timer_Yield(void)
+{
+	_UBYTE n, i;
+	_UDWORD now = _tick;
+
+	if(_taskRunning)
+	{
+		return;
+	}
+
+	for(n = 0; n < TIMER_TASK_MAX; n++)
+	{
+		i = (_taskTurn + n) % TIMER_TASK_MAX;
+		if((_task[i].Func == NULL) || ((_SDWORD)(_task[i].Next - now) > 0))
+		{
+			continue;
+		}
+
+		// 次の実行時刻を決める.大きく遅れていたら溜まった分は捨てる
+		_task[i].Next += _task[i].Period;
+		if((_SDWORD)(_task[i].Next - now) <= 0)
+		{
+			_task[i].Next = now + _task[i].Period;
+		}
+
+		_taskTurn = (i + 1) % TIMER_TASK_MAX;
+		_taskRunning = true;
+		_task[i].Func();
+		_taskRunning = false;
+		return;
+	}
+}
@@ -9,20 +9,84 @@
 	インクルード
  ----------------------------------------------------------------------*/
 #include "../typedefine.h"
+#include <stdbool.h>
+
+/*----------------------------------------------------------------------
+	定数定義
+ ----------------------------------------------------------------------*/
+#define TIMER_TICK_INTERVAL	6000	// CMT2のコンペアマッチ周期 6000: 1[mSec] (PCLK/8)
+#define TIMER_COUNT_PER_US	6		// 1[usec]あたりのCMT2カウント数
+#define TIMER_TASK_MAX		8		// 登録できるタスクの数
 
 /*----------------------------------------------------------------------
 	ソースコード
  ----------------------------------------------------------------------*/
+/** タイマー(CMT2による1[msec]周期の時刻カウンタ)の初期化
+ *   WaitMS,WaitUSを使う前に呼ぶ
+ * @param void
+ * @retval void
+ */
+void Timer_Initialize(void);
+
+/** 時刻カウンタ更新用CMT2割り込み
+ * @param void
+ * @retval void
+ */
+void Timer_IntCMT2(void);
+
+/** 現在時刻の取得
+ * @param void
+ * @retval _UDWORD: 初期化からの経過時間 [msec]
+ */
+_UDWORD Timer_GetTick(void);
+
+/** 現在時刻の取得(マイクロ秒単位)
+ *   割り込み処理の中から呼んでもよい.約71分で一周する
+ * @param void
+ * @retval _UDWORD: 初期化からの経過時間 [usec]
+ */
+_UDWORD Timer_GetTimeUS(void);
+
+/** 指定時刻まで待つ
+ *   待つ間は登録されたタスクを実行する
+ * @param deadline : 待ち終える時刻 [msec] (Timer_GetTickと同じ基準)
+ * @retval void
+ */
+void Timer_SleepUntil(_UDWORD deadline);
+
 /** 指定ミリ秒待つ
+ *   待つ間は登録されたタスクを実行する
  * @param msec : 待つミリ秒
  * @retval void
  */
 void Timer_WaitMS(_UINT msec);
 
 /** 指定マイクロ秒待つ
+ *   CMT2のカウンタを見て待つ.タスクは実行しない
  * @param usec : 待つマイクロ秒
  * @retval void
  */
 void Timer_WaitUS(_UINT usec);
 
+/** 周期タスクの登録
+ *   タスクはWaitMSなどで待っている間に,メインループの文脈で実行される
+ * @param task : タスク関数(短時間で戻ること)
+ * @param periodMS : 実行周期 [msec]
+ * @retval bool: 登録できたらtrue
+ */
+bool Timer_AddTask(void (*task)(void), _UWORD periodMS);
+
+/** 周期タスクの登録解除
+ * @param task : タスク関数
+ * @retval void
+ */
+void Timer_RemoveTask(void (*task)(void));
+
+/** 実行時刻になったタスクを実行する
+ *   ポーリングで待つループの中から呼ぶ
+ * @param void
+ * @retval void
+ */
+void Timer_Yield(void);
+
 #endif
@@ -0,0 +1,609 @@
+/**
+ * @file  ParamStore.c
+ * @brief データフラッシュに置くキー/値の不揮発パラメータ
+ *
+ * ページヘッダ(8バイト): 通し番号(4), 識別子(2), CRC(2)
+ * 記録(8バイト単位):     キー(2), 長さ(1), 長さの反転(1), CRC(2), 予備(2), 値
+ * 記録はヘッダから書くので,ヘッダが消去したままなら記録の終わりとみなせる.
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "ParamStore.h"
+#include <string.h>
+#include "../Global.h"
+#include "../Peripherals/Timer.h"
+
+/*----------------------------------------------------------------------
+	Private Macro Definitions
+ ----------------------------------------------------------------------*/
+#define PS_MAGIC			0x5053		// ページヘッダの識別子
+#define PS_HEADER_SIZE		8			// ページヘッダ,記録のヘッダの大きさ
+#define PS_RECORD_SIZE(len)	(PS_HEADER_SIZE + (((len) + DF_WRITE_SIZE - 1) & ~(DF_WRITE_SIZE - 1)))
+#define PS_RECORD_MAX		PS_RECORD_SIZE(PARAM_VALUE_MAX)
+#define PS_PAGE_OFFSET(p)	((_UDWORD)(p) * PARAM_PAGE_SIZE)
+#define PS_NONE				0			// 記録がない(0はページヘッダの位置なので記録の位置にならない)
+
+// 全キーの最新の記録を移しても,もう1つ書ける空きが残ること
+#if (PARAM_KEY_MAX * PS_RECORD_MAX) > (PARAM_PAGE_SIZE - PS_HEADER_SIZE - PS_RECORD_MAX)
+#error "PARAM_KEY_MAX * PARAM_VALUE_MAX does not fit in one page"
+#endif
+#if (PARAM_PAGE_NUM * PARAM_PAGE_SIZE) > DF_SIZE
+#error "PARAM_PAGE_NUM exceeds the data flash"
+#endif
+
+/*----------------------------------------------------------------------
+	Private Struct Definitions
+ ----------------------------------------------------------------------*/
+// ==== 書き込みを進める状態 ====
+typedef enum
+{
+	PS_IDLE = 0,		// 待ち行列を見る
+	PS_WRITE,			// 有効なページに記録を追記している
+	PS_ERASE,			// 移し先のページを消去している
+	PS_COPY,			// 移し先のページに最新の記録を書いている
+	PS_PAGE_HEADER,		// 移し先のページにページヘッダを書いている
+	PS_FAILED			// 書き込みをあきらめた
+}E_PS_STATE;
+
+// ==== 書き込み待ち ====
+typedef struct stParamPending
+{
+	_UBYTE Key;
+	_UBYTE Len;
+	_UBYTE Data[PARAM_VALUE_MAX];
+}ParamPending;
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+// 有効なページ
+static bool _valid = false;				// 有効なページがある
+static _UBYTE _active = 0;				// 有効なページの番号
+static _UDWORD _seq = 0;				// 有効なページの通し番号
+static _UWORD _tail = PS_HEADER_SIZE;	// 次に記録を書く位置(ページ内)
+static bool _dirty = false;				// 書きかけの記録がある(次の書き込みでページを移す)
+static _UWORD _index[PARAM_KEY_MAX];	// キーごとの最新の記録の位置(ページ内)
+
+// 書き込み待ち
+static ParamPending _queue[PARAM_QUEUE_SIZE];
+static _UBYTE _qHead = 0;
+static _UBYTE _qCount = 0;
+
+// 書き込み中
+static E_PS_STATE _state = PS_IDLE;
+static _UBYTE _buf[PS_RECORD_MAX];		// 書いている記録,ページヘッダ
+static _UWORD _bufLen = 0;				// _bufの書く長さ
+static _UWORD _bufPos = 0;				// _bufの次に書く位置
+static _UDWORD _bufAddr = 0;			// _bufの書き込み先(データフラッシュ先頭から)
+
+// ページの移動
+static _UBYTE _newPage = 0;				// 移し先のページ
+static _UWORD _newTail = 0;				// 移し先のページの次に記録を書く位置
+static _UWORD _newIndex[PARAM_KEY_MAX];	// 移し先のページでの記録の位置
+static _UWORD _eraseOffset = 0;			// 次に消去する位置(ページ内)
+static _UBYTE _copyKey = 0;				// 次に移すキー
+static _UBYTE _skip = 0;				// 失敗して飛ばしたページの数
+static _UBYTE _failCount = 0;			// 続けて失敗した回数
+
+/*----------------------------------------------------------------------
+	Private Method Declarations
+ ----------------------------------------------------------------------*/
+static void ParamStore_Task(void);
+static void ParamStore_StartNext(void);
+static void ParamStore_StartMove(void);
+static void ParamStore_CopyNext(void);
+static void ParamStore_WriteChunk(void);
+static void ParamStore_Fail(void);
+static bool ParamStore_ReadPageHeader(_UBYTE page, _UDWORD* seq);
+static void ParamStore_Scan(void);
+static bool ParamStore_IsBlankHeader(_UDWORD offset);
+static _UWORD ParamStore_RecordCrc(const _UBYTE* rec);
+static _UWORD ParamStore_Crc16(_UWORD crc, const _UBYTE* data, _UWORD len);
+static void ParamStore_PutWord(_UBYTE* p, _UWORD v);
+static _UWORD ParamStore_GetWord(const _UBYTE* p);
+
+/*----------------------------------------------------------------------
+	Public Method Definitions
+ ----------------------------------------------------------------------*/
+/** 不揮発パラメータの初期化
+ *   最新のページを探して記録を読み,書き込みを進める周期タスクを登録する
+ * @param void
+ * @retval bool: true: 有効なページがあった, false: 空(またはデータフラッシュが使えない)
+ */
+bool ParamStore_Initialize(void)
+{
+	_UBYTE p;
+	_UDWORD seq;
+
+	for(p = 0; p < PARAM_KEY_MAX; p++)
+	{
+		_index[p] = PS_NONE;
+	}
+
+	if(!DataFlash_Initialize())
+	{
+		_state = PS_FAILED;
+		return false;
+	}
+
+	// 通し番号が最も新しいページを有効とする
+	for(p = 0; p < PARAM_PAGE_NUM; p++)
+	{
+		if(ParamStore_ReadPageHeader(p, &seq) && (!_valid || ((_SDWORD)(seq - _seq) > 0)))
+		{
+			_valid = true;
+			_active = p;
+			_seq = seq;
+		}
+	}
+	if(_valid)
+	{
+		ParamStore_Scan();
+	}
+
+	Timer_AddTask(ParamStore_Task, PARAM_TASK_MS);
+	return _valid;
+}
+
+/** 値の読み出し
+ *   書き込み待ちの値があればそれを返す
+ * @param key: キー
+ * @param buf: 格納先
+ * @param len: 値の長さ(書いたときと同じであること)
+ * @retval bool: true: 読み出せた, false: 値がない(bufは書き換えない)
+ */
+bool ParamStore_Get(PARAM_KEY key, void* buf, _UBYTE len)
+{
+	_UBYTE head[PS_HEADER_SIZE];
+	_UBYTE i;
+
+	if(key >= PARAM_KEY_MAX)
+	{
+		return false;
+	}
+
+	// 書き込み待ちは新しいものから探す
+	for(i = _qCount; i > 0; i--)
+	{
+		ParamPending* e = &_queue[(_qHead + i - 1) % PARAM_QUEUE_SIZE];
+
+		if(e->Key == key)
+		{
+			if(e->Len != len)
+			{
+				return false;
+			}
+			memcpy(buf, e->Data, len);
+			return true;
+		}
+	}
+
+	if(!_valid || (_index[key] == PS_NONE))
+	{
+		return false;
+	}
+	DataFlash_Read(PS_PAGE_OFFSET(_active) + _index[key], head, PS_HEADER_SIZE);
+	if(head[2] != len)
+	{
+		return false;
+	}
+	DataFlash_Read(PS_PAGE_OFFSET(_active) + _index[key] + PS_HEADER_SIZE, buf, len);
+	return true;
+}
+
+/** 値の書き込み
+ *   書き込み待ちに積んで戻る.同じキーの書き込み待ちがあれば上書きし,今と同じ値なら何もしない
+ *   メインループの文脈から呼ぶこと(制御割り込みからは呼ばない)
+ * @param key: キー
+ * @param data: 値
+ * @param len: 値の長さ(PARAM_VALUE_MAX以下)
+ * @retval bool: true: 積めた, false: 書き込み待ちが一杯,または書き込みをあきらめた
+ */
+bool ParamStore_Set(PARAM_KEY key, const void* data, _UBYTE len)
+{
+	_UBYTE now[PARAM_VALUE_MAX];
+	_UBYTE i;
+	ParamPending* e;
+
+	if((_state == PS_FAILED) || (key >= PARAM_KEY_MAX) || (len > PARAM_VALUE_MAX))
+	{
+		return false;
+	}
+
+	// 同じキーの最も新しい書き込み待ちを上書きする(書き始めていれば後ろに積む)
+	for(i = _qCount; i > 0; i--)
+	{
+		e = &_queue[(_qHead + i - 1) % PARAM_QUEUE_SIZE];
+		if(e->Key == key)
+		{
+			if((i == 1) && (_state != PS_IDLE))
+			{
+				break;
+			}
+			e->Len = len;
+			memcpy(e->Data, data, len);
+			return true;
+		}
+	}
+
+	// 消去,書き込みの回数を減らすため,今と同じ値は書かない
+	// (書き込み,消去中は読み出しで待たせないよう比べずに積む)
+	if((DataFlash_GetStatus() != DF_BUSY)
+			&& ParamStore_Get(key, now, len) && (memcmp(now, data, len) == 0))
+	{
+		return true;
+	}
+
+	if(_qCount >= PARAM_QUEUE_SIZE)
+	{
+		return false;
+	}
+	e = &_queue[(_qHead + _qCount) % PARAM_QUEUE_SIZE];
+	e->Key = key;
+	e->Len = len;
+	memcpy(e->Data, data, len);
+	_qCount++;
+	return true;
+}
+
+/** 書き込み中か
+ * @param void
+ * @retval bool: true: 書き込み待ち,または書き込み中の値がある
+ */
+bool ParamStore_IsBusy(void)
+{
+	return (_state != PS_FAILED) && ((_qCount > 0) || (_state != PS_IDLE));
+}
+
+/** 書き込み待ちが全て書き終わるまで待つ
+ * @param void
+ * @retval void
+ */
+void ParamStore_Flush(void)
+{
+	while(ParamStore_IsBusy())
+	{
+		Yield();
+	}
+}
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+/** 書き込みを1コマンド分進める周期タスク
+ * @param void
+ * @retval void
+ */
+static void ParamStore_Task(void)
+{
+	E_DF_STATUS st;
+
+	if(_state == PS_FAILED)
+	{
+		return;
+	}
+	if(_state == PS_IDLE)
+	{
+		ParamStore_StartNext();
+		return;
+	}
+
+	st = DataFlash_GetStatus();
+	if(st == DF_BUSY)
+	{
+		return;
+	}
+	if(st == DF_ERROR)
+	{
+		ParamStore_Fail();
+		return;
+	}
+
+	switch(_state)
+	{
+	case PS_WRITE:
+		if(_bufPos < _bufLen)
+		{
+			ParamStore_WriteChunk();
+			break;
+		}
+		// 記録を書き終えた
+		_index[_queue[_qHead].Key] = _tail;
+		_tail += _bufLen;
+		_qHead = (_qHead + 1) % PARAM_QUEUE_SIZE;
+		_qCount--;
+		_failCount = 0;
+		_state = PS_IDLE;
+		break;
+	case PS_ERASE:
+		if(_eraseOffset < PARAM_PAGE_SIZE)
+		{
+			DataFlash_StartErase(PS_PAGE_OFFSET(_newPage) + _eraseOffset);
+			_eraseOffset += DF_ERASE_SIZE;
+			break;
+		}
+		// 消去し終えたので最新の記録を移す
+		for(_copyKey = 0; _copyKey < PARAM_KEY_MAX; _copyKey++)
+		{
+			_newIndex[_copyKey] = PS_NONE;
+		}
+		_copyKey = 0;
+		_newTail = PS_HEADER_SIZE;
+		_state = PS_COPY;
+		ParamStore_CopyNext();
+		break;
+	case PS_COPY:
+		if(_bufPos < _bufLen)
+		{
+			ParamStore_WriteChunk();
+			break;
+		}
+		ParamStore_CopyNext();
+		break;
+	case PS_PAGE_HEADER:
+		// ページヘッダを書き終えたので移し先が有効になる
+		_valid = true;
+		_active = _newPage;
+		_seq++;
+		_tail = _newTail;
+		memcpy(_index, _newIndex, sizeof(_index));
+		_dirty = false;
+		_skip = 0;
+		_failCount = 0;
+		_state = PS_IDLE;
+		break;
+	default:
+		break;
+	}
+}
+
+/** 待ち行列の先頭の書き込みを始める
+ *   有効なページに空きがなければ(書きかけの記録があれば)先にページを移す
+ * @param void
+ * @retval void
+ */
+static void ParamStore_StartNext(void)
+{
+	ParamPending* e;
+	_UWORD crc;
+
+	if(_qCount == 0)
+	{
+		return;
+	}
+	e = &_queue[_qHead];
+	if(!_valid || _dirty || ((_UDWORD)_tail + PS_RECORD_SIZE(e->Len) > PARAM_PAGE_SIZE))
+	{
+		ParamStore_StartMove();
+		return;
+	}
+
+	// 記録を作る
+	memset(_buf, 0, sizeof(_buf));
+	ParamStore_PutWord(&_buf[0], e->Key);
+	_buf[2] = e->Len;
+	_buf[3] = (_UBYTE)~e->Len;
+	memcpy(&_buf[PS_HEADER_SIZE], e->Data, e->Len);
+	crc = ParamStore_RecordCrc(_buf);
+	ParamStore_PutWord(&_buf[4], crc);
+
+	_bufLen = PS_RECORD_SIZE(e->Len);
+	_bufPos = 0;
+	_bufAddr = PS_PAGE_OFFSET(_active) + _tail;
+	_state = PS_WRITE;
+	ParamStore_WriteChunk();
+}
+
+/** 次のページへの移動を始める(移し先の消去から)
+ * @param void
+ * @retval void
+ */
+static void ParamStore_StartMove(void)
+{
+	_newPage = (_valid ? (_active + 1 + _skip) : _skip) % PARAM_PAGE_NUM;
+	_eraseOffset = DF_ERASE_SIZE;
+	_state = PS_ERASE;
+	DataFlash_StartErase(PS_PAGE_OFFSET(_newPage));
+}
+
+/** 次のキーの最新の記録を移し先へ書き始める
+ *   全て移し終えたらページヘッダを書き始める
+ * @param void
+ * @retval void
+ */
+static void ParamStore_CopyNext(void)
+{
+	while(_valid && (_copyKey < PARAM_KEY_MAX) && (_index[_copyKey] == PS_NONE))
+	{
+		_copyKey++;
+	}
+
+	if(!_valid || (_copyKey >= PARAM_KEY_MAX))
+	{
+		ParamStore_PutWord(&_buf[0], (_UWORD)(_seq + 1));
+		ParamStore_PutWord(&_buf[2], (_UWORD)((_seq + 1) >> 16));
+		ParamStore_PutWord(&_buf[4], PS_MAGIC);
+		ParamStore_PutWord(&_buf[6], ParamStore_Crc16(0xFFFF, _buf, 6));
+		_bufLen = PS_HEADER_SIZE;
+		_bufPos = 0;
+		_bufAddr = PS_PAGE_OFFSET(_newPage);
+		_state = PS_PAGE_HEADER;
+		ParamStore_WriteChunk();
+		return;
+	}
+
+	// 記録はCRCごとそのまま写す
+	DataFlash_Read(PS_PAGE_OFFSET(_active) + _index[_copyKey], _buf, PS_HEADER_SIZE);
+	_bufLen = PS_RECORD_SIZE(_buf[2]);
+	DataFlash_Read(PS_PAGE_OFFSET(_active) + _index[_copyKey] + PS_HEADER_SIZE, &_buf[PS_HEADER_SIZE], _bufLen - PS_HEADER_SIZE);
+	_bufPos = 0;
+	_bufAddr = PS_PAGE_OFFSET(_newPage) + _newTail;
+	_newIndex[_copyKey] = _newTail;
+	_newTail += _bufLen;
+	_copyKey++;
+	ParamStore_WriteChunk();
+}
+
+/** _bufの次のDF_WRITE_SIZEバイトを書き始める
+ * @param void
+ * @retval void
+ */
+static void ParamStore_WriteChunk(void)
+{
+	DataFlash_StartWrite(_bufAddr + _bufPos, &_buf[_bufPos]);
+	_bufPos += DF_WRITE_SIZE;
+}
+
+/** 書き込み,消去に失敗したとき
+ *   追記に失敗したらページを移し,移動に失敗したら移し先を1つ飛ばしてやり直す
+ * @param void
+ * @retval void
+ */
+static void ParamStore_Fail(void)
+{
+	if(_state == PS_WRITE)
+	{
+		_dirty = true;
+	}
+	else
+	{
+		_skip++;
+	}
+	_state = PS_IDLE;
+
+	// 有効なページ以外を全て試しても駄目なら書き込みをあきらめる
+	if((++_failCount >= PARAM_PAGE_NUM) || (_skip >= PARAM_PAGE_NUM - 1))
+	{
+		_state = PS_FAILED;
+	}
+}
+
+/** ページヘッダを読む
+ * @param page: ページの番号
+ * @param seq: 通し番号の格納先
+ * @retval bool: true: 有効なページヘッダ
+ */
+static bool ParamStore_ReadPageHeader(_UBYTE page, _UDWORD* seq)
+{
+	_UBYTE head[PS_HEADER_SIZE];
+
+	if(ParamStore_IsBlankHeader(PS_PAGE_OFFSET(page)))
+	{
+		return false;
+	}
+	DataFlash_Read(PS_PAGE_OFFSET(page), head, PS_HEADER_SIZE);
+	if((ParamStore_GetWord(&head[4]) != PS_MAGIC)
+			|| (ParamStore_GetWord(&head[6]) != ParamStore_Crc16(0xFFFF, head, 6)))
+	{
+		return false;
+	}
+	*seq = ParamStore_GetWord(&head[0]) | ((_UDWORD)ParamStore_GetWord(&head[2]) << 16);
+	return true;
+}
+
+/** 有効なページの記録を先頭から調べ,キーごとの最新の記録と書き込み位置を求める
+ * @param void
+ * @retval void
+ */
+static void ParamStore_Scan(void)
+{
+	_UWORD off = PS_HEADER_SIZE;
+	_UWORD key, size;
+
+	while(off + PS_HEADER_SIZE <= PARAM_PAGE_SIZE)
+	{
+		if(ParamStore_IsBlankHeader(PS_PAGE_OFFSET(_active) + off))
+		{
+			break;
+		}
+		DataFlash_Read(PS_PAGE_OFFSET(_active) + off, _buf, PS_HEADER_SIZE);
+		key = ParamStore_GetWord(&_buf[0]);
+		size = PS_RECORD_SIZE(_buf[2]);
+		if(((_UBYTE)(_buf[2] ^ _buf[3]) != 0xFF) || (_buf[2] > PARAM_VALUE_MAX)
+				|| (key >= PARAM_KEY_MAX) || (off + size > PARAM_PAGE_SIZE))
+		{
+			_dirty = true;
+			break;
+		}
+		DataFlash_Read(PS_PAGE_OFFSET(_active) + off + PS_HEADER_SIZE, &_buf[PS_HEADER_SIZE], size - PS_HEADER_SIZE);
+		if(ParamStore_GetWord(&_buf[4]) != ParamStore_RecordCrc(_buf))
+		{
+			_dirty = true;
+			break;
+		}
+		_index[key] = off;
+		off += size;
+	}
+	_tail = off;
+}
+
+/** ヘッダ(PS_HEADER_SIZEバイト)が全て消去したままか
+ *   一部だけ書かれていれば書きかけなので消去したままとはしない
+ * @param offset: ヘッダの位置(データフラッシュ先頭から)
+ * @retval bool: true: 消去したまま
+ */
+static bool ParamStore_IsBlankHeader(_UDWORD offset)
+{
+	_UBYTE i;
+
+	for(i = 0; i < PS_HEADER_SIZE; i += 2)
+	{
+		if(!DataFlash_IsBlank(offset + i))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/** 記録のCRC(キー,長さ,長さの反転,値)
+ * @param rec: 記録
+ * @retval _UWORD: CRC
+ */
+static _UWORD ParamStore_RecordCrc(const _UBYTE* rec)
+{
+	return ParamStore_Crc16(ParamStore_Crc16(0xFFFF, rec, 4), &rec[PS_HEADER_SIZE], rec[2]);
+}
+
+/** CRC-16-CCITT
+ * @param crc: 初期値(続けて計算するときは前の結果)
+ * @param data: データ
+ * @param len: バイト数
+ * @retval _UWORD: CRC
+ */
+static _UWORD ParamStore_Crc16(_UWORD crc, const _UBYTE* data, _UWORD len)
+{
+	_UBYTE i;
+
+	while(len--)
+	{
+		crc ^= (_UWORD)(*data++) << 8;
+		for(i = 0; i < 8; i++)
+		{
+			crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+/** 2バイトをリトルエンディアンで書く
+ * @param p: 書き込み先
+ * @param v: 値
+ * @retval void
+ */
+static void ParamStore_PutWord(_UBYTE* p, _UWORD v)
+{
+	p[0] = (_UBYTE)v;
+	p[1] = (_UBYTE)(v >> 8);
+}
+
+/** 2バイトをリトルエンディアンで読む
+ * @param p: 読み出し元
+ * @retval _UWORD: 値
+ */
+static _UWORD ParamStore_GetWord(const _UBYTE* p)
+{
+	return (_UWORD)(p[0] | (p[1] << 8));
+}
@@ -0,0 +1,70 @@
+/**
+ * @file  ParamStore.h
+ * @brief データフラッシュに置くキー/値の不揮発パラメータ
+ *
+ * 値は有効なページの末尾に記録として追記していき,キーごとに最新の記録を有効とする.
+ * ページが一杯になったら次のページを消去して最新の記録だけを移し,最後にページヘッダを書く.
+ * ページは順番に使うので消去回数は全ページで揃い,ページヘッダを書くまでは前のページが有効なまま残る.
+ * 記録,ページヘッダはCRCで確かめ,書きかけの記録より後ろは使わない(次の書き込みでページを移す).
+ *
+ * 書き込みは待ち行列に積むだけで,周期タスク(メインループの文脈)が1コマンドずつ進める.
+ * 制御割り込みはデータフラッシュに触れないので,書き込み中も止まらない.
+ *
+ * 保存しているのはゴール領域,光センサ距離変換表,壁判断基準値,横壁制御のゲイン,左右センサ基準値と探索の途中保存.
+ * 途中保存は再開モードで,それ以外は起動時に読み込む(保存がなければ#defineの初期値のまま).
+ * 左右センサ基準値は走行の前にも取り直すので,起動時の値は取り直さないモードで使われる.
+ */
+
+#ifndef __PARAMSTORE_H__
+#define __PARAMSTORE_H__
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "../typedefine.h"
+#include "../Peripherals/DataFlash.h"
+#include <stdbool.h>
+
+/*----------------------------------------------------------------------
+	Macro Definitions
+ ----------------------------------------------------------------------*/
+#define PARAM_PAGE_SIZE		(2 * DF_BLOCK_SIZE)	// ページの大きさ(データフラッシュの2ブロック)
+#define PARAM_PAGE_NUM		4				// ページ数(DB00〜DB07を使う)
+#define PARAM_KEY_MAX		32				// キーの数の上限(PARAM_KEY_NUMはこれ以下)
+#define PARAM_VALUE_MAX		64				// 値の最大バイト数
+#define PARAM_QUEUE_SIZE	8				// 書き込み待ちの数
+#define PARAM_TASK_MS		1				// 書き込みを進める周期 [msec]
+#define PARAM_MAP_KEY_NUM	16				// 迷路マップに割り当てるキーの数(MAZE_SIZE 32まで足りる)
+#define PARAM_SEARCHED_KEY_NUM	2			// 探索済み区画に割り当てるキーの数(MAZE_SIZE 32まで足りる)
+
+// ==== キー(値の形を変えたらキーも変えること.読み出しは長さが一致したときだけ成功する) ====
+// (上限を#ifで確かめられるよう,enumではなく#defineで並べる)
+#define PARAM_KEY_GOAL			0										// ゴール領域(x, y, w, h)
+#define PARAM_KEY_LS_DIST		(PARAM_KEY_GOAL + 1)					// 光センサ距離変換表(E_LS_CHANNEL順に4つ)
+#define PARAM_KEY_LS_DIST_END	(PARAM_KEY_LS_DIST + 4)
+#define PARAM_KEY_WALL_BASE		PARAM_KEY_LS_DIST_END					// 壁判断基準値(E_LS_CHANNEL順に4つ)
+#define PARAM_KEY_SIDE_GAIN		(PARAM_KEY_WALL_BASE + 1)				// 横壁制御のゲイン(SideGain)
+#define PARAM_KEY_LS_BASE		(PARAM_KEY_SIDE_GAIN + 1)				// 左右センサ基準値(左, 右)
+#define PARAM_KEY_MAP			(PARAM_KEY_LS_BASE + 1)					// 迷路マップ(数行ずつ)
+#define PARAM_KEY_SEARCHED		(PARAM_KEY_MAP + PARAM_MAP_KEY_NUM)		// 探索済み区画(行ごとのビット)
+#define PARAM_KEY_SEARCH_STATE	(PARAM_KEY_SEARCHED + PARAM_SEARCHED_KEY_NUM)	// 探索の再開位置
+#define PARAM_KEY_NUM			(PARAM_KEY_SEARCH_STATE + 1)
+
+#if PARAM_KEY_NUM > PARAM_KEY_MAX
+#error "PARAM_KEY_NUM exceeds PARAM_KEY_MAX"
+#endif
+
+/*----------------------------------------------------------------------
+	Type Definitions
+ ----------------------------------------------------------------------*/
+typedef _UBYTE PARAM_KEY;		// キー(PARAM_KEY_*)
+
+/*----------------------------------------------------------------------
+	Public Method Declarations
+ ----------------------------------------------------------------------*/
+bool ParamStore_Initialize(void);
+bool ParamStore_Get(PARAM_KEY key, void* buf, _UBYTE len);
+bool ParamStore_Set(PARAM_KEY key, const void* data, _UBYTE len);
+bool ParamStore_IsBusy(void);
+void ParamStore_Flush(void);
+
+#endif /* __PARAMSTORE_H__ */
@@ -19,6 +19,7 @@
 #include "Devices/LightSensor.h"
 #include "Devices/AD-128160-UART.h"
 #include "Controller/MouseController.h"
+#include "Peripherals/Profiler.h"
 
 #pragma section IntPRG
 
@@ -58,11 +59,18 @@ void Excep_CMT0_CMI0(void){ }
 // CMTU1_CMT1
 void Excep_CMT1_CMI1(void)
 {
+	PROFILE_ENTER_LATENCY(PROFILE_CMT1, CMT1.CMCNT * 4);	// PCLK/32 -> PCLK/8
 	RSPI0_IntCMT1();
+	PROFILE_EXIT(PROFILE_CMT1);
 }
 
 // CMTU2_CMT2
-void Excep_CMT2_CMI2(void){ }
+void Excep_CMT2_CMI2(void)
+{
+	PROFILE_ENTER_LATENCY(PROFILE_CMT2, CMT2.CMCNT);
+	Timer_IntCMT2();
+	PROFILE_EXIT(PROFILE_CMT2);
+}
 
 // CMTU3_CMT3
 void Excep_CMT3_CMI3(void){ }
@@ -91,13 +99,17 @@ void Excep_USB1_USBI1(void){ }
 // RSPI0 SPRI0
 void Excep_RSPI0_SPRI0(void)
 {
+	PROFILE_ENTER(PROFILE_RSPI0_SPRI0);
 	Int_SPRI0();
+	PROFILE_EXIT(PROFILE_RSPI0_SPRI0);
 }
 
 // RSPI0 SPTI0
 void Excep_RSPI0_SPTI0(void)
 {
+	PROFILE_ENTER(PROFILE_RSPI0_SPTI0);
 	Int_SPTI0();
+	PROFILE_EXIT(PROFILE_RSPI0_SPTI0);
 }
 
 // RSPI0 SPII0
@@ -330,11 +342,18 @@ void Excep_TPU7_TGIB7(void){ }
 // TPU8/MTU2 TGIA8/TGIA2
 void Excep_TPU8_TGIA8(void)
 {
+	PROFILE_ENTER_LATENCY(PROFILE_MTU2_TGIA, MTU2.TCNT / 2);	// PCLK/4 -> PCLK/8
 	MouseController_IntMTU2TGIA();
+	PROFILE_EXIT(PROFILE_MTU2_TGIA);
 }
 
 // TPU8/MTU2 TGIB8/TGIB2
-void Excep_TPU8_TGIB8(void){ }
+void Excep_TPU8_TGIB8(void)
+{
+	PROFILE_ENTER(PROFILE_MTU2_TGIB);
+	MouseController_IntMTU2TGIB();
+	PROFILE_EXIT(PROFILE_MTU2_TGIB);
+}
 
 // TPU9/MTU3 TGIA9/TGIA3
 void Excep_TPU9_TGIA9(void){ }
@@ -471,14 +490,21 @@ void Excep_RIIC3_TEI0(void){ }
 // DMACA DMAC0
 void Excep_DMACA_DMAC0(void)
 {
+	PROFILE_ENTER(PROFILE_DMAC0);
 	LightSensor_IntDMAC0();
+	PROFILE_EXIT(PROFILE_DMAC0);
 }
 
 // DMAC DMAC1
 void Excep_DMACA_DMAC1(void){ }
 
 // DMAC DMAC2
-void Excep_DMACA_DMAC2(void){ }
+void Excep_DMACA_DMAC2(void)
+{
+	PROFILE_ENTER(PROFILE_DMAC2);
+	RSPI0_IntDMAC2();
+	PROFILE_EXIT(PROFILE_DMAC2);
+}
 
 // DMAC DMAC3
 void Excep_DMACA_DMAC3(void){ }
@@ -510,6 +536,7 @@ void Excep_SCI1_RXI1(void)
 // SCI1_TXI1
 void Excep_SCI1_TXI1(void)
 {
+	PROFILE_ENTER(PROFILE_SCI1_TXI1);
 	if(SERIAL_TARGET_IS_CONSOLE)
 	{
 		SCI_IntTXI1();
@@ -518,6 +545,7 @@ void Excep_SCI1_TXI1(void)
 	{
 		AD128160_IntTXI();
 	}
+	PROFILE_EXIT(PROFILE_SCI1_TXI1);
 }
 
 // SCI1_TEI1
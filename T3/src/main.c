@@ -14,6 +14,7 @@
 #include "Peripherals/Timer.h"
 #include "Peripherals/SerialPort.h"
 #include "Peripherals/RSPI.h"
+#include "Peripherals/Profiler.h"
 #include "UserInterfaces/LED.h"
 #include "UserInterfaces/Switch.h"
 #include "UserInterfaces/Speaker.h"
@@ -27,6 +28,8 @@
 #include "Controller/MouseController.h"
 #include "Controller/Search.h"
 
+#include "Utils/ParamStore.h"
+
 /*----------------------------------------------------------------------
 	Macro Definitions
  ----------------------------------------------------------------------*/
@@ -53,6 +56,12 @@ extern "C"
  */
 void main(void)
 {
+	// タイマーの初期化(以降のWaitMS,WaitUSはこれを使う)
+	Timer_Initialize();
+
+	// 割り込み処理時間計測の初期化
+	Profiler_Initialize();
+
 	// LEDの初期化
 	LED_Initialize();
 
@@ -80,6 +89,37 @@ void main(void)
 	// 光センサの初期化
 	LightSensor_Initialize();
 
+	// 不揮発パラメータの初期化,保存してある壁判断基準値,横壁制御のゲイン,左右センサ基準値,光センサ距離変換表の読み込み
+	// (壁判断基準値は仮の距離変換表を作り直すので,距離変換表より先に読む)
+	ParamStore_Initialize();
+	{
+		_SWORD dist[LS_DIST_POINTS];
+		_SWORD wall[4], lsBase[2];
+		SideGain gain;
+		_UBYTE ch;
+
+		if(ParamStore_Get(PARAM_KEY_WALL_BASE, wall, sizeof(wall)))
+		{
+			LightSensor_SetWallBase(wall);
+		}
+		if(ParamStore_Get(PARAM_KEY_SIDE_GAIN, &gain, sizeof(gain)))
+		{
+			MouseController_SetSideGain(&gain);
+		}
+		if(ParamStore_Get(PARAM_KEY_LS_BASE, lsBase, sizeof(lsBase)))
+		{
+			LightSensor_GetValue()->Base.Left = lsBase[0];
+			LightSensor_GetValue()->Base.Right = lsBase[1];
+		}
+		for(ch = 0; ch < PARAM_KEY_LS_DIST_END - PARAM_KEY_LS_DIST; ch++)
+		{
+			if(ParamStore_Get((PARAM_KEY)(PARAM_KEY_LS_DIST + ch), dist, sizeof(dist)))
+			{
+				LightSensor_SetDistTable((E_LS_CHANNEL)ch, dist);
+			}
+		}
+	}
+
 	// RSPIの初期化
 	InitializeRSPI0();
 	DispLED(0x01);
@@ -106,12 +146,22 @@ void main(void)
 	PlaySound(300);
 	PlaySound(100);
 
-	// SPIサイクル動作開始
-//	RSPI0_StartCycleOperation();
+	// SPIサイクル動作開始(ジャイロ,エンコーダの値はこれで読み出す)
+	RSPI0_StartCycleOperation();
 
 	// 制御器の初期化
 	MouseController_Initialize();
 
+	// ジャイロのバイアス推定(静止させておくこと)
+	if(!MPU6500_Calibrate())
+	{
+		Printf("Gyro calibration failed\n");
+		PlaySound(1000);
+	}
+
+	// 探索の初期化
+	Search_Init();
+
 	while (1)
 	{
 		DispLED(0x01);
@@ -145,10 +195,12 @@ void main(void)
 				//AD128160_Locate(5, 0);
 				while(!GetSwitchState())
 				{
-					Printf(" LAng:%6d, ", AS5055_GetAngle(ENC_L));
-					Printf(" RAng:%6d\n", AS5055_GetAngle(ENC_R));
-					_UBYTE led = (_UBYTE)(AS5055_GetAngle(ENC_L)/512);
-					led = (led << 2) | ((_UBYTE)(AS5055_GetAngle(ENC_R)/512) & 0x03);
+					SensorFrame frame;
+					MouseController_GetSensorFrame(&frame);
+					Printf(" LAng:%6d, ", frame.EncL);
+					Printf(" RAng:%6d\n", frame.EncR);
+					_UBYTE led = (_UBYTE)(frame.EncL/512);
+					led = (led << 2) | ((_UBYTE)(frame.EncR/512) & 0x03);
 					DispLED(led);
 					WaitMS(100);
 				}
@@ -163,6 +215,53 @@ void main(void)
 			case 6:
 				MouseController_CheckValue();
 				break;
+			case 7:
+				Search_InputGoal();
+				break;
+			case 8:
+				Search_MakeTimeRoute();
+				break;
+			case 9:
+				Search_FastRun();
+				break;
+			case 10:
+				// スラローム探索
+				PlaySound(500);
+				PlaySound(500);
+				PlaySound(500);
+				WaitMS(1000);
+				LightSensor_GetBaseLR();
+				_MF.STATE.BIT.SLAL = 1;
+				Search_Adachi();
+				_MF.STATE.BIT.SLAL = 0;
+				break;
+			case 11:
+				// 割り込み処理時間の出力(スイッチで集計をリセット)
+				Profiler_Dump();
+				while(!GetSwitchState())
+				{
+					WaitMS(10);
+				}
+				Profiler_Reset();
+				break;
+			case 12:
+				// 光センサの距離較正(左右に壁のある区画で機体前端を前壁につけて置く)
+				PlaySound(500);
+				WaitMS(1000);
+				MouseController_CalibrateSensor();
+				while(!GetSwitchState())
+				{
+					WaitMS(10);
+				}
+				break;
+			case 13:
+				// 途中保存した所から探索を再開(保存した区画の中央に,保存した方向へ向けて置く)
+				Search_Resume();
+				break;
+			case 14:
+				// 壁判断基準値,横壁制御のゲインをシリアルから入力
+				MouseController_InputParam();
+				break;
 			default:
 				//	LightSensor用
 				LightSensor_GetBaseLR();
@@ -0,0 +1,409 @@
+/**
+ * @file  ControlTest.c
+ * @brief 制御割り込み(MouseController_IntMTU2TGIA)の浮動小数点/固定小数点の比較試験
+ *
+ * MouseController.c,WheelEstimator.cをそのまま取り込み,センサ,モータを置き換えて同じ走行をさせる.
+ * CONTROL_FIXED_POINT=0でビルドしたものは機体の模型(車輪速度の1次遅れ,エンコーダ,横壁センサ,ジャイロ)
+ * を閉ループで走らせ,制御周期ごとのセンサ値と出力を標準出力に書く.
+ * CONTROL_FIXED_POINT=1でビルドしたものはその記録(CONTROL_TRACE_FILE)のセンサ値を順に与えて
+ * 同じ走行をさせ,出力を比べる.
+ *   - 走行区間の数が同じであること
+ *   - 各制御周期のduty差がTEST_DUTY_TOL以内であること
+ *     (車輪速度制御では,0付近の目標車輪速度の符号が食い違い,摩擦分が変わった周期を除く)
+ *   - 区間の終了判定が記録と食い違った周期数がTEST_SLIP_MAX以内であること
+ *     (区間の終了は記録に合わせて進めるので,出力の差は演算の差だけになる)
+ * あわせて制御割り込み1回あたりの時間を表示する(ホストの時間で,実機の比ではない).
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "Controller/MouseController.c"
+#include "Controller/WheelEstimator.c"
+
+/*----------------------------------------------------------------------
+	Private Macro Definitions
+ ----------------------------------------------------------------------*/
+#define TEST_CYCLE_MAX		20000	// 走行全体の制御周期数の上限
+#define TEST_DUTY_TOL		0.05	// 各制御周期でのduty差の上限 [%]
+#define TEST_SLIP_MAX		8		// 区間の終了判定が記録と食い違った周期数の上限
+#define TEST_GAIN_R			0.97	// 右車輪の効きの比(左右差で横壁制御,角速度ループを働かせる)
+#define TEST_ENC_JITTER_US	50		// エンコーダの取得時刻のばらつき [usec]
+#define TEST_LS_PER_MM		10.0	// 横壁センサの差分値の変化 [1/mm]
+
+// 車輪速度の模型(モータモデルのduty->車輪速度と,機体質量の半分を1輪で動かすときの機械的時定数)
+#define TEST_MMPS_PER_DUTY	(1.0 / VEL_FF_V)	// [mm/s/%]
+#define TEST_TAU			(HW_MOTOR_R * (HW_MASS / 2.0) * (HW_WHEEL_DIAM / 2000.0) * (HW_WHEEL_DIAM / 2000.0) \
+								/ (HW_GEAR_RATIO * HW_GEAR_RATIO) / (HW_MOTOR_KT * HW_MOTOR_KE))	// [sec]
+#define TEST_COUNT_PER_MM	((1 << ENCODER_RESOLUTION) / (PI * HW_WHEEL_DIAM))
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+static double _duty[2];			// モータへの出力(正で前進) [%]
+#if !CONTROL_FIXED_POINT
+// ---- 機体の模型 ----
+static double _wheelV[2];		// 車輪速度 [mm/s]
+static double _wheelPos[2];		// 車輪の回転量 [mm]
+static double _lateral = 0;		// 区画中央からの横ずれ(右が正) [mm]
+static double _heading = 0;		// 進行方向のずれ(右回りが正) [rad]
+#endif
+static LSVal _lsv;
+
+// ---- 走行の記録(1制御周期分のセンサ値と出力) ----
+typedef struct
+{
+	_UDWORD TimeUS;				// 現在時刻 [usec]
+	_UWORD Angle[2];			// エンコーダの角度
+	_UDWORD Stamp[2];			// エンコーダの取得時刻 [usec]
+	_SWORD Gyro;				// ジャイロの角速度
+	float Lateral;				// 区画中央からの横ずれ(右が正) [mm]
+	_UWORD Seg;					// 終了した区間の数
+	_UBYTE Active;				// 区間を実行中なら1
+	float DutyL, DutyR;			// モータへの出力 [%]
+	float TarL, TarR;			// 車輪の目標速度(車輪速度制御のとき) [mm/s]
+}TestRecord;
+
+static TestRecord _in;			// 制御割り込みに与えるセンサ値
+
+static TestRecord _rec[TEST_CYCLE_MAX];
+static int _cycles = 0;
+static double _isrNS = 0;		// 制御割り込みの時間の合計 [nsec]
+
+/*----------------------------------------------------------------------
+	デバイスの置き換え(機体の模型から値を返す)
+ ----------------------------------------------------------------------*/
+_UWORD AS5055_GetAngle(E_AS5055_LR encLR)		{ return _in.Angle[encLR]; }
+_UDWORD AS5055_GetStamp(E_AS5055_LR encLR)		{ return _in.Stamp[encLR]; }
+
+bool DRV8836_DriveMotor(E_MOTOR_TYPE type, E_MOTOR_DIR dir, float duty)
+{
+	// 左はCCW,右はCWが前進
+	if(type == MOTOR_TYPE_LEFT)
+	{
+		_duty[0] = (dir == MOTOR_DIR_CCW) ? duty : -duty;
+	}
+	else
+	{
+		_duty[1] = (dir == MOTOR_DIR_CW) ? duty : -duty;
+	}
+	return true;
+}
+
+void LightSensor_Update(void)
+{
+	LSChannel now;
+
+	// 横壁に近いほど差分値が大きい
+	now.Left = (_SWORD)(200 - TEST_LS_PER_MM * _in.Lateral);
+	now.Right = (_SWORD)(200 + TEST_LS_PER_MM * _in.Lateral);
+	now.FwdL = now.FwdR = 100;
+	_lsv.Old = _lsv.Now;
+	_lsv.Now = now;
+	_lsv.Dif = now;
+	_lsv.Delta.Left = now.Left - _lsv.Old.Left;
+	_lsv.Delta.Right = now.Right - _lsv.Old.Right;
+	_lsv.Dist.Left = LS_MM(LS_DIST_SIDE_CENTER + _in.Lateral);
+	_lsv.Dist.Right = LS_MM(LS_DIST_SIDE_CENTER - _in.Lateral);
+}
+
+LSVal* LightSensor_GetValue(void)				{ return &_lsv; }
+_UDWORD LightSensor_GetStamp(void)				{ return _in.TimeUS; }
+void LightSensor_TriggerScan(void)				{}
+void LightSensor_SetDistTable(E_LS_CHANNEL ch, const _SWORD* ad)	{ (void)ch; (void)ad; }
+const _SWORD* LightSensor_GetDistTable(E_LS_CHANNEL ch)	{ (void)ch; return NULL; }
+void LightSensor_GetBaseLR(void)				{}
+void LightSensor_SetWallBase(const _SWORD* base)	{ (void)base; }
+const _SWORD* LightSensor_GetWallBase(void)		{ return NULL; }
+void LightSensor_PrintDistTable(void)			{}
+float Battery_GetValue(void)					{ return HW_BATTERY_NOMINAL; }
+
+_SWORD MPU6500_GetAngVel(void)					{ return _in.Gyro; }
+void MPU6500_TrackBias(void)					{}
+void MPU6500_GetSample(ImuSample* sample)
+{
+	memset(sample, 0, sizeof(*sample));
+	sample->GyroZ = _in.Gyro;
+	sample->Stamp = _in.TimeUS;
+}
+
+_UDWORD Timer_GetTimeUS(void)					{ return _in.TimeUS; }
+bool Timer_AddTask(void (*task)(void), _UWORD periodMS)	{ (void)task; (void)periodMS; return true; }
+void RSPI0_TriggerCycleOperation(void)			{}
+void Int_SPRI0(void)							{}
+bool ParamStore_Set(PARAM_KEY key, const void* data, _UBYTE len)	{ (void)key; (void)data; (void)len; return true; }
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+#if !CONTROL_FIXED_POINT
+/** 機体の模型を1制御周期分進め,センサ値を作る
+ */
+static void Test_Plant(void)
+{
+	const double dt = 1.0 / CONTROL_FREQ;
+	double v, yaw, count;
+	int w;
+
+	for(w = 0; w < 2; w++)
+	{
+		_wheelV[w] += (_duty[w] * TEST_MMPS_PER_DUTY * ((w == 1) ? TEST_GAIN_R : 1.0) - _wheelV[w]) * dt / TEST_TAU;
+		_wheelPos[w] += _wheelV[w] * dt;
+	}
+	v = (_wheelV[0] + _wheelV[1]) / 2;
+	yaw = (_wheelV[0] - _wheelV[1]) / HW_TREAD_WIDTH;
+	_heading += yaw * dt;
+	_lateral += v * sin(_heading) * dt;
+	_lateral = fmax(-20.0, fmin(20.0, _lateral));
+
+	_in.TimeUS += 1000000 / CONTROL_FREQ;
+	for(w = 0; w < 2; w++)
+	{
+		// 右は逆回転が前進
+		count = _wheelPos[w] * TEST_COUNT_PER_MM;
+		_in.Angle[w] = (_UWORD)((_SDWORD)floor((w == ENC_L) ? count : -count) & ((1 << ENCODER_RESOLUTION) - 1));
+		_in.Stamp[w] = _in.TimeUS - 300 - (_UDWORD)((_in.TimeUS / 1000 * 7 + w * 13) % TEST_ENC_JITTER_US);
+	}
+	_in.Gyro = (_SWORD)lround(yaw * 180.0 / PI * GYRO_LSB_PER_DPS / HW_GYRO_SIGN);
+	_in.Lateral = (float)_lateral;
+}
+#else
+static TestRecord _ref[TEST_CYCLE_MAX];	// 浮動小数点で走らせた記録
+static int _refCycles = 0;
+static int _slip = 0;					// 終了判定が記録と食い違った周期数
+#endif
+
+/** 1制御周期分のセンサ値を与えて制御割り込みを実行し,記録する
+ *   (浮動小数点は機体の模型から,固定小数点は浮動小数点の記録から与える)
+ */
+static void Test_Cycle(void)
+{
+	struct timespec t0, t1;
+
+	if(_cycles >= TEST_CYCLE_MAX)
+	{
+		printf("FAIL: the course did not finish in %d cycles\n", TEST_CYCLE_MAX);
+		exit(1);
+	}
+
+#if !CONTROL_FIXED_POINT
+	Test_Plant();
+#else
+	CTRL_VAL segEnd = _segEnd;
+	_UDWORD segEndTick = _segEndTick;
+	_UWORD segFlag = _seg.Flag;
+	bool refEnd, ownEnd, held = _segActive;
+
+	if(_cycles >= _refCycles)
+	{
+		printf("FAIL: the course ran longer than the float run (%d cycles)\n", _refCycles);
+		exit(1);
+	}
+	_in = _ref[_cycles];
+
+	// 区間の終了は記録に合わせる(開ループなので,しきい値の僅かな差で終了が前後すると
+	// 以降の出力を比べられず,旋回などが終わらなくなる).実行中の区間は割り込みの中では終えない
+	refEnd = _ref[_cycles].Seg != ((_cycles > 0) ? _ref[_cycles - 1].Seg : 0);
+	if(held)
+	{
+		_segEnd = (CTRL_VAL)0x7fffffff;
+		_segEndTick = 0xffffffff;
+		_seg.Flag &= ~SEG_END_ANGVMAX;
+	}
+#endif
+
+	// ---- 制御割り込み ----
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	MouseController_IntMTU2TGIA();
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	_isrNS += (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+
+#if CONTROL_FIXED_POINT
+	if(held)
+	{
+		_segEnd = segEnd;
+		_segEndTick = segEndTick;
+		_seg.Flag = segFlag;
+	}
+	// 固定小数点での終了判定が記録と食い違った周期を数える
+	ownEnd = _segActive && MouseController_IsSegmentEnd();
+	if(ownEnd != refEnd)
+	{
+		_slip++;
+	}
+	if(refEnd && _segActive)
+	{
+		MouseController_EndSegment();
+	}
+#endif
+
+	_rec[_cycles] = _in;
+	_rec[_cycles].Seg = _segDone;
+	_rec[_cycles].Active = _segActive;
+	_rec[_cycles].DutyL = (float)_duty[0];
+	_rec[_cycles].DutyR = (float)_duty[1];
+#if VELOCITY_FEEDBACK
+	_rec[_cycles].TarL = CTRL_TO_FLOAT(_velCtrlL.TarOld);
+	_rec[_cycles].TarR = CTRL_TO_FLOAT(_velCtrlR.TarOld);
+#endif
+	_cycles++;
+}
+
+/** 待ち(制御周期を進める)
+ */
+static void Test_WaitMS(_UINT msec)
+{
+	_UDWORD n;
+
+	for(n = 0; n < (_UDWORD)msec * CONTROL_FREQ / 1000; n++)
+	{
+		Test_Cycle();
+	}
+}
+
+/** 走行(直進,超信地旋回,スラローム,後退を一通り)
+ */
+static void Test_Course(void)
+{
+	Yield = Test_Cycle;
+	WaitMS = Test_WaitMS;
+#if WHEEL_ESTIMATOR
+	WheelEstimator_Reset(&_estL);
+	WheelEstimator_Reset(&_estR);
+#endif
+
+	SectionAD(6);
+	TurnR90AD();
+	HalfSectionA();
+	SlalomR90();
+	SlalomL90();
+	HalfSectionD();
+	TurnL180AD();
+	SectionAD(1);
+	SetPosition();
+	TurnL90AD();
+	TurnR180AD();
+}
+
+#if CONTROL_FIXED_POINT && VELOCITY_FEEDBACK
+/** 符号
+ * @retval int: -1, 0, 1
+ */
+static int Test_Sign(float v)
+{
+	return (v > 0) - (v < 0);
+}
+#endif
+
+/*----------------------------------------------------------------------
+	Main
+ ----------------------------------------------------------------------*/
+int main(void)
+{
+	int i;
+#if CONTROL_FIXED_POINT
+	FILE* fp;
+	TestRecord* r;
+	unsigned u[7];
+	int gyro;
+	int segs, slip, compared = 0, signFlip = 0;
+	double refNS, diff, maxDiff = 0;
+
+	// ---- 浮動小数点の記録を読む ----
+	fp = fopen(CONTROL_TRACE_FILE, "r");
+	if((fp == NULL) || (fscanf(fp, "%d %lf", &_refCycles, &refNS) != 2)
+		|| (_refCycles <= 0) || (_refCycles > TEST_CYCLE_MAX))
+	{
+		printf("FAIL: cannot read %s\n", CONTROL_TRACE_FILE);
+		return 1;
+	}
+	for(i = 0; i < _refCycles; i++)
+	{
+		r = &_ref[i];
+		if(fscanf(fp, "%u %u %u %u %u %d %f %u %u %f %f %f %f", &u[0], &u[1], &u[2], &u[3], &u[4], &gyro,
+					&r->Lateral, &u[5], &u[6], &r->DutyL, &r->DutyR, &r->TarL, &r->TarR) != 13)
+		{
+			printf("FAIL: %s is short\n", CONTROL_TRACE_FILE);
+			return 1;
+		}
+		r->TimeUS = u[0];
+		r->Angle[0] = (_UWORD)u[1];
+		r->Angle[1] = (_UWORD)u[2];
+		r->Stamp[0] = u[3];
+		r->Stamp[1] = u[4];
+		r->Gyro = (_SWORD)gyro;
+		r->Seg = (_UWORD)u[5];
+		r->Active = (_UBYTE)u[6];
+	}
+	fclose(fp);
+#endif
+
+	Test_Course();
+
+#if !CONTROL_FIXED_POINT
+	// ---- 記録を書き出す ----
+	printf("%d %.1f\n", _cycles, _isrNS / _cycles);
+	for(i = 0; i < _cycles; i++)
+	{
+		printf("%u %u %u %u %u %d %.9g %u %u %.6f %.6f %.6f %.6f\n", (unsigned)_rec[i].TimeUS,
+				_rec[i].Angle[0], _rec[i].Angle[1], (unsigned)_rec[i].Stamp[0], (unsigned)_rec[i].Stamp[1],
+				_rec[i].Gyro, _rec[i].Lateral, _rec[i].Seg, _rec[i].Active, _rec[i].DutyL, _rec[i].DutyR,
+				_rec[i].TarL, _rec[i].TarR);
+	}
+	return 0;
+#else
+	// ---- 各周期の出力を比べる(区間が食い違った周期は終了判定の差に数える) ----
+	segs = _rec[_cycles - 1].Seg;
+	if(segs != _ref[_refCycles - 1].Seg)
+	{
+		printf("FAIL: %d segments, float ran %d\n", segs, _ref[_refCycles - 1].Seg);
+		return 1;
+	}
+	slip = _slip + abs(_cycles - _refCycles);
+	for(i = 0; (i < _cycles) && (i < _refCycles); i++)
+	{
+		if((_rec[i].Seg != _ref[i].Seg) || (_rec[i].Active != _ref[i].Active))
+		{
+			slip++;
+			continue;
+		}
+#if VELOCITY_FEEDBACK
+		// 摩擦分は目標車輪速度の符号で±VEL_FF_F変わるので,0付近で符号が食い違った周期は比べない
+		if((Test_Sign(_rec[i].TarL) != Test_Sign(_ref[i].TarL)) || (Test_Sign(_rec[i].TarR) != Test_Sign(_ref[i].TarR)))
+		{
+			signFlip++;
+			continue;
+		}
+#endif
+		diff = fmax(fabs(_rec[i].DutyL - _ref[i].DutyL), fabs(_rec[i].DutyR - _ref[i].DutyR));
+		if(diff > TEST_DUTY_TOL)
+		{
+			printf("FAIL: cycle %d (segment %d): duty differs by %.4f %%\n", i, _rec[i].Seg, diff);
+			return 1;
+		}
+		maxDiff = fmax(maxDiff, diff);
+		compared++;
+	}
+	if(slip > TEST_SLIP_MAX)
+	{
+		printf("FAIL: %d cycles of segment end decisions differ\n", slip);
+		return 1;
+	}
+
+	printf("control: %d segments, %d cycles, duty within %.4f %% of float (segment end differs in %d cycles)\n",
+			segs, compared, maxDiff, slip);
+	if(signFlip > 0)
+	{
+		printf("  %d cycles not compared: the wheel target crossed 0 mm/s on one side only\n", signFlip);
+	}
+	printf("time per ISR on this host: float %.0f ns, Q16.16 %.0f ns\n", refNS, _isrNS / _cycles);
+	printf("%s: PASS\n", CONTROL_TEST_NAME);
+	return 0;
+#endif
+}
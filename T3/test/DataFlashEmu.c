@@ -0,0 +1,265 @@
+/**
+ * @file  DataFlashEmu.c
+ * @brief ホストで動かすデータフラッシュの模擬
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "DataFlashEmu.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------
+	Private Macro Definitions
+ ----------------------------------------------------------------------*/
+#define DFEMU_ERASE_TICKS	3		// 消去にかかるTick数
+#define DFEMU_WRITE_TICKS	1		// 書き込みにかかるTick数
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+// 共有メモリ上(電源を入れ直しても残る)
+static _UBYTE* _data = NULL;			// 内容
+static _UBYTE* _written = NULL;			// 書き込んだバイト(0なら消去したまま)
+static _UDWORD* _eraseCount = NULL;		// 消去単位ごとの消去回数
+
+// プロセスごと
+static bool _busy = false;
+static int _busyTicks = 0;
+static E_DF_STATUS _result = DF_READY;
+static long _cutAfter = -1;				// このコマンド数で電源を切る(負なら切らない)
+static long _commands = 0;
+static bool _cut = false;
+static bool _failNext = false;
+
+/*----------------------------------------------------------------------
+	Private Method Declarations
+ ----------------------------------------------------------------------*/
+static bool DataFlashEmu_StartCommand(void);
+
+/*----------------------------------------------------------------------
+	Public Method Definitions
+ ----------------------------------------------------------------------*/
+/** 模擬の初期化
+ *   共有メモリを割り当て,内容を不定値(一度も書いていない)にする
+ * @param shared: DataFlashEmu_SharedSize()バイトの共有メモリ
+ * @retval void
+ */
+void DataFlashEmu_Initialize(void* shared)
+{
+	_UDWORD i;
+
+	_data = (_UBYTE*)shared;
+	_written = _data + DF_SIZE;
+	_eraseCount = (_UDWORD*)(_written + DF_SIZE);
+
+	for(i = 0; i < DF_SIZE; i++)
+	{
+		_data[i] = (_UBYTE)rand();
+		_written[i] = 1;				// 出荷時の内容も不定なので,書いたものとして扱う
+	}
+	memset(_eraseCount, 0, sizeof(_UDWORD) * DFEMU_ERASE_BLOCKS);
+}
+
+/** 模擬に必要な共有メモリの大きさ
+ * @param void
+ * @retval _UDWORD: バイト数
+ */
+_UDWORD DataFlashEmu_SharedSize(void)
+{
+	return DF_SIZE * 2 + sizeof(_UDWORD) * DFEMU_ERASE_BLOCKS;
+}
+
+/** 電源断の予約
+ *   commands個のコマンドを終えたあと,次のコマンドを途中まで実行して電源を切る
+ * @param commands: 電源を切るまでのコマンド数
+ * @retval void
+ */
+void DataFlashEmu_CutAfter(long commands)
+{
+	_cutAfter = commands;
+	_commands = 0;
+	_cut = false;
+}
+
+/** 電源が切れたか
+ * @param void
+ * @retval bool: true: 切れた(以後のコマンドは何もしない)
+ */
+bool DataFlashEmu_IsCut(void)
+{
+	return _cut;
+}
+
+/** 次のコマンドを失敗させる
+ * @param void
+ * @retval void
+ */
+void DataFlashEmu_FailNext(void)
+{
+	_failNext = true;
+}
+
+/** 時間を1Tick進める
+ * @param void
+ * @retval void
+ */
+void DataFlashEmu_Tick(void)
+{
+	if(_busyTicks > 0)
+	{
+		_busyTicks--;
+	}
+}
+
+/** 消去回数の取得
+ * @param block: 消去単位の番号
+ * @retval _UDWORD: 消去回数
+ */
+_UDWORD DataFlashEmu_GetEraseCount(_UWORD block)
+{
+	return _eraseCount[block];
+}
+
+/*----------------------------------------------------------------------
+	DataFlash.hの置き換え
+ ----------------------------------------------------------------------*/
+bool DataFlash_Initialize(void)
+{
+	_busy = false;
+	_result = DF_READY;
+	return true;
+}
+
+void DataFlash_Read(_UDWORD offset, void* buf, _UWORD len)
+{
+	_UWORD i;
+
+	// 実機と同じく,実行中なら終わるまで待つ
+	_busyTicks = 0;
+	DataFlash_GetStatus();
+	for(i = 0; i < len; i++)
+	{
+		((_UBYTE*)buf)[i] = _written[offset + i] ? _data[offset + i] : (_UBYTE)rand();
+	}
+}
+
+bool DataFlash_IsBlank(_UDWORD offset)
+{
+	_busyTicks = 0;
+	DataFlash_GetStatus();
+	return !_written[offset] && !_written[offset + 1];
+}
+
+void DataFlash_StartErase(_UDWORD offset)
+{
+	_UWORD i;
+
+	if(_busy || (offset % DF_ERASE_SIZE) != 0 || (offset + DF_ERASE_SIZE) > DF_SIZE)
+	{
+		fprintf(stderr, "DataFlashEmu: bad erase 0x%lx\n", (unsigned long)offset);
+		abort();
+	}
+	if(!DataFlashEmu_StartCommand())
+	{
+		// 途中で電源が切れた: 一部だけ消える
+		for(i = 0; i < DF_ERASE_SIZE; i++)
+		{
+			if(rand() & 1)
+			{
+				_written[offset + i] = 0;
+			}
+		}
+		return;
+	}
+	_busyTicks = DFEMU_ERASE_TICKS;
+	if(_failNext)
+	{
+		_failNext = false;
+		_result = DF_ERROR;
+		return;
+	}
+	memset(&_written[offset], 0, DF_ERASE_SIZE);
+	_eraseCount[offset / DF_ERASE_SIZE]++;
+}
+
+void DataFlash_StartWrite(_UDWORD offset, const _UBYTE* data)
+{
+	_UWORD i;
+
+	if(_busy || (offset % DF_WRITE_SIZE) != 0 || (offset + DF_WRITE_SIZE) > DF_SIZE)
+	{
+		fprintf(stderr, "DataFlashEmu: bad write 0x%lx\n", (unsigned long)offset);
+		abort();
+	}
+	for(i = 0; i < DF_WRITE_SIZE; i++)
+	{
+		if(_written[offset + i])
+		{
+			fprintf(stderr, "DataFlashEmu: write to unerased 0x%lx\n", (unsigned long)offset);
+			abort();
+		}
+	}
+	if(!DataFlashEmu_StartCommand())
+	{
+		// 途中で電源が切れた: 一部のバイトが不定値になる
+		for(i = 0; i < DF_WRITE_SIZE; i++)
+		{
+			if(rand() & 1)
+			{
+				_written[offset + i] = 1;
+				_data[offset + i] = (_UBYTE)rand();
+			}
+		}
+		return;
+	}
+	_busyTicks = DFEMU_WRITE_TICKS;
+	if(_failNext)
+	{
+		// 失敗: 書きかけのまま残る
+		_failNext = false;
+		_result = DF_ERROR;
+		_written[offset] = 1;
+		_data[offset] = (_UBYTE)rand();
+		return;
+	}
+	for(i = 0; i < DF_WRITE_SIZE; i++)
+	{
+		_written[offset + i] = 1;
+		_data[offset + i] = data[i];
+	}
+}
+
+E_DF_STATUS DataFlash_GetStatus(void)
+{
+	if(_busy)
+	{
+		if(_busyTicks > 0)
+		{
+			return DF_BUSY;
+		}
+		_busy = false;
+	}
+	return _result;
+}
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+/** コマンドの開始
+ * @param void
+ * @retval bool: true: 実行する, false: 電源が切れた(以後も何もしない)
+ */
+static bool DataFlashEmu_StartCommand(void)
+{
+	if(_cut || ((_cutAfter >= 0) && (_commands++ >= _cutAfter)))
+	{
+		_cut = true;
+		return false;
+	}
+	_busy = true;
+	_result = DF_READY;
+	return true;
+}
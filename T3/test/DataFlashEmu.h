@@ -0,0 +1,33 @@
+/**
+ * @file  DataFlashEmu.h
+ * @brief ホストで動かすデータフラッシュの模擬(DataFlash.hの関数を置き換える)
+ *
+ * 消去したままのバイトは不定値を読む.電源断(指定回数目のコマンドで途中まで書いて以後は何もしない)と,
+ * 書き込み/消去の失敗を起こせる.フラッシュの内容は共有メモリに置くので,forkした子プロセスで
+ * 「電源を入れ直して」も残る.
+ */
+
+#ifndef __DATAFLASHEMU_H__
+#define __DATAFLASHEMU_H__
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "Peripherals/DataFlash.h"
+
+/*----------------------------------------------------------------------
+	Public Macro Definitions
+ ----------------------------------------------------------------------*/
+#define DFEMU_ERASE_BLOCKS	(DF_SIZE / DF_ERASE_SIZE)	// 消去単位の数
+
+/*----------------------------------------------------------------------
+	Public Method Declarations
+ ----------------------------------------------------------------------*/
+void DataFlashEmu_Initialize(void* shared);
+_UDWORD DataFlashEmu_SharedSize(void);
+void DataFlashEmu_CutAfter(long commands);
+bool DataFlashEmu_IsCut(void);
+void DataFlashEmu_FailNext(void);
+void DataFlashEmu_Tick(void);
+_UDWORD DataFlashEmu_GetEraseCount(_UWORD block);
+
+#endif
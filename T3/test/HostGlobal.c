@@ -0,0 +1,67 @@
+/**
+ * @file  HostGlobal.c
+ * @brief ホスト試験用のGlobal.c(関数ポインタの行き先をホストの処理にする)
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdarg.h>
+#include "Global.h"
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+static void Host_Printf(_UBYTE* str, ...)
+{
+	va_list ap;
+
+	va_start(ap, str);
+	vprintf((const char*)str, ap);
+	va_end(ap);
+}
+
+static void Host_Scanf(_UBYTE* str, ...)
+{
+	(void)str;			// 入力は使わない
+}
+
+static void Host_Wait(_UINT t)
+{
+	(void)t;
+}
+
+static void Host_Yield(void)
+{
+}
+
+static void Host_DispLED(_UBYTE lightPattern)
+{
+	(void)lightPattern;
+}
+
+static bool Host_GetSwitchState(void)
+{
+	return false;
+}
+
+static _UBYTE Host_ModeSelect(void)
+{
+	return 0;
+}
+
+/*----------------------------------------------------------------------
+	グローバル変数の定義
+ ----------------------------------------------------------------------*/
+volatile struct stMouseFlags _MF;
+
+void (*Printf)(_UBYTE*, ...) = Host_Printf;
+void (*Scanf)(_UBYTE* str, ...) = Host_Scanf;
+void (*WaitMS)(_UINT msec) = Host_Wait;
+void (*WaitUS)(_UINT usec) = Host_Wait;
+void (*Yield)(void) = Host_Yield;
+void (*DispLED)(_UBYTE lightPattern) = Host_DispLED;
+void (*PlaySound)(_UINT freq) = Host_Wait;
+bool (*GetSwitchState)(void) = Host_GetSwitchState;
+_UBYTE (*ModeSelect)(void) = Host_ModeSelect;
@@ -0,0 +1,76 @@
+/**
+ * @file  HostMouse.c
+ * @brief ホスト試験用の走行,センサ関数(Search.cをリンクするためだけの空の実装)
+ *
+ * 走行関数は何もせずに戻り,センサは壁なしを返す.
+ * 探索の歩数マップ,経路の試験は走行させずに直接呼ぶ.
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include <string.h>
+#include "Controller/MouseController.h"
+#include "Devices/LightSensor.h"
+#include "Utils/ParamStore.h"
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+static LSVal _lsv;
+
+/*----------------------------------------------------------------------
+	MouseController.hの置き換え
+ ----------------------------------------------------------------------*/
+void HalfSectionA(void)		{}
+void HalfSectionD(void)		{}
+void TurnR90AD(void)		{}
+void TurnL90AD(void)		{}
+void TurnR180AD(void)		{}
+void SlalomR90(void)		{}
+void SlalomL90(void)		{}
+void SetPosition(void)		{}
+void MouseController_CancelSegment(void)		{}
+void MouseController_WaitSegment(_UWORD seq)	{ (void)seq; }
+_UBYTE MouseController_GetQueueSpace(void)		{ return 0xff; }
+_UWORD SectionADQueue(_UBYTE halfNum)			{ (void)halfNum; return 0; }
+_UWORD TurnR90ADQueue(void)		{ return 0; }
+_UWORD TurnL90ADQueue(void)		{ return 0; }
+_UWORD TurnR180ADQueue(void)	{ return 0; }
+
+void MouseController_GetSensorFrame(SensorFrame* frame)
+{
+	memset(frame, 0, sizeof(*frame));
+}
+
+/*----------------------------------------------------------------------
+	LightSensor.hの置き換え
+ ----------------------------------------------------------------------*/
+void LightSensor_GetBaseLR(void)	{}
+
+LSVal* LightSensor_GetValue(void)
+{
+	return &_lsv;
+}
+
+const _SWORD* LightSensor_GetWallBase(void)
+{
+	static const _SWORD wallBase[4] = {WALL_BASE_FWD_L, WALL_BASE_LEFT, WALL_BASE_RIGHT, WALL_BASE_FWD_R};
+
+	return wallBase;
+}
+
+/*----------------------------------------------------------------------
+	ParamStore.hの置き換え(何も保存しない)
+ ----------------------------------------------------------------------*/
+bool ParamStore_Get(PARAM_KEY key, void* buf, _UBYTE len)
+{
+	(void)key; (void)buf; (void)len;
+	return false;
+}
+
+bool ParamStore_Set(PARAM_KEY key, const void* data, _UBYTE len)
+{
+	(void)key; (void)data; (void)len;
+	return true;
+}
@@ -0,0 +1,24 @@
+/**
+ * @file  HostTypedefine.h
+ * @brief ホストで実機(RX)と同じ幅の型にする(typedefine.hの代わりに-includeで先に読ませる)
+ *
+ * ホストのlongは64bitなので,typedefine.hのままでは32bitの桁あふれを再現できない.
+ */
+
+#ifndef __TYPEDEFINE_H__
+#define __TYPEDEFINE_H__
+
+#include <stdint.h>
+
+typedef int8_t _SBYTE;
+typedef uint8_t _UBYTE;
+typedef int16_t _SWORD;
+typedef uint16_t _UWORD;
+typedef int32_t _SINT;
+typedef uint32_t _UINT;
+typedef int32_t _SDWORD;
+typedef uint32_t _UDWORD;
+typedef int64_t _SQWORD;
+typedef uint64_t _UQWORD;
+
+#endif
@@ -0,0 +1,226 @@
+/**
+ * @file  MazeMaskTest.c
+ * @brief 行ビット列の壁情報(MazeMask)のホスト試験
+ *
+ * 1. mapとの変換(FromMap, ToMap, LoadCell)で壁が変わらず,指定しない側の4bitを壊さないこと
+ * 2. 行単位の展開による歩数マップが,1区画ずつの幅優先探索と区画ごとに一致すること
+ *    (探索走行用,二次走行用の両方の4bit,一部未探索の迷路を含む)
+ * あわせて1区画ずつの幅優先探索との時間を比べる(16区画では波面が細く,幅優先探索の方が速い).
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "TestMaze.h"
+#include "Controller/MazeMask.h"
+
+/*----------------------------------------------------------------------
+	Private Macro Definitions
+ ----------------------------------------------------------------------*/
+#define TEST_BENCH_LOOP		20		// 時間計測で1迷路あたり繰り返す回数
+#define TEST_CELL_EDITS		200		// 1迷路あたりLoadCellで書き換える回数
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+static _UBYTE _map[MAZE_SIZE][MAZE_SIZE];
+static MazeMask _mask;
+static MAZE_ROW _goal[MAZE_SIZE];
+static MAZE_STEP _smap[MAZE_SIZE][MAZE_SIZE];
+static MAZE_STEP _ref[MAZE_SIZE][MAZE_SIZE];
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+/** 1区画ずつの幅優先探索による歩数マップ(比較用)
+ */
+static void Ref_MakeStepMap(_UBYTE shift)
+{
+	static _UWORD queue[MAZE_CELL_NUM];
+	_UWORD head = 0, tail = 0;
+	_UBYTE x, y, wall;
+
+	for(y = 0; y < MAZE_SIZE; y++)
+	{
+		for(x = 0; x < MAZE_SIZE; x++)
+		{
+			_ref[y][x] = STEP_MAX;
+			if(_goal[y] & ((MAZE_ROW)1 << x))
+			{
+				_ref[y][x] = 0;
+				queue[tail++] = (_UWORD)(y * MAZE_SIZE + x);
+			}
+		}
+	}
+	while(head != tail)
+	{
+		x = queue[head] % MAZE_SIZE;
+		y = queue[head] / MAZE_SIZE;
+		head++;
+		wall = _map[y][x] >> shift;
+		if(!(wall & 0x08) && (y != MAZE_SIZE - 1) && (_ref[y + 1][x] == STEP_MAX))
+		{
+			_ref[y + 1][x] = _ref[y][x] + 1;
+			queue[tail++] = (_UWORD)((y + 1) * MAZE_SIZE + x);
+		}
+		if(!(wall & 0x04) && (x != MAZE_SIZE - 1) && (_ref[y][x + 1] == STEP_MAX))
+		{
+			_ref[y][x + 1] = _ref[y][x] + 1;
+			queue[tail++] = (_UWORD)(y * MAZE_SIZE + x + 1);
+		}
+		if(!(wall & 0x02) && (y != 0) && (_ref[y - 1][x] == STEP_MAX))
+		{
+			_ref[y - 1][x] = _ref[y][x] + 1;
+			queue[tail++] = (_UWORD)((y - 1) * MAZE_SIZE + x);
+		}
+		if(!(wall & 0x01) && (x != 0) && (_ref[y][x - 1] == STEP_MAX))
+		{
+			_ref[y][x - 1] = _ref[y][x] + 1;
+			queue[tail++] = (_UWORD)(y * MAZE_SIZE + x - 1);
+		}
+	}
+}
+
+/** 迷路を読み込む(一部未探索なら,未探索の区画は探索走行用で壁なし,二次走行用で壁あり)
+ */
+static void Test_Load(unsigned seed, bool partial)
+{
+	static _UBYTE maze[MAZE_SIZE][MAZE_SIZE];
+	_UBYTE x, y, w, h, i, j;
+
+	TestMaze_Generate(maze, seed);
+	TestMaze_ToMap(maze, _map);
+	if(partial)
+	{
+		for(y = 0; y < MAZE_SIZE; y++)
+		{
+			for(x = 0; x < MAZE_SIZE; x++)
+			{
+				if(TestMaze_Random() & 1)
+				{
+					_map[y][x] = 0xf0;
+				}
+			}
+		}
+	}
+	TestMaze_SetGoal(seed, &x, &y, &w, &h);
+	memset(_goal, 0, sizeof(_goal));
+	for(j = y; j < y + h; j++)
+	{
+		for(i = x; i < x + w; i++)
+		{
+			_goal[j] |= (MAZE_ROW)1 << i;
+		}
+	}
+}
+
+/** mapとの変換を確かめる
+ * @retval bool: true: 正しい
+ */
+static bool Test_Convert(void)
+{
+	static _UBYTE back[MAZE_SIZE][MAZE_SIZE];
+	MazeMask whole;
+	_UBYTE shift, x, y, n, v;
+
+	for(shift = 0; shift <= MAZE_MASK_SECOND; shift += MAZE_MASK_SECOND)
+	{
+		// ---- 変換して戻すと同じ(他方の4bitは0xAで埋めて壊れないことを見る) ----
+		MazeMask_FromMap(&_mask, _map, shift);
+		for(y = 0; y < MAZE_SIZE; y++)
+		{
+			for(x = 0; x < MAZE_SIZE; x++)
+			{
+				back[y][x] = (_UBYTE)(0xaa & ~(0x0f << shift));
+			}
+		}
+		MazeMask_ToMap(&_mask, back, shift);
+		for(y = 0; y < MAZE_SIZE; y++)
+		{
+			for(x = 0; x < MAZE_SIZE; x++)
+			{
+				if(back[y][x] != (_UBYTE)((_map[y][x] & (0x0f << shift)) | (0xaa & ~(0x0f << shift))))
+				{
+					printf("FAIL: ToMap shift %d (%d, %d)\n", shift, x, y);
+					return false;
+				}
+			}
+		}
+
+		// ---- 1区画ずつ書き換えても全体を変換し直したものと同じ ----
+		for(n = 0; n < TEST_CELL_EDITS; n++)
+		{
+			x = (_UBYTE)(TestMaze_Random() % MAZE_SIZE);
+			y = (_UBYTE)(TestMaze_Random() % MAZE_SIZE);
+			v = (_UBYTE)TestMaze_Random();
+			back[y][x] = v;
+			MazeMask_LoadCell(&_mask, back, shift, x, y);
+		}
+		MazeMask_FromMap(&whole, back, shift);
+		if(memcmp(&whole, &_mask, sizeof(whole)) != 0)
+		{
+			printf("FAIL: LoadCell shift %d\n", shift);
+			return false;
+		}
+	}
+	return true;
+}
+
+/*----------------------------------------------------------------------
+	Main
+ ----------------------------------------------------------------------*/
+int main(void)
+{
+	unsigned seed;
+	int partial, i, maps = 0;
+	_UBYTE shift;
+	double t0, tMask = 0, tRef = 0;
+
+	for(partial = 0; partial < 2; partial++)
+	{
+		for(seed = 0; seed < TEST_MAZE_NUM; seed++)
+		{
+			Test_Load(seed, partial != 0);
+			if(!Test_Convert())
+			{
+				printf("  seed %u partial %d\n", seed, partial);
+				return 1;
+			}
+
+			for(shift = 0; shift <= MAZE_MASK_SECOND; shift += MAZE_MASK_SECOND)
+			{
+				MazeMask_FromMap(&_mask, _map, shift);
+				MazeMask_MakeStepMap(&_mask, _goal, _smap);
+				Ref_MakeStepMap(shift);
+				if(memcmp(_smap, _ref, sizeof(_ref)) != 0)
+				{
+					printf("FAIL: step map seed %u partial %d shift %d\n", seed, partial, shift);
+					return 1;
+				}
+				maps++;
+
+				t0 = TestMaze_NowUS();
+				for(i = 0; i < TEST_BENCH_LOOP; i++)
+				{
+					MazeMask_MakeStepMap(&_mask, _goal, _smap);
+				}
+				tMask += TestMaze_NowUS() - t0;
+				t0 = TestMaze_NowUS();
+				for(i = 0; i < TEST_BENCH_LOOP; i++)
+				{
+					Ref_MakeStepMap(shift);
+				}
+				tRef += TestMaze_NowUS() - t0;
+			}
+		}
+	}
+
+	printf("maze mask: conversions ok, %d step maps match the per-cell flood\n", maps);
+	printf("time per map: %.2f us (per-cell flood %.2f us, x%.1f)\n",
+			tMask / (maps * TEST_BENCH_LOOP), tRef / (maps * TEST_BENCH_LOOP), tRef / tMask);
+	printf("MazeMaskTest: PASS\n");
+	return 0;
+}
@@ -0,0 +1,307 @@
+/**
+ * @file  ParamStoreTest.c
+ * @brief 不揮発パラメータ(ParamStore)のホスト試験
+ *
+ * 1. 書き込みを繰り返して電源を入れ直し,全キーが最後に書いた値になること(ページの消耗の偏りも表示)
+ * 2. 書き込み中の任意の時点で電源を切り,入れ直すと各キーが古い値か新しい値のどちらかであること
+ * 3. 書き込み/消去の失敗を混ぜても,その後の書き込みが読めること
+ * 電源の入れ直しはforkした子プロセスで行う(ParamStoreの状態はプロセスごと,フラッシュは共有).
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "DataFlashEmu.h"
+#include "Utils/ParamStore.h"
+
+/*----------------------------------------------------------------------
+	Private Macro Definitions
+ ----------------------------------------------------------------------*/
+#define TEST_WRITES			3000	// 1の書き込み回数
+#define TEST_CUTS			3000	// 2の電源断の回数
+#define TEST_CUT_SHORT		20		// 電源を切るまでのコマンド数の範囲(記録の追記中)
+#define TEST_CUT_LONG		600		// 電源を切るまでのコマンド数の範囲(ページの移動を含む)
+#define TEST_FAILS			500		// 3の書き込み回数
+#define TEST_TICKS_MAX		20000	// 1回の書き込みを待つTick数の上限
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+// 期待する値(共有メモリ上)
+typedef struct
+{
+	_UBYTE Valid[PARAM_KEY_NUM];
+	_UBYTE Value[PARAM_KEY_NUM][PARAM_VALUE_MAX];
+}TestModel;
+
+static TestModel* _model;
+static _UBYTE _len[PARAM_KEY_NUM];		// キーごとの値の長さ
+static void (*_task)(void) = NULL;
+
+/*----------------------------------------------------------------------
+	Timer.hの置き換え
+ ----------------------------------------------------------------------*/
+static void Test_Tick(void)
+{
+	if(_task != NULL)
+	{
+		_task();
+	}
+	DataFlashEmu_Tick();
+}
+
+void (*Yield)(void) = Test_Tick;
+
+bool Timer_AddTask(void (*task)(void), _UWORD periodMS)
+{
+	(void)periodMS;
+	_task = task;
+	return true;
+}
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+static void Test_Random(_UBYTE* buf, _UBYTE len)
+{
+	_UBYTE i;
+
+	for(i = 0; i < len; i++)
+	{
+		buf[i] = (_UBYTE)rand();
+	}
+}
+
+/** 全キーが期待どおりか調べる
+ *   keyの値はnewValueでもよい(電源断で書き込みが終わったかどうか分からないとき).
+ *   newValueが読めたら期待値を更新する
+ * @retval bool: true: 一致
+ */
+static bool Test_Verify(int key, const _UBYTE* newValue)
+{
+	_UBYTE buf[PARAM_VALUE_MAX];
+	bool got, okOld, okNew, ok = true;
+	int k;
+
+	for(k = 0; k < PARAM_KEY_NUM; k++)
+	{
+		got = ParamStore_Get((PARAM_KEY)k, buf, _len[k]);
+		okOld = _model->Valid[k] ? (got && (memcmp(buf, _model->Value[k], _len[k]) == 0)) : !got;
+		okNew = (k == key) && got && (memcmp(buf, newValue, _len[k]) == 0);
+		if(!okOld && !okNew)
+		{
+			printf("key %d mismatch (read=%d)\n", k, got);
+			ok = false;
+		}
+		if(okNew && !okOld)
+		{
+			memcpy(_model->Value[k], newValue, _len[k]);
+			_model->Valid[k] = 1;
+		}
+	}
+	return ok;
+}
+
+/** 子プロセスで実行し,終了コードを返す
+ */
+static int Test_Run(int (*body)(void))
+{
+	int status;
+	pid_t pid;
+
+	fflush(stdout);
+	pid = fork();
+	if(pid == 0)
+	{
+		exit(body());
+	}
+	waitpid(pid, &status, 0);
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+// ---- 1: 書き込みの繰り返し ----
+static int Test_WriteBody(void)
+{
+	_UBYTE v[PARAM_VALUE_MAX];
+	int n, k, y;
+
+	ParamStore_Initialize();
+	for(n = 0; n < TEST_WRITES; n++)
+	{
+		k = rand() % PARAM_KEY_NUM;
+		Test_Random(v, _len[k]);
+		while(!ParamStore_Set((PARAM_KEY)k, v, _len[k]))
+		{
+			Yield();
+		}
+		for(y = rand() % 8; y > 0; y--)
+		{
+			Yield();
+		}
+		memcpy(_model->Value[k], v, _len[k]);
+		_model->Valid[k] = 1;
+		if((rand() % 7 == 0) && !Test_Verify(-1, NULL))
+		{
+			return 1;
+		}
+	}
+	ParamStore_Flush();
+	return Test_Verify(-1, NULL) ? 0 : 1;
+}
+
+static int Test_RebootBody(void)
+{
+	ParamStore_Initialize();
+	return Test_Verify(-1, NULL) ? 0 : 1;
+}
+
+// ---- 2: 電源断 ----
+static int _cutKey;
+static long _cutAt;
+static _UBYTE _cutValue[PARAM_VALUE_MAX];
+
+static int Test_CutBody(void)
+{
+	int t;
+
+	DataFlashEmu_CutAfter(_cutAt);
+	ParamStore_Initialize();
+	ParamStore_Set((PARAM_KEY)_cutKey, _cutValue, _len[_cutKey]);
+	for(t = 0; (t < TEST_TICKS_MAX) && ParamStore_IsBusy() && !DataFlashEmu_IsCut(); t++)
+	{
+		Yield();
+	}
+	return DataFlashEmu_IsCut() ? 2 : 0;
+}
+
+static int Test_CutVerifyBody(void)
+{
+	ParamStore_Initialize();
+	return Test_Verify(_cutKey, _cutValue) ? 0 : 1;
+}
+
+// ---- 3: 書き込み/消去の失敗 ----
+static int Test_FailBody(void)
+{
+	_UBYTE v[PARAM_VALUE_MAX];
+	int n, k;
+
+	ParamStore_Initialize();
+	for(n = 0; n < TEST_FAILS; n++)
+	{
+		k = rand() % PARAM_KEY_NUM;
+		Test_Random(v, _len[k]);
+		if(rand() % 10 == 0)
+		{
+			DataFlashEmu_FailNext();
+		}
+		if(!ParamStore_Set((PARAM_KEY)k, v, _len[k]))
+		{
+			return 1;		// あきらめるほど続けては失敗させていない
+		}
+		ParamStore_Flush();
+	}
+	return 0;
+}
+
+static int Test_AfterFailBody(void)
+{
+	_UBYTE v[PARAM_VALUE_MAX], buf[PARAM_VALUE_MAX];
+
+	ParamStore_Initialize();
+	Test_Random(v, _len[0]);
+	if(!ParamStore_Set((PARAM_KEY)0, v, _len[0]))
+	{
+		return 1;
+	}
+	ParamStore_Flush();
+	return (ParamStore_Get((PARAM_KEY)0, buf, _len[0]) && (memcmp(buf, v, _len[0]) == 0)) ? 0 : 1;
+}
+
+/*----------------------------------------------------------------------
+	Main
+ ----------------------------------------------------------------------*/
+int main(void)
+{
+	_UBYTE* shared;
+	_UDWORD size, erases;
+	int k, p, i, cuts = 0, r;
+
+	srand(1);
+	size = DataFlashEmu_SharedSize() + sizeof(TestModel);
+	shared = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if(shared == MAP_FAILED)
+	{
+		perror("mmap");
+		return 1;
+	}
+	DataFlashEmu_Initialize(shared);
+	_model = (TestModel*)(shared + DataFlashEmu_SharedSize());
+	memset(_model, 0, sizeof(TestModel));
+
+	// 値の長さはキーごとに固定(最大長を多めにしてページの移動を増やす)
+	for(k = 0; k < PARAM_KEY_NUM; k++)
+	{
+		_len[k] = (rand() % 2) ? PARAM_VALUE_MAX : (_UBYTE)(1 + rand() % PARAM_VALUE_MAX);
+	}
+
+	// ---- 1 ----
+	if(Test_Run(Test_WriteBody) != 0 || Test_Run(Test_RebootBody) != 0)
+	{
+		printf("FAIL: write and reboot\n");
+		return 1;
+	}
+	printf("erases per page:");
+	for(p = 0; p < PARAM_PAGE_NUM; p++)
+	{
+		erases = 0;
+		for(i = 0; i < PARAM_PAGE_SIZE / DF_ERASE_SIZE; i++)
+		{
+			erases += DataFlashEmu_GetEraseCount((_UWORD)((p * PARAM_PAGE_SIZE) / DF_ERASE_SIZE + i));
+		}
+		printf(" %lu", (unsigned long)(erases / (PARAM_PAGE_SIZE / DF_ERASE_SIZE)));
+	}
+	printf("\n");
+
+	// ---- 2 ----
+	for(i = 0; i < TEST_CUTS; i++)
+	{
+		_cutKey = rand() % PARAM_KEY_NUM;
+		Test_Random(_cutValue, _len[_cutKey]);
+		_cutAt = (rand() % 2) ? (rand() % TEST_CUT_SHORT) : (rand() % TEST_CUT_LONG);
+		r = Test_Run(Test_CutBody);
+		if(r == 2)
+		{
+			cuts++;
+		}
+		else if(r != 0)
+		{
+			printf("FAIL: power cut run %d\n", i);
+			return 1;
+		}
+		// 期待値の更新は子プロセスで共有メモリに書く
+		if(Test_Run(Test_CutVerifyBody) != 0)
+		{
+			printf("FAIL: power cut %d\n", i);
+			return 1;
+		}
+	}
+	printf("power cut: %d runs, %d cut mid-operation\n", TEST_CUTS, cuts);
+
+	// ---- 3 ----
+	if(Test_Run(Test_FailBody) != 0 || Test_Run(Test_AfterFailBody) != 0)
+	{
+		printf("FAIL: injected errors\n");
+		return 1;
+	}
+	printf("injected errors: ok\n");
+
+	printf("ParamStoreTest: PASS\n");
+	return 0;
+}
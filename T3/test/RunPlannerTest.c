@@ -0,0 +1,248 @@
+/**
+ * @file  RunPlannerTest.c
+ * @brief 走行時間最小の経路(RunPlanner_MakeRoute)のホスト試験
+ *
+ * 生成した迷路(全て探索済み)で,歩数最小の経路(Search_MakeStepMap, Search_MakeRoute)と
+ * 走行時間最小の経路を同じ出発区画,向きから求め,RunPlanner_EstimateTimeで比べる.
+ *   - 走行時間最小の経路が壁を通らずにゴール区画に着くこと
+ *   - 予測走行時間が歩数最小の経路より長くならないこと
+ *     (計画は所要時間をCOST_UNITに丸めて比べるので,1動作あたりその半分までの差は許す)
+ *   - 計画が返す予測走行時間がRunPlanner_EstimateTimeと丸めの範囲で一致すること
+ *   - 走行時間最小の経路を動作列に変換(経路に上書き)し,元に戻すと経路に一致すること
+ * 出発は(0, 0)の北向きと,種ごとに乱数で選んだ区画,向きとする.
+ * MAZE_SIZEを32にしたビルド(RunPlannerTest32)でも同じ試験を行う.
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "TestMaze.h"
+#include "Controller/Search.h"
+#include "Controller/RunPlanner.h"
+#include "Controller/MotionPlan.h"
+
+/*----------------------------------------------------------------------
+	Private Macro Definitions
+ ----------------------------------------------------------------------*/
+#define TEST_STARTS			8		// 1迷路あたりの出発区画,向きの数
+#if MAZE_SIZE == 16
+#define TEST_COST_UNIT		0.02f	// RunPlanner.cのCOST_UNIT [sec]
+#else
+#define TEST_COST_UNIT		0.04f
+#endif
+
+/*----------------------------------------------------------------------
+	Search.cの変数
+ ----------------------------------------------------------------------*/
+extern volatile union map_coor{
+	_UWORD PLANE;
+	struct coor_axis{
+		_UWORD Y:MAZE_COORD_BITS;
+		_UWORD X:MAZE_COORD_BITS;
+	}AXIS;
+}PRELOC;
+extern _UBYTE map[MAZE_SIZE][MAZE_SIZE];
+extern _UBYTE mDir;
+extern _UBYTE route[MAZE_CELL_NUM];
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+static _UBYTE _timeRoute[MAZE_CELL_NUM];
+static _UBYTE _motionRoute[MAZE_CELL_NUM];
+static int _motionMax = 0;				// 動作列の長さの最大値
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+/** 経路をたどり,壁を通らずにゴール区画に着くか確かめる
+ * @param r: 経路(Search_MakeRouteと同じ形式)
+ * @param x, y, dir: 出発区画,向き
+ * @param moves: 動作(直進,旋回の切り替わり)の数
+ * @retval bool: true: ゴール区画に着く
+ */
+static bool Test_Walk(const _UBYTE* r, _UBYTE x, _UBYTE y, _UBYTE dir, int* moves)
+{
+	_UWORD i;
+	_UBYTE prev = 0x00;
+
+	*moves = 0;
+	for(i = 0; (i < MAZE_CELL_NUM) && (r[i] != 0xff) && (r[i] != 0x00); i++)
+	{
+		switch(r[i])
+		{
+		case 0x88:	break;
+		case 0x44:	dir = (dir + 1) & 0x03;	break;
+		case 0x22:	dir = (dir + 2) & 0x03;	break;
+		case 0x11:	dir = (dir + 3) & 0x03;	break;
+		default:	return false;
+		}
+		if((r[i] != 0x88) || (prev != 0x88))
+		{
+			*moves += (r[i] != 0x88) ? 2 : 1;		// 旋回と,その後の直進
+		}
+		prev = r[i];
+		if(map[y][x] & (0x08 >> dir))
+		{
+			return false;
+		}
+		if(dir == 0)		y++;
+		else if(dir == 1)	x++;
+		else if(dir == 2)	y--;
+		else				x--;
+	}
+	return Search_IsGoal(x, y);
+}
+
+/** 経路を動作列に変換し,元の経路に戻して比べる
+ * @param r: 経路
+ * @retval bool: true: 元に戻した経路が一致する
+ */
+static bool Test_Motion(const _UBYTE* r)
+{
+	static const _UBYTE turnCell[4] = {0x88, 0x44, 0x11, 0x22};	// MOTION_STRAIGHT, R90, L90, 180
+	const _UBYTE* m;
+	_UWORD i, n = 0;
+	_UBYTE k;
+
+	memcpy(_motionRoute, r, sizeof(_motionRoute));
+	if(!MotionPlan_Compile(_motionRoute) || (MotionPlan_Get() != _motionRoute))
+	{
+		return false;
+	}
+	m = MotionPlan_Get();
+	for(i = 0; m[i] != MOTION_END; i++)
+	{
+		k = m[i] & MOTION_NUM_MASK;
+		if((k == 0) || (k & 1) || (k > MOTION_NUM_MAX))
+		{
+			return false;
+		}
+		for(; k > 0; k -= 2, n++)
+		{
+			if(r[n] != ((k == (m[i] & MOTION_NUM_MASK)) ? turnCell[m[i] >> 6] : 0x88))
+			{
+				return false;
+			}
+		}
+	}
+	if(i > _motionMax)
+	{
+		_motionMax = i;
+	}
+	return (n == MAZE_CELL_NUM) || (r[n] == 0xff);
+}
+
+/** 1つの出発区画,向きで2つの経路を比べる
+ * @retval int: 1: 走行時間最小の経路が速い, 0: 同じ, -1: 失敗
+ */
+static int Test_Compare(unsigned seed, _UBYTE x, _UBYTE y, _UBYTE dir, double* saved)
+{
+	float stepTime, timeTime, planTime, tol;
+	int stepMoves, timeMoves;
+	bool stepFound;
+
+	// ---- 歩数最小の経路 ----
+	PRELOC.AXIS.X = x;
+	PRELOC.AXIS.Y = y;
+	mDir = dir;
+	Search_MakeStepMap();
+	Search_MakeRoute();
+	stepFound = (route[0] != 0x00);
+
+	// ---- 走行時間最小の経路 ----
+	planTime = RunPlanner_MakeRoute(map, x, y, dir, _timeRoute);
+	if(planTime < 0)
+	{
+		if(stepFound)
+		{
+			printf("FAIL: seed %u (%d, %d) dir %d: no time route, but a step route exists\n", seed, x, y, dir);
+			return -1;
+		}
+		return 0;
+	}
+	if(!stepFound || (mDir != dir))
+	{
+		printf("FAIL: seed %u (%d, %d) dir %d: no step route, but a time route exists\n", seed, x, y, dir);
+		return -1;
+	}
+	if(!Test_Walk(_timeRoute, x, y, dir, &timeMoves) || !Test_Walk(route, x, y, dir, &stepMoves))
+	{
+		printf("FAIL: seed %u (%d, %d) dir %d: a route runs into a wall or misses the goal\n", seed, x, y, dir);
+		return -1;
+	}
+	if(!Test_Motion(_timeRoute))
+	{
+		printf("FAIL: seed %u (%d, %d) dir %d: the motion list does not expand back to the route\n", seed, x, y, dir);
+		return -1;
+	}
+
+	stepTime = RunPlanner_EstimateTime(route);
+	timeTime = RunPlanner_EstimateTime(_timeRoute);
+	tol = (stepMoves + timeMoves) * TEST_COST_UNIT / 2;
+	if(timeTime > stepTime + tol)
+	{
+		printf("FAIL: seed %u (%d, %d) dir %d: time route %.3f s, step route %.3f s\n",
+				seed, x, y, dir, timeTime, stepTime);
+		return -1;
+	}
+	if((planTime > timeTime + timeMoves * TEST_COST_UNIT / 2) || (planTime < timeTime - timeMoves * TEST_COST_UNIT / 2))
+	{
+		printf("FAIL: seed %u (%d, %d) dir %d: planner says %.3f s, the route takes %.3f s\n",
+				seed, x, y, dir, planTime, timeTime);
+		return -1;
+	}
+	if(timeTime < stepTime - tol)
+	{
+		*saved += stepTime - timeTime;
+		return 1;
+	}
+	return 0;
+}
+
+/*----------------------------------------------------------------------
+	Main
+ ----------------------------------------------------------------------*/
+int main(void)
+{
+	static _UBYTE maze[MAZE_SIZE][MAZE_SIZE];
+	unsigned seed;
+	_UBYTE x, y, w, h, dir;
+	int n, r, runs = 0, faster = 0;
+	double saved = 0;
+
+	for(seed = 0; seed < TEST_MAZE_NUM; seed++)
+	{
+		TestMaze_Generate(maze, seed);
+		TestMaze_ToMap(maze, map);
+		TestMaze_SetGoal(seed, &x, &y, &w, &h);
+		Search_SetGoalRegion(x, y, w, h);
+
+		TestMaze_Seed(seed * 13 + 5);
+		for(n = 0; n < TEST_STARTS; n++)
+		{
+			x = (n == 0) ? START_X : (_UBYTE)(TestMaze_Random() % MAZE_SIZE);
+			y = (n == 0) ? START_Y : (_UBYTE)(TestMaze_Random() % MAZE_SIZE);
+			dir = (n == 0) ? 0 : (_UBYTE)(TestMaze_Random() % 4);
+			if(Search_IsGoal(x, y))
+			{
+				continue;
+			}
+			r = Test_Compare(seed, x, y, dir, &saved);
+			if(r < 0)
+			{
+				return 1;
+			}
+			faster += r;
+			runs++;
+		}
+	}
+
+	printf("run planner: %d starts, never slower than the step route, faster in %d (%.3f s saved on average)\n",
+			runs, faster, (faster > 0) ? saved / faster : 0.0);
+	printf("motion lists: at most %d motions (route buffer %d bytes)\n", _motionMax, MAZE_CELL_NUM);
+	printf("%s: PASS\n", (MAZE_SIZE == 16) ? "RunPlannerTest" : "RunPlannerTest32");
+	return 0;
+}
@@ -0,0 +1,288 @@
+/**
+ * @file  SegQueueTest.c
+ * @brief 走行区間キュー(MouseController_PushSegment, 制御割り込み, MouseController_CancelSegment)のホスト試験
+ *
+ * MouseController.cをそのまま取り込み,制御割り込み(MouseController_IntMTU2TGIA)を
+ * 間隔を乱数で変えたタイマのシグナルから呼ぶ.メインループ側の格納,待ち,破棄の
+ * 任意の命令の間に割り込みが入るので,格納位置,取り出し位置の更新順の誤りが表に出る.
+ *   - 格納した区間がなくならず,重複せず,格納した順に実行されること
+ *   - 実行された区間の中身が格納したものと一致すること(書きかけの区間を読まないこと)
+ *   - MouseController_WaitSegmentは区間の終了まで戻らないこと(戻った時点で区間を実行していないこと)
+ *   - MouseController_CancelSegmentの後は,それより前に格納した区間を実行せず,
+ *     キューが空で終了数が格納数に揃っていること.その後の格納も同じく扱われること
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "Controller/MouseController.c"
+
+/*----------------------------------------------------------------------
+	Private Macro Definitions
+ ----------------------------------------------------------------------*/
+#define TEST_SEGMENTS		40000	// 格納する区間の数
+#define TEST_ISR_US_MAX		20		// 割り込みの間隔の上限 [usec] (1〜この値の乱数)
+#define TEST_TICK_MAX		3		// 区間の長さの上限 [制御周期]
+#define TEST_WAIT_EVERY		97		// 区間の終了を待つ間隔(平均) [区間]
+#define TEST_CANCEL_EVERY	1500	// キューを破棄する間隔(平均) [区間]
+#define TEST_MAGIC			12345	// 試験で格納した区間の印(AngVMinに入れる)
+#define TEST_SPIN_MAX		50000	// 格納の前に空回りする回数の上限(キューが空く状況も作る)
+#define TEST_TIMEOUT_SEC	30		// 待ちが終わらないときに失敗とする時間 [sec]
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+static volatile _UDWORD _started[TEST_SEGMENTS + 1];	// 実行された順(割り込みが書く)
+static volatile _UDWORD _startNum = 0;
+static volatile _UDWORD _bad = 0;						// 中身が食い違った区間の番号
+static volatile _UDWORD _isrNum = 0;
+static _UDWORD _isrSeed = 1;							// 割り込み側の乱数(メインループと分ける)
+
+static _UBYTE _lost[TEST_SEGMENTS + 1];					// 破棄されてよい区間
+static time_t _start;
+
+/*----------------------------------------------------------------------
+	デバイスの置き換え(止まった機体の値を返す)
+ ----------------------------------------------------------------------*/
+static LSVal _lsv;
+
+_UWORD AS5055_GetAngle(E_AS5055_LR encLR)		{ (void)encLR; return 0; }
+_UDWORD AS5055_GetStamp(E_AS5055_LR encLR)		{ (void)encLR; return 0; }
+bool DRV8836_DriveMotor(E_MOTOR_TYPE type, E_MOTOR_DIR dir, float duty)	{ (void)type; (void)dir; (void)duty; return true; }
+void LightSensor_Update(void)					{}
+LSVal* LightSensor_GetValue(void)				{ return &_lsv; }
+_UDWORD LightSensor_GetStamp(void)				{ return 0; }
+void LightSensor_TriggerScan(void)				{}
+void LightSensor_SetDistTable(E_LS_CHANNEL ch, const _SWORD* ad)	{ (void)ch; (void)ad; }
+const _SWORD* LightSensor_GetDistTable(E_LS_CHANNEL ch)	{ (void)ch; return NULL; }
+void LightSensor_GetBaseLR(void)				{}
+void LightSensor_SetWallBase(const _SWORD* base)	{ (void)base; }
+const _SWORD* LightSensor_GetWallBase(void)		{ return NULL; }
+void LightSensor_PrintDistTable(void)			{}
+float Battery_GetValue(void)					{ return HW_BATTERY_NOMINAL; }
+_SWORD MPU6500_GetAngVel(void)					{ return 0; }
+void MPU6500_TrackBias(void)					{}
+void MPU6500_GetSample(ImuSample* sample)		{ memset(sample, 0, sizeof(*sample)); }
+_UDWORD Timer_GetTimeUS(void)					{ return 0; }
+bool Timer_AddTask(void (*task)(void), _UWORD periodMS)	{ (void)task; (void)periodMS; return true; }
+void RSPI0_TriggerCycleOperation(void)			{}
+void Int_SPRI0(void)							{}
+bool ParamStore_Set(PARAM_KEY key, const void* data, _UBYTE len)	{ (void)key; (void)data; (void)len; return true; }
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+/** 区間番号から区間を作る(中身の食い違いを見るため,各項目を番号から決める)
+ * @param id: 区間番号(1〜)
+ * @param seg: 作る区間
+ */
+static void Test_Make(_UDWORD id, MotionSegment* seg)
+{
+	memset(seg, 0, sizeof(*seg));
+	seg->Flag = SEG_END_TIME | ((id & 1) ? SEG_STOP : 0) | ((id & 2) ? SEG_KEEP_ANG : 0);
+	seg->V = (CTRL_VAL)id;					// SEG_SET_Vなしなので目標速度には使われない
+	seg->VMax = (CTRL_VAL)(id % 101);
+	seg->VMin = (CTRL_VAL)(id % 7);
+	seg->AngVMax = (CTRL_VAL)(id % 103);
+	seg->AngVMin = (CTRL_VAL)TEST_MAGIC;
+	seg->End = (CTRL_VAL)(id % (TEST_TICK_MAX + 1));	// 0なら開始した周期で終わる
+}
+
+/** 区間の中身が同じか(詰め物は比べない)
+ * @retval bool: true: 同じ
+ */
+static bool Test_Same(const MotionSegment* a, const MotionSegment* b)
+{
+	return (a->Flag == b->Flag) && (a->V == b->V) && (a->VMax == b->VMax) && (a->VMin == b->VMin)
+		&& (a->Acc == b->Acc) && (a->AngV == b->AngV) && (a->AngVMax == b->AngVMax) && (a->AngVMin == b->AngVMin)
+		&& (a->AngAcc == b->AngAcc) && (a->End == b->End);
+}
+
+/** 制御割り込み(タイマのシグナルから呼ぶ)
+ *   取り出した区間を記録し,次の割り込みを乱数の間隔で設定する
+ */
+static void Test_Isr(int sig)
+{
+	_UBYTE head = _segHead;
+	bool cancel = _segCancel;
+	struct itimerval it = {{0, 0}, {0, 0}};
+	MotionSegment ref;
+	_UDWORD id;
+
+	(void)sig;
+	MouseController_IntMTU2TGIA();
+	_isrNum++;
+
+	// 区間は1周期に1つだけ取り出される(破棄した周期は取り出さない)
+	if(!cancel && (_segHead != head) && (_seg.AngVMin == (CTRL_VAL)TEST_MAGIC))
+	{
+		id = (_UDWORD)_seg.V;
+		Test_Make(id, &ref);
+		if((id == 0) || (id > TEST_SEGMENTS) || !Test_Same(&ref, &_seg))
+		{
+			_bad = (id == 0) ? 0xffffffff : id;
+		}
+		else if(_startNum <= TEST_SEGMENTS)
+		{
+			_started[_startNum++] = id;
+		}
+	}
+
+	_isrSeed = _isrSeed * 1103515245 + 12345;
+	it.it_value.tv_usec = 1 + (_isrSeed >> 16) % TEST_ISR_US_MAX;
+	setitimer(ITIMER_REAL, &it, NULL);
+}
+
+/** 割り込みを止める
+ */
+static void Test_StopIsr(void)
+{
+	struct itimerval it = {{0, 0}, {0, 0}};
+
+	signal(SIGALRM, SIG_IGN);
+	setitimer(ITIMER_REAL, &it, NULL);
+}
+
+/** メインループの待ち(割り込みはシグナルで入るので,時間切れだけを見る)
+ */
+static void Test_Yield(void)
+{
+	if(time(NULL) - _start > TEST_TIMEOUT_SEC)
+	{
+		Test_StopIsr();
+		printf("FAIL: a wait did not finish in %d s (head %d tail %d done %u issued %u)\n",
+				TEST_TIMEOUT_SEC, _segHead, _segTail, _segDone, _segIssued);
+		exit(1);
+	}
+}
+
+/** 区間番号が実行されたか(実行順は番号順なので二分探索する)
+ * @retval bool: true: 実行された
+ */
+static bool Test_IsStarted(_UDWORD id)
+{
+	_UDWORD lo = 0, hi = _startNum;
+
+	while(lo < hi)
+	{
+		_UDWORD mid = (lo + hi) / 2;
+
+		if(_started[mid] < id)	lo = mid + 1;
+		else					hi = mid;
+	}
+	return (lo < _startNum) && (_started[lo] == id);
+}
+
+/*----------------------------------------------------------------------
+	Main
+ ----------------------------------------------------------------------*/
+int main(void)
+{
+	MotionSegment seg;
+	_UDWORD id, i, last, cancels = 0, waits = 0;
+	_UWORD seq;
+	volatile int spin;
+
+	srand(1);
+	_start = time(NULL);
+	Yield = Test_Yield;
+	signal(SIGALRM, Test_Isr);
+	raise(SIGALRM);
+
+	for(id = 1; id <= TEST_SEGMENTS; id++)
+	{
+		// ---- ときどき全て破棄する ----
+		if(rand() % TEST_CANCEL_EVERY == 0)
+		{
+			last = (_startNum > 0) ? _started[_startNum - 1] : 0;
+			MouseController_CancelSegment();
+			cancels++;
+			// 破棄より前に格納して,まだ実行されていなかった区間は破棄されてよい
+			for(i = last + 1; i < id; i++)
+			{
+				_lost[i] = !Test_IsStarted(i);
+			}
+			if((_segHead != _segTail) || _segActive || (_segDone != _segIssued))
+			{
+				Test_StopIsr();
+				printf("FAIL: after cancel %lu: head %d tail %d active %d done %u issued %u\n", (unsigned long)cancels,
+						_segHead, _segTail, _segActive, _segDone, _segIssued);
+				return 1;
+			}
+		}
+
+		// 半分の区間は間を空けて格納する(割り込みがキューを空にし,実行していない状態で格納させる)
+		if(rand() & 1)
+		{
+			for(spin = rand() % TEST_SPIN_MAX; spin > 0; spin--)
+			{
+			}
+		}
+
+		Test_Make(id, &seg);
+		seq = MouseController_PushSegment(&seg);
+
+		// ---- ときどき終了まで待つ ----
+		if(rand() % TEST_WAIT_EVERY == 0)
+		{
+			MouseController_WaitSegment(seq);
+			waits++;
+			if((_startNum == 0) || (_started[_startNum - 1] != id) || _segActive)
+			{
+				Test_StopIsr();
+				printf("FAIL: WaitSegment(%u) returned before segment %lu finished\n", seq, (unsigned long)id);
+				return 1;
+			}
+		}
+	}
+	MouseController_WaitSegment(seq);
+	Test_StopIsr();
+
+	// ---- 実行順,中身,なくなった区間を確かめる ----
+	if(_bad != 0)
+	{
+		printf("FAIL: segment %lu ran with different contents\n", (unsigned long)_bad);
+		return 1;
+	}
+	for(i = 1; i < _startNum; i++)
+	{
+		if(_started[i] <= _started[i - 1])
+		{
+			printf("FAIL: segment %lu ran after %lu\n", (unsigned long)_started[i], (unsigned long)_started[i - 1]);
+			return 1;
+		}
+	}
+	for(id = 1, i = 0; id <= TEST_SEGMENTS; id++)
+	{
+		if(Test_IsStarted(id))
+		{
+			if(_lost[id])
+			{
+				printf("FAIL: segment %lu ran after it was cancelled\n", (unsigned long)id);
+				return 1;
+			}
+		}
+		else if(!_lost[id])
+		{
+			printf("FAIL: segment %lu was lost\n", (unsigned long)id);
+			return 1;
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	printf("segment queue: %d pushed, %lu ran in order, %lu dropped by %lu cancels, %lu waits, %lu interrupts\n",
+			TEST_SEGMENTS, (unsigned long)_startNum, (unsigned long)i, (unsigned long)cancels,
+			(unsigned long)waits, (unsigned long)_isrNum);
+	printf("SegQueueTest: PASS\n");
+	return 0;
+}
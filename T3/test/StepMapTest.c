@@ -0,0 +1,160 @@
+/**
+ * @file  StepMapTest.c
+ * @brief 歩数マップ作成(Search_MakeStepMap)のホスト試験
+ *
+ * 生成した迷路で,元の全区画走査による歩数マップと区画ごとに一致することを確かめ,
+ * 1回あたりの作成時間を比べる.迷路は全て探索済みのものと,半分の区画が未探索のものを使う.
+ * MAZE_SIZEを32にしたビルド(StepMapTest32)でも同じ試験を行い,マップの大きさを表示する.
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include <stdio.h>
+#include "TestMaze.h"
+#include "Controller/Search.h"
+#include "Controller/MazeMask.h"	// MAZE_MASK_SEARCH
+
+/*----------------------------------------------------------------------
+	Private Macro Definitions
+ ----------------------------------------------------------------------*/
+#define TEST_BENCH_LOOP		20		// 時間計測で1迷路あたり繰り返す回数
+
+/*----------------------------------------------------------------------
+	Search.cの変数
+ ----------------------------------------------------------------------*/
+extern _UBYTE map[MAZE_SIZE][MAZE_SIZE];
+extern MAZE_STEP smap[MAZE_SIZE][MAZE_SIZE];
+extern MAZE_ROW goalMask[MAZE_SIZE];
+extern MAZE_CELL stepQueue[MAZE_CELL_NUM];
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+static MAZE_STEP _ref[MAZE_SIZE][MAZE_SIZE];
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+/** 元の歩数マップ作成(歩数ごとに全区画を走査する)
+ *   元は自分の座標に届いたら止めていたが,比べるため到達できる全区画まで展開する
+ */
+static void Ref_MakeStepMap(_UBYTE shift)
+{
+	_UBYTE x, y, mTemp;
+	MAZE_STEP mStep = 0;
+	bool found;
+
+	for(y = 0; y < MAZE_SIZE; y++)
+	{
+		for(x = 0; x < MAZE_SIZE; x++)
+		{
+			_ref[y][x] = (goalMask[y] & ((MAZE_ROW)1 << x)) ? 0 : STEP_MAX;
+		}
+	}
+
+	do
+	{
+		found = false;
+		for(y = 0; y < MAZE_SIZE; y++)
+		{
+			for(x = 0; x < MAZE_SIZE; x++)
+			{
+				if(_ref[y][x] != mStep)
+				{
+					continue;
+				}
+				found = true;
+				mTemp = map[y][x] >> shift;
+				if(!(mTemp & 0x08) && (y != MAZE_SIZE - 1) && (_ref[y + 1][x] == STEP_MAX))	_ref[y + 1][x] = mStep + 1;
+				if(!(mTemp & 0x04) && (x != MAZE_SIZE - 1) && (_ref[y][x + 1] == STEP_MAX))	_ref[y][x + 1] = mStep + 1;
+				if(!(mTemp & 0x02) && (y != 0) && (_ref[y - 1][x] == STEP_MAX))				_ref[y - 1][x] = mStep + 1;
+				if(!(mTemp & 0x01) && (x != 0) && (_ref[y][x - 1] == STEP_MAX))				_ref[y][x - 1] = mStep + 1;
+			}
+		}
+		mStep++;
+	}while(found && (mStep != STEP_MAX));
+}
+
+/** 迷路を読み込む
+ * @param seed: 迷路の種
+ * @param partial: true: 半分の区画を未探索にする(未探索の壁は探索走行用の4bitではなし)
+ */
+static void Test_Load(unsigned seed, bool partial)
+{
+	static _UBYTE maze[MAZE_SIZE][MAZE_SIZE];
+	_UBYTE x, y, w, h;
+
+	TestMaze_Generate(maze, seed);
+	TestMaze_ToMap(maze, map);
+	if(partial)
+	{
+		for(y = 0; y < MAZE_SIZE; y++)
+		{
+			for(x = 0; x < MAZE_SIZE; x++)
+			{
+				if(TestMaze_Random() & 1)
+				{
+					map[y][x] = 0xf0;
+				}
+			}
+		}
+	}
+	TestMaze_SetGoal(seed, &x, &y, &w, &h);
+	Search_SetGoalRegion(x, y, w, h);
+}
+
+/*----------------------------------------------------------------------
+	Main
+ ----------------------------------------------------------------------*/
+int main(void)
+{
+	unsigned seed;
+	int partial, i, cells = 0;
+	_UBYTE x, y;
+	double t0, tNew = 0, tRef = 0;
+
+	for(partial = 0; partial < 2; partial++)
+	{
+		for(seed = 0; seed < TEST_MAZE_NUM; seed++)
+		{
+			Test_Load(seed, partial != 0);
+			Search_MakeStepMap();
+			Ref_MakeStepMap(MAZE_MASK_SEARCH);
+			for(y = 0; y < MAZE_SIZE; y++)
+			{
+				for(x = 0; x < MAZE_SIZE; x++)
+				{
+					if(smap[y][x] != _ref[y][x])
+					{
+						printf("FAIL: seed %u partial %d (%d, %d): %d, expected %d\n",
+								seed, partial, x, y, smap[y][x], _ref[y][x]);
+						return 1;
+					}
+					cells++;
+				}
+			}
+
+			t0 = TestMaze_NowUS();
+			for(i = 0; i < TEST_BENCH_LOOP; i++)
+			{
+				Search_MakeStepMap();
+			}
+			tNew += TestMaze_NowUS() - t0;
+			t0 = TestMaze_NowUS();
+			for(i = 0; i < TEST_BENCH_LOOP; i++)
+			{
+				Ref_MakeStepMap(MAZE_MASK_SEARCH);
+			}
+			tRef += TestMaze_NowUS() - t0;
+		}
+	}
+
+	printf("step map (%dx%d): %d mazes, %d cells match\n", MAZE_SIZE, MAZE_SIZE, 2 * TEST_MAZE_NUM, cells);
+	printf("map size: map %u bytes, smap %u bytes, goalMask %u bytes, stepQueue %u bytes\n",
+			(unsigned)sizeof(map), (unsigned)sizeof(smap), (unsigned)sizeof(goalMask), (unsigned)sizeof(stepQueue));
+	printf("time per map: %.2f us (full scan %.2f us, x%.1f)\n",
+			tNew / (2 * TEST_MAZE_NUM * TEST_BENCH_LOOP), tRef / (2 * TEST_MAZE_NUM * TEST_BENCH_LOOP), tRef / tNew);
+	printf("%s: PASS\n", (MAZE_SIZE == 16) ? "StepMapTest" : "StepMapTest32");
+	return 0;
+}
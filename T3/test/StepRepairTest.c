@@ -0,0 +1,184 @@
+/**
+ * @file  StepRepairTest.c
+ * @brief 歩数マップ差分更新(Search_UpdateStepMap)のホスト試験
+ *
+ * 1. 生成した迷路を足立法で探索させ,区画ごとの壁の書き込みのたびに
+ *    差分更新した歩数マップが作り直したものと一致することを確かめる
+ * 2. 任意の区画の壁を任意に書き換え(壁が増える,減る,複数変わる)ても一致することを確かめる
+ * あわせて差分更新と作り直しの1回あたりの時間を比べる.
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "TestMaze.h"
+#include "Controller/Search.h"
+
+/*----------------------------------------------------------------------
+	Private Macro Definitions
+ ----------------------------------------------------------------------*/
+#define TEST_RANDOM_WRITES	500		// 2で1迷路あたり書き換える回数
+#define TEST_STEP_LIMIT		(4 * MAZE_CELL_NUM)	// 1回の探索の歩数の上限
+
+/*----------------------------------------------------------------------
+	Search.cの変数
+ ----------------------------------------------------------------------*/
+extern volatile union map_coor{
+	_UWORD PLANE;
+	struct coor_axis{
+		_UWORD Y:MAZE_COORD_BITS;
+		_UWORD X:MAZE_COORD_BITS;
+	}AXIS;
+}PRELOC;
+extern _UBYTE map[MAZE_SIZE][MAZE_SIZE];
+extern MAZE_STEP smap[MAZE_SIZE][MAZE_SIZE];
+extern _UBYTE wallInfo;
+extern _UBYTE mDir;
+extern MAZE_ROW goalMask[MAZE_SIZE];
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+static _UBYTE _maze[MAZE_SIZE][MAZE_SIZE];		// 実際の迷路
+static MAZE_STEP _ref[MAZE_SIZE][MAZE_SIZE];	// 差分更新した歩数マップ
+static long _updates = 0;
+static double _tUpdate = 0, _tFull = 0;
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+/** 現在地で壁を書き込み,差分更新した歩数マップを作り直したものと比べる
+ *   (Search_ConfirmRoute()と同じ手順)
+ * @retval bool: true: 一致
+ */
+static bool Test_WriteAndCompare(void)
+{
+	_UBYTE x = (_UBYTE)PRELOC.AXIS.X, y = (_UBYTE)PRELOC.AXIS.Y;
+	_UBYTE wallOld = map[y][x] & 0x0f;
+	double t0;
+
+	Search_WriteMap();
+	t0 = TestMaze_NowUS();
+	Search_UpdateStepMap(wallOld ^ (map[y][x] & 0x0f));
+	_tUpdate += TestMaze_NowUS() - t0;
+
+	memcpy(_ref, smap, sizeof(_ref));
+
+	t0 = TestMaze_NowUS();
+	Search_MakeStepMap();
+	_tFull += TestMaze_NowUS() - t0;
+	_updates++;
+
+	return memcmp(smap, _ref, sizeof(_ref)) == 0;
+}
+
+/** 実際の迷路から現在地,方向での壁情報(前,右,左)を作る
+ */
+static _UBYTE Test_Sense(void)
+{
+	_UBYTE w = _maze[PRELOC.AXIS.Y][PRELOC.AXIS.X];
+	_UBYTE info = 0x00;
+
+	if(w & (0x08 >> mDir))					info |= 0x88;
+	if(w & (0x08 >> ((mDir + 1) & 0x03)))	info |= 0x44;
+	if(w & (0x08 >> ((mDir + 3) & 0x03)))	info |= 0x11;
+	return info;
+}
+
+/** 歩数の最も小さい隣接区画へ進む(同じなら前を優先)
+ * @retval bool: true: 進めた
+ */
+static bool Test_Move(void)
+{
+	_UBYTE x = (_UBYTE)PRELOC.AXIS.X, y = (_UBYTE)PRELOC.AXIS.Y;
+	_UBYTE d, dir, best = 0xff;
+	MAZE_STEP s, bestStep = STEP_MAX;
+
+	for(d = 0; d < 4; d++)
+	{
+		dir = (mDir + d) & 0x03;		// 前,右,後,左の順
+		if(map[y][x] & (0x08 >> dir))
+		{
+			continue;
+		}
+		if((dir == 0) && (y < MAZE_SIZE - 1))	s = smap[y + 1][x];
+		else if((dir == 1) && (x < MAZE_SIZE - 1))	s = smap[y][x + 1];
+		else if((dir == 2) && (y > 0))			s = smap[y - 1][x];
+		else if((dir == 3) && (x > 0))			s = smap[y][x - 1];
+		else									continue;
+		if(s < bestStep)
+		{
+			bestStep = s;
+			best = dir;
+		}
+	}
+	if(best == 0xff)
+	{
+		return false;
+	}
+	Search_SetDir(best);
+	Search_AdvancePosition();
+	return true;
+}
+
+/*----------------------------------------------------------------------
+	Main
+ ----------------------------------------------------------------------*/
+int main(void)
+{
+	unsigned seed;
+	int n, steps, explore = 0;
+	_UBYTE gx, gy, gw, gh;
+
+	for(seed = 0; seed < TEST_MAZE_NUM; seed++)
+	{
+		TestMaze_Generate(_maze, seed);
+		TestMaze_SetGoal(seed, &gx, &gy, &gw, &gh);
+
+		// ---- 1: 足立法の探索 ----
+		Search_MapInit();
+		Search_SetGoalRegion(gx, gy, gw, gh);
+		PRELOC.PLANE = 0;
+		Search_SetDir(DIR_TURN_0);
+		wallInfo = Test_Sense();
+		Search_WriteMap();
+		Search_MakeStepMap();
+		for(steps = 0; steps < TEST_STEP_LIMIT; steps++)
+		{
+			if(Search_IsGoal(PRELOC.AXIS.X, PRELOC.AXIS.Y) || !Test_Move())
+			{
+				break;
+			}
+			wallInfo = Test_Sense();
+			if(!Test_WriteAndCompare())
+			{
+				printf("FAIL: seed %u explore step %d at (%d, %d)\n", seed, steps, PRELOC.AXIS.X, PRELOC.AXIS.Y);
+				return 1;
+			}
+		}
+		explore += steps;
+
+		// ---- 2: 任意の書き換え(誤検出,壁の消失を含む) ----
+		for(n = 0; n < TEST_RANDOM_WRITES; n++)
+		{
+			PRELOC.AXIS.X = TestMaze_Random() % MAZE_SIZE;
+			PRELOC.AXIS.Y = TestMaze_Random() % MAZE_SIZE;
+			Search_SetDir((_UBYTE)(TestMaze_Random() % 4));
+			wallInfo = (_UBYTE)(((TestMaze_Random() & 1) ? 0x88 : 0) | ((TestMaze_Random() & 1) ? 0x44 : 0)
+						| ((TestMaze_Random() & 1) ? 0x11 : 0));
+			if(!Test_WriteAndCompare())
+			{
+				printf("FAIL: seed %u random write %d at (%d, %d)\n", seed, n, PRELOC.AXIS.X, PRELOC.AXIS.Y);
+				return 1;
+			}
+		}
+	}
+
+	printf("step map repair: %ld updates (%d while exploring) match a full rebuild\n", _updates, explore);
+	printf("time per update: %.2f us (full rebuild %.2f us)\n", _tUpdate / _updates, _tFull / _updates);
+	printf("StepRepairTest: PASS\n");
+	return 0;
+}
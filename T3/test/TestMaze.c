@@ -0,0 +1,181 @@
+/**
+ * @file  TestMaze.c
+ * @brief ホスト試験で使う迷路の生成
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "TestMaze.h"
+#include <time.h>
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+static unsigned _seed = 1;
+
+/*----------------------------------------------------------------------
+	Private Method Declarations
+ ----------------------------------------------------------------------*/
+static void TestMaze_Remove(_UBYTE maze[MAZE_SIZE][MAZE_SIZE], _UBYTE x, _UBYTE y, _UBYTE d);
+
+/*----------------------------------------------------------------------
+	Public Method Definitions
+ ----------------------------------------------------------------------*/
+/** 迷路の生成
+ *   種の値で形を変える(0: 柱だけ, 1: 全て壁, 他: 穴掘り法の迷路に種ごとの数だけ抜け道を足す)
+ * @param maze: 生成先(下位4bitにNESW順の壁)
+ * @param seed: 種
+ * @retval void
+ */
+void TestMaze_Generate(_UBYTE maze[MAZE_SIZE][MAZE_SIZE], unsigned seed)
+{
+	static _UWORD stack[MAZE_CELL_NUM];
+	static _UBYTE seen[MAZE_SIZE][MAZE_SIZE];
+	_UWORD sp = 0, loops, n;
+	_UBYTE x, y, d, cand[4], nc;
+
+	TestMaze_Seed(seed);
+	for(y = 0; y < MAZE_SIZE; y++)
+	{
+		for(x = 0; x < MAZE_SIZE; x++)
+		{
+			maze[y][x] = (seed == 0) ? 0x00 : 0x0f;
+			seen[y][x] = 0;
+		}
+	}
+	if(seed <= 1)
+	{
+		// 外周の壁だけ付けて終わる
+		for(y = 0; y < MAZE_SIZE; y++)
+		{
+			maze[y][0] |= 0x01;
+			maze[y][MAZE_SIZE - 1] |= 0x04;
+		}
+		for(x = 0; x < MAZE_SIZE; x++)
+		{
+			maze[0][x] |= 0x02;
+			maze[MAZE_SIZE - 1][x] |= 0x08;
+		}
+		return;
+	}
+
+	// ---- 穴掘り法(行き止まりまで掘って戻る) ----
+	stack[sp++] = 0;
+	seen[0][0] = 1;
+	while(sp > 0)
+	{
+		x = stack[sp - 1] % MAZE_SIZE;
+		y = stack[sp - 1] / MAZE_SIZE;
+		nc = 0;
+		if((y < MAZE_SIZE - 1) && !seen[y + 1][x])	cand[nc++] = 0;
+		if((x < MAZE_SIZE - 1) && !seen[y][x + 1])	cand[nc++] = 1;
+		if((y > 0) && !seen[y - 1][x])				cand[nc++] = 2;
+		if((x > 0) && !seen[y][x - 1])				cand[nc++] = 3;
+		if(nc == 0)
+		{
+			sp--;
+			continue;
+		}
+		d = cand[TestMaze_Random() % nc];
+		TestMaze_Remove(maze, x, y, d);
+		if(d == 0)		y++;
+		else if(d == 1)	x++;
+		else if(d == 2)	y--;
+		else			x--;
+		seen[y][x] = 1;
+		stack[sp++] = (_UWORD)(y * MAZE_SIZE + x);
+	}
+
+	// ---- 抜け道(ループ)を足す ----
+	loops = (_UWORD)(seed % (MAZE_CELL_NUM / 4));
+	for(n = 0; n < loops; n++)
+	{
+		x = (_UBYTE)(TestMaze_Random() % MAZE_SIZE);
+		y = (_UBYTE)(TestMaze_Random() % MAZE_SIZE);
+		d = (_UBYTE)(TestMaze_Random() % 4);
+		if(((d == 0) && (y == MAZE_SIZE - 1)) || ((d == 1) && (x == MAZE_SIZE - 1))
+				|| ((d == 2) && (y == 0)) || ((d == 3) && (x == 0)))
+		{
+			continue;
+		}
+		TestMaze_Remove(maze, x, y, d);
+	}
+}
+
+/** 全て探索し終えたときのmapを作る(上位,下位4bitとも実際の壁)
+ * @param maze: 迷路
+ * @param map: 作成先
+ * @retval void
+ */
+void TestMaze_ToMap(_UBYTE maze[MAZE_SIZE][MAZE_SIZE], _UBYTE map[MAZE_SIZE][MAZE_SIZE])
+{
+	_UBYTE x, y;
+
+	for(y = 0; y < MAZE_SIZE; y++)
+	{
+		for(x = 0; x < MAZE_SIZE; x++)
+		{
+			map[y][x] = (_UBYTE)(maze[y][x] | (maze[y][x] << 4));
+		}
+	}
+}
+
+/** 種ごとのゴール領域(1x1から3x3,迷路の中)
+ * @param seed: 種
+ * @param x, y, w, h: ゴール領域
+ * @retval void
+ */
+void TestMaze_SetGoal(unsigned seed, _UBYTE* x, _UBYTE* y, _UBYTE* w, _UBYTE* h)
+{
+	TestMaze_Seed(seed * 7 + 3);
+	*w = (_UBYTE)(1 + TestMaze_Random() % 3);
+	*h = (_UBYTE)(1 + TestMaze_Random() % 3);
+	*x = (_UBYTE)(TestMaze_Random() % (MAZE_SIZE - *w + 1));
+	*y = (_UBYTE)(TestMaze_Random() % (MAZE_SIZE - *h + 1));
+}
+
+/** 乱数(処理系のrandに依らず同じ列を返す)
+ * @param void
+ * @retval unsigned: 0〜0x7fff
+ */
+unsigned TestMaze_Random(void)
+{
+	_seed = _seed * 1103515245u + 12345u;
+	return (_seed >> 16) & 0x7fff;
+}
+
+/** 乱数の種を設定する
+ * @param seed: 種
+ * @retval void
+ */
+void TestMaze_Seed(unsigned seed)
+{
+	_seed = seed + 1;
+}
+
+/** 経過時間(計測用)
+ * @param void
+ * @retval double: [usec]
+ */
+double TestMaze_NowUS(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec * 1e-3;
+}
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+/** 壁を取り除く(隣の区画の壁も)
+ */
+static void TestMaze_Remove(_UBYTE maze[MAZE_SIZE][MAZE_SIZE], _UBYTE x, _UBYTE y, _UBYTE d)
+{
+	maze[y][x] &= (_UBYTE)~(0x08 >> d);
+	if(d == 0)		maze[y + 1][x] &= (_UBYTE)~0x02;
+	else if(d == 1)	maze[y][x + 1] &= (_UBYTE)~0x01;
+	else if(d == 2)	maze[y - 1][x] &= (_UBYTE)~0x08;
+	else			maze[y][x - 1] &= (_UBYTE)~0x04;
+}
@@ -0,0 +1,31 @@
+/**
+ * @file  TestMaze.h
+ * @brief ホスト試験で使う迷路の生成
+ *
+ * 壁はmapと同じ形式(下位4bitにNESW順)で,隣の区画と食い違わないように作る.
+ * 同じ種からは同じ迷路ができるので,失敗した迷路を種で再現できる.
+ */
+
+#ifndef __TESTMAZE_H__
+#define __TESTMAZE_H__
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include "Controller/MazeDefine.h"
+
+/*----------------------------------------------------------------------
+	Public Macro Definitions
+ ----------------------------------------------------------------------*/
+#define TEST_MAZE_NUM	200		// 試験に使う迷路の数(種は0〜TEST_MAZE_NUM-1)
+
+/*----------------------------------------------------------------------
+	Public Method Declarations
+ ----------------------------------------------------------------------*/
+void TestMaze_Generate(_UBYTE maze[MAZE_SIZE][MAZE_SIZE], unsigned seed);
+void TestMaze_ToMap(_UBYTE maze[MAZE_SIZE][MAZE_SIZE], _UBYTE map[MAZE_SIZE][MAZE_SIZE]);
+void TestMaze_SetGoal(unsigned seed, _UBYTE* x, _UBYTE* y, _UBYTE* w, _UBYTE* h);
+unsigned TestMaze_Random(void);
+void TestMaze_Seed(unsigned seed);
+double TestMaze_NowUS(void);
+
+#endif
@@ -0,0 +1,445 @@
+/**
+ * @file  TimerTest.c
+ * @brief タイマー,周期タスク(Timer.c)のホスト試験
+ *
+ * Timer.cをそのまま取り込み,CMT2と割り込み要求フラグを仮想時計に置き換えて動かす.
+ * 型はHostTypedefine.hで実機と同じ幅にする(時刻カウンタの桁あふれを再現するため).
+ * 1. WaitMS,SleepUntilが時刻カウンタの桁あふれをまたいでも,指定時刻を過ぎてから戻ること
+ *    (タスクの実行で遅れるのはそのタスクの時間だけであること)
+ * 2. WaitUSがコンペアマッチでのクリアをまたいでも指定時間だけ待つこと
+ * 3. GetTimeUSが,割り込みが待たされて時刻カウンタが遅れていても仮想時計と一致すること
+ * 4. 周期タスクが周期どおりに実行され,過負荷でも同じ回数ずつ実行され,
+ *    大きく遅れたときに溜まった分をまとめて実行しないこと
+ * 待ちの間の時間は,常に実行時刻になっている周期0のタスク(Yieldの1回を1[usec]とする)で進める.
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "BoardDefine.h"
+
+/*----------------------------------------------------------------------
+	Private Macro Definitions
+ ----------------------------------------------------------------------*/
+#define TEST_WRAP_BEFORE	100		// 時刻カウンタの桁あふれの何[msec]前から始めるか
+#define TEST_WAITS			500		// 1,2の待ちの回数
+#define TEST_WAIT_MS_MAX	30		// 1で待つ最大のミリ秒
+#define TEST_WAIT_US_MAX	3000	// 2で待つ最大のマイクロ秒
+#define TEST_READ_MAX		30		// 2でCMCNTを読む間に進む最大のカウント数(割り込み処理など)
+#define TEST_READS			20000	// 3の読み出しの回数
+#define TEST_IDLE_US		1		// Yield 1回の時間 [usec]
+#define TEST_BUSY_US		300		// 1で待つ間に実行するタスクの時間 [usec]
+#define TEST_RUN_MS			10000	// 4で動かす時間 [msec]
+#define TEST_LOAD_US		700		// 4の過負荷のタスクの時間 [usec] (周期1[msec]で3つ)
+#define TEST_LIGHT_US		50		// 4の軽負荷のタスクの時間 [usec]
+#define TEST_LONG_US		20000	// 4の溜まった分を捨てるか調べるときの長いタスクの時間 [usec]
+#define TEST_TASKS			4		// 4で使うタスクの数
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+// ---- 仮想時計(Timer.cより前に置く) ----
+static _UQWORD _count = 0;					// 経過カウント(CMT2のカウントクロック)
+static _UWORD _cnt = 0;						// CMT2.CMCNTの値
+static _UDWORD _trueTick = 0;				// 割り込みの遅れを含まない時刻 [msec]
+static bool _masked = false;				// 割り込みを待たせている(割り込み処理中)
+static _UWORD _readCounts = 0;				// CMT2を読むたびに進めるカウント数
+static volatile struct st_cmt0 _cmt2;
+static volatile struct st_cmt _cmt;
+static _UBYTE _ir, _ien, _ipr, _mstp;		// CMT2の割り込み要求,許可,レベル,モジュールストップ
+
+static volatile struct st_cmt0* Test_Cmt2(void);
+
+/*----------------------------------------------------------------------
+	Timer.cの取り込み(レジスタを仮想時計に置き換える)
+ ----------------------------------------------------------------------*/
+#undef CMT
+#undef CMT2
+#undef IR
+#undef IEN
+#undef IPR
+#undef MSTP
+#define CMT				_cmt
+#define CMT2			(*Test_Cmt2())
+#define IR(x, y)		_ir
+#define IEN(x, y)		_ien
+#define IPR(x, y)		_ipr
+#define MSTP(x)			_mstp
+
+#include "Peripherals/Timer.c"
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+static _UDWORD _period[TEST_TASKS];			// タスクの周期 [msec]
+static _UDWORD _cost[TEST_TASKS];			// タスクの時間 [usec]
+static _UDWORD _due[TEST_TASKS];			// タスクの実行時刻 [msec]
+static _UDWORD _runs[TEST_TASKS];			// タスクの実行回数
+static _UDWORD _lastTick[TEST_TASKS];		// タスクを最後に実行した時刻 [msec]
+static _SDWORD _late = 0;					// タスクの実行時刻からの最大の遅れ [usec]
+static bool _sameTick = false;				// 同じ時刻に2回実行したタスクがある
+static int _depth = 0;						// タスクの入れ子の深さ
+static bool _nested = false;				// タスクの中でタスクが実行された
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+/** 仮想時計を進める
+ *   コンペアマッチで割り込み要求を立て,待たされていなければ割り込みを実行する
+ * @param counts: 進めるカウント数
+ */
+static void Test_Advance(_UDWORD counts)
+{
+	_UDWORD step;
+
+	while(counts > 0)
+	{
+		step = TIMER_TICK_INTERVAL - _cnt;
+		if(step > counts)
+		{
+			step = counts;
+		}
+		_cnt += step;
+		_count += step;
+		counts -= step;
+		if(_cnt == TIMER_TICK_INTERVAL)
+		{
+			_cnt = 0;
+			_trueTick++;
+			_ir = 1;
+		}
+		if(_ir && !_masked)
+		{
+			_ir = 0;
+			Timer_IntCMT2();
+		}
+	}
+	if(_ir && !_masked)
+	{
+		_ir = 0;
+		Timer_IntCMT2();
+	}
+}
+
+/** CMT2のレジスタ(読むたびに_readCountsだけ仮想時計を進める)
+ */
+static volatile struct st_cmt0* Test_Cmt2(void)
+{
+	Test_Advance(_readCounts);
+	_cmt2.CMCNT = _cnt;
+	return &_cmt2;
+}
+
+/** 待ちの間に時間を進めるタスク
+ */
+static void Test_Idle(void)
+{
+	Test_Advance(TEST_IDLE_US * TIMER_COUNT_PER_US);
+}
+
+/** 1で待つ間に実行するタスク
+ */
+static void Test_Busy(void)
+{
+	Test_Advance(TEST_BUSY_US * TIMER_COUNT_PER_US);
+}
+
+/** 4のタスクの本体
+ *   実行時刻からの遅れ,同じ時刻での2回目の実行,入れ子を記録し,_cost[n]だけ時間を進める
+ */
+static void Test_Run(int n)
+{
+	_SDWORD late = (_SDWORD)(Timer_GetTimeUS() - _due[n] * 1000);
+
+	if(late > _late)
+	{
+		_late = late;
+	}
+	if((_runs[n] != 0) && (_lastTick[n] == _tick))
+	{
+		_sameTick = true;
+	}
+	_lastTick[n] = _tick;
+	_due[n] += _period[n];
+	_runs[n]++;
+
+	if(++_depth > 1)
+	{
+		_nested = true;
+	}
+	Timer_Yield();				// タスクの中の待ちでは他のタスクを実行しない
+	Test_Advance(_cost[n] * TIMER_COUNT_PER_US);
+	_depth--;
+}
+
+static void Test_Task0(void) { Test_Run(0); }
+static void Test_Task1(void) { Test_Run(1); }
+static void Test_Task2(void) { Test_Run(2); }
+static void Test_Task3(void) { Test_Run(3); }
+
+static void (* const _taskFunc[TEST_TASKS])(void) = { Test_Task0, Test_Task1, Test_Task2, Test_Task3 };
+
+/** 4のタスクを登録し,TEST_RUN_MSだけ待つ
+ * @param num: タスクの数
+ * @param period, cost: タスクごとの周期 [msec],時間 [usec]
+ */
+static void Test_RunTasks(int num, const _UDWORD* period, const _UDWORD* cost, _UDWORD runMS)
+{
+	int n;
+
+	_late = 0;
+	_sameTick = false;
+	_nested = false;
+	for(n = 0; n < num; n++)
+	{
+		_period[n] = period[n];
+		_cost[n] = cost[n];
+		_due[n] = _tick + period[n];
+		_runs[n] = 0;
+		Timer_AddTask(_taskFunc[n], (_UWORD)period[n]);
+	}
+	Timer_SleepUntil(_tick + runMS);
+	for(n = 0; n < num; n++)
+	{
+		Timer_RemoveTask(_taskFunc[n]);
+	}
+}
+
+/** 1: ミリ秒の待ち
+ * @param busy: 待つ間にTest_Busyを実行するか
+ * @param maxLate: 指定時刻からの最大の遅れ [usec]
+ * @retval bool: true: 正しい
+ */
+static bool Test_WaitMS(bool busy, _UDWORD* maxLate)
+{
+	_UDWORD ms, deadline, late, limit;
+	_UQWORD start;
+	int n;
+
+	*maxLate = 0;
+	if(busy)
+	{
+		Timer_AddTask(Test_Busy, 2);
+	}
+	// 待ちの遅れは1[msec]の残り,Yield1回,待つ間のタスク1回まで
+	limit = (1000 + TEST_IDLE_US + (busy ? TEST_BUSY_US : 0)) * TIMER_COUNT_PER_US;
+	for(n = 0; n < TEST_WAITS; n++)
+	{
+		ms = (_UDWORD)(rand() % TEST_WAIT_MS_MAX);
+		Test_Advance((_UDWORD)(rand() % TIMER_TICK_INTERVAL));	// 1[msec]の中の任意の位置から
+
+		if(n % 2 == 0)
+		{
+			start = _count;
+			Timer_WaitMS(ms);
+			if((_count - start < ms * TIMER_TICK_INTERVAL) || (_count - start > ms * TIMER_TICK_INTERVAL + limit))
+			{
+				printf("FAIL: WaitMS(%lu) took %lu counts\n", (unsigned long)ms, (unsigned long)(_count - start));
+				return false;
+			}
+			late = _cnt;			// 次の時刻から数えたms後の時刻を過ぎた分
+		}
+		else
+		{
+			deadline = _tick + ms;
+			Timer_SleepUntil(deadline);
+			// 指定時刻ちょうどに戻る(Yield1回,タスク1回では1[msec]を越えない)
+			if(_tick != deadline && ms != 0)
+			{
+				printf("FAIL: SleepUntil(%lu) returned at %lu\n", (unsigned long)deadline, (unsigned long)_tick);
+				return false;
+			}
+			late = (ms != 0) ? _cnt : 0;
+		}
+		if(late / TIMER_COUNT_PER_US > *maxLate)
+		{
+			*maxLate = late / TIMER_COUNT_PER_US;
+		}
+	}
+	if(busy)
+	{
+		Timer_RemoveTask(Test_Busy);
+	}
+	return true;
+}
+
+/** 2: マイクロ秒の待ち
+ * @param maxOver: 指定時間を越えた最大のカウント数
+ * @retval bool: true: 正しい
+ */
+static bool Test_WaitUS(_UDWORD* maxOver)
+{
+	_UDWORD us, over;
+	_UQWORD start;
+	int n;
+
+	*maxOver = 0;
+	for(n = 0; n < TEST_WAITS; n++)
+	{
+		us = (_UDWORD)(rand() % TEST_WAIT_US_MAX);
+		_readCounts = (_UWORD)(1 + rand() % TEST_READ_MAX);
+		start = _count;
+		Timer_WaitUS(us);
+		// 最初の読み出しまでと最後の読み出しの分だけ長くなる
+		if((_count - start < us * TIMER_COUNT_PER_US) || (_count - start > us * TIMER_COUNT_PER_US + 2 * _readCounts))
+		{
+			printf("FAIL: WaitUS(%lu) took %lu counts\n", (unsigned long)us, (unsigned long)(_count - start));
+			return false;
+		}
+		over = (_UDWORD)(_count - start) - us * TIMER_COUNT_PER_US;
+		if(over > *maxOver)
+		{
+			*maxOver = over;
+		}
+	}
+	_readCounts = 0;
+	return true;
+}
+
+/** 3: マイクロ秒の時刻
+ *   割り込みを待たせる時間は1[msec]の半分未満(GetTimeUSで補正できる範囲)
+ * @retval bool: true: 正しい
+ */
+static bool Test_TimeUS(void)
+{
+	_UDWORD t, expect, held;
+	int n;
+
+	_trueTick = _tick;
+	for(n = 0; n < TEST_READS; n++)
+	{
+		if(rand() % 4 == 0)
+		{
+			_masked = true;
+			held = (_UDWORD)(rand() % (TIMER_TICK_INTERVAL / 2));
+			Test_Advance(held);
+		}
+		else
+		{
+			Test_Advance((_UDWORD)(rand() % (2 * TIMER_TICK_INTERVAL)));
+		}
+		t = Timer_GetTimeUS();
+		expect = _trueTick * 1000 + _cnt / TIMER_COUNT_PER_US;
+		if(t != expect)
+		{
+			printf("FAIL: GetTimeUS %lu, expected %lu (masked %d)\n", (unsigned long)t, (unsigned long)expect, _masked);
+			return false;
+		}
+		_masked = false;
+		Test_Advance(0);
+	}
+	return true;
+}
+
+/*----------------------------------------------------------------------
+	Main
+ ----------------------------------------------------------------------*/
+int main(void)
+{
+	static const _UDWORD loadPeriod[] = { 1, 1, 1 };
+	static const _UDWORD loadCost[] = { TEST_LOAD_US, TEST_LOAD_US, TEST_LOAD_US };
+	static const _UDWORD lightPeriod[] = { 1, 2, 5, 10 };
+	static const _UDWORD lightCost[] = { TEST_LIGHT_US, TEST_LIGHT_US, TEST_LIGHT_US, TEST_LIGHT_US };
+	static const _UDWORD longPeriod[] = { 1, 100 };
+	static const _UDWORD longCost[] = { 10, TEST_LONG_US };
+	_UDWORD late, lateBusy, over, runs;
+	int n;
+
+	srand(1);
+	Timer_Initialize();
+	_tick = 0xFFFFFFFFu - TEST_WRAP_BEFORE;
+	if(!Timer_AddTask(Test_Idle, 0))
+	{
+		printf("FAIL: AddTask\n");
+		return 1;
+	}
+
+	// ---- 1 ----
+	if(!Test_WaitMS(false, &late) || !Test_WaitMS(true, &lateBusy))
+	{
+		return 1;
+	}
+	if(_tick > 0x80000000u)
+	{
+		printf("FAIL: the tick did not wrap\n");
+		return 1;
+	}
+	printf("deadline: %d waits across the tick wrap, late by at most %lu us (%lu us with a %d us task)\n",
+			2 * TEST_WAITS, (unsigned long)late, (unsigned long)lateBusy, TEST_BUSY_US);
+
+	// ---- 2 ----
+	if(!Test_WaitUS(&over))
+	{
+		return 1;
+	}
+	printf("wait us: %d waits, over by at most %lu counts\n", TEST_WAITS, (unsigned long)over);
+
+	// ---- 3 ----
+	if(!Test_TimeUS())
+	{
+		return 1;
+	}
+	printf("time us: %d reads match the virtual clock\n", TEST_READS);
+
+	// ---- 4 ----
+	// 登録数の上限(Test_Idleで1つ使っている)
+	for(n = 0; n < TIMER_TASK_MAX - 1; n++)
+	{
+		if(!Timer_AddTask(_taskFunc[0], 1))
+		{
+			printf("FAIL: AddTask %d\n", n);
+			return 1;
+		}
+	}
+	if(Timer_AddTask(_taskFunc[1], 1))
+	{
+		printf("FAIL: AddTask over TIMER_TASK_MAX\n");
+		return 1;
+	}
+	Timer_RemoveTask(_taskFunc[0]);
+
+	// 過負荷: 周期1[msec]で時間0.7[msec]のタスク3つは同じ回数ずつ
+	Test_RunTasks(3, loadPeriod, loadCost, TEST_RUN_MS);
+	if((_runs[0] > _runs[1] + 1) || (_runs[1] > _runs[0] + 1) || (_runs[0] > _runs[2] + 1) || (_runs[2] > _runs[0] + 1)
+			|| _nested)
+	{
+		printf("FAIL: overload runs %lu %lu %lu\n", (unsigned long)_runs[0], (unsigned long)_runs[1], (unsigned long)_runs[2]);
+		return 1;
+	}
+	printf("overload: 3 tasks ran %lu %lu %lu times\n",
+			(unsigned long)_runs[0], (unsigned long)_runs[1], (unsigned long)_runs[2]);
+
+	// 軽負荷: 周期どおりの回数で,遅れは他のタスクの時間まで
+	Test_RunTasks(4, lightPeriod, lightCost, TEST_RUN_MS);
+	for(n = 0; n < 4; n++)
+	{
+		runs = TEST_RUN_MS / lightPeriod[n];
+		if((_runs[n] + 1 < runs) || (_runs[n] > runs))
+		{
+			printf("FAIL: task %d (period %lu) ran %lu times\n", n, (unsigned long)lightPeriod[n], (unsigned long)_runs[n]);
+			return 1;
+		}
+	}
+	if((_late > (_SDWORD)(3 * TEST_LIGHT_US + TEST_IDLE_US)) || _nested)
+	{
+		printf("FAIL: light load late by %ld us\n", (long)_late);
+		return 1;
+	}
+	printf("light load: periods 1 2 5 10 ms ran on time, late by at most %ld us\n", (long)_late);
+
+	// 長いタスクで遅れても,溜まった分をまとめて実行しない
+	Test_RunTasks(2, longPeriod, longCost, 1000);
+	if(_sameTick)
+	{
+		printf("FAIL: a late task ran twice in one tick\n");
+		return 1;
+	}
+	printf("backlog: 1 ms task ran %lu times in 1000 ms beside a %d ms task, never twice in one tick\n",
+			(unsigned long)_runs[0], TEST_LONG_US / 1000);
+
+	printf("TimerTest: PASS\n");
+	return 0;
+}
@@ -0,0 +1,226 @@
+/**
+ * @file  WheelCtrlTest.c
+ * @brief 車輪速度制御(MouseController_WheelDuty)のホスト試験
+ *
+ * MouseController.cをそのまま取り込み,車輪1輪のモータの模型と閉ループを組む.
+ * 模型はフィードフォワードと同じ式(逆起電力,加速分,摩擦)で,効き(トルク)と摩擦を
+ * 設計値からずらし,フィードバックで埋める分を作る.速度はエンコーダと同じく1制御周期遅れで返す.
+ *   - 台形の速度指令に追従し,等速区間の定常偏差が小さいこと
+ *   - 出力が上限に張り付く階段状の指令で,行き過ぎが小さいこと(アンチワインドアップ)
+ *   - 出せない速度を指令し続けた後,積分が溜まっておらず,届く速度に戻したときにすぐ追従すること
+ * CONTROL_FIXED_POINT=0(WheelCtrlTest)と1(WheelCtrlFixTest)の両方でビルドする.
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "Controller/MouseController.c"
+
+/*----------------------------------------------------------------------
+	Private Macro Definitions
+ ----------------------------------------------------------------------*/
+#define TEST_PLANT_GAIN		0.8		// 模型のトルクの効き(設計値との比)
+#define TEST_PLANT_FRICTION	1.5		// 模型の摩擦(設計値との比)
+#define TEST_SUBSTEP		10		// 1制御周期を分ける数
+
+#define TEST_TRACK_ERR_MAX	100.0	// 台形指令の加減速中の偏差の上限 [mm/s]
+#define TEST_STEADY_ERR_MAX	5.0		// 等速区間の終わりの偏差の上限 [mm/s]
+#define TEST_OVERSHOOT_MAX	0.03	// 飽和する階段状の指令の行き過ぎの上限(指令との比)
+#define TEST_RECOVER_MS_MAX	150		// 出せない速度の指令から戻したときに指令の2%以内に入るまでの時間の上限 [msec]
+#define TEST_INTEG_MAX		(DRV8836_DUTY_MAX / VEL_KI)	// 積分の上限(積分だけで上限の出力になる量) [mm]
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+static WheelVelCtrl _ctrl;
+static double _v = 0;			// 模型の車輪速度 [mm/s]
+static double _vMeas = 0;		// 制御に返す車輪速度(1制御周期前の値) [mm/s]
+static double _duty = 0;		// 最後の出力 [%]
+static int _sat = 0;			// 出力が上限に張り付いた周期数
+
+/*----------------------------------------------------------------------
+	デバイスの置き換え(この試験では制御割り込みを呼ばない)
+ ----------------------------------------------------------------------*/
+static LSVal _lsv;
+
+_UWORD AS5055_GetAngle(E_AS5055_LR encLR)		{ (void)encLR; return 0; }
+_UDWORD AS5055_GetStamp(E_AS5055_LR encLR)		{ (void)encLR; return 0; }
+bool DRV8836_DriveMotor(E_MOTOR_TYPE type, E_MOTOR_DIR dir, float duty)	{ (void)type; (void)dir; (void)duty; return true; }
+void LightSensor_Update(void)					{}
+LSVal* LightSensor_GetValue(void)				{ return &_lsv; }
+_UDWORD LightSensor_GetStamp(void)				{ return 0; }
+void LightSensor_TriggerScan(void)				{}
+void LightSensor_SetDistTable(E_LS_CHANNEL ch, const _SWORD* ad)	{ (void)ch; (void)ad; }
+const _SWORD* LightSensor_GetDistTable(E_LS_CHANNEL ch)	{ (void)ch; return NULL; }
+void LightSensor_GetBaseLR(void)				{}
+void LightSensor_SetWallBase(const _SWORD* base)	{ (void)base; }
+const _SWORD* LightSensor_GetWallBase(void)		{ return NULL; }
+void LightSensor_PrintDistTable(void)			{}
+float Battery_GetValue(void)					{ return HW_BATTERY_NOMINAL; }
+_SWORD MPU6500_GetAngVel(void)					{ return 0; }
+void MPU6500_TrackBias(void)					{}
+void MPU6500_GetSample(ImuSample* sample)		{ memset(sample, 0, sizeof(*sample)); }
+_UDWORD Timer_GetTimeUS(void)					{ return 0; }
+bool Timer_AddTask(void (*task)(void), _UWORD periodMS)	{ (void)task; (void)periodMS; return true; }
+void RSPI0_TriggerCycleOperation(void)			{}
+void Int_SPRI0(void)							{}
+bool ParamStore_Set(PARAM_KEY key, const void* data, _UBYTE len)	{ (void)key; (void)data; (void)len; return true; }
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+/** 制御器と模型を止まった状態にする
+ */
+static void Test_Reset(void)
+{
+	memset(&_ctrl, 0, sizeof(_ctrl));
+	_v = 0;
+	_vMeas = 0;
+	_duty = 0;
+	_sat = 0;
+}
+
+/** 1制御周期分,制御器と模型を進める
+ *   模型: duty = VEL_FF_V * v + VEL_FF_A * (1制御周期あたりの速度変化) + 摩擦 をvについて解く
+ * @param tarv: 目標車輪速度 [mm/s]
+ */
+static void Test_Cycle(double tarv)
+{
+	const double dt = 1.0 / TEST_SUBSTEP;		// [制御周期]
+	double force;
+	int i;
+
+	_duty = CTRL_TO_FLOAT(MouseController_WheelDuty(&_ctrl, CTRL_FROM_FLOAT(tarv), CTRL_FROM_FLOAT(_vMeas)));
+	if(fabs(_duty) >= DRV8836_DUTY_MAX - 1e-3)
+	{
+		_sat++;
+	}
+	_vMeas = _v;
+	for(i = 0; i < TEST_SUBSTEP; i++)
+	{
+		force = _duty * TEST_PLANT_GAIN - VEL_FF_V * _v;
+		if(_v > 0)			force -= VEL_FF_F * TEST_PLANT_FRICTION;
+		else if(_v < 0)		force += VEL_FF_F * TEST_PLANT_FRICTION;
+		else if(fabs(force) <= VEL_FF_F * TEST_PLANT_FRICTION)	force = 0;	// 静止摩擦
+		else				force -= ((force > 0) ? 1 : -1) * VEL_FF_F * TEST_PLANT_FRICTION;
+		_v += force / VEL_FF_A * dt;
+	}
+}
+
+/** 台形の速度指令への追従
+ *   0から加速してVMAXで等速,その後0まで減速する
+ */
+static bool Test_Track(void)
+{
+	const double vmax = 1000, acc = 3000;	// [mm/s], [mm/s^2]
+	const int accMs = (int)(vmax / acc * 1000), holdMs = 500;
+	double tarv, errMax = 0, steady;
+	int t;
+
+	Test_Reset();
+	for(t = 0; t < 2 * accMs + holdMs; t++)
+	{
+		if(t < accMs)					tarv = acc * t / 1000.0;
+		else if(t < accMs + holdMs)		tarv = vmax;
+		else							tarv = vmax - acc * (t - accMs - holdMs) / 1000.0;
+		Test_Cycle(tarv);
+		if(fabs(tarv - _v) > errMax)
+		{
+			errMax = fabs(tarv - _v);
+		}
+		if(t == accMs + holdMs - 1)
+		{
+			steady = vmax - _v;
+		}
+	}
+	printf("tracking: error at most %.1f mm/s, %.2f mm/s at the end of the cruise\n", errMax, steady);
+	if((errMax > TEST_TRACK_ERR_MAX) || (fabs(steady) > TEST_STEADY_ERR_MAX))
+	{
+		printf("FAIL: trapezoid tracking error %.1f mm/s (limit %.1f), steady %.2f mm/s (limit %.1f)\n",
+				errMax, TEST_TRACK_ERR_MAX, steady, TEST_STEADY_ERR_MAX);
+		return false;
+	}
+	return true;
+}
+
+/** 出力が上限に張り付く階段状の指令
+ */
+static bool Test_Step(void)
+{
+	const double tarv = 2000;		// [mm/s] 上限の出力で届くが,立ち上がりは張り付く
+	double vPeak = 0;
+	int t;
+
+	Test_Reset();
+	for(t = 0; t < 2000; t++)
+	{
+		Test_Cycle(tarv);
+		if(_v > vPeak)
+		{
+			vPeak = _v;
+		}
+	}
+	printf("saturated step: %d ms at the duty limit, overshoot %.2f %%, %.1f mm/s after 2 s\n",
+			_sat, (vPeak - tarv) / tarv * 100, _v);
+	if((_sat == 0) || (vPeak > tarv * (1 + TEST_OVERSHOOT_MAX)) || (fabs(_v - tarv) > TEST_STEADY_ERR_MAX))
+	{
+		printf("FAIL: step to %.0f mm/s peaked at %.1f mm/s and settled at %.1f mm/s\n", tarv, vPeak, _v);
+		return false;
+	}
+	return true;
+}
+
+/** 出せない速度を指令し続けた後,届く速度に戻す
+ */
+static bool Test_Windup(void)
+{
+	const double tarHigh = 4000, tarLow = 1000;		// [mm/s]
+	double integ;
+	int t, reach = -1;
+
+	Test_Reset();
+	for(t = 0; t < 1000; t++)
+	{
+		Test_Cycle(tarHigh);
+	}
+	if(_v >= tarHigh * 0.9)
+	{
+		printf("FAIL: %.0f mm/s should be out of reach (reached %.1f mm/s)\n", tarHigh, _v);
+		return false;
+	}
+	integ = CTRL_TO_FLOAT(_ctrl.Integ);
+	for(t = 0; (t < 1000) && (reach < 0); t++)
+	{
+		Test_Cycle(tarLow);
+		if(fabs(_v - tarLow) <= tarLow * 0.02)
+		{
+			reach = t;
+		}
+	}
+	printf("windup: held at %.0f mm/s, integral %.1f mm, within 2 %% of %.0f mm/s after %d ms\n",
+			tarHigh, integ, tarLow, reach);
+	if((fabs(integ) > TEST_INTEG_MAX) || (reach < 0) || (reach > TEST_RECOVER_MS_MAX))
+	{
+		printf("FAIL: after the unreachable command: integral %.1f mm (limit %.1f), %d ms to come back (limit %d)\n",
+				integ, TEST_INTEG_MAX, reach, TEST_RECOVER_MS_MAX);
+		return false;
+	}
+	return true;
+}
+
+/*----------------------------------------------------------------------
+	Main
+ ----------------------------------------------------------------------*/
+int main(void)
+{
+	if(!Test_Track() || !Test_Step() || !Test_Windup())
+	{
+		return 1;
+	}
+	printf("%s: PASS\n", WHEEL_CTRL_TEST_NAME);
+	return 0;
+}
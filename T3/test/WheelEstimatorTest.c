@@ -0,0 +1,436 @@
+/**
+ * @file  WheelEstimatorTest.c
+ * @brief 車輪の角度,角速度の推定(WheelEstimator.c)とエンコーダの受信データ処理(AS5055.c)のホスト試験
+ *
+ * WheelEstimator.c,AS5055.cをそのまま取り込み,合成したエンコーダの角度列
+ * (SPIの取得周期で取得時刻付き,1制御周期ごとに最新のサンプルを渡す)で確かめる.
+ * 1. WrapDiffが全ての角度の組で1回転で折り返した差になること
+ * 2. 等速,加減速で0と4095の境目を何度もまたいでも,推定角速度が真値に追従し,
+ *    1制御周期の角度差より誤差が小さいこと.返す角度変化の合計が実際の回転量と一致すること
+ * 3. 単発の外れ値を棄却して推定が乱れないこと.WHEEL_EST_REJECT_MAX回続けば実際に動いたとみなすこと
+ * 4. 取得間隔がWHEEL_EST_DT_MIN_US未満のサンプル,同じ時刻のサンプルを使わず,
+ *    WHEEL_EST_DT_MAX_USより空いたらやり直すこと
+ * 5. AS5055: 境目をまたぐ角度の平均が崩れないこと.パリティ異常,エラーフラグの受信データを捨てること
+ * 時刻は時刻カウンタの桁あふれの直前から始める.CONTROL_FIXED_POINT=0,1の両方でビルドする.
+ */
+
+/*----------------------------------------------------------------------
+	Includes
+ ----------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Controller/WheelEstimator.c"
+#include "Devices/AS5055.c"
+
+/*----------------------------------------------------------------------
+	Private Macro Definitions
+ ----------------------------------------------------------------------*/
+#define TEST_TICK_US		1000	// 制御周期 [usec]
+#define TEST_SPI_US			1560	// エンコーダの取得周期 [usec] (制御周期と同期しない)
+#define TEST_JITTER_US		50		// 取得時刻のばらつき [usec]
+#define TEST_TICKS			3000	// 1つの角度列の制御周期数
+#define TEST_SETTLE			100		// 追従を待つ制御周期数
+#define TEST_START_US		(0xFFFFFFFFu - 1000000)	// 開始時刻(1[sec]後に時刻カウンタが桁あふれする)
+#define TEST_VEL_TOL		0.15	// 等速での推定角速度の誤差の上限 [count/msec] (二乗平均,±1カウントの雑音で約0.11)
+#define TEST_VEL_REL		0.01	// 同,速度に比例する分
+#define TEST_ACC_LAG		0.7		// 加減速での推定角速度の誤差の上限 [count/msec] (最大)
+#define TEST_OUTLIER_EVERY	37		// 3で外れ値を入れる間隔 [サンプル]
+#define TEST_JUMP			300		// 3で実際に飛ぶ角度 [count]
+#define TEST_AVG_SETS		10000	// 5で平均を確かめる組の数
+#define TEST_AVG_SPREAD		200		// 5の1組の角度の広がり [count]
+
+#if ENCODER_SAMPLING_NUM < 2
+#error "build with ENCODER_SAMPLING_NUM >= 2 to test the averaging"
+#endif
+
+/*----------------------------------------------------------------------
+	Private global variables
+ ----------------------------------------------------------------------*/
+static _UDWORD _timeUS = 0;
+
+// ---- 合成した角度列 ----
+typedef struct
+{
+	double Vel0;				// 初速度 [count/msec]
+	double Acc;					// 加速度 [count/msec^2] (TEST_TICKSの半分で符号を反転する)
+	int Noise;					// 角度に足す雑音の幅(±) [count]
+	int OutlierEvery;			// 外れ値を入れる間隔(0なら入れない) [サンプル]
+}TestTrace;
+
+typedef struct
+{
+	double VelRms;				// 推定角速度の誤差の二乗平均 [count/msec]
+	double VelMax;				// 推定角速度の誤差の最大 [count/msec]
+	double TickRms;				// 1制御周期の角度差の誤差の二乗平均 [count/msec]
+	_SDWORD DiffSum;			// 返した角度変化の合計 [count]
+	_SDWORD Travel;				// 最初と最後に採用したサンプルの間の実際の回転量 [count]
+	_UDWORD Outliers;			// 入れた外れ値の数(TEST_SETTLE以降)
+	_UDWORD Rejects;			// 棄却した数(TEST_SETTLE以降)
+}TestResult;
+
+/*----------------------------------------------------------------------
+	デバイスの置き換え
+ ----------------------------------------------------------------------*/
+_UDWORD Timer_GetTimeUS(void)					{ return _timeUS; }
+bool RSPI0_RegisterDeviceForCycleOperation(RSPI_CYCLE_DESC* desc)	{ (void)desc; return true; }
+void Int_SPRI0(void)							{}
+
+/*----------------------------------------------------------------------
+	Private Method Definitions
+ ----------------------------------------------------------------------*/
+/** 1: 全ての角度の組でWrapDiffを確かめる
+ * @retval bool: true: 正しい
+ */
+static bool Test_WrapDiff(void)
+{
+	int a, b, ref;
+
+	for(a = 0; a < WHEEL_EST_COUNT; a++)
+	{
+		for(b = 0; b < WHEEL_EST_COUNT; b++)
+		{
+			ref = ((a - b) % WHEEL_EST_COUNT + WHEEL_EST_COUNT + WHEEL_EST_COUNT / 2) % WHEEL_EST_COUNT
+					- WHEEL_EST_COUNT / 2;
+			if(WheelEstimator_WrapDiff((_UWORD)a, (_UWORD)b) != ref)
+			{
+				printf("FAIL: WrapDiff(%d, %d) = %d, expected %d\n",
+						a, b, WheelEstimator_WrapDiff((_UWORD)a, (_UWORD)b), ref);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/** 角度列を合成して推定させる
+ *   SPIの取得ごとに真の角度(途中で0と4095の境目をまたぐ)を量子化し,雑音,外れ値を足す.
+ *   制御周期ごとに最新のサンプルを推定器に渡す
+ * @param trace: 角度列の条件
+ * @param result: 結果
+ */
+static void Test_Run(const TestTrace* trace, TestResult* result)
+{
+	WheelEstimator est;
+	double pos = 0.5 - trace->Vel0 * TEST_TICKS / 2, vel = trace->Vel0, acc = trace->Acc;	// 途中で0をまたぐ
+	double t = 0, nextSpi = 0, err;
+	_SDWORD truth = 0, first = 0, lastAccepted = 0, tickTruth = 0, prevTickTruth = 0;
+	_UWORD angle = 0;
+	_UDWORD stamp = 0, samples = 0, rejects = 0;
+	bool have = false, started = false;
+	int tick, n = 0;
+
+	memset(result, 0, sizeof(*result));
+	WheelEstimator_Reset(&est);
+
+	for(tick = 0; tick < TEST_TICKS; tick++)
+	{
+		if(tick == TEST_TICKS / 2)
+		{
+			acc = -acc;
+		}
+
+		// ---- この制御周期までのSPIの取得 ----
+		while(nextSpi <= (tick + 1) * TEST_TICK_US)
+		{
+			double dt = (nextSpi - t) / 1000.0;
+
+			vel += acc * dt;
+			pos += vel * dt - acc * dt * dt / 2;
+			t = nextSpi;
+			truth = (_SDWORD)floor(pos) + ((trace->Noise > 0) ? (rand() % (2 * trace->Noise + 1)) - trace->Noise : 0);
+			angle = (_UWORD)(truth & (WHEEL_EST_COUNT - 1));
+			samples++;
+			if((trace->OutlierEvery > 0) && (samples % trace->OutlierEvery == 0))
+			{
+				// 予測から必ずWHEEL_EST_GATEより外れる角度
+				angle = (_UWORD)((angle + WHEEL_EST_GATE * 4 + rand() % (WHEEL_EST_COUNT - WHEEL_EST_GATE * 8))
+						& (WHEEL_EST_COUNT - 1));
+				if(tick >= TEST_SETTLE)
+				{
+					result->Outliers++;
+				}
+			}
+			stamp = TEST_START_US + (_UDWORD)t + (_UDWORD)(rand() % (TEST_JITTER_US + 1));
+			have = true;
+			nextSpi += TEST_SPI_US;
+		}
+		if(!have)
+		{
+			continue;
+		}
+
+		// ---- 制御周期での推定 ----
+		if(tick == TEST_SETTLE)
+		{
+			rejects = est.RejectNum;	// 動きながら推定を始めると最初は棄却が続くので数えない
+		}
+		_timeUS = TEST_START_US + (_UDWORD)((tick + 1) * TEST_TICK_US);
+		result->DiffSum += WheelEstimator_Update(&est, angle, stamp);
+		if(est.Stamp == stamp)
+		{
+			lastAccepted = truth;
+			if(!started)
+			{
+				first = truth;
+				result->DiffSum = 0;
+				started = true;
+			}
+		}
+
+		// 1制御周期の角度差(従来の求め方)
+		prevTickTruth = tickTruth;
+		tickTruth = truth;
+
+		if(tick >= TEST_SETTLE)
+		{
+			err = CTRL_TO_FLOAT(est.Vel) - vel;
+			result->VelRms += err * err;
+			result->VelMax = fmax(result->VelMax, fabs(err));
+			err = (tickTruth - prevTickTruth) * 1000.0 / TEST_TICK_US - vel;
+			result->TickRms += err * err;
+			n++;
+		}
+	}
+
+	result->VelRms = sqrt(result->VelRms / n);
+	result->TickRms = sqrt(result->TickRms / n);
+	result->Travel = lastAccepted - first;
+	result->Rejects = est.RejectNum - rejects;
+}
+
+/** 2, 3: 角度列で推定を確かめる
+ * @retval bool: true: 正しい
+ */
+static bool Test_Traces(void)
+{
+	static const double vels[] = { 0.05, 0.3, 2.0, 10.0, 40.0 };
+	TestTrace trace = {0};
+	TestResult res;
+	double worstRms = 0, worstRatio = 0, lag = 0, tol;
+	unsigned i, sign;
+
+	// ---- 2: 等速(両方向) ----
+	for(i = 0; i < sizeof(vels) / sizeof(vels[0]); i++)
+	{
+		for(sign = 0; sign < 2; sign++)
+		{
+			trace.Vel0 = sign ? -vels[i] : vels[i];
+			trace.Noise = 1;
+			Test_Run(&trace, &res);
+			tol = TEST_VEL_TOL + TEST_VEL_REL * vels[i];
+			if((res.VelRms > tol) || (res.VelRms > res.TickRms / 2))
+			{
+				printf("FAIL: %.2f count/ms: velocity error %.4f (one-tick difference %.4f, limit %.4f)\n",
+						trace.Vel0, res.VelRms, res.TickRms, tol);
+				return false;
+			}
+			if((res.DiffSum != res.Travel) || (res.Rejects != 0))
+			{
+				printf("FAIL: %.2f count/ms: returned %ld counts for %ld travelled, %lu rejects\n", trace.Vel0,
+						(long)res.DiffSum, (long)res.Travel, (unsigned long)res.Rejects);
+				return false;
+			}
+			worstRms = fmax(worstRms, res.VelRms);
+			worstRatio = fmax(worstRatio, res.VelRms / res.TickRms);
+		}
+	}
+	printf("constant speed: velocity error at most %.4f count/ms rms (x%.2f of the one-tick difference)\n",
+			worstRms, worstRatio);
+
+	// ---- 2: 加減速(0から40[count/msec]まで加速して戻る) ----
+	trace.Vel0 = 0;
+	trace.Acc = 40.0 / (TEST_TICKS / 2);
+	trace.Noise = 1;
+	Test_Run(&trace, &res);
+	if((res.VelMax > TEST_ACC_LAG) || (res.DiffSum != res.Travel))
+	{
+		printf("FAIL: ramp: velocity error up to %.4f count/ms, returned %ld counts for %ld travelled\n",
+				res.VelMax, (long)res.DiffSum, (long)res.Travel);
+		return false;
+	}
+	lag = res.VelMax;
+
+	// ---- 3: 単発の外れ値 ----
+	trace.Vel0 = 10.0;
+	trace.Acc = 0;
+	trace.OutlierEvery = TEST_OUTLIER_EVERY;
+	Test_Run(&trace, &res);
+	tol = TEST_VEL_TOL + TEST_VEL_REL * trace.Vel0;
+	if((res.Rejects != res.Outliers) || (res.VelRms > tol))
+	{
+		printf("FAIL: outliers: %lu of %lu rejected, velocity error %.4f (limit %.4f)\n",
+				(unsigned long)res.Rejects, (unsigned long)res.Outliers, res.VelRms, tol);
+		return false;
+	}
+	printf("ramp: velocity lags by at most %.4f count/ms; outliers: %lu of %lu rejected, error %.4f count/ms rms\n",
+			lag, (unsigned long)res.Rejects, (unsigned long)res.Outliers, res.VelRms);
+	return true;
+}
+
+/** 3, 4: 続けて外れたとき,取得間隔が短い,空いたときを確かめる
+ * @retval bool: true: 正しい
+ */
+static bool Test_Edges(void)
+{
+	WheelEstimator est;
+	_UDWORD stamp = 0xFFFFFFFFu - 20 * 1000;	// 途中で時刻カウンタが桁あふれする
+	_UWORD angle = WHEEL_EST_COUNT - 20;
+	_SWORD diff = 0;
+	int i;
+
+	// ---- 等速(5[count/msec])で追従させておく ----
+	WheelEstimator_Reset(&est);
+	for(i = 0; i < 50; i++)
+	{
+		WheelEstimator_Update(&est, angle, stamp);
+		angle = (angle + 5) & (WHEEL_EST_COUNT - 1);
+		stamp += 1000;
+	}
+
+	// ---- 3: TEST_JUMPだけ飛んだまま戻らない ----
+	angle = (angle + TEST_JUMP) & (WHEEL_EST_COUNT - 1);
+	for(i = 0; i < WHEEL_EST_REJECT_MAX; i++)
+	{
+		diff = WheelEstimator_Update(&est, angle, stamp);
+		if((i < WHEEL_EST_REJECT_MAX - 1) ? ((diff != 0) || (est.RejectRun != i + 1)) : (est.Raw != angle))
+		{
+			printf("FAIL: jump: sample %d returned %d, %d in a row rejected\n", i, diff, est.RejectRun);
+			return false;
+		}
+		angle = (angle + 5) & (WHEEL_EST_COUNT - 1);
+		stamp += 1000;
+	}
+	if((diff != TEST_JUMP + 5 * WHEEL_EST_REJECT_MAX) || (est.RejectRun != 0)
+		|| (CTRL_TO_INT(est.Pos) != est.Raw) || (est.RejectNum != WHEEL_EST_REJECT_MAX))
+	{
+		printf("FAIL: jump: restarted with %d counts, pos %d raw %d\n", diff, (int)CTRL_TO_INT(est.Pos), est.Raw);
+		return false;
+	}
+
+	// ---- 4: 同じ時刻,短い間隔のサンプルは使わない ----
+	if((WheelEstimator_Update(&est, (_UWORD)(est.Raw + 9), est.Stamp) != 0)
+		|| (WheelEstimator_Update(&est, (_UWORD)(est.Raw + 1), est.Stamp + WHEEL_EST_DT_MIN_US - 1) != 0)
+		|| (est.Stamp != stamp - 1000) || (est.RejectNum != WHEEL_EST_REJECT_MAX))
+	{
+		printf("FAIL: a repeated stamp or a sample %d us after the last one was used\n", WHEEL_EST_DT_MIN_US - 1);
+		return false;
+	}
+
+	// ---- 4: 間隔が空いたら差分を返してやり直す ----
+	stamp = est.Stamp + WHEEL_EST_DT_MAX_US + 1;
+	angle = (est.Raw + 123) & (WHEEL_EST_COUNT - 1);
+	diff = WheelEstimator_Update(&est, angle, stamp);
+	if((diff != 123) || (est.Vel != 0) || (est.Stamp != stamp) || (CTRL_TO_INT(est.Pos) != angle))
+	{
+		printf("FAIL: gap: returned %d, vel %.3f\n", diff, CTRL_TO_FLOAT(est.Vel));
+		return false;
+	}
+
+	// ---- やり直した後も追従する ----
+	for(i = 0; i < 50; i++)
+	{
+		angle = (angle + 5) & (WHEEL_EST_COUNT - 1);
+		stamp += 1000;
+		WheelEstimator_Update(&est, angle, stamp);
+	}
+	if(fabs(CTRL_TO_FLOAT(est.Vel) - 5.0) > TEST_VEL_TOL)
+	{
+		printf("FAIL: gap: velocity %.3f after restarting\n", CTRL_TO_FLOAT(est.Vel));
+		return false;
+	}
+	return true;
+}
+
+/** AS5055の受信データを作る(偶数パリティ付き)
+ * @param angle: 角度 [count]
+ * @param error: エラーフラグ
+ * @retval _UWORD: 受信データ
+ */
+static _UWORD Test_Frame(_UWORD angle, bool error)
+{
+	// bit14,15(角度以外)は受け取る側で使わないので適当に埋める
+	return AppendEvenParity((_UWORD)((rand() & 0xC000) | (angle << 2) | (error ? AS_ERROR_FLAG : 0)));
+}
+
+/** 5: AS5055の平均,受信データの検査を確かめる
+ * @retval bool: true: 正しい
+ */
+static bool Test_AS5055(void)
+{
+	_UWORD angles[ENCODER_SAMPLING_NUM], got;
+	_UDWORD stamp;
+	int n, i, center, sum;
+
+	for(n = 0; n < TEST_AVG_SETS; n++)
+	{
+		// 半分は境目のまわり
+		center = (n & 1) ? (WHEEL_EST_COUNT - TEST_AVG_SPREAD / 2 + rand() % TEST_AVG_SPREAD) : rand();
+		sum = 0;
+		for(i = 0; i < ENCODER_SAMPLING_NUM; i++)
+		{
+			angles[i] = (_UWORD)((center + rand() % TEST_AVG_SPREAD - TEST_AVG_SPREAD / 2) & 0x0FFF);
+			sum += WheelEstimator_WrapDiff(angles[i], (_UWORD)(center & 0x0FFF));
+			EncL_recv = Test_Frame(angles[i], false);
+			_timeUS++;
+			AS5055_LeftEnc_CycleTransferEnd();
+			if(AS5055_GetStamp(ENC_L) != _timeUS)
+			{
+				printf("FAIL: AS5055 stamp %lu, received at %lu\n",
+						(unsigned long)AS5055_GetStamp(ENC_L), (unsigned long)_timeUS);
+				return false;
+			}
+		}
+		got = AS5055_GetAngle(ENC_L);
+		// 真の平均との差は整数の商の切り捨ての1カウントまで
+		if(abs(WheelEstimator_WrapDiff(got, (_UWORD)((center + (int)floor((double)sum / ENCODER_SAMPLING_NUM)) & 0x0FFF)))
+			> 1)
+		{
+			printf("FAIL: AS5055 average around %d: got %d\n", center & 0x0FFF, got);
+			return false;
+		}
+	}
+
+	// ---- パリティ異常,エラーフラグは捨てる ----
+	stamp = AS5055_GetStamp(ENC_L);
+	for(i = 0; i < 16; i++)
+	{
+		EncL_recv = (_UWORD)(Test_Frame(1000, false) ^ (1 << i));
+		_timeUS++;
+		AS5055_LeftEnc_CycleTransferEnd();
+	}
+	EncL_recv = Test_Frame(1000, true);
+	_timeUS++;
+	AS5055_LeftEnc_CycleTransferEnd();
+	if((AS5055_GetErrorCount(ENC_L) != 17) || (AS5055_GetStamp(ENC_L) != stamp) || (AS5055_GetAngle(ENC_L) != got))
+	{
+		printf("FAIL: AS5055 kept a bad frame (%lu dropped)\n", (unsigned long)AS5055_GetErrorCount(ENC_L));
+		return false;
+	}
+	printf("AS5055: %d averages across the wrap, 17 bad frames dropped\n", TEST_AVG_SETS);
+	return true;
+}
+
+/*----------------------------------------------------------------------
+	Main
+ ----------------------------------------------------------------------*/
+int main(void)
+{
+	srand(1);
+
+	if(!Test_WrapDiff())
+	{
+		return 1;
+	}
+	printf("wrap diff: %d pairs ok\n", WHEEL_EST_COUNT * WHEEL_EST_COUNT);
+
+	if(!Test_Traces() || !Test_Edges() || !Test_AS5055())
+	{
+		return 1;
+	}
+	printf("jump, short interval, gap: ok\n");
+	printf("%s: PASS\n", WHEEL_EST_TEST_NAME);
+	return 0;
+}
@@ -0,0 +1,14 @@
+/**
+ * @file  machine.h
+ * @brief ホストで組み込み関数(machine.h)の代わりにするもの
+ */
+
+#ifndef __HOST_MACHINE_H__
+#define __HOST_MACHINE_H__
+
+#define setpsw_i()
+#define clrpsw_i()
+#define nop()
+#define wait()
+
+#endif